@@ -1,50 +1,1220 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "assert.h"
-#include "compress40.h"
-#include "pnm.h"
+#include "arith.h"
+#include "archive.h"
+#include "batch.h"
+#include "patch.h"
+#include "pipeline.h"
+#include "sequence.h"
+#include "stats.h"
 
-static void (*compress_or_decompress)(FILE *input) = compress40;
+static Arith_codec *compress_or_decompress = Arith_compress;
+static int pipelined = 0;
+static unsigned scale = 1;
+static Arith_region crop;
+static int cropped = 0;
+static unsigned tile = 0;
+static int entropy = 0;
+static int predict = 0;
+static int progressive = 0;
+static int previewing = 0;
+static int sequence = 0;
+static long tile_index = -1;
+static unsigned threads = 0;
+static Arith_transform_op transform_op;
+static Arith_region box;
+static int stitching = 0;
+static Arith_direction direction;
+static unsigned piece_width = 0, piece_height = 0;
+static int analyzing = 0;
+static int detail = 0;
+static int histogram = 0;
+static long near = -1;
+static const char *archive_path = NULL;
+static int adding = 0, listing = 0;
+static const char *patch_path = NULL;
+static const char *old_path = NULL;
+static Arith_region *dirty = NULL;
+static unsigned ndirty = 0;
+
+/* an option and whether it was given, for the compatibility checks */
+typedef struct Given {
+        const char *name;
+        int set;
+} Given;
+
+static void usage(const char *progname);
+static void refuse(const char *progname, const char *option,
+                   const Given *given, unsigned ngiven);
+static void require(const char *progname, const char *option, int met,
+                    const char *needed);
+static void checkPartial(const char *progname, int batch);
+static void checkEncoding(const char *progname, int batch);
+static void checkPreview(const char *progname, int batch);
+static void checkSequence(const char *progname, int batch);
+static void checkReshaping(const char *progname, int batch);
+static void checkAnalysis(const char *progname, int batch);
+static void checkArchive(const char *progname, int batch,
+                         const char *outdir);
+static void checkPatch(const char *progname, int batch, const char *outdir);
+static const char *archiveOption(void);
+static unsigned parseScale(const char *progname, const char *arg);
+static int parseRegion(const char *arg, Arith_region *rect);
+static void parseTransform(const char *progname, const char *arg);
+static Arith_codec transformImage;
+static Arith_codec previewImage;
+static uint8_t *readImage(const char *progname, const char *path,
+                          size_t *n, int *mapped);
+static void releaseImage(uint8_t *src, size_t n, int mapped);
+static int stitchFiles(const char *progname, char **paths,
+                       unsigned npaths);
+static int splitFile(const char *progname, const char *path,
+                     const char *outdir);
+static Arith_piecefun writePiece;
+static int analyzeFiles(const char *progname, char **paths,
+                        unsigned npaths);
+static int encodeSequence(const char *progname, char **paths,
+                          unsigned npaths);
+static int decodeSequence(const char *progname, const char *path);
+static int patchFile(const char *progname, const char *path);
+static uint8_t *mapInput(FILE *fp, size_t *n);
+static void codeOne(const char *progname, FILE *fp);
+static Arith_status codeBuffer(const uint8_t *src, size_t n);
+static Archive_T openArchive(const char *progname);
+static int addToArchive(const char *progname, char **paths,
+                        unsigned npaths);
+static int listArchive(const char *progname);
+static int codeArchived(const char *progname, char **ids, unsigned nids,
+                        int batch, const char *outdir);
+static int codeBatch(char **paths, unsigned npaths, const char *outdir,
+                     unsigned threads, Archive_T archive);
 
 int main(int argc, char *argv[])
 {
         int i;
+        int batch = 0;
+        const char *outdir = NULL;
         if(argc == 1)
         {
-            fprintf(stderr, "Usage: %s -d [filename]\n"
-                    "       %s -c [filename]\n",
-                    argv[0], argv[0]);
-            exit(1);
+            usage(argv[0]);
         }
-        
+
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-c") == 0) {
-                        compress_or_decompress = compress40;
+                        compress_or_decompress = Arith_compress;
                 } else if (strcmp(argv[i], "-d") == 0) {
-                        compress_or_decompress = decompress40;
+                        compress_or_decompress = Arith_decompress;
+                } else if (strcmp(argv[i], "--stats") == 0) {
+                        Stats_enable();
+                } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+                        scale = parseScale(argv[0], argv[++i]);
+                } else if (strcmp(argv[i], "--region") == 0 &&
+                           i + 1 < argc) {
+                        if (!parseRegion(argv[++i], &crop)) {
+                                fprintf(stderr, "%s: --region must be "
+                                        "x,y,w,h with w and h positive\n",
+                                        argv[0]);
+                                exit(1);
+                        }
+                        cropped = 1;
+                } else if (strcmp(argv[i], "--transform") == 0 &&
+                           i + 1 < argc) {
+                        parseTransform(argv[0], argv[++i]);
+                        compress_or_decompress = transformImage;
+                } else if (strcmp(argv[i], "--stitch") == 0 &&
+                           i + 1 < argc) {
+                        i++;
+                        if (strcmp(argv[i], "across") == 0) {
+                                direction = ARITH_ACROSS;
+                        } else if (strcmp(argv[i], "down") == 0) {
+                                direction = ARITH_DOWN;
+                        } else {
+                                usage(argv[0]);
+                        }
+                        stitching = 1;
+                } else if (strcmp(argv[i], "--split") == 0 && i + 1 < argc) {
+                        char extra;
+                        if (sscanf(argv[++i], "%ux%u%c", &piece_width,
+                                   &piece_height, &extra) != 2 ||
+                            piece_width < 2 || piece_width % 2 != 0 ||
+                            piece_height < 2 || piece_height % 2 != 0) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--analyze") == 0) {
+                        analyzing = 1;
+                } else if (strcmp(argv[i], "--detail") == 0) {
+                        detail = 1;
+                } else if (strcmp(argv[i], "--histogram") == 0) {
+                        histogram = 1;
+                } else if (strcmp(argv[i], "--near") == 0 && i + 1 < argc) {
+                        near = atol(argv[++i]);
+                        if (near < 0 || near > 64) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--archive") == 0 &&
+                           i + 1 < argc) {
+                        archive_path = argv[++i];
+                } else if (strcmp(argv[i], "--archive-add") == 0 &&
+                           i + 1 < argc) {
+                        archive_path = argv[++i];
+                        adding = 1;
+                } else if (strcmp(argv[i], "--archive-list") == 0 &&
+                           i + 1 < argc) {
+                        archive_path = argv[++i];
+                        listing = 1;
+                } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+                        tile = atoi(argv[++i]);
+                        if (tile < 2 || tile % 2 != 0) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--entropy") == 0) {
+                        entropy = 1;
+                } else if (strcmp(argv[i], "--predict") == 0) {
+                        predict = 1;
+                } else if (strcmp(argv[i], "--progressive") == 0) {
+                        progressive = 1;
+                } else if (strcmp(argv[i], "--preview") == 0) {
+                        previewing = 1;
+                } else if (strcmp(argv[i], "--sequence") == 0) {
+                        sequence = 1;
+                } else if (strcmp(argv[i], "--patch") == 0 && i + 1 < argc) {
+                        patch_path = argv[++i];
+                } else if (strcmp(argv[i], "--dirty") == 0 && i + 1 < argc) {
+                        if (dirty == NULL) {
+                                dirty = malloc(argc * sizeof(*dirty));
+                                assert(dirty != NULL);
+                        }
+                        if (!parseRegion(argv[++i], &dirty[ndirty++])) {
+                                fprintf(stderr, "%s: --dirty must be "
+                                        "x,y,w,h with w and h positive\n",
+                                        argv[0]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--old") == 0 && i + 1 < argc) {
+                        old_path = argv[++i];
+                } else if (strcmp(argv[i], "--tile-index") == 0 &&
+                           i + 1 < argc) {
+                        tile_index = atol(argv[++i]);
+                        if (tile_index < 0) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--pipeline") == 0) {
+                        pipelined = 1;
+                } else if (strcmp(argv[i], "--batch") == 0) {
+                        batch = 1;
+                } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                        outdir = argv[++i];
+                } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                        threads = atoi(argv[++i]);
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
-                } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
-                                argv[0], argv[0]);
-                        exit(1);
+                } else if (!batch && !stitching && !analyzing && !adding &&
+                           !sequence && argc - i > 2) {
+                        usage(argv[0]);
                 } else {
                         break;
                 }
         }
+
+        checkPartial(argv[0], batch);
+        checkEncoding(argv[0], batch);
+        checkPreview(argv[0], batch);
+        checkSequence(argv[0], batch);
+        checkReshaping(argv[0], batch);
+        checkAnalysis(argv[0], batch);
+        checkArchive(argv[0], batch, outdir);
+        checkPatch(argv[0], batch, outdir);
+
+        if (previewing) {
+                compress_or_decompress = previewImage;
+        }
+
+        if (adding) {
+                if (i == argc) {
+                        usage(argv[0]);
+                }
+                return addToArchive(argv[0], argv + i, argc - i);
+        }
+        if (listing) {
+                if (i != argc) {
+                        usage(argv[0]);
+                }
+                return listArchive(argv[0]);
+        }
+        if (archive_path != NULL) {
+                if (batch ? outdir == NULL : argc - i != 1) {
+                        usage(argv[0]);
+                }
+                return codeArchived(argv[0], argv + i, argc - i, batch,
+                                    outdir);
+        }
+
+        if (patch_path != NULL) {
+                if (argc - i > 1) {
+                        usage(argv[0]);
+                }
+                return patchFile(argv[0], i < argc ? argv[i] : NULL);
+        }
+
+        if (analyzing) {
+                return analyzeFiles(argv[0], argv + i, argc - i);
+        }
+
+        if (sequence) {
+                if (compress_or_decompress == Arith_decompress) {
+                        if (argc - i > 1) {
+                                usage(argv[0]);
+                        }
+                        return decodeSequence(argv[0],
+                                              i < argc ? argv[i] : NULL);
+                }
+                if (i == argc) {
+                        usage(argv[0]);
+                }
+                return encodeSequence(argv[0], argv + i, argc - i);
+        }
+
+        if (stitching) {
+                if (i == argc) {
+                        usage(argv[0]);
+                }
+                return stitchFiles(argv[0], argv + i, argc - i);
+        }
+        if (piece_width > 0) {
+                if (outdir == NULL || argc - i > 1) {
+                        usage(argv[0]);
+                }
+                return splitFile(argv[0], i < argc ? argv[i] : NULL, outdir);
+        }
+
+        if (batch) {
+                if (outdir == NULL) {
+                        usage(argv[0]);
+                }
+                if (i < argc) {
+                        return codeBatch(argv + i, argc - i, outdir, threads,
+                                         NULL);
+                }
+                char **paths;
+                unsigned npaths = Batch_read_manifest(stdin, &paths);
+                int result = codeBatch(paths, npaths, outdir, threads,
+                                       NULL);
+                for (unsigned k = 0; k < npaths; k++) {
+                        free(paths[k]);
+                }
+                free(paths);
+                return result;
+        }
+
         assert(argc - i <= 1);    /* at most one file on command line */
         if (i < argc) {
                 FILE *fp = fopen(argv[i], "r");
-                assert(fp != NULL);
-                compress_or_decompress(fp);
+                if (fp == NULL) {
+                        perror(argv[i]);
+                        exit(1);
+                }
+                codeOne(argv[0], fp);
+                fclose(fp);
+        } else {
+                codeOne(argv[0], stdin);
+        }
+
+        return EXIT_SUCCESS;
+}
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s -d [--pipeline] [--stats] [filename]\n"
+                "       %s -c [--pipeline] [--stats] [filename]\n"
+                "       %s -d --scale 1/2|1/4|1/8 [--stats] [filename]\n"
+                "       %s -d --region x,y,w,h [--stats] [filename]\n"
+                "       %s -c [--tile size] [--entropy] [--predict] "
+                "[--stats] [filename]\n"
+                "       %s -c --progressive [--stats] [filename]\n"
+                "       %s -d --preview [--scale 1/2|1/4|1/8 | --region "
+                "x,y,w,h] [filename]\n"
+                "       %s -d [-j threads] [--tile-index k] [--stats] "
+                "[filename]\n"
+                "       %s -c --sequence frame ...\n"
+                "       %s -d --sequence [filename]\n"
+                "       %s --patch file [--dirty x,y,w,h ...] [--old "
+                "filename] [filename]\n"
+                "       %s -c|-d --batch -o outdir [-j threads] "
+                "[filename ...]\n"
+                "       %s --transform flipx|flipy|rot180|transpose|"
+                "crop=x,y,w,h\n"
+                "          [--tile size] [--entropy] [--predict] "
+                "[filename]\n"
+                "       %s --stitch across|down [--tile size] [--entropy] "
+                "[--predict]\n"
+                "          filename ...\n"
+                "       %s --split WxH -o outdir [--tile size] [--entropy] "
+                "[--predict]\n"
+                "          [filename]\n"
+                "       %s --analyze [--detail] [--histogram] [--near bits] "
+                "[filename ...]\n"
+                "       %s --archive-add archive filename ...\n"
+                "       %s --archive-list archive\n"
+                "       %s -d|--transform op [options] --archive archive id\n"
+                "       %s -d --batch -o outdir [-j threads] --archive "
+                "archive [id ...]\n",
+                progname, progname, progname, progname, progname, progname,
+                progname, progname, progname, progname, progname, progname,
+                progname, progname, progname, progname, progname, progname,
+                progname, progname);
+        exit(1);
+}
+
+/* exits with a message if any option in given other than option itself was
+ * given along with it */
+static void refuse(const char *progname, const char *option,
+                   const Given *given, unsigned ngiven)
+{
+        for (unsigned k = 0; k < ngiven; k++) {
+                if (given[k].set && strcmp(given[k].name, option) != 0) {
+                        fprintf(stderr, "%s: %s cannot be used with %s\n",
+                                progname, option, given[k].name);
+                        exit(1);
+                }
+        }
+}
+
+/* exits with a message unless what option needs was given */
+static void require(const char *progname, const char *option, int met,
+                    const char *needed)
+{
+        if (!met) {
+                fprintf(stderr, "%s: %s needs %s\n", progname, option,
+                        needed);
+                exit(1);
+        }
+}
+
+#define NGIVEN(given) (sizeof(given) / sizeof((given)[0]))
+
+/* thumbnails, regions and single tiles come from the in-memory decoder
+ * only, one at a time */
+static void checkPartial(const char *progname, int batch)
+{
+        const char *option = scale > 1 ? "--scale" :
+                             cropped ? "--region" :
+                             tile_index >= 0 ? "--tile-index" : NULL;
+        if (option == NULL) {
+                return;
+        }
+        require(progname, option, compress_or_decompress == Arith_decompress,
+                "-d");
+        Given given[] = {
+                { "--pipeline", pipelined }, { "--batch", batch },
+                { "--scale", scale > 1 }, { "--region", cropped },
+                { "--tile-index", tile_index >= 0 }
+        };
+        refuse(progname, option, given, NGIVEN(given));
+}
+
+/* tiles, entropy coding, prediction and layers are written by the
+ * in-memory encoder or after a transform */
+static void checkEncoding(const char *progname, int batch)
+{
+        const char *option = tile > 0 ? "--tile" :
+                             entropy ? "--entropy" :
+                             predict ? "--predict" :
+                             progressive ? "--progressive" : NULL;
+        if (option == NULL) {
+                return;
+        }
+        require(progname, option,
+                compress_or_decompress == Arith_compress ||
+                compress_or_decompress == transformImage,
+                "-c or --transform");
+        Given given[] = {
+                { "--pipeline", pipelined }, { "--batch", batch }
+        };
+        refuse(progname, option, given, NGIVEN(given));
+        if (progressive) {
+                Given layered[] = {
+                        { "--tile", tile > 0 }, { "--entropy", entropy },
+                        { "--predict", predict }
+                };
+                refuse(progname, "--progressive", layered, NGIVEN(layered));
+        }
+        if (entropy && tile > 0 && tile < ARITH_ENTROPY_MIN_TILE) {
+                fprintf(stderr, "%s: --entropy needs --tile %d or more\n",
+                        progname, ARITH_ENTROPY_MIN_TILE);
+                exit(1);
+        }
+}
+
+/* a preview decodes one image, whole or in part */
+static void checkPreview(const char *progname, int batch)
+{
+        if (!previewing) {
+                return;
+        }
+        require(progname, "--preview",
+                compress_or_decompress == Arith_decompress, "-d");
+        Given given[] = {
+                { "--pipeline", pipelined }, { "--batch", batch },
+                { "--tile-index", tile_index >= 0 },
+                { "--analyze", analyzing }, { "--stitch", stitching },
+                { "--split", piece_width > 0 },
+                { archiveOption(), archive_path != NULL }
+        };
+        refuse(progname, "--preview", given, NGIVEN(given));
+}
+
+/* a sequence is coded whole, with its own format */
+static void checkSequence(const char *progname, int batch)
+{
+        if (!sequence) {
+                return;
+        }
+        Given given[] = {
+                { "--transform", compress_or_decompress == transformImage },
+                { "--pipeline", pipelined }, { "--batch", batch },
+                { "--scale", scale > 1 }, { "--region", cropped },
+                { "--tile-index", tile_index >= 0 }, { "--tile", tile > 0 },
+                { "--entropy", entropy }, { "--predict", predict },
+                { "--progressive", progressive },
+                { "--preview", previewing }, { "--analyze", analyzing },
+                { "--stitch", stitching }, { "--split", piece_width > 0 },
+                { archiveOption(), archive_path != NULL }
+        };
+        refuse(progname, "--sequence", given, NGIVEN(given));
+}
+
+/* --transform, --stitch and --split work on whole images in memory, one
+ * of them at a time */
+static void checkReshaping(const char *progname, int batch)
+{
+        int transforming = compress_or_decompress == transformImage;
+        const char *option = transforming ? "--transform" :
+                             stitching ? "--stitch" :
+                             piece_width > 0 ? "--split" : NULL;
+        if (option == NULL) {
+                return;
+        }
+        Given given[] = {
+                { "--pipeline", pipelined }, { "--batch", batch },
+                { "--scale", scale > 1 }, { "--region", cropped },
+                { "--tile-index", tile_index >= 0 },
+                { "--transform", transforming }, { "--stitch", stitching },
+                { "--split", piece_width > 0 }
+        };
+        refuse(progname, option, given, NGIVEN(given));
+}
+
+/* --analyze reads its images and writes nothing; its own options need it */
+static void checkAnalysis(const char *progname, int batch)
+{
+        if (!analyzing) {
+                require(progname, "--detail", !detail, "--analyze");
+                require(progname, "--histogram", !histogram, "--analyze");
+                require(progname, "--near", near < 0, "--analyze");
+                return;
+        }
+        Given given[] = {
+                { "--pipeline", pipelined }, { "--batch", batch },
+                { "--scale", scale > 1 }, { "--region", cropped },
+                { "--tile-index", tile_index >= 0 }, { "--tile", tile > 0 },
+                { "--entropy", entropy }, { "--predict", predict },
+                { "--progressive", progressive }, { "--stitch", stitching },
+                { "--split", piece_width > 0 },
+                { "--transform", compress_or_decompress == transformImage }
+        };
+        refuse(progname, "--analyze", given, NGIVEN(given));
+}
+
+/* adding to and listing an archive take nothing else; coding images from
+ * one needs -d or --transform */
+static void checkArchive(const char *progname, int batch,
+                         const char *outdir)
+{
+        if (archive_path == NULL) {
+                return;
+        }
+        const char *option = archiveOption();
+        Given given[] = {
+                { "--pipeline", pipelined }, { "--analyze", analyzing },
+                { "--stitch", stitching }, { "--split", piece_width > 0 }
+        };
+        refuse(progname, option, given, NGIVEN(given));
+        if (adding || listing) {
+                Given alone[] = {
+                        { "--batch", batch }, { "--scale", scale > 1 },
+                        { "--region", cropped },
+                        { "--tile-index", tile_index >= 0 },
+                        { "--tile", tile > 0 }, { "--entropy", entropy },
+                        { "--predict", predict },
+                        { "--progressive", progressive },
+                        { "--archive-add", adding },
+                        { "--archive-list", listing },
+                        { "-o", outdir != NULL }
+                };
+                refuse(progname, option, alone, NGIVEN(alone));
+        } else {
+                require(progname, option,
+                        compress_or_decompress != Arith_compress,
+                        "-d or --transform");
+        }
+}
+
+/* --patch rewrites a format 2 file in place; --dirty and --old need it */
+static void checkPatch(const char *progname, int batch, const char *outdir)
+{
+        if (patch_path == NULL) {
+                require(progname, "--dirty", dirty == NULL, "--patch");
+                require(progname, "--old", old_path == NULL, "--patch");
+                return;
+        }
+        Given given[] = {
+                { "-d", compress_or_decompress == Arith_decompress },
+                { "--transform", compress_or_decompress == transformImage },
+                { "--pipeline", pipelined }, { "--batch", batch },
+                { "--tile", tile > 0 }, { "--entropy", entropy },
+                { "--predict", predict }, { "--progressive", progressive },
+                { "--sequence", sequence }, { "--analyze", analyzing },
+                { "--stitch", stitching }, { "--split", piece_width > 0 },
+                { archiveOption(), archive_path != NULL }, { "-o", outdir != NULL }
+        };
+        refuse(progname, "--patch", given, NGIVEN(given));
+}
+
+/* the archive option given, for messages */
+static const char *archiveOption(void)
+{
+        return adding ? "--archive-add" :
+               listing ? "--archive-list" : "--archive";
+}
+
+/* the denominator of a --scale argument "1/2", "1/4" or "1/8" ("1" is
+ * full size); anything else is a usage error */
+static unsigned parseScale(const char *progname, const char *arg)
+{
+        if (strcmp(arg, "1") == 0 || strcmp(arg, "1/1") == 0) {
+                return 1;
+        } else if (strcmp(arg, "1/2") == 0) {
+                return 2;
+        } else if (strcmp(arg, "1/4") == 0) {
+                return 4;
+        } else if (strcmp(arg, "1/8") == 0) {
+                return 8;
+        }
+        fprintf(stderr, "%s: --scale must be 1/2, 1/4 or 1/8\n", progname);
+        exit(1);
+}
+
+/* the rectangle "x,y,w,h" of --region and of a crop; 0 if arg is not
+ * one or is empty */
+static int parseRegion(const char *arg, Arith_region *rect)
+{
+        char extra;
+        return sscanf(arg, "%u,%u,%u,%u%c", &rect -> x, &rect -> y,
+                      &rect -> width, &rect -> height, &extra) == 4 &&
+               rect -> width > 0 && rect -> height > 0;
+}
+
+/* the op of a --transform argument; a crop must have even corners */
+static void parseTransform(const char *progname, const char *arg)
+{
+        static const struct {
+                const char *name;
+                Arith_transform_op op;
+        } ops[] = {
+                { "flipx", ARITH_FLIP_X }, { "flipy", ARITH_FLIP_Y },
+                { "rot180", ARITH_ROTATE_180 },
+                { "transpose", ARITH_TRANSPOSE }
+        };
+        for (unsigned k = 0; k < sizeof(ops) / sizeof(ops[0]); k++) {
+                if (strcmp(arg, ops[k].name) == 0) {
+                        transform_op = ops[k].op;
+                        return;
+                }
+        }
+        if (strncmp(arg, "crop=", 5) == 0 && parseRegion(arg + 5, &box) &&
+            (box.x | box.y | box.width | box.height) % 2 == 0) {
+                transform_op = ARITH_CROP;
+                return;
+        }
+        fprintf(stderr, "%s: --transform must be flipx, flipy, rot180, "
+                "transpose or crop=x,y,w,h with x, y, w and h even\n",
+                progname);
+        exit(1);
+}
+
+/* the codec of --transform: Arith_transform() with the op of the command
+ * line */
+static Arith_status transformImage(const uint8_t *src, size_t n,
+                                   uint8_t **out, size_t *outlen,
+                                   const Arith_options *opts)
+{
+        return Arith_transform(src, n, transform_op, &box, out, outlen,
+                               opts);
+}
+
+/* the codec of --preview: Arith_preview() of what has arrived of a format
+ * 5 image, which need not be final */
+static Arith_status previewImage(const uint8_t *src, size_t n,
+                                 uint8_t **out, size_t *outlen,
+                                 const Arith_options *opts)
+{
+        return Arith_preview(src, n, out, outlen, NULL, opts);
+}
+
+/* compress the frames at paths, in order, into one sequence on stdout
+ * (-c --sequence) */
+static int encodeSequence(const char *progname, char **paths,
+                          unsigned npaths)
+{
+        Sequence_T seq = Sequence_new();
+        assert(seq != NULL);
+        Arith_status status = ARITH_OK;
+        for (unsigned k = 0; k < npaths && status == ARITH_OK; k++) {
+                size_t n, outlen;
+                int mapped;
+                uint8_t *src = readImage(progname, paths[k], &n, &mapped);
+                uint8_t *out;
+                status = Sequence_encode(seq, src, n, &out, &outlen);
+                releaseImage(src, n, mapped);
+                if (status == ARITH_OK &&
+                    fwrite(out, 1, outlen, stdout) != outlen) {
+                        status = ARITH_EIO;
+                }
+                if (status != ARITH_OK) {
+                        fprintf(stderr, "%s: %s: %s\n", progname, paths[k],
+                                Arith_strerror(status));
+                }
+        }
+        Sequence_free(&seq);
+        return status == ARITH_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* decompress the sequence at path (stdin if NULL) to stdout, one P6 image
+ * after another, as the frames arrive (-d --sequence) */
+static int decodeSequence(const char *progname, const char *path)
+{
+        FILE *fp = path != NULL ? fopen(path, "r") : stdin;
+        if (fp == NULL) {
+                perror(path);
+                exit(1);
+        }
+        Sequence_T seq = Sequence_new();
+        size_t cap = 1 << 16, len = 0;
+        uint8_t *buf = malloc(cap);
+        assert(seq != NULL && buf != NULL);
+        unsigned frames = 0;
+        Arith_status status;
+        for (;;) {
+                uint8_t *out;
+                size_t used, outlen;
+                status = Sequence_decode(seq, buf, len, &used, &out,
+                                         &outlen);
+                if (status == ARITH_OK) {
+                        if (fwrite(out, 1, outlen, stdout) != outlen) {
+                                status = ARITH_EIO;
+                                break;
+                        }
+                        memmove(buf, buf + used, len - used);
+                        len -= used;
+                        frames++;
+                        continue;
+                }
+                if (status != ARITH_ETRUNCATED || feof(fp) || ferror(fp)) {
+                        break;
+                }
+                if (len == cap) {
+                        cap *= 2;
+                        buf = realloc(buf, cap);
+                        assert(buf != NULL);
+                }
+                len += fread(buf + len, 1, cap - len, fp);
+        }
+        /* the input may only end between frames, after the first */
+        if (ferror(fp)) {
+                status = ARITH_EIO;
+        } else if (status == ARITH_ETRUNCATED && len == 0 && frames > 0) {
+                status = ARITH_OK;
+        }
+        if (status != ARITH_OK) {
+                fprintf(stderr, "%s: %s: %s\n", progname,
+                        path != NULL ? path : "stdin",
+                        Arith_strerror(status));
+        }
+        free(buf);
+        Sequence_free(&seq);
+        if (fp != stdin) {
                 fclose(fp);
+        }
+        return status == ARITH_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* map a regular file into memory so that only the pages a region needs
+ * are read; returns NULL for pipes and anything else that cannot be
+ * mapped */
+static uint8_t *mapInput(FILE *fp, size_t *n)
+{
+        struct stat st;
+        if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode) ||
+            st.st_size == 0) {
+                return NULL;
+        }
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                         fileno(fp), 0);
+        if (map == MAP_FAILED) {
+                return NULL;
+        }
+        *n = st.st_size;
+        return map;
+}
+
+/* compress or decompress fp to stdout; exits on failure. With --pipeline
+ * the image is streamed through reader, transform and writer threads */
+static void codeOne(const char *progname, FILE *fp)
+{
+        uint8_t *src;
+        size_t n;
+        Arith_status status;
+        if (pipelined) {
+                status = compress_or_decompress == Arith_compress
+                         ? Pipeline_compress(fp, stdout)
+                         : Pipeline_decompress(fp, stdout);
+                if (status != ARITH_OK) {
+                        fprintf(stderr, "%s: %s\n", progname,
+                                Arith_strerror(status));
+                        exit(1);
+                }
+                return;
+        }
+        uint8_t *map = cropped ? mapInput(fp, &n) : NULL;
+        if (map != NULL) {
+                src = map;
+                status = ARITH_OK;
+        } else {
+                status = Arith_read_stream(fp, &src, &n);
+        }
+        if (status == ARITH_OK) {
+                status = codeBuffer(src, n);
+                if (map != NULL) {
+                        munmap(map, n);
+                } else {
+                        free(src);
+                }
+        }
+        if (status != ARITH_OK) {
+                fprintf(stderr, "%s: %s\n", progname, Arith_strerror(status));
+                exit(1);
+        }
+}
+
+/* compress or decompress src[0..n) to stdout with the options of the
+ * command line */
+static Arith_status codeBuffer(const uint8_t *src, size_t n)
+{
+        uint8_t *out;
+        size_t outlen;
+        Arith_status status;
+        Arith_options opts = { .scale = scale,
+                               .region = cropped ? &crop : NULL,
+                               .tile = tile, .entropy = entropy,
+                               .predict = predict,
+                               .progressive = progressive,
+                               .threads = threads };
+        if (tile_index >= 0) {
+                status = Arith_decompress_tile(src, n, tile_index, &out,
+                                               &outlen, &opts);
+        } else {
+                status = compress_or_decompress(src, n, &out, &outlen,
+                                                &opts);
+        }
+        if (status == ARITH_OK) {
+                Stats_clock clock = Stats_start();
+                if (fwrite(out, 1, outlen, stdout) != outlen) {
+                        status = ARITH_EIO;
+                }
+                Stats_lap(STATS_WRITE_OUTPUT, clock);
+                Stats_io(0, outlen);
+                free(out);
+        }
+        return status;
+}
+
+/* the archive of the command line; exits if it cannot be opened */
+static Archive_T openArchive(const char *progname)
+{
+        Archive_T archive;
+        Arith_status status = Archive_open(archive_path, &archive);
+        if (status != ARITH_OK) {
+                fprintf(stderr, "%s: %s: %s\n", progname, archive_path,
+                        Arith_strerror(status));
+                exit(1);
+        }
+        return archive;
+}
+
+/* add the compressed images at paths to the archive (--archive-add), each
+ * under its base name without the extension */
+static int addToArchive(const char *progname, char **paths, unsigned npaths)
+{
+        char **ids = malloc(npaths * sizeof(*ids));
+        uint8_t **images = malloc(npaths * sizeof(*images));
+        size_t *lens = malloc(npaths * sizeof(*lens));
+        int *mapped = malloc(npaths * sizeof(*mapped));
+        assert(ids != NULL && images != NULL && lens != NULL &&
+               mapped != NULL);
+        for (unsigned k = 0; k < npaths; k++) {
+                const char *base = strrchr(paths[k], '/');
+                base = base != NULL ? base + 1 : paths[k];
+                const char *dot = strrchr(base, '.');
+                ids[k] = dot != NULL && dot != base
+                         ? strndup(base, dot - base) : strdup(base);
+                assert(ids[k] != NULL);
+                images[k] = readImage(progname, paths[k], &lens[k],
+                                      &mapped[k]);
+        }
+        Arith_status status = Archive_append(archive_path, npaths,
+                                             (const char *const *)ids,
+                                             (const uint8_t *const *)images,
+                                             lens);
+        for (unsigned k = 0; k < npaths; k++) {
+                free(ids[k]);
+                releaseImage(images[k], lens[k], mapped[k]);
+        }
+        free(ids);
+        free(images);
+        free(lens);
+        free(mapped);
+        if (status != ARITH_OK) {
+                fprintf(stderr, "%s: %s: %s\n", progname, archive_path,
+                        Arith_strerror(status));
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+/* print the ID and size of every image of the archive (--archive-list) */
+static int listArchive(const char *progname)
+{
+        Archive_T archive = openArchive(progname);
+        for (unsigned k = 0; k < Archive_count(archive); k++) {
+                const char *id;
+                size_t idlen, len;
+                Archive_entry(archive, k, &id, &idlen, NULL, &len);
+                printf("%.*s\t%zu\n", (int)idlen, id, len);
+        }
+        Archive_free(&archive);
+        return EXIT_SUCCESS;
+}
+
+/* decode (or transform) images of the archive where they lie: the one
+ * with ID ids[0] to stdout, or with --batch those with the IDs given (all
+ * if none are) into outdir */
+static int codeArchived(const char *progname, char **ids, unsigned nids,
+                        int batch, const char *outdir)
+{
+        Archive_T archive = openArchive(progname);
+        int result = EXIT_SUCCESS;
+        if (batch) {
+                char **all = NULL;
+                if (nids == 0) {
+                        nids = Archive_count(archive);
+                        all = malloc((nids + 1) * sizeof(*all));
+                        assert(all != NULL);
+                        for (unsigned k = 0; k < nids; k++) {
+                                const char *id;
+                                size_t idlen;
+                                Archive_entry(archive, k, &id, &idlen, NULL,
+                                              NULL);
+                                all[k] = strndup(id, idlen);
+                                assert(all[k] != NULL);
+                        }
+                        ids = all;
+                }
+                result = codeBatch(ids, nids, outdir, threads, archive);
+                for (unsigned k = 0; all != NULL && k < nids; k++) {
+                        free(all[k]);
+                }
+                free(all);
+        } else {
+                const uint8_t *image;
+                size_t len;
+                Arith_status status = Archive_find(archive, ids[0], &image,
+                                                   &len)
+                                      ? codeBuffer(image, len)
+                                      : ARITH_EINVAL;
+                if (status != ARITH_OK) {
+                        fprintf(stderr, "%s: %s: %s\n", progname, ids[0],
+                                status == ARITH_EINVAL
+                                ? "no such image in the archive"
+                                : Arith_strerror(status));
+                        result = EXIT_FAILURE;
+                }
+        }
+        Archive_free(&archive);
+        return result;
+}
+
+/* bring the format 2 image in the file at patch_path up to date with the
+ * PPM image at path (stdin if NULL), looking only inside the --dirty
+ * rectangles and only at blocks that differ from --old, and report what
+ * was written (--patch) */
+static int patchFile(const char *progname, const char *path)
+{
+        size_t n, old_n = 0;
+        int mapped, old_mapped = 0;
+        uint8_t *src = readImage(progname, path, &n, &mapped);
+        uint8_t *old = old_path != NULL ?
+                       readImage(progname, old_path, &old_n, &old_mapped) :
+                       NULL;
+        Patch_stats stats;
+        Arith_status status = Patch_file(patch_path, src, n, dirty, ndirty,
+                                         old, old_n, &stats);
+        releaseImage(src, n, mapped);
+        if (old != NULL) {
+                releaseImage(old, old_n, old_mapped);
+        }
+        free(dirty);
+        if (status != ARITH_OK) {
+                fprintf(stderr, "%s: %s: %s\n", progname, patch_path,
+                        Arith_strerror(status));
+                return EXIT_FAILURE;
+        }
+        printf("%s: %llu of %llu blocks changed (%llu re-encoded, %llu "
+               "writes)\n", patch_path, (unsigned long long)stats.changed,
+               (unsigned long long)stats.blocks,
+               (unsigned long long)stats.encoded,
+               (unsigned long long)stats.writes);
+        return EXIT_SUCCESS;
+}
+
+/* the whole of path (stdin if NULL), mapped if it is a regular file so
+ * that only the pages copied are read; exits on failure. *mapped tells
+ * releaseImage() how to let it go */
+static uint8_t *readImage(const char *progname, const char *path,
+                          size_t *n, int *mapped)
+{
+        FILE *fp = path != NULL ? fopen(path, "r") : stdin;
+        if (fp == NULL) {
+                perror(path);
+                exit(1);
+        }
+        uint8_t *src = mapInput(fp, n);
+        *mapped = src != NULL;
+        if (src == NULL) {
+                Arith_status status = Arith_read_stream(fp, &src, n);
+                if (status != ARITH_OK) {
+                        fprintf(stderr, "%s: %s: %s\n", progname,
+                                path != NULL ? path : "stdin",
+                                Arith_strerror(status));
+                        exit(1);
+                }
+        }
+        if (fp != stdin) {
+                fclose(fp);
+        }
+        return src;
+}
+
+static void releaseImage(uint8_t *src, size_t n, int mapped)
+{
+        if (mapped) {
+                munmap(src, n);
+        } else {
+                free(src);
+        }
+}
+
+/* join the compressed images at paths (--stitch) and write the result to
+ * stdout */
+static int stitchFiles(const char *progname, char **paths, unsigned npaths)
+{
+        uint8_t **srcs = malloc(npaths * sizeof(*srcs));
+        size_t *ns = malloc(npaths * sizeof(*ns));
+        int *mapped = malloc(npaths * sizeof(*mapped));
+        assert(srcs != NULL && ns != NULL && mapped != NULL);
+        for (unsigned k = 0; k < npaths; k++) {
+                srcs[k] = readImage(progname, paths[k], &ns[k], &mapped[k]);
+        }
+
+        Arith_options opts = { .tile = tile, .entropy = entropy,
+                               .predict = predict,
+                               .progressive = progressive };
+        uint8_t *out;
+        size_t outlen;
+        Arith_status status = Arith_stitch((const uint8_t *const *)srcs, ns,
+                                           npaths, direction, &out, &outlen,
+                                           &opts);
+        for (unsigned k = 0; k < npaths; k++) {
+                releaseImage(srcs[k], ns[k], mapped[k]);
+        }
+        free(srcs);
+        free(ns);
+        free(mapped);
+        if (status == ARITH_OK) {
+                if (fwrite(out, 1, outlen, stdout) != outlen) {
+                        status = ARITH_EIO;
+                }
+                Stats_io(0, outlen);
+                free(out);
+        }
+        if (status != ARITH_OK) {
+                fprintf(stderr, "%s: %s\n", progname, Arith_strerror(status));
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+/* where writePiece() puts the pieces of --split */
+typedef struct Pieces {
+        const char *outdir;
+        const char *stem;       /* base name of the input, or "stdin" */
+        int stem_len;
+} Pieces;
+
+/* cut the compressed image at path (stdin if NULL) into pieces written to
+ * outdir as <base name>-<row>-<column>.c40 */
+static int splitFile(const char *progname, const char *path,
+                     const char *outdir)
+{
+        size_t n;
+        int mapped;
+        uint8_t *src = readImage(progname, path, &n, &mapped);
+
+        Pieces pieces = { outdir, "stdin", 5 };
+        if (path != NULL) {
+                const char *slash = strrchr(path, '/');
+                pieces.stem = slash != NULL ? slash + 1 : path;
+                const char *dot = strrchr(pieces.stem, '.');
+                pieces.stem_len = dot != NULL && dot != pieces.stem
+                                  ? dot - pieces.stem
+                                  : (int)strlen(pieces.stem);
+        }
+        Arith_options opts = { .tile = tile, .entropy = entropy,
+                               .predict = predict,
+                               .progressive = progressive };
+        Arith_status status = Arith_split(src, n, piece_width, piece_height,
+                                          writePiece, &pieces, &opts);
+        releaseImage(src, n, mapped);
+        if (status != ARITH_OK) {
+                fprintf(stderr, "%s: %s\n", progname, Arith_strerror(status));
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+/* the Arith_piecefun of --split: one file per piece */
+static Arith_status writePiece(unsigned row, unsigned col,
+                               const uint8_t *piece, size_t len, void *cl)
+{
+        Pieces *pieces = cl;
+        char *name = malloc(strlen(pieces -> outdir) + pieces -> stem_len +
+                            32);
+        assert(name != NULL);
+        sprintf(name, "%s/%.*s-%u-%u.c40", pieces -> outdir,
+                pieces -> stem_len, pieces -> stem, row, col);
+        FILE *fp = fopen(name, "wb");
+        Arith_status status = ARITH_OK;
+        if (fp == NULL) {
+                perror(name);
+                status = ARITH_EIO;
+        } else {
+                if (fwrite(piece, 1, len, fp) != len) {
+                        status = ARITH_EIO;
+                }
+                if (fclose(fp) != 0) {
+                        status = ARITH_EIO;
+                }
+                Stats_io(0, len);
+        }
+        free(name);
+        return status;
+}
+
+/* print one line of Arith_analyze() per path (stdin if there are none):
+ * name, size, mean luma, mean and variance of Pb and Pr, the hash and,
+ * with --histogram, the luma bins; with --near, then a line for each pair
+ * whose hashes are at most that many bits apart */
+static int analyzeFiles(const char *progname, char **paths, unsigned npaths)
+{
+        char *none[] = { NULL };
+        if (npaths == 0) {
+                paths = none;
+                npaths = 1;
+        }
+        uint64_t *hashes = malloc(npaths * sizeof(*hashes));
+        int *found = malloc(npaths * sizeof(*found));
+        assert(hashes != NULL && found != NULL);
+        int result = EXIT_SUCCESS;
+        for (unsigned k = 0; k < npaths; k++) {
+                const char *name = paths[k] != NULL ? paths[k] : "-";
+                size_t n;
+                int mapped;
+                uint8_t *src = readImage(progname, paths[k], &n, &mapped);
+                Arith_summary s;
+                Arith_status status = Arith_analyze(src, n, detail, &s,
+                                                    NULL);
+                releaseImage(src, n, mapped);
+                found[k] = status == ARITH_OK;
+                if (status != ARITH_OK) {
+                        fprintf(stderr, "%s: %s: %s\n", progname, name,
+                                Arith_strerror(status));
+                        result = EXIT_FAILURE;
+                        continue;
+                }
+                hashes[k] = s.hash;
+                printf("%s\t%ux%u\tY %.4f\tPb %.4f %.6f\tPr %.4f %.6f"
+                       "\t%016llx", name, s.width, s.height, s.mean_y,
+                       s.mean_pb, s.var_pb, s.mean_pr, s.var_pr,
+                       (unsigned long long)s.hash);
+                for (unsigned j = 0; histogram && j < ARITH_LUMA_BINS; j++) {
+                        printf("%c%llu", j == 0 ? '\t' : ' ',
+                               (unsigned long long)s.luma[j]);
+                }
+                printf("\n");
+        }
+        for (unsigned k = 0; near >= 0 && k < npaths; k++) {
+                for (unsigned j = k + 1; found[k] && j < npaths; j++) {
+                        unsigned distance = Arith_hash_distance(hashes[k],
+                                                                hashes[j]);
+                        if (found[j] && distance <= near) {
+                                printf("near\t%s\t%s\t%u\n", paths[k],
+                                       paths[j], distance);
+                        }
+                }
+        }
+        free(hashes);
+        free(found);
+        return result;
+}
+
+/* code every path into outdir and report throughput on stderr; the paths
+ * come from the command line or, when there are none, from stdin. With an
+ * archive they are the IDs of its images */
+static int codeBatch(char **paths, unsigned npaths, const char *outdir,
+                     unsigned threads, Archive_T archive)
+{
+        Batch_stats stats;
+        const char *extension =
+                compress_or_decompress == Arith_compress ? "c40" : "ppm";
+        if (archive != NULL) {
+                Batch_run_archive(compress_or_decompress, archive, paths,
+                                  npaths, outdir, extension, threads,
+                                  &stats);
         } else {
-                compress_or_decompress(stdin);
+                Batch_run(compress_or_decompress, paths, npaths, outdir,
+                          extension, threads, &stats);
         }
 
-        return EXIT_SUCCESS; 
+        double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+        fprintf(stderr, "batch: %u files, %u failed, %.1f MB in, "
+                "%.1f MB out, %.3f s, %.1f MB/s, %.1f files/s\n",
+                stats.files, stats.failures, stats.bytes_in / 1e6,
+                stats.bytes_out / 1e6, stats.seconds,
+                stats.bytes_in / 1e6 / seconds, stats.files / seconds);
+        return stats.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
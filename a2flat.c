@@ -0,0 +1,166 @@
+#include <stdlib.h>
+
+#include <a2flat.h>
+#include "assert.h"
+
+/*
+ * A flat array keeps its cells in one row-major block right after this
+ * header, so cell (i, j) is at elems + (j * width + i) * size. The header
+ * is padded to 16 bytes to keep the cells aligned.
+ */
+typedef struct Flat {
+        int width, height;
+        int size;
+        int pad;
+        char elems[];
+} *Flat;
+
+static inline void *cell(Flat flat, int i, int j)
+{
+        return flat->elems + ((size_t)j * flat->width + i) * flat->size;
+}
+
+static void init(Flat flat, int width, int height, int size)
+{
+        flat->width  = width;
+        flat->height = height;
+        flat->size   = size;
+}
+
+/*********************************************/
+/* Define a private version of each function */
+/* in A2Methods_T that we implement          */
+/*********************************************/
+
+static A2Methods_UArray2 new(int width, int height, int size)
+{
+        assert(width >= 0 && height >= 0 && size > 0);
+        Flat flat = malloc(sizeof(*flat) + (size_t)width * height * size);
+        assert(flat != NULL);
+        init(flat, width, height, size);
+        return flat;
+}
+
+static A2Methods_UArray2 new_with_blocksize(int width, int height,
+                                            int size,  int blocksize)
+{
+        (void) blocksize;
+        return new(width, height, size);
+}
+
+static void a2free(A2Methods_UArray2 *array2p)
+{
+        assert(array2p && *array2p);
+        free(*array2p);
+        *array2p = NULL;
+}
+
+static int width(A2Methods_UArray2 array2)
+{
+        assert(array2);
+        return ((Flat)array2)->width;
+}
+
+static int height(A2Methods_UArray2 array2)
+{
+        assert(array2);
+        return ((Flat)array2)->height;
+}
+
+static int size(A2Methods_UArray2 array2)
+{
+        assert(array2);
+        return ((Flat)array2)->size;
+}
+
+static int blocksize(A2Methods_UArray2 array2)
+{
+        (void)array2;
+        return 1;
+}
+
+static A2Methods_Object *at(A2Methods_UArray2 array2, int i, int j)
+{
+        Flat flat = array2;
+        assert(flat);
+        assert(i >= 0 && i < flat->width && j >= 0 && j < flat->height);
+        return cell(flat, i, j);
+}
+
+static void map_row_major(A2Methods_UArray2 array2,
+                          A2Methods_applyfun apply,
+                          void *cl)
+{
+        Flat flat = array2;
+        assert(flat);
+        char *elem = flat->elems;  /* cells are visited in memory order */
+        for (int j = 0; j < flat->height; j++)
+                for (int i = 0; i < flat->width; i++, elem += flat->size)
+                        apply(i, j, array2, elem, cl);
+}
+
+static void map_col_major(A2Methods_UArray2   array2,
+                          A2Methods_applyfun  apply,
+                          void               *cl)
+{
+        Flat flat = array2;
+        assert(flat);
+        for (int i = 0; i < flat->width; i++)
+                for (int j = 0; j < flat->height; j++)
+                        apply(i, j, array2, cell(flat, i, j), cl);
+}
+
+static void small_map_row_major(A2Methods_UArray2        array2,
+                                A2Methods_smallapplyfun  apply,
+                                void                    *cl)
+{
+        Flat flat = array2;
+        assert(flat);
+        size_t n = (size_t)flat->width * flat->height;
+        char *elem = flat->elems;
+        for (size_t k = 0; k < n; k++, elem += flat->size)
+                apply(elem, cl);
+}
+
+static void small_map_col_major(A2Methods_UArray2        array2,
+                                A2Methods_smallapplyfun  apply,
+                                void                    *cl)
+{
+        Flat flat = array2;
+        assert(flat);
+        for (int i = 0; i < flat->width; i++)
+                for (int j = 0; j < flat->height; j++)
+                        apply(cell(flat, i, j), cl);
+}
+
+static struct A2Methods_T uarray2_methods_flat_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        map_row_major,
+        map_col_major,
+        NULL,
+        map_row_major,
+        small_map_row_major,
+        small_map_col_major,
+        NULL,
+        small_map_row_major
+};
+
+A2Methods_T uarray2_methods_flat = &uarray2_methods_flat_struct;
+
+A2Methods_UArray2 A2flat_new_in(Scratch_T scratch, int width, int height,
+                                int size)
+{
+        assert(scratch && width >= 0 && height >= 0 && size > 0);
+        Flat flat = Scratch_alloc(scratch, sizeof(*flat) +
+                                  (size_t)width * height * size);
+        if (flat != NULL)
+                init(flat, width, height, size);
+        return flat;
+}
@@ -0,0 +1,11 @@
+#include <a2methods.h>
+#include "scratch.h"
+
+/* functions for arrays stored in one contiguous row-major block */
+extern A2Methods_T uarray2_methods_flat;
+
+/* creates a flat array inside scratch instead of with malloc; it goes
+ * away at the next Scratch_reset() and must not be passed to 'free'.
+ * Returns NULL when the arena cannot grow. */
+extern A2Methods_UArray2 A2flat_new_in(Scratch_T scratch, int width,
+                                       int height, int size);
@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <a2lazy.h>
+#include "assert.h"
+#include "codec.h"
+#include "codeword.h"
+
+#define DEFAULT_TILE 64
+#define DEFAULT_CACHE 16
+
+/*
+ * A lazy array reads the plain grid of Arith_codewords(): the file's own
+ * codewords when it is format 2, otherwise a copy. Each slot
+ * of the cache holds the pixels of one tile, tile pixels to a row, and
+ * the stamp of its last use; the slot with the oldest stamp is refilled
+ * on a miss. 'last' is checked first, since neighbouring cells are
+ * usually asked for in turn.
+ */
+typedef struct Slot {
+        int tx, ty;             /* the tile held, or -1, -1 */
+        unsigned long stamp;
+        struct Pnm_rgb *pixels;
+} Slot;
+
+typedef struct Lazy {
+        int width, height;
+        int tile;
+        const uint8_t *codewords;
+        uint8_t *owned;         /* a buffer freed with the array, or NULL */
+        void *map;              /* the file from A2lazy_open(), or NULL */
+        size_t maplen;
+        int nslots;
+        Slot *slots;
+        Slot *last;
+        unsigned long clock;
+} *Lazy;
+
+/* decodes the w x h pixels whose top left corner is (x, y), all even, to
+ * dest, stride pixels to a row */
+static void decodeRect(Lazy lazy, int x, int y, int w, int h,
+                       struct Pnm_rgb *dest, int stride)
+{
+        size_t row = (size_t)(lazy->width / 2) * CODEWORD_BYTES;
+        const uint8_t *src = lazy->codewords + (size_t)(y / 2) * row +
+                             (size_t)(x / 2) * CODEWORD_BYTES;
+        for (int r = 0; r < h; r += 2, src += row, dest += 2 * stride)
+                decodeBlockRow(src, w / 2, 255, dest, dest + stride);
+}
+
+/* the slot holding tile (tx, ty), decoding it into the least recently
+ * used slot if no slot does */
+static Slot *fetch(Lazy lazy, int tx, int ty)
+{
+        Slot *slot = lazy->last;
+        if (slot->tx != tx || slot->ty != ty) {
+                Slot *oldest = &lazy->slots[0];
+                slot = NULL;
+                for (int k = 0; k < lazy->nslots && slot == NULL; k++) {
+                        if (lazy->slots[k].tx == tx &&
+                            lazy->slots[k].ty == ty)
+                                slot = &lazy->slots[k];
+                        else if (lazy->slots[k].stamp < oldest->stamp)
+                                oldest = &lazy->slots[k];
+                }
+                if (slot == NULL) {
+                        slot = oldest;
+                        if (slot->pixels == NULL) {
+                                slot->pixels = malloc((size_t)lazy->tile *
+                                                      lazy->tile *
+                                                      sizeof(*slot->pixels));
+                                assert(slot->pixels != NULL);
+                        }
+                        int x = tx * lazy->tile, y = ty * lazy->tile;
+                        int w = lazy->width - x < lazy->tile
+                                ? lazy->width - x : lazy->tile;
+                        int h = lazy->height - y < lazy->tile
+                                ? lazy->height - y : lazy->tile;
+                        decodeRect(lazy, x, y, w, h, slot->pixels,
+                                   lazy->tile);
+                        slot->tx = tx;
+                        slot->ty = ty;
+                }
+                lazy->last = slot;
+        }
+        slot->stamp = ++lazy->clock;
+        return slot;
+}
+
+/* a lazy array over comp[0..n); map, if not NULL, is released with it */
+static Lazy lazyNew(const uint8_t *comp, size_t n, int blocksize,
+                   int cache, void *map, Arith_status *status)
+{
+        assert(blocksize >= 0 && blocksize % 2 == 0 && cache >= 0);
+        unsigned width, height;
+        const uint8_t *codewords;
+        uint8_t *owned;
+        Arith_status result = Arith_codewords(comp, n, &width, &height,
+                                              &codewords, &owned);
+        if (status != NULL)
+                *status = result;
+        if (result != ARITH_OK)
+                return NULL;
+
+        Lazy lazy = malloc(sizeof(*lazy));
+        assert(lazy != NULL);
+        lazy->width = width;
+        lazy->height = height;
+        lazy->tile = blocksize > 0 ? blocksize : DEFAULT_TILE;
+        lazy->codewords = codewords;
+        lazy->owned = owned;
+        lazy->map = map;
+        lazy->maplen = n;
+        lazy->nslots = cache > 0 ? cache : DEFAULT_CACHE;
+        lazy->slots = malloc(lazy->nslots * sizeof(*lazy->slots));
+        assert(lazy->slots != NULL);
+        for (int k = 0; k < lazy->nslots; k++)
+                lazy->slots[k] = (Slot){ -1, -1, 0, NULL };
+        lazy->last = &lazy->slots[0];
+        lazy->clock = 0;
+        return lazy;
+}
+
+/*********************************************/
+/* Define a private version of each function */
+/* in A2Methods_T that we implement          */
+/*********************************************/
+
+static A2Methods_UArray2 new(int width, int height, int size)
+{
+        (void)width;
+        (void)height;
+        (void)size;
+        assert(!"lazy arrays are opened with A2lazy_open()");
+        return NULL;
+}
+
+static A2Methods_UArray2 new_with_blocksize(int width, int height,
+                                            int size, int blocksize)
+{
+        (void)blocksize;
+        return new(width, height, size);
+}
+
+static void a2free(A2Methods_UArray2 *array2p)
+{
+        assert(array2p && *array2p);
+        Lazy lazy = *array2p;
+        for (int k = 0; k < lazy->nslots; k++)
+                free(lazy->slots[k].pixels);
+        free(lazy->slots);
+        free(lazy->owned);
+        if (lazy->map != NULL)
+                munmap(lazy->map, lazy->maplen);
+        free(lazy);
+        *array2p = NULL;
+}
+
+static int width(A2Methods_UArray2 array2)
+{
+        assert(array2);
+        return ((Lazy)array2)->width;
+}
+
+static int height(A2Methods_UArray2 array2)
+{
+        assert(array2);
+        return ((Lazy)array2)->height;
+}
+
+static int size(A2Methods_UArray2 array2)
+{
+        assert(array2);
+        return sizeof(struct Pnm_rgb);
+}
+
+static int blocksize(A2Methods_UArray2 array2)
+{
+        assert(array2);
+        return ((Lazy)array2)->tile;
+}
+
+static A2Methods_Object *at(A2Methods_UArray2 array2, int i, int j)
+{
+        Lazy lazy = array2;
+        assert(lazy);
+        assert(i >= 0 && i < lazy->width && j >= 0 && j < lazy->height);
+        Slot *slot = fetch(lazy, i / lazy->tile, j / lazy->tile);
+        return &slot->pixels[(j % lazy->tile) * lazy->tile +
+                             i % lazy->tile];
+}
+
+/* two scanlines at a time, decoded straight from the codewords */
+static void map_row_major(A2Methods_UArray2 array2,
+                          A2Methods_applyfun apply,
+                          void *cl)
+{
+        Lazy lazy = array2;
+        assert(lazy);
+        struct Pnm_rgb *rows = malloc(2 * (size_t)lazy->width *
+                                      sizeof(*rows));
+        assert(rows != NULL);
+        for (int j = 0; j < lazy->height; j += 2) {
+                decodeRect(lazy, 0, j, lazy->width, 2, rows, lazy->width);
+                for (int i = 0; i < 2 * lazy->width; i++)
+                        apply(i % lazy->width, j + i / lazy->width, array2,
+                              &rows[i], cl);
+        }
+        free(rows);
+}
+
+/* two columns at a time, one codeword from each row of blocks */
+static void map_col_major(A2Methods_UArray2   array2,
+                          A2Methods_applyfun  apply,
+                          void               *cl)
+{
+        Lazy lazy = array2;
+        assert(lazy);
+        struct Pnm_rgb *cols = malloc(2 * (size_t)lazy->height *
+                                      sizeof(*cols));
+        assert(cols != NULL);
+        for (int i = 0; i < lazy->width; i += 2) {
+                decodeRect(lazy, i, 0, 2, lazy->height, cols, 2);
+                for (int c = 0; c < 2; c++)
+                        for (int j = 0; j < lazy->height; j++)
+                                apply(i + c, j, array2, &cols[2 * j + c],
+                                      cl);
+        }
+        free(cols);
+}
+
+/* a tile at a time, through a buffer of its own */
+static void map_block_major(A2Methods_UArray2   array2,
+                            A2Methods_applyfun  apply,
+                            void               *cl)
+{
+        Lazy lazy = array2;
+        assert(lazy);
+        int tile = lazy->tile;
+        struct Pnm_rgb *pixels = malloc((size_t)tile * tile *
+                                        sizeof(*pixels));
+        assert(pixels != NULL);
+        for (int y = 0; y < lazy->height; y += tile) {
+                for (int x = 0; x < lazy->width; x += tile) {
+                        int w = lazy->width - x < tile ? lazy->width - x
+                                                       : tile;
+                        int h = lazy->height - y < tile ? lazy->height - y
+                                                        : tile;
+                        decodeRect(lazy, x, y, w, h, pixels, tile);
+                        for (int j = 0; j < h; j++)
+                                for (int i = 0; i < w; i++)
+                                        apply(x + i, y + j, array2,
+                                              &pixels[j * tile + i], cl);
+                }
+        }
+        free(pixels);
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void                    *cl;
+};
+
+static void apply_small(int i, int j, A2Methods_UArray2 array2,
+                        A2Methods_Object *ptr, void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)array2;
+        cl->apply(ptr, cl->cl);
+}
+
+static void small_map_row_major(A2Methods_UArray2        array2,
+                                A2Methods_smallapplyfun  apply,
+                                void                    *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_row_major(array2, apply_small, &mycl);
+}
+
+static void small_map_col_major(A2Methods_UArray2        array2,
+                                A2Methods_smallapplyfun  apply,
+                                void                    *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_col_major(array2, apply_small, &mycl);
+}
+
+static void small_map_block_major(A2Methods_UArray2        array2,
+                                  A2Methods_smallapplyfun  apply,
+                                  void                    *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_block_major(array2, apply_small, &mycl);
+}
+
+static struct A2Methods_T uarray2_methods_lazy_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        map_row_major,
+        map_col_major,
+        map_block_major,
+        map_row_major,
+        small_map_row_major,
+        small_map_col_major,
+        small_map_block_major,
+        small_map_row_major
+};
+
+A2Methods_T uarray2_methods_lazy = &uarray2_methods_lazy_struct;
+
+A2Methods_UArray2 A2lazy_new(const uint8_t *comp, size_t n, int blocksize,
+                             int cache, Arith_status *status)
+{
+        assert(comp);
+        return lazyNew(comp, n, blocksize, cache, NULL, status);
+}
+
+A2Methods_UArray2 A2lazy_open(const char *path, int blocksize, int cache,
+                              Arith_status *status)
+{
+        assert(path);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL) {
+                if (status != NULL)
+                        *status = ARITH_EIO;
+                return NULL;
+        }
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) &&
+            st.st_size > 0)
+                map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                           fileno(fp), 0);
+        if (map != MAP_FAILED) {
+                fclose(fp);
+                Lazy lazy = lazyNew(map, st.st_size, blocksize, cache, map,
+                                 status);
+                if (lazy == NULL)
+                        munmap(map, st.st_size);
+                return lazy;
+        }
+
+        /* pipes and such are read whole, and a format 2 buffer is kept
+         * for the life of the array */
+        uint8_t *buf;
+        size_t n;
+        Arith_status result = Arith_read_stream(fp, &buf, &n);
+        fclose(fp);
+        if (result != ARITH_OK) {
+                if (status != NULL)
+                        *status = result;
+                return NULL;
+        }
+        Lazy lazy = lazyNew(buf, n, blocksize, cache, NULL, status);
+        if (lazy != NULL && lazy->owned == NULL)
+                lazy->owned = buf;
+        else
+                free(buf);
+        return lazy;
+}
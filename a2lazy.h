@@ -0,0 +1,29 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <a2methods.h>
+#include "arith.h"
+
+/* functions for read-only arrays of struct Pnm_rgb (denominator 255) that
+ * decode a compressed image a tile at a time, as cells are asked for.
+ * 'new' and 'new_with_blocksize' are checked runtime errors: open one with
+ * A2lazy_open() or A2lazy_new() and release it with 'free'. A pointer from
+ * 'at' is good until the next call on the array; a cell written through
+ * it keeps its value only while its tile stays cached. The maps stream
+ * the image in their order without touching the cache, and 'blocksize'
+ * is the side of a tile, the unit of block_major. */
+extern A2Methods_T uarray2_methods_lazy;
+
+/* opens the compressed image (any format) in the file at path, mapping a
+ * format 2 file so that only the codewords of the tiles used are read.
+ * Tiles are blocksize x blocksize pixels (0: 64; otherwise even) and at
+ * most cache of them (0: 16) are kept, the least recently used going
+ * first. Returns NULL, with the reason in *status if status is not NULL,
+ * when the image cannot be read. */
+extern A2Methods_UArray2 A2lazy_open(const char *path, int blocksize,
+                                     int cache, Arith_status *status);
+
+/* the same for the compressed image in comp[0..n), which must outlive the
+ * array when it is in format 2 */
+extern A2Methods_UArray2 A2lazy_new(const uint8_t *comp, size_t n,
+                                    int blocksize, int cache,
+                                    Arith_status *status);
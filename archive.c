@@ -0,0 +1,438 @@
+/*********************************************************************
+ *                     archive.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for image archives. An open
+ *              archive is just the mapped file and where its index and
+ *              names start; every entry is decoded from the index when
+ *              it is asked for. Adding images merges the sorted new IDs
+ *              into the sorted old ones and rewrites only the index.
+ *********************************************************************/
+
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "assert.h"
+#include "archive.h"
+
+#define T Archive_T
+
+/* images start with this, whatever their format */
+#define IMAGE_MAGIC "COMP40 Compressed image format "
+
+struct T {
+    const uint8_t *data;
+    size_t n;
+    unsigned count;
+    const uint8_t *index;
+    const uint8_t *names;
+    size_t names_len;
+};
+
+/* an entry as the index holds it */
+typedef struct Entry {
+    const char *id;
+    size_t idlen;
+    uint64_t offset, length;
+} Entry;
+
+static Arith_status parse(const uint8_t *data, size_t n, struct T *archive);
+static Entry entryAt(const struct T *archive, unsigned k);
+static int compareIds(const char *x, size_t xlen, const char *y,
+                      size_t ylen);
+static int compareEntries(const void *x, const void *y);
+static Arith_status writeAll(int fd, const void *buf, size_t len,
+                             off_t offset);
+static uint64_t getBig(const uint8_t *src, unsigned bytes);
+static void putBig(uint8_t *dest, uint64_t value, unsigned bytes);
+
+
+/*  Name: Archive_open
+ *  Purpose: This function maps an archive read-only.
+ *  Input: the path and the location for the archive
+ *  Output: ARITH_OK, ARITH_EIO or ARITH_EBADFORMAT
+ *  Error condition: ARITH_EINVAL if a pointer is NULL.
+ */
+Arith_status Archive_open(const char *path, T *archive)
+{
+    if (path == NULL || archive == NULL) {
+        return ARITH_EINVAL;
+    }
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return ARITH_EIO;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return ARITH_EIO;
+    }
+    struct T parsed;
+    Arith_status status = parse(map, st.st_size, &parsed);
+    if (status == ARITH_OK) {
+        *archive = malloc(sizeof(**archive));
+        status = *archive == NULL ? ARITH_ENOMEM : ARITH_OK;
+    }
+    if (status != ARITH_OK) {
+        munmap(map, st.st_size);
+        return status;
+    }
+    **archive = parsed;
+    return ARITH_OK;
+}
+
+/*  Name: Archive_free
+ *  Purpose: This function unmaps and frees an archive.
+ *  Error condition: CRE if archive or *archive is NULL.
+ */
+void Archive_free(T *archive)
+{
+    assert(archive != NULL && *archive != NULL);
+    munmap((void *)(*archive) -> data, (*archive) -> n);
+    free(*archive);
+    *archive = NULL;
+}
+
+unsigned Archive_count(T archive)
+{
+    assert(archive != NULL);
+    return archive -> count;
+}
+
+/*  Name: Archive_entry
+ *  Purpose: This function reports entry k of the index.
+ *  Error condition: CRE if archive is NULL or k is out of range.
+ */
+void Archive_entry(T archive, unsigned k, const char **id, size_t *idlen,
+                   const uint8_t **image, size_t *len)
+{
+    assert(archive != NULL && k < archive -> count);
+    Entry entry = entryAt(archive, k);
+    if (id != NULL) {
+        *id = entry.id;
+    }
+    if (idlen != NULL) {
+        *idlen = entry.idlen;
+    }
+    if (image != NULL) {
+        *image = archive -> data + entry.offset;
+    }
+    if (len != NULL) {
+        *len = entry.length;
+    }
+}
+
+/*  Name: Archive_find
+ *  Purpose: This function binary searches the index for an ID.
+ *  Input: the archive, the ID and locations for the image and its length
+ *  Output: 1 if found, 0 if not
+ *  Error condition: CRE if archive or id is NULL.
+ */
+int Archive_find(T archive, const char *id, const uint8_t **image,
+                 size_t *len)
+{
+    assert(archive != NULL && id != NULL);
+    size_t idlen = strlen(id);
+    unsigned low = 0, high = archive -> count;
+    while (low < high) {
+        unsigned mid = low + (high - low) / 2;
+        Entry entry = entryAt(archive, mid);
+        int order = compareIds(entry.id, entry.idlen, id, idlen);
+        if (order == 0) {
+            Archive_entry(archive, mid, NULL, NULL, image, len);
+            return 1;
+        } else if (order < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return 0;
+}
+
+/*  Name: Archive_append
+ *  Purpose: This function writes the new images where the old index
+ *           starts, then the merged index, names and trailer after them.
+ *           If a write fails, the old index and trailer are put back and
+ *           the file is cut to its old length.
+ *  Input: the path, the number of images, their IDs, the images and their
+ *         lengths
+ *  Output: ARITH_OK, or the reason nothing was added
+ *  Error condition: ARITH_EINVAL if a pointer is NULL.
+ */
+Arith_status Archive_append(const char *path, unsigned count,
+                            const char *const *ids,
+                            const uint8_t *const *images, const size_t *lens)
+{
+    if (path == NULL || (count > 0 &&
+                         (ids == NULL || images == NULL || lens == NULL))) {
+        return ARITH_EINVAL;
+    }
+    Entry *added = malloc((count + 1) * sizeof(*added));
+    if (added == NULL) {
+        return ARITH_ENOMEM;
+    }
+    for (unsigned k = 0; k < count; k++) {
+        if (ids[k] == NULL || images[k] == NULL || ids[k][0] == '\0') {
+            free(added);
+            return ARITH_EINVAL;
+        }
+        if (lens[k] < strlen(IMAGE_MAGIC) ||
+            memcmp(images[k], IMAGE_MAGIC, strlen(IMAGE_MAGIC)) != 0) {
+            free(added);
+            return ARITH_EBADFORMAT;
+        }
+        /* offset holds k until the image is written */
+        added[k] = (Entry){ ids[k], strlen(ids[k]), k, lens[k] };
+    }
+    qsort(added, count, sizeof(*added), compareEntries);
+    for (unsigned k = 1; k < count; k++) {
+        if (compareEntries(&added[k - 1], &added[k]) == 0) {
+            free(added);
+            return ARITH_EINVAL;
+        }
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(added);
+        return ARITH_EIO;
+    }
+    size_t old_size = st.st_size;
+    void *map = NULL;
+    struct T old = { NULL, 0, 0, NULL, NULL, 0 };
+    Arith_status status = ARITH_OK;
+    if (old_size > 0) {
+        map = mmap(NULL, old_size, PROT_READ, MAP_SHARED, fd, 0);
+        status = map == MAP_FAILED ? ARITH_EIO
+                                   : parse(map, old_size, &old);
+    }
+
+    /* merge, keeping a copy of the old tail so that it can be restored */
+    size_t start = strlen(ARCHIVE_MAGIC), tail_len = 0;
+    if (status == ARITH_OK && old_size > 0) {
+        start = old.index - old.data;
+        tail_len = old_size - start;
+    }
+    unsigned total = old.count + count;
+    Entry *merged = malloc((total + 1) * sizeof(*merged));
+    uint8_t *tail = malloc(tail_len + 1);
+    if (status == ARITH_OK && (merged == NULL || tail == NULL)) {
+        status = ARITH_ENOMEM;
+    }
+    size_t names_len = 0;
+    unsigned i = 0, j = 0, m = 0;
+    while (status == ARITH_OK && (i < old.count || j < count)) {
+        Entry next = i < old.count ? entryAt(&old, i) : added[j];
+        int order = i == old.count ? 1 : j == count ? -1
+                    : compareEntries(&next, &added[j]);
+        if (order == 0) {
+            status = ARITH_EINVAL;
+        } else {
+            merged[m] = order < 0 ? next : added[j];
+            merged[m].offset = order < 0 ? next.offset
+                                         : (uint64_t)1 << 63 |
+                                           added[j].offset;
+            names_len += merged[m++].idlen;
+            i += order < 0;
+            j += order > 0;
+        }
+    }
+    if (status == ARITH_OK && tail_len > 0) {
+        memcpy(tail, old.data + start, tail_len);
+    }
+
+    /* the index is built before anything is written, while the old IDs
+     * can still be read; the top bit of offset marks a new entry whose
+     * offset is still its position in ids */
+    uint64_t *placed = malloc((count + 1) * sizeof(*placed));
+    size_t index_len = (size_t)total * ARCHIVE_ENTRY_BYTES + names_len +
+                       ARCHIVE_TRAILER_BYTES;
+    uint8_t *index = malloc(index_len);
+    if (status == ARITH_OK && (placed == NULL || index == NULL)) {
+        status = ARITH_ENOMEM;
+    }
+    size_t pos = start;
+    for (unsigned k = 0; k < count && status == ARITH_OK; k++) {
+        placed[k] = pos;
+        pos += lens[k];
+    }
+    if (status == ARITH_OK) {
+        uint8_t *entry = index;
+        uint8_t *names = index + (size_t)total * ARCHIVE_ENTRY_BYTES;
+        size_t name_at = 0;
+        for (unsigned k = 0; k < total; k++) {
+            uint64_t offset = merged[k].offset >> 63
+                              ? placed[merged[k].offset & ~((uint64_t)1 << 63)]
+                              : merged[k].offset;
+            putBig(entry, offset, 8);
+            putBig(entry + 8, merged[k].length, 8);
+            putBig(entry + 16, name_at, 4);
+            putBig(entry + 20, merged[k].idlen, 4);
+            memcpy(names + name_at, merged[k].id, merged[k].idlen);
+            name_at += merged[k].idlen;
+            entry += ARCHIVE_ENTRY_BYTES;
+        }
+        uint8_t *trailer = names + names_len;
+        putBig(trailer, pos, 8);
+        putBig(trailer + 8, total, 8);
+        memcpy(trailer + 16, ARCHIVE_TRAILER_MAGIC, 8);
+    }
+    int written = 0;
+    if (status == ARITH_OK && old_size == 0) {
+        status = writeAll(fd, ARCHIVE_MAGIC, start, 0);
+    }
+    for (unsigned k = 0; k < count && status == ARITH_OK; k++) {
+        written = 1;
+        status = writeAll(fd, images[k], lens[k], placed[k]);
+    }
+    if (status == ARITH_OK) {
+        written = 1;
+        status = writeAll(fd, index, index_len, pos);
+    }
+    if (status == ARITH_OK && ftruncate(fd, pos + index_len) != 0) {
+        status = ARITH_EIO;
+    }
+    if (status != ARITH_OK && written) {
+        /* best effort: the file as it was */
+        if (tail_len > 0) {
+            writeAll(fd, tail, tail_len, start);
+        }
+        if (ftruncate(fd, old_size) != 0) {
+            status = ARITH_EIO;
+        }
+    }
+
+    if (map != NULL && map != MAP_FAILED) {
+        munmap(map, old_size);
+    }
+    close(fd);
+    free(added);
+    free(merged);
+    free(tail);
+    free(placed);
+    free(index);
+    return status;
+}
+
+/*  Name: parse
+ *  Purpose: This function checks the magic, the trailer and every entry
+ *           of an archive, including that the IDs are strictly sorted.
+ *  Output: ARITH_OK with *archive filled in, or ARITH_EBADFORMAT
+ */
+static Arith_status parse(const uint8_t *data, size_t n, struct T *archive)
+{
+    size_t magic = strlen(ARCHIVE_MAGIC);
+    if (n < magic + ARCHIVE_TRAILER_BYTES ||
+        memcmp(data, ARCHIVE_MAGIC, magic) != 0 ||
+        memcmp(data + n - 8, ARCHIVE_TRAILER_MAGIC, 8) != 0) {
+        return ARITH_EBADFORMAT;
+    }
+    const uint8_t *trailer = data + n - ARCHIVE_TRAILER_BYTES;
+    uint64_t index = getBig(trailer, 8), count = getBig(trailer + 8, 8);
+    size_t room = n - ARCHIVE_TRAILER_BYTES;
+    if (index < magic || index > room ||
+        count > (room - index) / ARCHIVE_ENTRY_BYTES || count > UINT32_MAX) {
+        return ARITH_EBADFORMAT;
+    }
+    archive -> data = data;
+    archive -> n = n;
+    archive -> count = count;
+    archive -> index = data + index;
+    archive -> names = archive -> index + count * ARCHIVE_ENTRY_BYTES;
+    archive -> names_len = data + room - archive -> names;
+
+    for (unsigned k = 0; k < count; k++) {
+        const uint8_t *entry = archive -> index + k * ARCHIVE_ENTRY_BYTES;
+        uint64_t offset = getBig(entry, 8), length = getBig(entry + 8, 8);
+        uint64_t id = getBig(entry + 16, 4), idlen = getBig(entry + 20, 4);
+        if (offset < magic || offset > index || length > index - offset ||
+            id > archive -> names_len || idlen > archive -> names_len - id ||
+            idlen == 0) {
+            return ARITH_EBADFORMAT;
+        }
+        if (k > 0) {
+            Entry previous = entryAt(archive, k - 1);
+            Entry current = entryAt(archive, k);
+            if (compareEntries(&previous, &current) >= 0) {
+                return ARITH_EBADFORMAT;
+            }
+        }
+    }
+    return ARITH_OK;
+}
+
+static Entry entryAt(const struct T *archive, unsigned k)
+{
+    const uint8_t *entry = archive -> index + (size_t)k * ARCHIVE_ENTRY_BYTES;
+    Entry result;
+    result.offset = getBig(entry, 8);
+    result.length = getBig(entry + 8, 8);
+    result.id = (const char *)archive -> names + getBig(entry + 16, 4);
+    result.idlen = getBig(entry + 20, 4);
+    return result;
+}
+
+/*  Name: compareIds
+ *  Purpose: This function orders IDs byte by byte, a prefix first.
+ */
+static int compareIds(const char *x, size_t xlen, const char *y,
+                      size_t ylen)
+{
+    int order = memcmp(x, y, xlen < ylen ? xlen : ylen);
+    if (order != 0) {
+        return order;
+    }
+    return (xlen > ylen) - (xlen < ylen);
+}
+
+static int compareEntries(const void *x, const void *y)
+{
+    const Entry *a = x, *b = y;
+    return compareIds(a -> id, a -> idlen, b -> id, b -> idlen);
+}
+
+static Arith_status writeAll(int fd, const void *buf, size_t len,
+                             off_t offset)
+{
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t written = pwrite(fd, p, len, offset);
+        if (written <= 0) {
+            return ARITH_EIO;
+        }
+        p += written;
+        len -= written;
+        offset += written;
+    }
+    return ARITH_OK;
+}
+
+static uint64_t getBig(const uint8_t *src, unsigned bytes)
+{
+    uint64_t value = 0;
+    for (unsigned k = 0; k < bytes; k++) {
+        value = value << 8 | src[k];
+    }
+    return value;
+}
+
+static void putBig(uint8_t *dest, uint64_t value, unsigned bytes)
+{
+    for (unsigned k = bytes; k-- > 0; value >>= 8) {
+        dest[k] = value & 0xff;
+    }
+}
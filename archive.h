@@ -0,0 +1,91 @@
+/*********************************************************************
+ *                     archive.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for archives of many compressed
+ *              images in one file, each found by an ID. The layout is
+ *
+ *                  "COMP40 Archive 1\n"
+ *                  image, image, ...   compressed images (any format),
+ *                                      each with its own header
+ *                  index               one ARCHIVE_ENTRY_BYTES entry per
+ *                                      image, sorted by ID
+ *                  names               the IDs, back to back
+ *                  trailer             the index's offset and the count,
+ *                                      8 bytes big-endian each, then
+ *                                      ARCHIVE_TRAILER_MAGIC
+ *
+ *              An entry is the image's offset and length (8 bytes each)
+ *              and its ID's offset within the names and length (4 bytes
+ *              each), all big-endian. Since the index comes last, adding
+ *              images writes them over the old index and puts a new one
+ *              after them; the images already there are not moved.
+ *              Lookups are a binary search of the index in the mapped
+ *              file, and the image found is decoded where it lies.
+ *********************************************************************/
+
+#ifndef ARCHIVE_INCLUDED
+#define ARCHIVE_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arith.h"
+
+#define ARCHIVE_MAGIC "COMP40 Archive 1\n"
+#define ARCHIVE_TRAILER_MAGIC "C40INDEX"
+#define ARCHIVE_ENTRY_BYTES 24
+#define ARCHIVE_TRAILER_BYTES 24
+
+#define T Archive_T
+typedef struct T *T;
+
+/* Function: Archive_open()
+ * Job: map the archive at path and check its index.
+ * Expected output: ARITH_OK with *archive set; ARITH_EIO if the file
+ *      cannot be mapped, ARITH_EBADFORMAT if it is not an archive.
+ */
+extern Arith_status Archive_open(const char *path, T *archive);
+
+/* Function: Archive_free()
+ * Job: unmap the archive and set *archive to NULL; the images it handed
+ *      out go with it.
+ */
+extern void Archive_free(T *archive);
+
+/* Function: Archive_count()
+ * Job: return the number of images.
+ */
+extern unsigned Archive_count(T archive);
+
+/* Function: Archive_entry()
+ * Job: store the ID (not NUL-terminated) and the image of entry k, in ID
+ *      order; any output pointer may be NULL.
+ */
+extern void Archive_entry(T archive, unsigned k, const char **id,
+                          size_t *idlen, const uint8_t **image,
+                          size_t *len);
+
+/* Function: Archive_find()
+ * Job: find the image with ID id and store where it lies in the mapped
+ *      archive.
+ * Expected output: 1, or 0 if there is no such image.
+ */
+extern int Archive_find(T archive, const char *id, const uint8_t **image,
+                        size_t *len);
+
+/* Function: Archive_append()
+ * Job: add the count images images[k][0..lens[k]) with IDs ids[k] to the
+ *      archive at path, creating it if there is none.
+ * Expected output: ARITH_OK; ARITH_EINVAL if an ID is empty or already
+ *      used (in the archive or among ids), ARITH_EBADFORMAT if an image
+ *      is not a compressed image or path is not an archive, ARITH_EIO if
+ *      the file cannot be written. On failure the archive is unchanged.
+ */
+extern Arith_status Archive_append(const char *path, unsigned count,
+                                   const char *const *ids,
+                                   const uint8_t *const *images,
+                                   const size_t *lens);
+
+#undef T
+#endif
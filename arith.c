@@ -0,0 +1,1325 @@
+/*********************************************************************
+ *                     arith.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the in-memory compression
+ *              library. It validates its input up front, so that the
+ *              stages in codec.c (which treat bad arguments as checked
+ *              run-time errors) only ever see well-formed images, and
+ *              then strings the stages together.
+ *********************************************************************/
+
+
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "assert.h"
+#include "arith.h"
+#include "codec.h"
+#include "codeword.h"
+#include "geometry.h"
+#include "layers.h"
+#include "ppmmem.h"
+#include "predict.h"
+#include "a2plain.h"
+#include "a2flat.h"
+#include "scratch.h"
+#include "stats.h"
+#include "survey.h"
+#include "tile.h"
+
+#define A2 A2Methods_UArray2
+
+/* a coding for finish() beside those of tile.h: the layers of format 5 */
+#define LAYERED 0x40
+
+struct Arith_context {
+    Scratch_T scratch;      /* planes and output of the current call */
+};
+
+/*
+ * where the memory of one call comes from: the context's arena when the
+ * caller gave one, otherwise methods->new and malloc
+ */
+typedef struct Memory {
+    Arith_context ctx;
+    A2Methods_T methods;
+} Memory;
+
+/*
+ * the plain codewords of an image in format 2 order: borrowed from the
+ * input when it is format 2, otherwise a copy that must be freed
+ */
+typedef struct Grid {
+    unsigned width, height;
+    const uint8_t *codewords;
+    uint8_t *copy;          /* NULL when borrowed */
+} Grid;
+
+static Memory chooseMemory(const Arith_options *opts);
+static A2 newPlane(Memory *mem, int width, int height, int size);
+static void freePlane(Memory *mem, A2 *plane);
+static void *newBuffer(Memory *mem, size_t size);
+static void freeBuffer(Memory *mem, void *buffer);
+static Arith_status thumbnail(Memory *mem, const uint8_t *codewords,
+                              unsigned width, unsigned height,
+                              unsigned scale, uint8_t **out,
+                              size_t *outlen);
+static Arith_status decode(const uint8_t *comp, size_t n, int *complete,
+                           uint8_t **out, size_t *outlen,
+                           const Arith_options *opts);
+static uint8_t *unpredict(Memory *mem, const uint8_t *codewords,
+                          unsigned width, unsigned height,
+                          const Arith_region *crop);
+static uint8_t *unlayer(Memory *mem, const uint8_t *layers, size_t avail,
+                        unsigned width, unsigned height, unsigned scale,
+                        const Arith_region *crop, int *complete);
+static int outputFormat(const Arith_options *opts, unsigned *tile,
+                        int *coding);
+static Arith_status finish(Memory *mem, uint8_t *dest, size_t hlen,
+                           unsigned width, unsigned height, unsigned tile,
+                           int coding, uint8_t **out, size_t *outlen);
+static Arith_status loadGrid(Memory *mem, const uint8_t *comp, size_t n,
+                             Grid *grid);
+static void freeGrid(Memory *mem, Grid *grid);
+static void copyRect(const Grid *grid, Arith_region box, uint8_t *dest);
+static int isTiled(const uint8_t *comp, size_t n);
+static Arith_status tiled(Memory *mem, const uint8_t *comp, size_t n,
+                          unsigned scale, const Arith_region *crop,
+                          unsigned threads, uint8_t **out, size_t *outlen);
+static Arith_status region(Memory *mem, const uint8_t *codewords,
+                           unsigned width, unsigned height,
+                           Arith_region crop, uint8_t **out,
+                           size_t *outlen);
+
+
+/*  Name: Arith_compress
+ *  Purpose: This function compresses a PPM image held in memory. The image
+ *           is trimmed to even dimensions while it is read.
+ *  Input: the PPM image and its length, locations for the output buffer and
+ *         its length, and the options (may be NULL).
+ *  Output: ARITH_OK, or the reason the image could not be compressed.
+ *  Error condition: ARITH_EINVAL if a required pointer is NULL.
+ */
+Arith_status Arith_compress(const uint8_t *ppm, size_t n,
+                            uint8_t **out, size_t *outlen,
+                            const Arith_options *opts)
+{
+    unsigned tile;
+    int coding;
+    if (!outputFormat(opts, &tile, &coding) || ppm == NULL || out == NULL ||
+        outlen == NULL) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Stats_clock clock = Stats_start();
+    Memory mem = chooseMemory(opts);
+    A2Methods_T methods = mem.methods;
+
+    Ppmmem_header header;
+    Arith_status status = Ppmmem_parse_header(ppm, n, &header);
+    clock = Stats_lap(STATS_PARSE_HEADER, clock);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    if (header.width < 2 || header.height < 2) {
+        return ARITH_ETOOSMALL;
+    }
+    status = Ppmmem_check_size(&header, n);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    int width = header.width & ~1u;
+    int height = header.height & ~1u;
+
+    struct Pnm_ppm origImage = { width, height, header.denominator, NULL,
+                                 methods };
+    struct Pnm_rgb *row = newBuffer(&mem, header.width *
+                                          sizeof(struct Pnm_rgb));
+    origImage.pixels = newPlane(&mem, width, height, sizeof(struct Pnm_rgb));
+    A2 arrayDCT = newPlane(&mem, width/2, height/2, sizeof(DCT));
+    Block_memo *memo = newBuffer(&mem, sizeof(Block_memo));
+    uint8_t *dest = newBuffer(&mem, CODEWORD_HEADER_MAX +
+                                    Codeword_image_size(width, height));
+    if (row == NULL || origImage.pixels == NULL || arrayDCT == NULL ||
+        memo == NULL || dest == NULL) {
+        status = ARITH_ENOMEM;
+    }
+
+    if (status == ARITH_OK) {
+        clock = Stats_start();
+        status = Ppmmem_read_pixels(&header, ppm, n, origImage.pixels,
+                                    methods, row);
+        clock = Stats_lap(STATS_READ_PIXELS, clock);
+    }
+    if (status == ARITH_OK) {
+        /* RGB -> DCT (1/4 sized DCT array), repeated blocks from the
+         * memo */
+        initBlockMemo(memo, header.denominator);
+        RGB_toDCT(&origImage, arrayDCT, methods, memo);
+        reportBlockMemo(memo);
+        clock = Stats_lap(STATS_RGB_TO_DCT, clock);
+        /* packing DCT info into codewords using bitpack.c */
+        size_t len = packDCT(arrayDCT, methods, dest);
+        status = finish(&mem, dest, len - Codeword_image_size(width, height),
+                        width, height, tile, coding, out, outlen);
+        Stats_lap(STATS_PACK, clock);
+    } else {
+        freeBuffer(&mem, dest);
+    }
+
+    freeBuffer(&mem, memo);
+    freePlane(&mem, &arrayDCT);
+    freePlane(&mem, &origImage.pixels);
+    freeBuffer(&mem, row);
+    return status;
+}
+
+/*  Name: Arith_decompress
+ *  Purpose: This function decompresses a compressed image held in memory
+ *           into a P6 image.
+ *  Input: the compressed image and its length, locations for the output
+ *         buffer and its length, and the options (may be NULL).
+ *  Output: ARITH_OK, or the reason the image could not be decompressed.
+ *  Error condition: ARITH_EINVAL if a required pointer is NULL.
+ */
+Arith_status Arith_decompress(const uint8_t *comp, size_t n,
+                              uint8_t **out, size_t *outlen,
+                              const Arith_options *opts)
+{
+    return decode(comp, n, NULL, out, outlen, opts);
+}
+
+/*  Name: Arith_preview
+ *  Purpose: This function decompresses as much of a format 5 image as has
+ *           arrived, once its averages layer is whole.
+ *  Input: the first n bytes of the compressed image, locations for the
+ *         output buffer and its length, one for whether the picture is
+ *         final (may be NULL), and the options (may be NULL).
+ *  Output: ARITH_OK, or the reason the image could not be decompressed.
+ *  Error condition: ARITH_EINVAL if a required pointer is NULL.
+ */
+Arith_status Arith_preview(const uint8_t *comp, size_t n, uint8_t **out,
+                           size_t *outlen, int *complete,
+                           const Arith_options *opts)
+{
+    int whole = 0;
+    Arith_status status = decode(comp, n, &whole, out, outlen, opts);
+    if (status == ARITH_OK && complete != NULL) {
+        *complete = whole;
+    }
+    return status;
+}
+
+/*  Name: Arith_transform
+ *  Purpose: This function transforms a compressed image in the codeword
+ *           domain: the codewords are gathered into a plain grid, moved
+ *           and rewritten by Geometry_apply() (or cut out, for a crop)
+ *           behind a format 2 header, and finished like a compressed
+ *           image.
+ *  Input: the compressed image and its length, the op, the crop (for
+ *         ARITH_CROP), locations for the output and the options (may be
+ *         NULL)
+ *  Output: ARITH_OK, or the reason the image could not be transformed
+ *  Error condition: ARITH_EINVAL if a required pointer is NULL or the crop
+ *                   is bad.
+ */
+Arith_status Arith_transform(const uint8_t *comp, size_t n,
+                             Arith_transform_op op, const Arith_region *crop,
+                             uint8_t **out, size_t *outlen,
+                             const Arith_options *opts)
+{
+    unsigned tile;
+    int coding;
+    if (!outputFormat(opts, &tile, &coding) || comp == NULL || out == NULL ||
+        outlen == NULL ||
+        (op == ARITH_CROP && (crop == NULL || crop -> x % 2 != 0 ||
+                              crop -> y % 2 != 0 || crop -> width % 2 != 0 ||
+                              crop -> height % 2 != 0))) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Memory mem = chooseMemory(opts);
+    Grid grid;
+    Arith_status status = loadGrid(&mem, comp, n, &grid);
+    if (status != ARITH_OK) {
+        return status;
+    }
+
+    Arith_region box = { 0, 0, grid.width, grid.height };
+    if (op == ARITH_CROP) {
+        box = *crop;
+        if (box.width == 0 || box.height == 0 || box.x >= grid.width ||
+            box.y >= grid.height) {
+            freeGrid(&mem, &grid);
+            return ARITH_EINVAL;
+        }
+        if (box.width > grid.width - box.x) {
+            box.width = grid.width - box.x;
+        }
+        if (box.height > grid.height - box.y) {
+            box.height = grid.height - box.y;
+        }
+    } else if (op == ARITH_TRANSPOSE) {
+        box.width = grid.height;
+        box.height = grid.width;
+    }
+    uint8_t *dest = newBuffer(&mem, CODEWORD_HEADER_MAX +
+                                    Codeword_image_size(box.width,
+                                                        box.height));
+    if (dest == NULL) {
+        freeGrid(&mem, &grid);
+        return ARITH_ENOMEM;
+    }
+
+    Stats_clock clock = Stats_start();
+    size_t hlen = Codeword_header_write(dest, box.width, box.height,
+                                        CODEWORD_PLAIN);
+    if (op == ARITH_CROP) {
+        copyRect(&grid, box, dest + hlen);
+    } else {
+        Geometry_apply(grid.codewords, grid.width / 2, grid.height / 2, op,
+                       dest + hlen);
+    }
+    freeGrid(&mem, &grid);
+    Stats_lap(STATS_ROWS, clock);
+    status = finish(&mem, dest, hlen, box.width, box.height, tile, coding,
+                    out, outlen);
+    Stats_lap(STATS_PACK, clock);
+    return status;
+}
+
+/*  Name: Arith_stitch
+ *  Purpose: This function joins compressed images by copying runs of
+ *           codewords: side by side, each output row of blocks is the
+ *           same row of every input in turn; one above the other, each
+ *           input is a single run.
+ *  Input: the compressed images and their lengths, how many there are,
+ *         the direction, locations for the output and the options (may
+ *         be NULL)
+ *  Output: ARITH_OK, or the reason the images could not be joined
+ *  Error condition: ARITH_EINVAL if a required pointer is NULL, count is
+ *                   0, or the images do not line up.
+ */
+Arith_status Arith_stitch(const uint8_t *const *comps, const size_t *ns,
+                          unsigned count, Arith_direction direction,
+                          uint8_t **out, size_t *outlen,
+                          const Arith_options *opts)
+{
+    unsigned tile;
+    int coding;
+    if (!outputFormat(opts, &tile, &coding) || comps == NULL || ns == NULL ||
+        count == 0 || out == NULL || outlen == NULL) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Memory mem = chooseMemory(opts);
+    Grid *grids = newBuffer(&mem, count * sizeof(*grids));
+    if (grids == NULL) {
+        return ARITH_ENOMEM;
+    }
+
+    /* the sum of the widths (or heights) must stay a valid dimension */
+    Arith_status status = ARITH_OK;
+    unsigned loaded = 0;
+    uint64_t total = 0;
+    while (loaded < count && status == ARITH_OK) {
+        if (comps[loaded] == NULL) {
+            status = ARITH_EINVAL;
+            break;
+        }
+        status = loadGrid(&mem, comps[loaded], ns[loaded], &grids[loaded]);
+        if (status != ARITH_OK) {
+            break;
+        }
+        Grid *g = &grids[loaded++];
+        total += direction == ARITH_ACROSS ? g -> width : g -> height;
+        if ((direction == ARITH_ACROSS ? g -> height != grids[0].height
+                                       : g -> width != grids[0].width) ||
+            total > INT_MAX) {
+            status = ARITH_EINVAL;
+        }
+    }
+    unsigned width = 0, height = 0;
+    uint8_t *dest = NULL;
+    if (status == ARITH_OK) {
+        width = direction == ARITH_ACROSS ? total : grids[0].width;
+        height = direction == ARITH_ACROSS ? grids[0].height : total;
+        dest = newBuffer(&mem, CODEWORD_HEADER_MAX +
+                               Codeword_image_size(width, height));
+        status = dest == NULL ? ARITH_ENOMEM : ARITH_OK;
+    }
+
+    Stats_clock clock = Stats_start();
+    size_t hlen = 0;
+    if (status == ARITH_OK) {
+        hlen = Codeword_header_write(dest, width, height, CODEWORD_PLAIN);
+        uint8_t *p = dest + hlen;
+        if (direction == ARITH_DOWN) {
+            for (unsigned k = 0; k < count; k++) {
+                size_t size = Codeword_image_size(grids[k].width,
+                                                  grids[k].height);
+                memcpy(p, grids[k].codewords, size);
+                p += size;
+            }
+        } else {
+            for (unsigned r = 0; r < height / 2; r++) {
+                for (unsigned k = 0; k < count; k++) {
+                    size_t row = (size_t)(grids[k].width / 2) *
+                                 CODEWORD_BYTES;
+                    memcpy(p, grids[k].codewords + r * row, row);
+                    p += row;
+                }
+            }
+        }
+    }
+    for (unsigned k = 0; k < loaded; k++) {
+        freeGrid(&mem, &grids[k]);
+    }
+    freeBuffer(&mem, grids);
+    Stats_lap(STATS_ROWS, clock);
+    if (status != ARITH_OK) {
+        freeBuffer(&mem, dest);
+        return status;
+    }
+    status = finish(&mem, dest, hlen, width, height, tile, coding, out,
+                    outlen);
+    Stats_lap(STATS_PACK, clock);
+    return status;
+}
+
+/*  Name: Arith_split
+ *  Purpose: This function cuts a compressed image into pieces by copying
+ *           runs of codewords, finishing and handing over one piece at a
+ *           time.
+ *  Input: the compressed image and its length, the size of a piece, the
+ *         function to call with each piece and its closure, and the
+ *         options (may be NULL)
+ *  Output: ARITH_OK, the reason the image could not be split, or the
+ *          first status other than ARITH_OK that apply returned
+ *  Error condition: ARITH_EINVAL if a pointer is NULL or a piece
+ *                   dimension is odd or 0.
+ */
+Arith_status Arith_split(const uint8_t *comp, size_t n, unsigned piece_width,
+                         unsigned piece_height, Arith_piecefun *apply,
+                         void *cl, const Arith_options *opts)
+{
+    unsigned tile;
+    int coding;
+    if (!outputFormat(opts, &tile, &coding) || comp == NULL ||
+        apply == NULL || piece_width == 0 || piece_height == 0 ||
+        piece_width % 2 != 0 || piece_height % 2 != 0) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Memory mem = chooseMemory(opts);
+    Grid grid;
+    Arith_status status = loadGrid(&mem, comp, n, &grid);
+    if (status != ARITH_OK) {
+        return status;
+    }
+
+    unsigned across = (grid.width + piece_width - 1) / piece_width;
+    unsigned down = (grid.height + piece_height - 1) / piece_height;
+    for (unsigned r = 0; r < down && status == ARITH_OK; r++) {
+        for (unsigned c = 0; c < across && status == ARITH_OK; c++) {
+            Arith_region box = { c * piece_width, r * piece_height,
+                                 piece_width, piece_height };
+            if (box.width > grid.width - box.x) {
+                box.width = grid.width - box.x;
+            }
+            if (box.height > grid.height - box.y) {
+                box.height = grid.height - box.y;
+            }
+            uint8_t *dest = newBuffer(&mem, CODEWORD_HEADER_MAX +
+                                            Codeword_image_size(box.width,
+                                                                box.height));
+            if (dest == NULL) {
+                status = ARITH_ENOMEM;
+                break;
+            }
+            Stats_clock clock = Stats_start();
+            size_t hlen = Codeword_header_write(dest, box.width, box.height,
+                                                CODEWORD_PLAIN);
+            copyRect(&grid, box, dest + hlen);
+            uint8_t *piece;
+            size_t len;
+            status = finish(&mem, dest, hlen, box.width, box.height, tile,
+                            coding, &piece, &len);
+            Stats_lap(STATS_PACK, clock);
+            if (status == ARITH_OK) {
+                status = apply(r, c, piece, len, cl);
+                freeBuffer(&mem, piece);
+            }
+        }
+    }
+    freeGrid(&mem, &grid);
+    return status;
+}
+
+/*  Name: Arith_codewords
+ *  Purpose: This function hands out the plain grid of a compressed image
+ *           for callers that decode it themselves.
+ *  Input: the compressed image and its length, and locations for the
+ *         dimensions, the grid and the copy to free
+ *  Output: ARITH_OK, or the reason the image could not be read
+ *  Error condition: ARITH_EINVAL if a pointer is NULL.
+ */
+Arith_status Arith_codewords(const uint8_t *comp, size_t n, unsigned *width,
+                             unsigned *height, const uint8_t **codewords,
+                             uint8_t **copy)
+{
+    if (comp == NULL || width == NULL || height == NULL ||
+        codewords == NULL || copy == NULL) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Memory mem = chooseMemory(NULL);
+    Grid grid;
+    Arith_status status = loadGrid(&mem, comp, n, &grid);
+    if (status == ARITH_OK) {
+        *width = grid.width;
+        *height = grid.height;
+        *codewords = grid.codewords;
+        *copy = grid.copy;
+    }
+    return status;
+}
+
+/*  Name: Arith_analyze
+ *  Purpose: This function measures a compressed image from the plain grid
+ *           of its codewords.
+ *  Input: the compressed image and its length, whether to rebuild the
+ *         four lumas of each block, the summary to fill in and the
+ *         options (may be NULL)
+ *  Output: ARITH_OK, or the reason the image could not be read
+ *  Error condition: ARITH_EINVAL if a pointer is NULL.
+ */
+Arith_status Arith_analyze(const uint8_t *comp, size_t n, int detail,
+                           Arith_summary *summary, const Arith_options *opts)
+{
+    if (comp == NULL || summary == NULL) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Memory mem = chooseMemory(opts);
+    Grid grid;
+    Arith_status status = loadGrid(&mem, comp, n, &grid);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    Stats_clock clock = Stats_start();
+    summary -> width = grid.width;
+    summary -> height = grid.height;
+    Survey_scan(grid.codewords, grid.width / 2, grid.height / 2, detail,
+                summary);
+    Stats_lap(STATS_ROWS, clock);
+    freeGrid(&mem, &grid);
+    return ARITH_OK;
+}
+
+/*  Name: Arith_hash_distance
+ *  Purpose: This function counts the bits in which two hashes differ.
+ */
+unsigned Arith_hash_distance(uint64_t x, uint64_t y)
+{
+    return __builtin_popcountll(x ^ y);
+}
+
+/*  Name: Arith_tile_count
+ *  Purpose: This function reports the tile grid of a format 3 image.
+ *  Input: the compressed image, its length and locations for the counts
+ *  Output: ARITH_OK or the status of Tile_open()
+ *  Error condition: ARITH_EINVAL if a pointer is NULL.
+ */
+Arith_status Arith_tile_count(const uint8_t *comp, size_t n,
+                              unsigned *across, unsigned *down)
+{
+    if (comp == NULL || across == NULL || down == NULL) {
+        return ARITH_EINVAL;
+    }
+    Tile_layout layout;
+    Arith_status status = Tile_open(comp, n, &layout);
+    if (status == ARITH_OK) {
+        *across = layout.across;
+        *down = layout.down;
+    }
+    return status;
+}
+
+/*  Name: Arith_decompress_tile
+ *  Purpose: This function decompresses one tile of a format 3 image.
+ *  Input: the compressed image and its length, the tile, locations for
+ *         the output buffer and its length, and the options (may be NULL)
+ *  Output: ARITH_OK, or the reason the tile could not be decompressed
+ *  Error condition: ARITH_EINVAL if a pointer is NULL or there is no such
+ *                   tile.
+ */
+Arith_status Arith_decompress_tile(const uint8_t *comp, size_t n,
+                                   unsigned index, uint8_t **out,
+                                   size_t *outlen, const Arith_options *opts)
+{
+    if (comp == NULL || out == NULL || outlen == NULL) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Memory mem = chooseMemory(opts);
+    Tile_layout layout;
+    Arith_status status = Tile_open(comp, n, &layout);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    if (index >= layout.across * layout.down) {
+        return ARITH_EINVAL;
+    }
+    unsigned x, y, w, h;
+    Tile_bounds(&layout, index, &x, &y, &w, &h);
+    uint8_t *dest = newBuffer(&mem, PPMMEM_HEADER_MAX +
+                                    Ppmmem_row_bytes(w, 255) * h);
+    if (dest == NULL) {
+        return ARITH_ENOMEM;
+    }
+    size_t hlen = Ppmmem_header_write(dest, w, h, 255);
+    status = Tile_decode_one(&layout, index, dest + hlen);
+    if (status != ARITH_OK) {
+        freeBuffer(&mem, dest);
+        return status;
+    }
+    *out = dest;
+    *outlen = hlen + Ppmmem_row_bytes(w, 255) * h;
+    return ARITH_OK;
+}
+
+/*  Name: Arith_context_new
+ *  Purpose: This function creates a context with an empty arena.
+ *  Output: the context, or NULL when out of memory
+ */
+Arith_context Arith_context_new(void)
+{
+    Arith_context ctx = malloc(sizeof(*ctx));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx -> scratch = Scratch_new();
+    if (ctx -> scratch == NULL) {
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+/*  Name: Arith_context_free
+ *  Purpose: This function releases a context and its arena.
+ *  Error condition: CRE if ctx or *ctx is NULL.
+ */
+void Arith_context_free(Arith_context *ctx)
+{
+    assert(ctx != NULL && *ctx != NULL);
+    Scratch_free(&(*ctx) -> scratch);
+    free(*ctx);
+    *ctx = NULL;
+}
+
+/*  Name: Arith_context_peak
+ *  Purpose: This function reports the memory use of a context.
+ *  Input: the context and a location for its capacity (may be NULL)
+ *  Output: the most bytes of scratch used by a single call
+ *  Error condition: CRE if ctx is NULL.
+ */
+size_t Arith_context_peak(Arith_context ctx, size_t *capacity)
+{
+    assert(ctx != NULL);
+    if (capacity != NULL) {
+        *capacity = Scratch_capacity(ctx -> scratch);
+    }
+    return Scratch_peak(ctx -> scratch);
+}
+
+/*  Name: Arith_read_stream
+ *  Purpose: This function reads a stream to end of file into memory,
+ *           doubling the buffer as it fills.
+ *  Input: the stream, locations for the buffer and its length
+ *  Output: ARITH_OK, ARITH_ENOMEM or ARITH_EIO
+ *  Error condition: ARITH_EINVAL if a pointer is NULL.
+ */
+Arith_status Arith_read_stream(FILE *fp, uint8_t **buf, size_t *n)
+{
+    if (fp == NULL || buf == NULL || n == NULL) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Stats_clock clock = Stats_start();
+    size_t capacity = 1 << 16;
+    size_t length = 0;
+    uint8_t *data = malloc(capacity);
+    if (data == NULL) {
+        return ARITH_ENOMEM;
+    }
+    Stats_alloc(capacity);
+
+    for (;;) {
+        length += fread(data + length, 1, capacity - length, fp);
+        if (length < capacity) {
+            break;
+        }
+        uint8_t *bigger = realloc(data, capacity * 2);
+        if (bigger == NULL) {
+            free(data);
+            return ARITH_ENOMEM;
+        }
+        data = bigger;
+        capacity *= 2;
+        Stats_alloc(capacity);
+    }
+    if (ferror(fp)) {
+        free(data);
+        return ARITH_EIO;
+    }
+    *buf = data;
+    *n = length;
+    Stats_io(length, 0);
+    Stats_lap(STATS_READ_INPUT, clock);
+    return ARITH_OK;
+}
+
+/*  Name: Arith_strerror
+ *  Purpose: This function describes a status for error messages.
+ *  Input: a status
+ *  Output: a constant string
+ */
+const char *Arith_strerror(Arith_status status)
+{
+    switch (status) {
+    case ARITH_OK:         return "success";
+    case ARITH_EINVAL:     return "invalid argument";
+    case ARITH_EBADFORMAT: return "input is not in the expected format";
+    case ARITH_ETRUNCATED: return "input is truncated";
+    case ARITH_ETOOSMALL:  return "image must be at least 2x2 pixels";
+    case ARITH_ENOMEM:     return "out of memory";
+    case ARITH_EIO:        return "I/O error";
+    }
+    return "unknown error";
+}
+
+/*  Name: chooseMemory
+ *  Purpose: This function decides where the memory of a call comes from. A
+ *           context's arena is reset here, which also releases the output
+ *           of the previous call made with it.
+ *  Input: the options (may be NULL)
+ *  Output: the Memory to allocate from
+ */
+static Memory chooseMemory(const Arith_options *opts)
+{
+    Memory mem = { NULL, uarray2_methods_plain };
+    if (opts != NULL && opts -> context != NULL) {
+        mem.ctx = opts -> context;
+        mem.methods = uarray2_methods_flat;
+        Scratch_reset(mem.ctx -> scratch);
+    } else if (opts != NULL && opts -> methods != NULL) {
+        mem.methods = opts -> methods;
+    }
+    return mem;
+}
+
+/*  Name: newPlane
+ *  Purpose: This function creates a 2D array from the arena or with the
+ *           chosen methods.
+ *  Output: the array, or NULL if the arena cannot grow
+ */
+static A2 newPlane(Memory *mem, int width, int height, int size)
+{
+    if (mem -> ctx != NULL) {
+        return A2flat_new_in(mem -> ctx -> scratch, width, height, size);
+    }
+    Stats_alloc((size_t)width * height * size);
+    return mem -> methods -> new(width, height, size);
+}
+
+/*  Name: freePlane
+ *  Purpose: This function frees a plane made by newPlane; planes in the
+ *           arena go away when it is reset.
+ */
+static void freePlane(Memory *mem, A2 *plane)
+{
+    if (mem -> ctx == NULL && *plane != NULL) {
+        mem -> methods -> free(plane);
+    }
+}
+
+/*  Name: newBuffer
+ *  Purpose: This function allocates size bytes from the arena or with
+ *           malloc.
+ *  Output: the memory, or NULL when out of memory
+ */
+static void *newBuffer(Memory *mem, size_t size)
+{
+    if (mem -> ctx != NULL) {
+        return Scratch_alloc(mem -> ctx -> scratch, size);
+    }
+    Stats_alloc(size);
+    return malloc(size);
+}
+
+/*  Name: freeBuffer
+ *  Purpose: This function frees a buffer made by newBuffer.
+ */
+static void freeBuffer(Memory *mem, void *buffer)
+{
+    if (mem -> ctx == NULL) {
+        free(buffer);
+    }
+}
+
+/*  Name: thumbnail
+ *  Purpose: This function decodes a 1/scale thumbnail one scanline at a
+ *           time with decodeThumbnailRow(), reading scale / 2 rows of
+ *           codewords per scanline; no plane is made.
+ *  Input: the memory to allocate from, the codewords of a width x height
+ *         image, the scale (2, 4 or 8) and locations for the output
+ *  Output: ARITH_OK or ARITH_ENOMEM
+ */
+static Arith_status thumbnail(Memory *mem, const uint8_t *codewords,
+                              unsigned width, unsigned height,
+                              unsigned scale, uint8_t **out,
+                              size_t *outlen)
+{
+    unsigned factor = scale / 2;
+    unsigned blocks = width / 2, block_rows = height / 2;
+    unsigned thumb_width = (blocks + factor - 1) / factor;
+    unsigned thumb_height = (block_rows + factor - 1) / factor;
+    size_t row_bytes = Ppmmem_row_bytes(thumb_width, 255);
+
+    uint8_t *dest = newBuffer(mem, PPMMEM_HEADER_MAX +
+                                   row_bytes * thumb_height);
+    cv *sums = newBuffer(mem, thumb_width * sizeof(*sums));
+    struct Pnm_rgb *row = newBuffer(mem, thumb_width * sizeof(*row));
+    if (dest == NULL || sums == NULL || row == NULL) {
+        freeBuffer(mem, dest);
+        freeBuffer(mem, sums);
+        freeBuffer(mem, row);
+        return ARITH_ENOMEM;
+    }
+
+    Stats_clock clock = Stats_start();
+    uint8_t *p = dest + Ppmmem_header_write(dest, thumb_width,
+                                            thumb_height, 255);
+    for (unsigned y = 0; y < thumb_height; y++) {
+        unsigned first = y * factor;
+        unsigned rows = first + factor <= block_rows ? factor
+                                                     : block_rows - first;
+        decodeThumbnailRow(codewords + (size_t)first * blocks *
+                           CODEWORD_BYTES, blocks, rows, factor, 255, sums,
+                           row);
+        p += Ppmmem_write_row(row, thumb_width, 255, p);
+    }
+    Stats_lap(STATS_ROWS, clock);
+    freeBuffer(mem, sums);
+    freeBuffer(mem, row);
+    *out = dest;
+    *outlen = p - dest;
+    return ARITH_OK;
+}
+
+/*  Name: region
+ *  Purpose: This function decodes part of an image. The codewords are a
+ *           row-major grid, so the blocks covering the crop are found by
+ *           arithmetic: each row of blocks it spans is decoded from just
+ *           its own run of codewords with decodeBlockRow(), and the pixels
+ *           inside the crop are written out. The rest of the codewords are
+ *           never read, so a mapped file only pages in what is needed.
+ *  Input: the memory to allocate from, the codewords of a width x height
+ *         image, the crop and locations for the output
+ *  Output: ARITH_OK, ARITH_EINVAL if the crop misses the image, or
+ *          ARITH_ENOMEM
+ */
+static Arith_status region(Memory *mem, const uint8_t *codewords,
+                           unsigned width, unsigned height,
+                           Arith_region crop, uint8_t **out,
+                           size_t *outlen)
+{
+    if (crop.width == 0 || crop.height == 0 || crop.x >= width ||
+        crop.y >= height) {
+        return ARITH_EINVAL;
+    }
+    if (crop.width > width - crop.x) {
+        crop.width = width - crop.x;
+    }
+    if (crop.height > height - crop.y) {
+        crop.height = height - crop.y;
+    }
+    unsigned blocks = width / 2;
+    unsigned first = crop.x / 2;
+    unsigned across = (crop.x + crop.width + 1) / 2 - first;
+    size_t row_bytes = Ppmmem_row_bytes(crop.width, 255);
+
+    uint8_t *dest = newBuffer(mem, PPMMEM_HEADER_MAX +
+                                   row_bytes * crop.height);
+    struct Pnm_rgb *pair = newBuffer(mem, 4 * across * sizeof(*pair));
+    if (dest == NULL || pair == NULL) {
+        freeBuffer(mem, dest);
+        freeBuffer(mem, pair);
+        return ARITH_ENOMEM;
+    }
+    struct Pnm_rgb *top = pair, *bottom = pair + 2 * across;
+    unsigned skip = crop.x - 2 * first;
+
+    Stats_clock clock = Stats_start();
+    uint8_t *p = dest + Ppmmem_header_write(dest, crop.width, crop.height,
+                                            255);
+    for (unsigned y = crop.y & ~1u; y < crop.y + crop.height; y += 2) {
+        decodeBlockRow(codewords + ((size_t)(y / 2) * blocks + first) *
+                       CODEWORD_BYTES, across, 255, top, bottom);
+        if (y >= crop.y) {
+            p += Ppmmem_write_row(top + skip, crop.width, 255, p);
+        }
+        if (y + 1 < crop.y + crop.height) {
+            p += Ppmmem_write_row(bottom + skip, crop.width, 255, p);
+        }
+    }
+    Stats_lap(STATS_ROWS, clock);
+    freeBuffer(mem, pair);
+    *out = dest;
+    *outlen = p - dest;
+    return ARITH_OK;
+}
+
+/*  Name: outputFormat
+ *  Purpose: This function reads the options that choose the compressed
+ *           format; entropy coding implies tiles of TILE_DEFAULT.
+ *  Input: the options (may be NULL) and locations for the tile size (0
+ *         for an untiled format) and the coding
+ *  Output: 0 if the options ask for an odd tile size, for entropy coding
+ *          of tiles smaller than ARITH_ENTROPY_MIN_TILE, or for format 5
+ *          together with tiles or prediction; 1 otherwise
+ */
+static int outputFormat(const Arith_options *opts, unsigned *tile,
+                        int *coding)
+{
+    int entropy = opts != NULL && opts -> entropy;
+    int predict = opts != NULL && opts -> predict;
+    int progressive = opts != NULL && opts -> progressive;
+    *tile = opts != NULL ? opts -> tile : 0;
+    if (entropy && *tile == 0) {
+        *tile = TILE_DEFAULT;
+    }
+    *coding = (entropy ? TILE_RANS : TILE_RAW) |
+              (predict ? TILE_PREDICTED : 0) | (progressive ? LAYERED : 0);
+    return *tile % 2 == 0 &&
+           !(entropy && *tile < ARITH_ENTROPY_MIN_TILE) &&
+           !(progressive && (*tile != 0 || predict));
+}
+
+/*  Name: finish
+ *  Purpose: This function turns the format 2 image in dest (hlen bytes of
+ *           header, then the codewords) into the format asked for: it is
+ *           left as it is, predicted in place into format 4, or regrouped
+ *           into tiles or layers in a new buffer, in which case dest is
+ *           freed.
+ *  Input: the memory to allocate from, the image, the length of its
+ *         header, its dimensions, the tile size (0: untiled), the coding
+ *         and locations for the output
+ *  Output: ARITH_OK, or ARITH_ENOMEM with dest freed
+ */
+static Arith_status finish(Memory *mem, uint8_t *dest, size_t hlen,
+                           unsigned width, unsigned height, unsigned tile,
+                           int coding, uint8_t **out, size_t *outlen)
+{
+    uint8_t *codewords = dest + hlen;
+    size_t size = Codeword_image_size(width, height);
+    if (tile != 0) {
+        uint8_t *tiles = newBuffer(mem, Tile_bound(width, height, tile,
+                                                   tile));
+        if (tiles != NULL) {
+            *outlen = Tile_pack(codewords, width, height, tile, tile,
+                                coding, tiles);
+            *out = tiles;
+        }
+        freeBuffer(mem, dest);
+        return tiles != NULL ? ARITH_OK : ARITH_ENOMEM;
+    }
+    if (coding & LAYERED) {
+        size_t blocks = (size_t)(width / 2) * (height / 2);
+        uint8_t *layers = newBuffer(mem, CODEWORD_HEADER_MAX +
+                                         Layers_size(blocks));
+        if (layers != NULL) {
+            size_t len = Codeword_header_write(layers, width, height,
+                                               CODEWORD_PROGRESSIVE);
+            Layers_split(codewords, blocks, layers + len);
+            *outlen = len + Layers_size(blocks);
+            *out = layers;
+        }
+        freeBuffer(mem, dest);
+        return layers != NULL ? ARITH_OK : ARITH_ENOMEM;
+    }
+    if (coding & TILE_PREDICTED) {
+        Predict_encode(codewords, width / 2, height / 2,
+                       (size_t)(width / 2) * CODEWORD_BYTES);
+        /* the format 4 header is as long as the format 2 one; it is
+         * built apart, as it ends in a NUL */
+        uint8_t head[CODEWORD_HEADER_MAX];
+        size_t len = Codeword_header_write(head, width, height,
+                                           CODEWORD_PREDICTED);
+        assert(len == hlen);
+        memcpy(dest, head, len);
+    }
+    *out = dest;
+    *outlen = hlen + size;
+    return ARITH_OK;
+}
+
+/*  Name: loadGrid
+ *  Purpose: This function gathers the codewords of any format into a
+ *           plain format 2 grid. Those of format 2 are used where they
+ *           lie; tiles are unpacked into a copy, the averages of format 4
+ *           are restored in one, and the layers of format 5 joined.
+ *  Input: the memory to allocate from, the compressed image, its length
+ *         and the grid to fill in
+ *  Output: ARITH_OK, or the reason the image could not be read
+ */
+static Arith_status loadGrid(Memory *mem, const uint8_t *comp, size_t n,
+                             Grid *grid)
+{
+    Stats_clock clock = Stats_start();
+    Tile_layout layout;
+    int tiled = isTiled(comp, n), kind = CODEWORD_PLAIN;
+    size_t len = 0;
+    Arith_status status = tiled
+                          ? Tile_open(comp, n, &layout)
+                          : Codeword_header_parse(comp, n, &grid -> width,
+                                                  &grid -> height, &kind,
+                                                  &len);
+    Stats_lap(STATS_PARSE_HEADER, clock);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    if (tiled) {
+        grid -> width = layout.width;
+        grid -> height = layout.height;
+    }
+    size_t blocks = (size_t)(grid -> width / 2) * (grid -> height / 2);
+    if (!tiled && n - len < (kind == CODEWORD_PROGRESSIVE
+                             ? Layers_size(blocks)
+                             : Codeword_image_size(grid -> width,
+                                                   grid -> height))) {
+        return ARITH_ETRUNCATED;
+    }
+    grid -> codewords = comp + len;
+    grid -> copy = NULL;
+    if (!tiled && kind == CODEWORD_PLAIN) {
+        return ARITH_OK;
+    }
+
+    size_t size = Codeword_image_size(grid -> width, grid -> height);
+    size_t stride = (size_t)(grid -> width / 2) * CODEWORD_BYTES;
+    grid -> copy = newBuffer(mem, size);
+    if (grid -> copy == NULL) {
+        return ARITH_ENOMEM;
+    }
+    clock = Stats_start();
+    if (tiled) {
+        unsigned ntiles = layout.across * layout.down;
+        for (unsigned t = 0; t < ntiles && status == ARITH_OK; t++) {
+            status = Tile_unpack(&layout, t, grid -> copy, stride);
+        }
+    } else if (kind == CODEWORD_PROGRESSIVE) {
+        Layers_join(comp + len, n - len, blocks, grid -> copy);
+    } else {
+        memcpy(grid -> copy, comp + len, size);
+        Predict_decode(grid -> copy, grid -> width / 2, grid -> height / 2,
+                       stride);
+    }
+    Stats_lap(STATS_UNPACK, clock);
+    if (status != ARITH_OK) {
+        freeBuffer(mem, grid -> copy);
+        return status;
+    }
+    grid -> codewords = grid -> copy;
+    return ARITH_OK;
+}
+
+/*  Name: freeGrid
+ *  Purpose: This function frees the copy a Grid may hold.
+ */
+static void freeGrid(Memory *mem, Grid *grid)
+{
+    if (grid -> copy != NULL) {
+        freeBuffer(mem, grid -> copy);
+    }
+}
+
+/*  Name: copyRect
+ *  Purpose: This function copies the codewords of the blocks inside box
+ *           (even corners, inside the grid) to dest, one run per row.
+ */
+static void copyRect(const Grid *grid, Arith_region box, uint8_t *dest)
+{
+    size_t stride = (size_t)(grid -> width / 2) * CODEWORD_BYTES;
+    size_t row = (size_t)(box.width / 2) * CODEWORD_BYTES;
+    const uint8_t *src = grid -> codewords + (box.y / 2) * stride +
+                         (size_t)(box.x / 2) * CODEWORD_BYTES;
+    for (unsigned r = 0; r < box.height / 2; r++) {
+        memcpy(dest + r * row, src + r * stride, row);
+    }
+}
+
+/*  Name: decode
+ *  Purpose: This function decompresses an image for Arith_decompress()
+ *           and Arith_preview(). A preview takes format 5 only, and draws
+ *           the blocks whose detail has not arrived from their averages.
+ *  Input: the compressed image and its length, NULL for a full decode or
+ *         a location for whether the preview is final, locations for the
+ *         output buffer and its length, and the options (may be NULL).
+ *  Output: ARITH_OK, or the reason the image could not be decompressed.
+ */
+static Arith_status decode(const uint8_t *comp, size_t n, int *complete,
+                           uint8_t **out, size_t *outlen,
+                           const Arith_options *opts)
+{
+    unsigned scale = opts != NULL && opts -> scale != 0 ? opts -> scale : 1;
+    const Arith_region *crop = opts != NULL ? opts -> region : NULL;
+    if (comp == NULL || out == NULL || outlen == NULL ||
+        (scale != 1 && scale != 2 && scale != 4 && scale != 8) ||
+        (crop != NULL && scale != 1)) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Stats_clock clock = Stats_start();
+    Memory mem = chooseMemory(opts);
+    A2Methods_T methods = mem.methods;
+    if (isTiled(comp, n)) {
+        if (complete != NULL) {
+            return ARITH_EBADFORMAT;
+        }
+        unsigned threads = opts != NULL && opts -> threads != 0
+                           ? opts -> threads : 1;
+        return tiled(&mem, comp, n, scale, crop, threads, out, outlen);
+    }
+
+    /* read in header info of the compressed file */
+    struct Pnm_ppm d_image;
+    size_t len;
+    int layout;
+    Arith_status status = readHeader(comp, n, &len, &layout, methods,
+                                     &d_image);
+    Stats_lap(STATS_PARSE_HEADER, clock);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    if (complete != NULL && layout != CODEWORD_PROGRESSIVE) {
+        return ARITH_EBADFORMAT;
+    }
+    int width = d_image.width;
+    int height = d_image.height;
+    size_t blocks = (size_t)(width / 2) * (height / 2);
+    if (n - len < (layout != CODEWORD_PROGRESSIVE
+                   ? Codeword_image_size(width, height)
+                   : complete != NULL ? Layers_dc_size(blocks)
+                                      : Layers_size(blocks))) {
+        return ARITH_ETRUNCATED;
+    }
+    const uint8_t *codewords = comp + len;
+    uint8_t *restored = NULL;
+    if (layout != CODEWORD_PLAIN) {
+        restored = layout == CODEWORD_PREDICTED
+                   ? unpredict(&mem, codewords, width, height, crop)
+                   : unlayer(&mem, codewords, n - len, width, height, scale,
+                             crop, complete);
+        if (restored == NULL) {
+            return ARITH_ENOMEM;
+        }
+        codewords = restored;
+    }
+    if (scale > 1 || crop != NULL) {
+        status = scale > 1
+                 ? thumbnail(&mem, codewords, width, height, scale, out,
+                             outlen)
+                 : region(&mem, codewords, width, height, *crop, out,
+                          outlen);
+        freeBuffer(&mem, restored);
+        return status;
+    }
+
+    /* prepping for decompression */
+    A2 arrayDCT = newPlane(&mem, width/2, height/2, sizeof(DCT));
+    /* expand each DCT element to 2*2 CV */
+    A2 arrayYPP_back = newPlane(&mem, width, height, sizeof(cv));
+    d_image.pixels = newPlane(&mem, width, height, sizeof(struct Pnm_rgb));
+    uint8_t *dest = newBuffer(&mem, Ppmmem_size(&d_image));
+
+    if (arrayDCT == NULL || arrayYPP_back == NULL || d_image.pixels == NULL ||
+        dest == NULL) {
+        status = ARITH_ENOMEM;
+        freeBuffer(&mem, dest);
+    } else {
+        /* decompression steps */
+        clock = Stats_start();
+        unpackDCT(arrayDCT, codewords, methods);
+        clock = Stats_lap(STATS_UNPACK, clock);
+        DCTtoCV(arrayDCT, arrayYPP_back, methods);
+        clock = Stats_lap(STATS_DCT_TO_CV, clock);
+        CV_toRGB(&d_image, arrayYPP_back, methods);
+        clock = Stats_lap(STATS_CV_TO_RGB, clock);
+        *outlen = Ppmmem_write(&d_image, dest);
+        Stats_lap(STATS_WRITE_PPM, clock);
+        *out = dest;
+    }
+
+    freePlane(&mem, &arrayDCT);
+    freePlane(&mem, &arrayYPP_back);
+    freePlane(&mem, &d_image.pixels);
+    freeBuffer(&mem, restored);
+    return status;
+}
+
+/*  Name: unpredict
+ *  Purpose: This function copies the codewords of a format 4 image and
+ *           restores their averages. A region needs only the rows down to
+ *           its last, since each row is predicted from the ones above.
+ *  Input: the memory to allocate from, the codewords of a width x height
+ *         image and the region (may be NULL)
+ *  Output: the restored codewords, or NULL when out of memory
+ */
+static uint8_t *unpredict(Memory *mem, const uint8_t *codewords,
+                          unsigned width, unsigned height,
+                          const Arith_region *crop)
+{
+    unsigned blocks = width / 2, rows = height / 2;
+    if (crop != NULL && crop -> y < height &&
+        crop -> height < height - crop -> y) {
+        rows = (crop -> y + crop -> height + 1) / 2;
+    }
+    size_t stride = (size_t)blocks * CODEWORD_BYTES;
+    uint8_t *grid = newBuffer(mem, Codeword_image_size(width, height));
+    if (grid == NULL) {
+        return NULL;
+    }
+    Stats_clock clock = Stats_start();
+    memcpy(grid, codewords, rows * stride);
+    Predict_decode(grid, blocks, rows, stride);
+    Stats_lap(STATS_UNPACK, clock);
+    return grid;
+}
+
+/*  Name: unlayer
+ *  Purpose: This function joins the layers of a format 5 image, of which
+ *           avail bytes have arrived, into plain codewords. A thumbnail
+ *           needs the averages alone, and is final as soon as they are
+ *           whole; a full picture or a region is final once every block
+ *           it draws has its detail.
+ *  Input: the memory to allocate from, the layers, the bytes of them that
+ *         have arrived, the dimensions, the scale, the region (may be
+ *         NULL) and a location for whether the picture is final (may be
+ *         NULL)
+ *  Output: the codewords, or NULL when out of memory
+ */
+static uint8_t *unlayer(Memory *mem, const uint8_t *layers, size_t avail,
+                        unsigned width, unsigned height, unsigned scale,
+                        const Arith_region *crop, int *complete)
+{
+    size_t across = width / 2, blocks = across * (height / 2);
+    size_t needed = blocks;
+    if (scale > 1) {
+        avail = Layers_dc_size(blocks);
+        needed = 0;
+    } else if (crop != NULL && crop -> y < height &&
+               crop -> height < height - crop -> y) {
+        needed = (crop -> y + crop -> height + 1) / 2 * across;
+    }
+    uint8_t *grid = newBuffer(mem, Codeword_image_size(width, height));
+    if (grid == NULL) {
+        return NULL;
+    }
+    Stats_clock clock = Stats_start();
+    size_t refined = Layers_join(layers, avail, blocks, grid);
+    Stats_lap(STATS_UNPACK, clock);
+    if (complete != NULL) {
+        *complete = refined >= needed;
+    }
+    return grid;
+}
+
+/*  Name: isTiled
+ *  Purpose: This function tells format 3 from format 2 by its magic.
+ */
+static int isTiled(const uint8_t *comp, size_t n)
+{
+    size_t magic_len = strlen(CODEWORD_TILED_MAGIC);
+    return n >= magic_len &&
+           memcmp(comp, CODEWORD_TILED_MAGIC, magic_len) == 0;
+}
+
+/*  Name: tiled
+ *  Purpose: This function decompresses a format 3 image. A full decode
+ *           hands every tile to Tile_decode(); a thumbnail or a region
+ *           first puts the codewords of the tiles it needs back into a
+ *           format 2 grid and then decodes that as usual.
+ *  Input: the memory to allocate from, the compressed image and its
+ *         length, the scale, the region (may be NULL), the number of
+ *         threads and locations for the output
+ *  Output: ARITH_OK, or the reason the image could not be decompressed
+ */
+static Arith_status tiled(Memory *mem, const uint8_t *comp, size_t n,
+                          unsigned scale, const Arith_region *crop,
+                          unsigned threads, uint8_t **out, size_t *outlen)
+{
+    Stats_clock clock = Stats_start();
+    Tile_layout layout;
+    Arith_status status = Tile_open(comp, n, &layout);
+    Stats_lap(STATS_PARSE_HEADER, clock);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    unsigned width = layout.width, height = layout.height;
+
+    if (scale == 1 && crop == NULL) {
+        size_t row_bytes = Ppmmem_row_bytes(width, 255);
+        uint8_t *dest = newBuffer(mem, PPMMEM_HEADER_MAX +
+                                       row_bytes * height);
+        if (dest == NULL) {
+            return ARITH_ENOMEM;
+        }
+        size_t hlen = Ppmmem_header_write(dest, width, height, 255);
+        status = Tile_decode(&layout, threads, dest + hlen);
+        if (status != ARITH_OK) {
+            freeBuffer(mem, dest);
+            return status;
+        }
+        *out = dest;
+        *outlen = hlen + row_bytes * height;
+        return ARITH_OK;
+    }
+
+    /* the tiles a region touches, or all of them */
+    unsigned x0 = 0, y0 = 0, x1 = layout.across, y1 = layout.down;
+    if (crop != NULL && crop -> x < width && crop -> y < height &&
+        crop -> width > 0 && crop -> height > 0) {
+        x0 = crop -> x / layout.tile_width;
+        y0 = crop -> y / layout.tile_height;
+        unsigned right = crop -> width > width - crop -> x
+                         ? width : crop -> x + crop -> width;
+        unsigned bottom = crop -> height > height - crop -> y
+                          ? height : crop -> y + crop -> height;
+        x1 = (right - 1) / layout.tile_width + 1;
+        y1 = (bottom - 1) / layout.tile_height + 1;
+    }
+    size_t stride = (size_t)(width / 2) * CODEWORD_BYTES;
+    uint8_t *grid = newBuffer(mem, Codeword_image_size(width, height));
+    if (grid == NULL) {
+        return ARITH_ENOMEM;
+    }
+    for (unsigned ty = y0; ty < y1 && status == ARITH_OK; ty++) {
+        for (unsigned tx = x0; tx < x1 && status == ARITH_OK; tx++) {
+            status = Tile_unpack(&layout, ty * layout.across + tx, grid,
+                                 stride);
+        }
+    }
+    if (status == ARITH_OK) {
+        status = scale > 1
+                 ? thumbnail(mem, grid, width, height, scale, out, outlen)
+                 : region(mem, grid, width, height, *crop, out, outlen);
+    }
+    freeBuffer(mem, grid);
+    return status;
+}
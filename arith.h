@@ -0,0 +1,346 @@
+/*********************************************************************
+ *                     arith.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for the in-memory compression
+ *              library. Unlike compress40()/decompress40(), these
+ *              functions read from and write to memory buffers, keep no
+ *              global state (so they may be called from several threads
+ *              at once) and report bad input through a status code
+ *              instead of aborting.
+ *********************************************************************/
+
+#ifndef ARITH_INCLUDED
+#define ARITH_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "a2methods.h"
+#include "pnm.h"
+
+/* result of every library call; ARITH_OK is zero */
+typedef enum Arith_status {
+    ARITH_OK = 0,
+    ARITH_EINVAL,       /* NULL buffer or output pointer */
+    ARITH_EBADFORMAT,   /* input is not a PPM / compressed image */
+    ARITH_ETRUNCATED,   /* input ends before the last pixel/codeword */
+    ARITH_ETOOSMALL,    /* image narrower or shorter than 2 pixels */
+    ARITH_ENOMEM,       /* output buffer could not be allocated */
+    ARITH_EIO           /* reading or writing a stream failed */
+} Arith_status;
+
+/*
+ * a reusable scratch context: it owns an arena from which every plane
+ * and the output of a call are allocated. The arena is reset (not freed)
+ * at the start of each call, so once it has grown to fit the largest
+ * image, calls made with the context do not allocate at all; an arena
+ * past SCRATCH_KEEP (scratch.h) is freed at the reset instead. A context
+ * may be used by one thread at a time.
+ */
+typedef struct Arith_context *Arith_context;
+
+/* a rectangle of pixels; x and y locate its top left corner */
+typedef struct Arith_region {
+    unsigned x, y, width, height;
+} Arith_region;
+
+/*
+ * tuning knobs shared by compression and decompression; passing NULL
+ * for the options pointer, or NULL or 0 for a field, selects the default
+ */
+typedef struct Arith_options {
+    A2Methods_T methods;    /* method suite for the planes (plain);
+                             * ignored when a context is given */
+    Arith_context context;  /* scratch context (none: use malloc) */
+    unsigned scale;         /* decompression only: 1 (full size), or 2, 4
+                             * or 8 for a 1/scale thumbnail made from the
+                             * block averages alone */
+    const Arith_region *region;     /* decompression only: decode just
+                                     * this part of the image (all) */
+    unsigned tile;          /* compression only: write the tiled format 3
+                             * with tile x tile pixel tiles (format 2) */
+    int entropy;            /* compression only: rANS code the tiles of
+                             * format 3, with TILE_DEFAULT tiles unless
+                             * tile says otherwise, which must then be
+                             * at least ARITH_ENTROPY_MIN_TILE (no) */
+    int predict;            /* compression only: code the block averages
+                             * as residuals from their neighbours
+                             * (predict.h): format 4, or predicted tiles
+                             * of format 3 (no) */
+    int progressive;        /* compression only: write format 5, the
+                             * averages of every block ahead of the
+                             * detail of any (layers.h); not with tiles or
+                             * prediction (no) */
+    unsigned threads;       /* decompression of format 3: threads decoding
+                             * tiles at once (1) */
+} Arith_options;
+
+/* the smallest tile side that can be entropy coded: the codewords of a
+ * 6x6 tile take fewer bytes than the tables of a coded one */
+#define ARITH_ENTROPY_MIN_TILE 8
+
+/* Function: Arith_compress()
+ * Job: compress the PPM image held in ppm[0..n) and return the compressed
+ *      image in a buffer *out of *outlen bytes.
+ * Expected input: a P3 or P6 image of at least 2x2 pixels; odd widths and
+ *      heights are trimmed by one. A tile size in the options must be even,
+ *      and at least ARITH_ENTROPY_MIN_TILE with entropy coding.
+ * Expected output: ARITH_OK, or an error status with *out left untouched.
+ *      Without a context the caller frees *out with free(); with one, *out
+ *      belongs to the context and is valid until its next use.
+ */
+extern Arith_status Arith_compress(const uint8_t *ppm, size_t n,
+                                   uint8_t **out, size_t *outlen,
+                                   const Arith_options *opts);
+
+/* Function: Arith_decompress()
+ * Job: decompress the compressed image (format 2, 3, 4 or 5) held in
+ *      comp[0..n) and return a P6 image with denominator 255 in a buffer
+ *      *out of *outlen bytes.
+ *      With a scale of s > 1 in the options the image is ceil(width / s)
+ *      by ceil(height / s) pixels, each the average of an s x s box.
+ *      With a region, only the codewords of the 2x2 blocks that cover it
+ *      are read, and the image is the region clipped to the picture.
+ * Expected output: ARITH_OK, or an error status with *out left untouched;
+ *      ARITH_EINVAL for a scale other than 0, 1, 2, 4 or 8, for a region
+ *      that misses the picture, or for a region and a scale together.
+ *      *out is owned as for Arith_compress().
+ */
+extern Arith_status Arith_decompress(const uint8_t *comp, size_t n,
+                                     uint8_t **out, size_t *outlen,
+                                     const Arith_options *opts);
+
+/* Function: Arith_preview()
+ * Job: as Arith_decompress(), for the first n bytes of a format 5 image
+ *      that is still arriving. Once its averages are whole, every block is
+ *      drawn: from its averages alone (flat) until its detail is in too.
+ *      Calling again with more bytes refines the same picture in place,
+ *      top down; a thumbnail needs the averages only.
+ * Expected output: ARITH_OK, with *complete (if not NULL) set when the
+ *      picture is final; ARITH_ETRUNCATED while the averages are not all
+ *      there; ARITH_EBADFORMAT for any other format.
+ */
+extern Arith_status Arith_preview(const uint8_t *comp, size_t n,
+                                  uint8_t **out, size_t *outlen,
+                                  int *complete, const Arith_options *opts);
+
+/* a rearrangement of a compressed image that needs no decoding */
+typedef enum Arith_transform_op {
+    ARITH_FLIP_X,           /* mirror left to right */
+    ARITH_FLIP_Y,           /* mirror top to bottom */
+    ARITH_ROTATE_180,
+    ARITH_TRANSPOSE,        /* swap rows and columns */
+    ARITH_CROP              /* keep a rectangle with even corners */
+} Arith_transform_op;
+
+/* Function: Arith_transform()
+ * Job: apply op to the compressed image (any format) in comp[0..n) by
+ *      rearranging its codewords, and return the result in *out, *outlen,
+ *      in the format Arith_compress() would write with the same options.
+ *      Every op is exact on the codewords: a mirror negates c and d (or b
+ *      and d), a transpose swaps b and c, and the averages move with their
+ *      block, so nothing is lost to a decode and re-encode.
+ * Expected input: for ARITH_CROP, a crop whose x, y, width and height are
+ *      even; it is clipped to the picture. It is ignored for other ops.
+ * Expected output: ARITH_OK, or an error status with *out left untouched;
+ *      ARITH_EINVAL for an odd or missing crop, or one that misses the
+ *      picture. *out is owned as for Arith_compress().
+ */
+extern Arith_status Arith_transform(const uint8_t *comp, size_t n,
+                                    Arith_transform_op op,
+                                    const Arith_region *crop, uint8_t **out,
+                                    size_t *outlen,
+                                    const Arith_options *opts);
+
+/* how Arith_stitch() lays its images out */
+typedef enum Arith_direction {
+    ARITH_ACROSS,           /* side by side, left to right */
+    ARITH_DOWN              /* one above the other, top to bottom */
+} Arith_direction;
+
+/* Function: Arith_stitch()
+ * Job: join the count compressed images comps[k][0..ns[k]) (any format)
+ *      into one, in the order given, by copying runs of codewords, and
+ *      return it as Arith_transform() does.
+ * Expected output: ARITH_OK, or an error status with *out left untouched;
+ *      ARITH_EINVAL if count is 0, if the images do not share their height
+ *      (ARITH_ACROSS) or width (ARITH_DOWN), or if the result would be
+ *      too large. *out is owned as for Arith_compress().
+ */
+extern Arith_status Arith_stitch(const uint8_t *const *comps,
+                                 const size_t *ns, unsigned count,
+                                 Arith_direction direction, uint8_t **out,
+                                 size_t *outlen, const Arith_options *opts);
+
+/* called with the row and column of a piece, the piece (a compressed
+ * image of len bytes, valid only during the call) and the closure; a
+ * status other than ARITH_OK stops the split and is returned by it */
+typedef Arith_status Arith_piecefun(unsigned row, unsigned col,
+                                    const uint8_t *piece, size_t len,
+                                    void *cl);
+
+/* Function: Arith_split()
+ * Job: cut the compressed image in comp[0..n) into pieces of
+ *      piece_width x piece_height pixels (the last column and row may be
+ *      narrower) by copying runs of codewords, and call apply with each
+ *      in row-major order, in the format Arith_compress() would write
+ *      with the same options.
+ * Expected output: ARITH_OK, an error status, or the first status other
+ *      than ARITH_OK returned by apply; ARITH_EINVAL if a piece dimension
+ *      is odd or 0.
+ */
+extern Arith_status Arith_split(const uint8_t *comp, size_t n,
+                                unsigned piece_width, unsigned piece_height,
+                                Arith_piecefun *apply, void *cl,
+                                const Arith_options *opts);
+
+/* Function: Arith_codewords()
+ * Job: find the codewords of the compressed image (any format) in
+ *      comp[0..n) as a plain grid, as format 2 lays them out: width / 2
+ *      to a row, rows in order, averages not predicted. For format 2,
+ *      *codewords points into comp and *copy is NULL; otherwise they point
+ *      to a new buffer that the caller frees with free(*copy).
+ * Expected output: ARITH_OK, or the reason the image could not be read.
+ */
+extern Arith_status Arith_codewords(const uint8_t *comp, size_t n,
+                                    unsigned *width, unsigned *height,
+                                    const uint8_t **codewords,
+                                    uint8_t **copy);
+
+/* bins of the luma histogram of Arith_analyze() */
+#define ARITH_LUMA_BINS 256
+
+/* what Arith_analyze() measures */
+typedef struct Arith_summary {
+    unsigned width, height;
+    uint64_t luma[ARITH_LUMA_BINS]; /* pixels by luma: bin k holds
+                                     * k/256 <= Y < (k+1)/256 */
+    double mean_y;
+    double mean_pb, mean_pr;        /* Pb and Pr of the blocks */
+    double var_pb, var_pr;
+    uint64_t hash;                  /* average hash of the block averages:
+                                     * near images differ in few bits */
+} Arith_summary;
+
+/* Function: Arith_analyze()
+ * Job: measure the compressed image (any format) in comp[0..n) from its
+ *      codewords, without decoding a pixel. Without detail every pixel of
+ *      a block is counted at the block's average luma; with it the four
+ *      lumas are rebuilt from b, c and d as the decoder would.
+ * Expected output: ARITH_OK, or the reason the image could not be read.
+ *      Format 2 images are scanned where they lie. Only the context of
+ *      the options is used.
+ */
+extern Arith_status Arith_analyze(const uint8_t *comp, size_t n, int detail,
+                                  Arith_summary *summary,
+                                  const Arith_options *opts);
+
+/* Function: Arith_hash_distance()
+ * Job: return the number of bits in which two hashes of Arith_analyze()
+ *      differ; a handful or fewer marks a near duplicate.
+ */
+extern unsigned Arith_hash_distance(uint64_t x, uint64_t y);
+
+/* Function: Arith_tile_count()
+ * Job: store the number of tiles across and down a format 3 image.
+ * Expected output: ARITH_OK, or the reason comp is not a valid one.
+ */
+extern Arith_status Arith_tile_count(const uint8_t *comp, size_t n,
+                                     unsigned *across, unsigned *down);
+
+/* Function: Arith_decompress_tile()
+ * Job: decompress tile index (row-major, from 0) of a format 3 image on
+ *      its own into a P6 image, reading only that tile's codewords.
+ * Expected output: as for Arith_decompress(); ARITH_EINVAL if there is no
+ *      such tile. Only the context of the options is used.
+ */
+extern Arith_status Arith_decompress_tile(const uint8_t *comp, size_t n,
+                                          unsigned index, uint8_t **out,
+                                          size_t *outlen,
+                                          const Arith_options *opts);
+
+/* Function: Arith_context_new() / Arith_context_free()
+ * Job: create an empty context (NULL when out of memory) / release one
+ *      and set *ctx to NULL.
+ */
+extern Arith_context Arith_context_new(void);
+extern void Arith_context_free(Arith_context *ctx);
+
+/* Function: Arith_context_peak()
+ * Job: return the most scratch memory any one call has used, and through
+ *      *capacity (if not NULL) the memory the context holds.
+ */
+extern size_t Arith_context_peak(Arith_context ctx, size_t *capacity);
+
+/* the type shared by Arith_compress and Arith_decompress */
+typedef Arith_status Arith_codec(const uint8_t *src, size_t n,
+                                 uint8_t **out, size_t *outlen,
+                                 const Arith_options *opts);
+
+/* Function: Arith_read_stream()
+ * Job: read fp to end of file into a newly malloc'ed buffer, for callers
+ *      that hold a FILE * rather than a buffer.
+ * Expected output: ARITH_OK, ARITH_ENOMEM or ARITH_EIO.
+ */
+extern Arith_status Arith_read_stream(FILE *fp, uint8_t **buf, size_t *n);
+
+/*
+ * incremental decoder: instead of handing over a whole compressed image,
+ * the caller feeds it bytes as they arrive, split anywhere (inside the
+ * header or inside a codeword), and is called back once per completed
+ * pair of scanlines
+ */
+typedef struct Arith_decoder *Arith_decoder;
+
+/* called with the index of the top scanline (always even), the two
+ * scanlines of width pixels each, and the closure given to _new */
+typedef void Arith_rowfun(unsigned row, const struct Pnm_rgb *top,
+                          const struct Pnm_rgb *bottom, unsigned width,
+                          void *cl);
+
+/* Function: Arith_decoder_new()
+ * Job: create a decoder that reports rows to apply(row, ..., cl); the
+ *      pixels it reports have denominator 255. It reads formats 2 and 4,
+ *      whose codewords arrive in scanline order; format 5 is drawn as it
+ *      arrives by Arith_preview().
+ * Expected output: the decoder, or NULL if it cannot be allocated.
+ */
+extern Arith_decoder Arith_decoder_new(Arith_rowfun *apply, void *cl);
+
+/* Function: Arith_decoder_feed()
+ * Job: consume len bytes of the compressed image, calling apply for every
+ *      scanline pair they complete. Bytes after the last codeword are
+ *      ignored.
+ * Expected output: ARITH_OK, ARITH_EBADFORMAT (the header is bad; every
+ *      later call returns it too) or ARITH_ENOMEM.
+ */
+extern Arith_status Arith_decoder_feed(Arith_decoder dec, const uint8_t *buf,
+                                       size_t len);
+
+/* Function: Arith_decoder_finish()
+ * Job: report whether the whole image was received.
+ * Expected output: ARITH_OK when every row was delivered, otherwise the
+ *      sticky error or ARITH_ETRUNCATED; see Arith_decoder_progress().
+ */
+extern Arith_status Arith_decoder_finish(Arith_decoder dec);
+
+/* Function: Arith_decoder_progress()
+ * Job: store the image dimensions (0 until the header is complete) and the
+ *      number of scanlines delivered so far; any pointer may be NULL.
+ */
+extern void Arith_decoder_progress(Arith_decoder dec, unsigned *width,
+                                   unsigned *height, unsigned *rows_done);
+
+/* Function: Arith_decoder_free()
+ * Job: release the decoder and set *dec to NULL.
+ */
+extern void Arith_decoder_free(Arith_decoder *dec);
+
+/* Function: Arith_strerror()
+ * Job: return a constant, human-readable description of a status.
+ */
+extern const char *Arith_strerror(Arith_status status);
+
+#endif
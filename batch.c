@@ -0,0 +1,438 @@
+/*********************************************************************
+ *                     batch.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for batch mode. Every worker
+ *              owns a deque of file indices: it takes work from the
+ *              back of its own deque and, once that is empty, steals
+ *              from the front of another worker's. Each deque has its
+ *              own lock, which is only contended while stealing.
+ *              Output names are worked out before any file is queued;
+ *              inputs whose names clash with an earlier input's (same
+ *              base name, another directory) fail without being coded,
+ *              so that no two workers ever write the same file.
+ *********************************************************************/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "assert.h"
+#include "batch.h"
+#include "stats.h"
+
+/* the deque of a worker: indices queue[head..tail) are still to do */
+typedef struct Deque {
+    pthread_mutex_t lock;
+    unsigned *queue;
+    unsigned head, tail;
+} Deque;
+
+/* state shared by every worker of one batch */
+typedef struct Pool {
+    Arith_codec *codec;
+    Archive_T archive;      /* where the inputs are, or NULL for files */
+    char **paths;
+    const char *outdir;
+    const char *extension;
+    char **dests;           /* the output path of each input */
+    unsigned nworkers;
+    Deque *deques;
+    pthread_mutex_t stats_lock;
+    Batch_stats *stats;
+} Pool;
+
+/* an output path and the input it is for, sorted to find clashes */
+typedef struct Output {
+    const char *dest;
+    unsigned index;
+} Output;
+
+/* closure of one worker thread */
+typedef struct Worker {
+    Pool *pool;
+    unsigned id;
+    Arith_context ctx;      /* reused for every file the worker codes */
+} Worker;
+
+static void run(Arith_codec *codec, Archive_T archive, char **paths,
+                unsigned npaths, const char *outdir, const char *extension,
+                unsigned threads, Batch_stats *stats);
+static void *work(void *cl);
+static int takeOwn(Deque *deque, unsigned *index);
+static int steal(Pool *pool, unsigned thief, unsigned *index);
+static void processFile(Pool *pool, Arith_context ctx, unsigned index);
+static char *outputPath(const char *outdir, const char *path,
+                        const char *extension);
+static unsigned findClashes(Pool *pool, unsigned npaths, uint8_t *clash);
+static int compareOutputs(const void *a, const void *b);
+static Arith_status writeFile(const char *path, const uint8_t *buf,
+                              size_t n);
+static double now(void);
+
+
+/*  Name: Batch_run
+ *  Purpose: This function codes a batch of files.
+ *  Input: the codec, the paths, the output directory and extension, the
+ *         pool size (0 for one per processor) and the stats to fill in.
+ *  Output: N/A
+ *  Error condition: CRE if a pointer is NULL or threads cannot be made.
+ */
+void Batch_run(Arith_codec *codec, char **paths, unsigned npaths,
+               const char *outdir, const char *extension,
+               unsigned threads, Batch_stats *stats)
+{
+    run(codec, NULL, paths, npaths, outdir, extension, threads, stats);
+}
+
+/*  Name: Batch_run_archive
+ *  Purpose: This function codes a batch of images of an archive.
+ *  Input: as Batch_run(), with the archive and the IDs for the paths
+ *  Output: N/A
+ *  Error condition: CRE if a pointer is NULL or threads cannot be made.
+ */
+void Batch_run_archive(Arith_codec *codec, Archive_T archive, char **ids,
+                       unsigned nids, const char *outdir,
+                       const char *extension, unsigned threads,
+                       Batch_stats *stats)
+{
+    assert(archive != NULL);
+    run(codec, archive, ids, nids, outdir, extension, threads, stats);
+}
+
+/*  Name: run
+ *  Purpose: This function deals the inputs out to the workers' deques,
+ *           starts the workers and waits for them to drain every deque.
+ *  Input: as Batch_run(), with the archive the inputs are in (NULL for
+ *         files)
+ *  Output: N/A
+ */
+static void run(Arith_codec *codec, Archive_T archive, char **paths,
+                unsigned npaths, const char *outdir, const char *extension,
+                unsigned threads, Batch_stats *stats)
+{
+    assert(codec != NULL && (paths != NULL || npaths == 0));
+    assert(outdir != NULL && extension != NULL && stats != NULL);
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? online : 1;
+    }
+    if (threads > npaths) {
+        threads = npaths > 0 ? npaths : 1;
+    }
+    memset(stats, 0, sizeof(*stats));
+    double start = now();
+
+    Pool pool = { codec, archive, paths, outdir, extension, NULL, threads,
+                  NULL, PTHREAD_MUTEX_INITIALIZER, stats };
+    pool.dests = calloc(npaths + 1, sizeof(char *));
+    uint8_t *clash = calloc(npaths + 1, 1);
+    pool.deques = calloc(threads, sizeof(Deque));
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    Worker *workers = calloc(threads, sizeof(Worker));
+    assert(pool.dests != NULL && clash != NULL && pool.deques != NULL &&
+           tids != NULL && workers != NULL);
+    stats -> failures = findClashes(&pool, npaths, clash);
+
+    /* deal files round robin so neighbours in the list are spread out */
+    for (unsigned w = 0; w < threads; w++) {
+        Deque *deque = &pool.deques[w];
+        pthread_mutex_init(&deque -> lock, NULL);
+        deque -> queue = malloc((npaths / threads + 1) * sizeof(unsigned));
+        assert(deque -> queue != NULL);
+    }
+    for (unsigned i = 0, dealt = 0; i < npaths; i++) {
+        if (!clash[i]) {
+            Deque *deque = &pool.deques[dealt++ % threads];
+            deque -> queue[deque -> tail++] = i;
+        }
+    }
+
+    for (unsigned w = 0; w < threads; w++) {
+        workers[w].pool = &pool;
+        workers[w].id = w;
+        int err = pthread_create(&tids[w], NULL, work, &workers[w]);
+        assert(err == 0);
+    }
+    for (unsigned w = 0; w < threads; w++) {
+        pthread_join(tids[w], NULL);
+    }
+
+    for (unsigned w = 0; w < threads; w++) {
+        pthread_mutex_destroy(&pool.deques[w].lock);
+        free(pool.deques[w].queue);
+    }
+    pthread_mutex_destroy(&pool.stats_lock);
+    for (unsigned i = 0; i < npaths; i++) {
+        free(pool.dests[i]);
+    }
+    free(pool.dests);
+    free(clash);
+    free(pool.deques);
+    free(tids);
+    free(workers);
+    stats -> seconds = now() - start;
+}
+
+/*  Name: Batch_read_manifest
+ *  Purpose: This function reads a list of paths, one per line.
+ *  Input: the stream and the location for the array of paths
+ *  Output: the number of paths read
+ *  Error condition: CRE if a pointer is NULL or memory runs out.
+ */
+unsigned Batch_read_manifest(FILE *fp, char ***paths)
+{
+    assert(fp != NULL && paths != NULL);
+    unsigned count = 0, capacity = 64;
+    char **list = malloc(capacity * sizeof(char *));
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    assert(list != NULL);
+
+    while ((len = getline(&line, &size, fp)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len == 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            list = realloc(list, capacity * sizeof(char *));
+            assert(list != NULL);
+        }
+        list[count] = strdup(line);
+        assert(list[count] != NULL);
+        count++;
+    }
+    free(line);
+    *paths = list;
+    return count;
+}
+
+/*  Name: work
+ *  Purpose: This function is the body of a worker thread: it processes its
+ *           own files, then steals until no deque has any left. All the
+ *           files of a worker share one scratch context, so after the first
+ *           few files the library stops allocating.
+ *  Input: the Worker closure
+ *  Output: NULL
+ */
+static void *work(void *cl)
+{
+    Worker *worker = cl;
+    Pool *pool = worker -> pool;
+    unsigned index;
+
+    /* without a context the library falls back on malloc */
+    worker -> ctx = Arith_context_new();
+    while (takeOwn(&pool -> deques[worker -> id], &index) ||
+           steal(pool, worker -> id, &index)) {
+        processFile(pool, worker -> ctx, index);
+    }
+    if (worker -> ctx != NULL) {
+        Arith_context_free(&worker -> ctx);
+    }
+    return NULL;
+}
+
+/*  Name: takeOwn
+ *  Purpose: This function pops the most recently dealt file off the back of
+ *           a worker's own deque.
+ *  Output: 1 with *index set, or 0 if the deque is empty
+ */
+static int takeOwn(Deque *deque, unsigned *index)
+{
+    int found = 0;
+    pthread_mutex_lock(&deque -> lock);
+    if (deque -> head < deque -> tail) {
+        *index = deque -> queue[--deque -> tail];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque -> lock);
+    return found;
+}
+
+/*  Name: steal
+ *  Purpose: This function takes a file off the front of the first other
+ *           deque that has one, starting with the thief's neighbour so
+ *           thieves spread over their victims.
+ *  Output: 1 with *index set, or 0 if every deque is empty
+ */
+static int steal(Pool *pool, unsigned thief, unsigned *index)
+{
+    for (unsigned k = 1; k < pool -> nworkers; k++) {
+        Deque *victim = &pool -> deques[(thief + k) % pool -> nworkers];
+        int found = 0;
+        pthread_mutex_lock(&victim -> lock);
+        if (victim -> head < victim -> tail) {
+            *index = victim -> queue[victim -> head++];
+            found = 1;
+        }
+        pthread_mutex_unlock(&victim -> lock);
+        if (found) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*  Name: processFile
+ *  Purpose: This function reads, codes and writes one file (or codes the
+ *           image of an archive where it lies), then adds its sizes to
+ *           the batch totals.
+ *  Input: the pool, the worker's context (may be NULL) and the index of
+ *         the file
+ *  Output: N/A
+ */
+static void processFile(Pool *pool, Arith_context ctx, unsigned index)
+{
+    Arith_options opts = { .context = ctx };
+    const char *path = pool -> paths[index];
+    uint8_t *src = NULL, *out = NULL;
+    size_t n = 0, outlen = 0;
+    Arith_status status = ARITH_EIO;
+
+    if (pool -> archive != NULL) {
+        const uint8_t *image;
+        status = Archive_find(pool -> archive, path, &image, &n)
+                 ? pool -> codec(image, n, &out, &outlen, &opts)
+                 : ARITH_EINVAL;
+    } else {
+        FILE *fp = fopen(path, "rb");
+        if (fp != NULL) {
+            status = Arith_read_stream(fp, &src, &n);
+            fclose(fp);
+        }
+        if (status == ARITH_OK) {
+            status = pool -> codec(src, n, &out, &outlen, &opts);
+            free(src);
+        }
+    }
+    if (status == ARITH_OK) {
+        status = writeFile(pool -> dests[index], out, outlen);
+        if (ctx == NULL) {
+            free(out);
+        }
+    }
+
+    pthread_mutex_lock(&pool -> stats_lock);
+    if (status == ARITH_OK) {
+        pool -> stats -> files++;
+        pool -> stats -> bytes_in += n;
+        pool -> stats -> bytes_out += outlen;
+    } else {
+        pool -> stats -> failures++;
+        fprintf(stderr, "%s: %s\n", path, Arith_strerror(status));
+    }
+    pthread_mutex_unlock(&pool -> stats_lock);
+}
+
+/*  Name: outputPath
+ *  Purpose: This function builds outdir/<base name of path> with the
+ *           extension of the base name replaced.
+ *  Output: a malloc'ed string, or NULL when out of memory
+ */
+static char *outputPath(const char *outdir, const char *path,
+                        const char *extension)
+{
+    const char *base = strrchr(path, '/');
+    base = base == NULL ? path : base + 1;
+    const char *dot = strrchr(base, '.');
+    int stem = (dot == NULL || dot == base) ? (int)strlen(base)
+                                            : (int)(dot - base);
+
+    size_t size = strlen(outdir) + stem + strlen(extension) + 3;
+    char *dest = malloc(size);
+    if (dest != NULL) {
+        snprintf(dest, size, "%s/%.*s.%s", outdir, stem, base, extension);
+    }
+    return dest;
+}
+
+/*  Name: findClashes
+ *  Purpose: This function works out the output path of every input and
+ *           marks each input whose path is that of an earlier input,
+ *           reporting it on stderr.
+ *  Input: the pool, whose dests it fills in, the number of inputs and
+ *         the array of marks (all 0)
+ *  Output: the number of inputs marked
+ *  Error condition: CRE when out of memory.
+ */
+static unsigned findClashes(Pool *pool, unsigned npaths, uint8_t *clash)
+{
+    Output *outputs = malloc((npaths + 1) * sizeof(Output));
+    assert(outputs != NULL);
+    for (unsigned i = 0; i < npaths; i++) {
+        pool -> dests[i] = outputPath(pool -> outdir, pool -> paths[i],
+                                      pool -> extension);
+        assert(pool -> dests[i] != NULL);
+        outputs[i].dest = pool -> dests[i];
+        outputs[i].index = i;
+    }
+    qsort(outputs, npaths, sizeof(Output), compareOutputs);
+
+    unsigned clashes = 0, first = 0;
+    for (unsigned k = 1; k < npaths; k++) {
+        if (strcmp(outputs[k].dest, outputs[first].dest) != 0) {
+            first = k;
+            continue;
+        }
+        clash[outputs[k].index] = 1;
+        clashes++;
+        fprintf(stderr, "%s: %s is already the output of %s\n",
+                pool -> paths[outputs[k].index], outputs[k].dest,
+                pool -> paths[outputs[first].index]);
+    }
+    free(outputs);
+    return clashes;
+}
+
+/*  Name: compareOutputs
+ *  Purpose: This function orders outputs by path, then by input.
+ */
+static int compareOutputs(const void *a, const void *b)
+{
+    const Output *x = a, *y = b;
+    int order = strcmp(x -> dest, y -> dest);
+    if (order != 0) {
+        return order;
+    }
+    return (x -> index > y -> index) - (x -> index < y -> index);
+}
+
+/*  Name: writeFile
+ *  Purpose: This function writes n bytes of buf to a new file at path.
+ *  Output: ARITH_OK or ARITH_EIO
+ */
+static Arith_status writeFile(const char *path, const uint8_t *buf, size_t n)
+{
+    Stats_clock clock = Stats_start();
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return ARITH_EIO;
+    }
+    size_t written = fwrite(buf, 1, n, fp);
+    int closed = fclose(fp);
+    Stats_lap(STATS_WRITE_OUTPUT, clock);
+    Stats_io(0, written);
+    if (closed != 0 || written != n) {
+        return ARITH_EIO;
+    }
+    return ARITH_OK;
+}
+
+/*  Name: now
+ *  Purpose: This function returns a monotonic time stamp in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
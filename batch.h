@@ -0,0 +1,62 @@
+/*********************************************************************
+ *                     batch.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for compressing or decompressing
+ *              many files in one process. Files are spread over a pool
+ *              of worker threads, each with its own queue; a worker
+ *              whose queue runs dry steals from the others, so a single
+ *              huge image only ever occupies one worker.
+ *********************************************************************/
+
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+
+#include <stddef.h>
+#include <stdio.h>
+#include "arith.h"
+#include "archive.h"
+
+/* totals over a whole batch */
+typedef struct Batch_stats {
+    unsigned files;         /* files processed successfully */
+    unsigned failures;      /* files that could not be read/coded/written */
+    size_t bytes_in;        /* input bytes of the successful files */
+    size_t bytes_out;       /* output bytes written */
+    double seconds;         /* wall clock time of the whole batch */
+} Batch_stats;
+
+/* Function: Batch_run()
+ * Job: apply codec to each of the npaths files and write each result to
+ *      outdir, named after the input's base name with its extension
+ *      replaced by extension (e.g. "a/b.ppm" -> "outdir/b.c40"). A file
+ *      whose output name is that of an earlier file (e.g. "c/b.ppm")
+ *      fails without being coded. Errors are reported on stderr, one
+ *      line per failing file.
+ * Expected input: threads is the size of the pool; 0 means one per
+ *      online processor.
+ * Expected output: the totals in *stats.
+ */
+extern void Batch_run(Arith_codec *codec, char **paths, unsigned npaths,
+                      const char *outdir, const char *extension,
+                      unsigned threads, Batch_stats *stats);
+
+/* Function: Batch_run_archive()
+ * Job: as Batch_run(), for the images of archive with the nids IDs ids;
+ *      each is coded where it lies in the mapped archive, and the output
+ *      is named as if the ID were a path.
+ */
+extern void Batch_run_archive(Arith_codec *codec, Archive_T archive,
+                              char **ids, unsigned nids, const char *outdir,
+                              const char *extension, unsigned threads,
+                              Batch_stats *stats);
+
+/* Function: Batch_read_manifest()
+ * Job: read one path per line from fp (blank lines are skipped) into a
+ *      malloc'ed array of malloc'ed strings.
+ * Expected output: the number of paths; *paths is set even when it is 0.
+ */
+extern unsigned Batch_read_manifest(FILE *fp, char ***paths);
+
+#endif
@@ -0,0 +1,478 @@
+/*********************************************************************
+ *                     bench.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the benchmark harness for the codec ("make
+ *              bench"). It builds a deterministic corpus of synthetic
+ *              images, times every stage of compression and
+ *              decompression separately with clock_gettime() for each
+ *              A2Methods suite, the row kernels and the library entry
+ *              points, and prints the median megapixels per second of
+ *              each as CSV on stdout.
+ *
+ *              Before timing anything it checks that encodeBlockRow()
+ *              gives every flat block of 8-bit colour the codeword of
+ *              the general transform (calculate_CVtoDCT() over four
+ *              CVs); any difference is printed on stderr and the
+ *              program exits with status 1.
+ *
+ *              Usage: bench [-r runs] [--min size] [--max size] [--check]
+ *********************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "assert.h"
+#include "arith.h"
+#include "codec.h"
+#include "codeword.h"
+#include "ppmmem.h"
+#include "pnm.h"
+#include "a2plain.h"
+#include "a2flat.h"
+#include "a2blocked.h"
+
+#define A2 A2Methods_UArray2
+
+#define MAX_RUNS 99
+
+/* mismatches printed before the rest are only counted */
+#define MAX_REPORTS 20
+
+/* every timed step; the A2 stages are timed once per suite */
+typedef enum {
+    READ, TRIM, RGB_TO_CV, CV_TO_DCT, PACK,
+    HEADER, UNPACK, DCT_TO_CV, CV_TO_RGB, WRITE,
+    ENCODE_ROWS, DECODE_ROWS,
+    COMPRESS, DECOMPRESS,
+    NSTAGES
+} Stage;
+
+static const char *stageNames[NSTAGES] = {
+    "Pnm_ppmread", "trimDimension", "RGB_toCV", "CVtoDCT", "packDCT",
+    "readHeader", "unpackDCT", "DCTtoCV", "CV_toRGB", "Ppmmem_write",
+    "encodeBlockRow", "decodeBlockRow",
+    "Arith_compress", "Arith_decompress"
+};
+
+/* seconds taken by each stage in each run */
+typedef double Timings[NSTAGES][MAX_RUNS];
+
+typedef void Pattern(unsigned x, unsigned y, unsigned width,
+                     unsigned height, uint32_t *seed, uint8_t rgb[3]);
+
+static Pattern gradient, noise, flat, photo;
+
+static const struct {
+    const char *name;
+    Pattern *fill;
+} patterns[] = {
+    { "gradient", gradient },
+    { "noise",    noise    },
+    { "flat",     flat     },
+    { "photo",    photo    },
+};
+
+static const struct {
+    const char *name;
+    A2Methods_T *methods;
+} suites[] = {
+    { "plain",   &uarray2_methods_plain   },
+    { "flat",    &uarray2_methods_flat    },
+    { "blocked", &uarray2_methods_blocked },
+};
+
+static const unsigned sizes[] = { 64, 256, 1024, 4096, 16384 };
+
+static unsigned long checkFlatBlocks(void);
+static uint8_t *makeImage(Pattern *fill, unsigned size, size_t *n);
+static void timeSuite(A2Methods_T methods, const uint8_t *ppm, size_t n,
+                      Timings t, int run);
+static void timeRows(const uint8_t *ppm, size_t n, Timings t, int run);
+static void timeLibrary(const uint8_t *ppm, size_t n, Arith_context ctx,
+                        Timings t, int run);
+static void report(const char *pattern, unsigned size, const char *variant,
+                   Timings t, Stage first, Stage last, int runs);
+static double lap(double *start);
+static int compareDoubles(const void *a, const void *b);
+static uint32_t xorshift(uint32_t *seed);
+static uint8_t clamp(double value);
+static void usage(const char *progname);
+
+
+int main(int argc, char *argv[])
+{
+    int runs = 5;
+    unsigned min = 64, max = 1024;
+    int check_only = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min") == 0 && i + 1 < argc) {
+            min = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+            max = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check_only = 1;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (runs < 1 || runs > MAX_RUNS) {
+        usage(argv[0]);
+    }
+
+    unsigned long mismatches = checkFlatBlocks();
+    if (mismatches > 0) {
+        fprintf(stderr, "bench: %lu flat blocks differ\n", mismatches);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "bench: every flat block matches calculate_CVtoDCT\n");
+    if (check_only) {
+        return EXIT_SUCCESS;
+    }
+
+    static Timings t;
+    Arith_context ctx = Arith_context_new();
+    assert(ctx != NULL);
+    printf("pattern,width,height,variant,stage,runs,median_ms,mpix_per_s\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        if (sizes[s] < min || sizes[s] > max) {
+            continue;
+        }
+        for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+            size_t n;
+            uint8_t *ppm = makeImage(patterns[p].fill, sizes[s], &n);
+            const char *name = patterns[p].name;
+
+            for (size_t k = 0; k < sizeof(suites) / sizeof(suites[0]); k++) {
+                for (int run = 0; run < runs; run++) {
+                    timeSuite(*suites[k].methods, ppm, n, t, run);
+                }
+                report(name, sizes[s], suites[k].name, t, READ, WRITE, runs);
+            }
+            for (int run = 0; run < runs; run++) {
+                timeRows(ppm, n, t, run);
+            }
+            report(name, sizes[s], "rows", t, ENCODE_ROWS, DECODE_ROWS,
+                   runs);
+            for (int run = 0; run < runs; run++) {
+                timeLibrary(ppm, n, NULL, t, run);
+            }
+            report(name, sizes[s], "library", t, COMPRESS, DECOMPRESS, runs);
+            for (int run = 0; run < runs; run++) {
+                timeLibrary(ppm, n, ctx, t, run);
+            }
+            report(name, sizes[s], "library+context", t, COMPRESS,
+                   DECOMPRESS, runs);
+            fflush(stdout);
+            free(ppm);
+        }
+    }
+    Arith_context_free(&ctx);
+    return EXIT_SUCCESS;
+}
+
+/*  Name: checkFlatBlocks
+ *  Purpose: This function encodes a flat 2x2 block of every 8-bit colour
+ *           with encodeBlockRow(), which takes the flat path, and compares
+ *           the codeword with that of calculate_CVtoDCT() given the four
+ *           CVs of the block.
+ *  Output: the number of colours whose codewords differ
+ */
+static unsigned long checkFlatBlocks(void)
+{
+    unsigned long mismatches = 0;
+    for (uint32_t rgb = 0; rgb < 1u << 24; rgb++) {
+        struct Pnm_rgb px = { rgb >> 16, rgb >> 8 & 0xff, rgb & 0xff };
+        struct Pnm_rgb top[2] = { px, px }, bottom[2] = { px, px };
+        uint8_t flat[CODEWORD_BYTES];
+        encodeBlockRow(top, bottom, 1, 255, NULL, flat);
+
+        cv elem = calculateCV(px.red, px.green, px.blue, 255);
+        DCT element;
+        calculate_CVtoDCT(&elem, &elem, &elem, &elem, &element);
+        uint32_t general = Codeword_pack(&element);
+        if (Codeword_get(flat) != general) {
+            if (mismatches < MAX_REPORTS) {
+                fprintf(stderr, "flat block %u %u %u: 0x%08x, general "
+                        "0x%08x\n", px.red, px.green, px.blue,
+                        (unsigned)Codeword_get(flat), (unsigned)general);
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+/*  Name: makeImage
+ *  Purpose: This function renders a size x size P6 image of a pattern; the
+ *           same arguments always give the same bytes.
+ *  Input: the pattern, the size and a location for the length
+ *  Output: the malloc'ed image
+ */
+static uint8_t *makeImage(Pattern *fill, unsigned size, size_t *n)
+{
+    size_t row = Ppmmem_row_bytes(size, 255);
+    uint8_t *ppm = malloc(PPMMEM_HEADER_MAX + row * size);
+    assert(ppm != NULL);
+    uint8_t *p = ppm + Ppmmem_header_write(ppm, size, size, 255);
+    uint32_t seed = 2463534242u;
+    for (unsigned y = 0; y < size; y++) {
+        for (unsigned x = 0; x < size; x++, p += 3) {
+            fill(x, y, size, size, &seed, p);
+        }
+    }
+    *n = p - ppm;
+    return ppm;
+}
+
+/*  Name: timeSuite
+ *  Purpose: This function runs the whole codec once through the A2 stages
+ *           with one method suite, timing each stage. The arrays are made
+ *           outside the timed regions, as the library does.
+ */
+static void timeSuite(A2Methods_T methods, const uint8_t *ppm, size_t n,
+                      Timings t, int run)
+{
+    FILE *fp = fmemopen((void *)ppm, n, "rb");
+    assert(fp != NULL);
+    double start = 0;
+    lap(&start);
+    Pnm_ppm image = Pnm_ppmread(fp, methods);
+    t[READ][run] = lap(&start);
+    fclose(fp);
+    trimDimension(image, methods);
+    t[TRIM][run] = lap(&start);
+
+    int width = image -> width, height = image -> height;
+    A2 arrayYPP = methods -> new(width, height, sizeof(cv));
+    A2 arrayDCT = methods -> new(width / 2, height / 2, sizeof(DCT));
+    uint8_t *comp = malloc(CODEWORD_HEADER_MAX +
+                           Codeword_image_size(width, height));
+    assert(comp != NULL);
+    lap(&start);
+    RGB_toCV(image, arrayYPP, methods);
+    t[RGB_TO_CV][run] = lap(&start);
+    CVtoDCT(arrayYPP, arrayDCT, methods);
+    t[CV_TO_DCT][run] = lap(&start);
+    size_t len = packDCT(arrayDCT, methods, comp);
+    t[PACK][run] = lap(&start);
+
+    struct Pnm_ppm out;
+    size_t hlen;
+    Arith_status status = readHeader(comp, len, &hlen, NULL, methods, &out);
+    t[HEADER][run] = lap(&start);
+    assert(status == ARITH_OK);
+    A2 backDCT = methods -> new(width / 2, height / 2, sizeof(DCT));
+    A2 backYPP = methods -> new(width, height, sizeof(cv));
+    out.pixels = methods -> new(width, height, sizeof(struct Pnm_rgb));
+    uint8_t *dest = malloc(Ppmmem_size(&out));
+    assert(dest != NULL);
+    lap(&start);
+    unpackDCT(backDCT, comp + hlen, methods);
+    t[UNPACK][run] = lap(&start);
+    DCTtoCV(backDCT, backYPP, methods);
+    t[DCT_TO_CV][run] = lap(&start);
+    CV_toRGB(&out, backYPP, methods);
+    t[CV_TO_RGB][run] = lap(&start);
+    Ppmmem_write(&out, dest);
+    t[WRITE][run] = lap(&start);
+
+    free(dest);
+    methods -> free(&out.pixels);
+    methods -> free(&backYPP);
+    methods -> free(&backDCT);
+    free(comp);
+    methods -> free(&arrayDCT);
+    methods -> free(&arrayYPP);
+    Pnm_ppmfree(&image);
+}
+
+/*  Name: timeRows
+ *  Purpose: This function times the row kernels used by the streaming
+ *           paths: parse and encode every row pair, then decode and write
+ *           every row pair, with no A2 arrays in between.
+ */
+static void timeRows(const uint8_t *ppm, size_t n, Timings t, int run)
+{
+    Ppmmem_header header;
+    Arith_status status = Ppmmem_parse_header(ppm, n, &header);
+    assert(status == ARITH_OK);
+    unsigned width = header.width, blocks = width / 2;
+    size_t row_bytes = Ppmmem_row_bytes(width, 255);
+    struct Pnm_rgb *top = malloc(width * sizeof(struct Pnm_rgb));
+    struct Pnm_rgb *bottom = malloc(width * sizeof(struct Pnm_rgb));
+    uint8_t *comp = malloc(Codeword_image_size(width, header.height));
+    uint8_t *dest = malloc(row_bytes * header.height);
+    assert(top != NULL && bottom != NULL && comp != NULL && dest != NULL);
+
+    double start = 0;
+    size_t pos = header.len;
+    lap(&start);
+    for (unsigned pair = 0; pair < header.height / 2; pair++) {
+        Ppmmem_read_row(&header, ppm, n, &pos, top);
+        Ppmmem_read_row(&header, ppm, n, &pos, bottom);
+        encodeBlockRow(top, bottom, blocks, header.denominator, NULL,
+                       comp + (size_t)pair * blocks * CODEWORD_BYTES);
+    }
+    t[ENCODE_ROWS][run] = lap(&start);
+    uint8_t *d = dest;
+    for (unsigned pair = 0; pair < header.height / 2; pair++) {
+        decodeBlockRow(comp + (size_t)pair * blocks * CODEWORD_BYTES,
+                       blocks, 255, top, bottom);
+        d += Ppmmem_write_row(top, width, 255, d);
+        d += Ppmmem_write_row(bottom, width, 255, d);
+    }
+    t[DECODE_ROWS][run] = lap(&start);
+
+    free(top);
+    free(bottom);
+    free(comp);
+    free(dest);
+}
+
+/*  Name: timeLibrary
+ *  Purpose: This function times Arith_compress and Arith_decompress end to
+ *           end, with a warm context or (ctx NULL) with malloc.
+ */
+static void timeLibrary(const uint8_t *ppm, size_t n, Arith_context ctx,
+                        Timings t, int run)
+{
+    Arith_options opts = { .context = ctx };
+    uint8_t *comp, *out;
+    size_t complen, outlen;
+    double start = 0;
+    lap(&start);
+    Arith_status status = Arith_compress(ppm, n, &comp, &complen, &opts);
+    t[COMPRESS][run] = lap(&start);
+    assert(status == ARITH_OK);
+
+    /* with a context, the next call reclaims comp */
+    uint8_t *copy = comp;
+    if (ctx != NULL) {
+        copy = malloc(complen);
+        assert(copy != NULL);
+        memcpy(copy, comp, complen);
+    }
+    lap(&start);
+    status = Arith_decompress(copy, complen, &out, &outlen, &opts);
+    t[DECOMPRESS][run] = lap(&start);
+    assert(status == ARITH_OK);
+    free(copy);
+    if (ctx == NULL) {
+        free(out);
+    }
+}
+
+/*  Name: report
+ *  Purpose: This function prints one CSV line with the median time and
+ *           throughput of each of the stages first..last.
+ */
+static void report(const char *pattern, unsigned size, const char *variant,
+                   Timings t, Stage first, Stage last, int runs)
+{
+    double mpix = (double)size * size / 1e6;
+    for (int s = first; s <= (int)last; s++) {
+        qsort(t[s], runs, sizeof(double), compareDoubles);
+        double median = runs % 2 ? t[s][runs / 2]
+                                 : (t[s][runs / 2 - 1] + t[s][runs / 2]) / 2;
+        printf("%s,%u,%u,%s,%s,%d,%.3f,%.1f\n", pattern, size, size,
+               variant, stageNames[s], runs, median * 1e3,
+               median > 0 ? mpix / median : INFINITY);
+    }
+}
+
+/*  Name: lap
+ *  Purpose: This function returns the seconds since *start and restarts
+ *           the clock.
+ */
+static double lap(double *start)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    double now = ts.tv_sec + ts.tv_nsec / 1e9;
+    double elapsed = now - *start;
+    *start = now;
+    return elapsed;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* the Marsaglia xorshift generator: fast, and the same on every machine */
+static uint32_t xorshift(uint32_t *seed)
+{
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *seed = x;
+}
+
+static uint8_t clamp(double value)
+{
+    return value < 0 ? 0 : value > 255 ? 255 : (uint8_t)value;
+}
+
+/* smooth ramps in each channel: the best case for the DCT */
+static void gradient(unsigned x, unsigned y, unsigned width,
+                     unsigned height, uint32_t *seed, uint8_t rgb[3])
+{
+    rgb[0] = x * 255 / (width - 1);
+    rgb[1] = y * 255 / (height - 1);
+    rgb[2] = (x + y) * 255 / (width + height - 2);
+    (void)seed;
+}
+
+/* independent uniform samples: the worst case */
+static void noise(unsigned x, unsigned y, unsigned width,
+                  unsigned height, uint32_t *seed, uint8_t rgb[3])
+{
+    uint32_t r = xorshift(seed);
+    rgb[0] = r;
+    rgb[1] = r >> 8;
+    rgb[2] = r >> 16;
+    (void)x; (void)y; (void)width; (void)height;
+}
+
+/* large rectangles of one colour each, like screenshots and diagrams */
+static void flat(unsigned x, unsigned y, unsigned width,
+                 unsigned height, uint32_t *seed, uint8_t rgb[3])
+{
+    uint32_t region = (x / 61) * 2654435761u ^ (y / 47) * 40503u;
+    uint32_t colour = xorshift(&region) | 1;
+    rgb[0] = colour;
+    rgb[1] = colour >> 8;
+    rgb[2] = colour >> 16;
+    (void)width; (void)height; (void)seed;
+}
+
+/* low-frequency shading with hard-edged shapes and a little sensor noise,
+ * roughly the statistics of a photograph */
+static void photo(unsigned x, unsigned y, unsigned width,
+                  unsigned height, uint32_t *seed, uint8_t rgb[3])
+{
+    double base = 128 + 70 * sin(x * 0.013 + y * 0.007);
+    double shade = ((x / 97 + y / 131) % 5 == 0) ? -60 : 0;
+    double grain = (int)(xorshift(seed) % 13) - 6;
+    rgb[0] = clamp(base + 40 * cos(y * 0.021) + shade + grain);
+    rgb[1] = clamp(base * 0.8 + 30 * sin((x + y) * 0.017) + shade + grain);
+    rgb[2] = clamp(100 + 60 * sin(x * 0.031) * cos(y * 0.011) + shade +
+                   grain);
+    (void)width; (void)height;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-r runs (1-%d)] [--min size] "
+            "[--max size] [--check]\n", progname, MAX_RUNS);
+    exit(1);
+}
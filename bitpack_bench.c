@@ -0,0 +1,433 @@
+/*********************************************************************
+ *                     bitpack_bench.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the equivalence suite and micro-benchmark for
+ *              bit packing ("make bitpack_bench"). It first checks every
+ *              function of bitpack_fast.h against bitpack.c: every value
+ *              at every lsb for widths up to SMALL_WIDTH, random and edge
+ *              values at every width/lsb pair up to 64, and the shift
+ *              helpers at every shift from 0 to 64. Calls that raise
+ *              Bitpack_Overflow must raise it in both. Any difference is
+ *              printed on stderr and the program exits with status 1
+ *              before timing anything.
+ *
+ *              It then prints the ns/op of each function of each variant
+ *              as CSV on stdout, one row per width averaged over every
+ *              lsb, or one row per width/lsb pair with --each-lsb.
+ *
+ *              Usage: bitpack_bench [-n ops] [--check] [--each-lsb]
+ *********************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "assert.h"
+#include "except.h"
+#include "bitpack.h"
+#include "bitpack_fast.h"
+
+/* widths up to this one are checked for every value of the field */
+#define SMALL_WIDTH 10
+
+/* random trials per width/lsb pair above SMALL_WIDTH */
+#define TRIALS 256
+
+/* inputs cycled through by the timing loops */
+#define NINPUTS 1024
+
+/* mismatches printed before the rest are only counted */
+#define MAX_REPORTS 20
+
+/* the shift helpers of bitpack.c, which bitpack.h does not export */
+extern uint64_t left_shiftu(uint64_t num, unsigned shift_num);
+extern int64_t left_shifts(int64_t num, unsigned shift_num);
+extern uint64_t right_shiftu(uint64_t num, unsigned shift_num);
+extern int64_t right_shifts(int64_t num, unsigned shift_num);
+
+typedef enum {
+    FITSU, FITSS, GETU, GETS, NEWU, NEWS, NFUNCTIONS
+} Function;
+
+static const char *functionNames[NFUNCTIONS] = {
+    "fitsu", "fitss", "getu", "gets", "newu", "news"
+};
+
+typedef enum { REFERENCE, FAST, NVARIANTS } Variant;
+
+static const char *variantNames[NVARIANTS] = { "bitpack", "fast" };
+
+static unsigned long mismatches = 0;
+static volatile uint64_t sink;
+
+static void checkShifts(void);
+static void checkWidth(unsigned width, unsigned lsb, uint64_t *seed);
+static void checkUnsigned(unsigned width, unsigned lsb, uint64_t word,
+                          uint64_t value);
+static void checkSigned(unsigned width, unsigned lsb, uint64_t word,
+                        int64_t value);
+static int newu(Variant v, uint64_t word, unsigned width, unsigned lsb,
+                uint64_t value, uint64_t *result);
+static int news(Variant v, uint64_t word, unsigned width, unsigned lsb,
+                int64_t value, uint64_t *result);
+static void expect(int same, const char *what, unsigned width, unsigned lsb,
+                   uint64_t word, uint64_t value, uint64_t ref,
+                   uint64_t fast);
+static double timeCalls(Function f, Variant v, unsigned width, unsigned lsb,
+                        long ops, const uint64_t *words,
+                        const uint64_t *values);
+static double now(void);
+static uint64_t xorshift(uint64_t *seed);
+static void usage(const char *progname);
+
+
+int main(int argc, char *argv[])
+{
+    long ops = 100000;
+    int check_only = 0, each_lsb = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            ops = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check_only = 1;
+        } else if (strcmp(argv[i], "--each-lsb") == 0) {
+            each_lsb = 1;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (ops < 1) {
+        usage(argv[0]);
+    }
+
+    uint64_t seed = 88172645463325252ull;
+    checkShifts();
+    for (unsigned width = 1; width <= 64; width++) {
+        for (unsigned lsb = 0; lsb + width <= 64; lsb++) {
+            checkWidth(width, lsb, &seed);
+        }
+    }
+    if (mismatches > 0) {
+        fprintf(stderr, "bitpack_bench: %lu mismatches\n", mismatches);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "bitpack_bench: all variants match bitpack.c\n");
+    if (check_only) {
+        return EXIT_SUCCESS;
+    }
+
+    static uint64_t words[NINPUTS], values[NINPUTS];
+    for (int i = 0; i < NINPUTS; i++) {
+        words[i] = xorshift(&seed);
+        values[i] = xorshift(&seed);
+    }
+    printf("function,variant,width,%sns_per_op\n", each_lsb ? "lsb," : "");
+    for (Function f = 0; f < NFUNCTIONS; f++) {
+        for (Variant v = 0; v < NVARIANTS; v++) {
+            /* gets and news need a sign bit and a bit for the value */
+            unsigned first = (f == GETS || f == NEWS) ? 2 : 1;
+            for (unsigned width = first; width <= 64; width++) {
+                double total = 0;
+                for (unsigned lsb = 0; lsb + width <= 64; lsb++) {
+                    double ns = timeCalls(f, v, width, lsb, ops, words,
+                                          values);
+                    total += ns;
+                    if (each_lsb) {
+                        printf("%s,%s,%u,%u,%.3f\n", functionNames[f],
+                               variantNames[v], width, lsb, ns);
+                    }
+                }
+                if (!each_lsb) {
+                    printf("%s,%s,%u,%.3f\n", functionNames[f],
+                           variantNames[v], width, total / (65 - width));
+                }
+            }
+            fflush(stdout);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/*  Name: checkShifts
+ *  Purpose: This function checks the shift helpers of bitpack.c at every
+ *           shift from 0 to 64: a shift of 64 gives 0, or ~0 for a right
+ *           shift of a negative signed number, rather than C's undefined
+ *           behavior.
+ */
+static void checkShifts(void)
+{
+    static const uint64_t nums[] = {
+        0, 1, 0x8000000000000000ull, 0x7fffffffffffffffull, ~0ull,
+        0x0123456789abcdefull, 0xfedcba9876543210ull
+    };
+    for (unsigned shift = 0; shift <= 64; shift++) {
+        for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+            uint64_t n = nums[i];
+            int64_t s = (int64_t)n;
+            uint64_t left = shift == 64 ? 0 : n << shift;
+            uint64_t right = shift == 64 ? 0 : n >> shift;
+            int64_t sright = shift == 64 ? (s < 0 ? -1 : 0) : s >> shift;
+            expect(left_shiftu(n, shift) == left, "left_shiftu", 0, shift,
+                   n, 0, left, left_shiftu(n, shift));
+            expect((uint64_t)left_shifts(s, shift) == left, "left_shifts",
+                   0, shift, n, 0, left, left_shifts(s, shift));
+            expect(right_shiftu(n, shift) == right, "right_shiftu", 0, shift,
+                   n, 0, right, right_shiftu(n, shift));
+            expect(right_shifts(s, shift) == sright, "right_shifts", 0,
+                   shift, n, 0, sright, right_shifts(s, shift));
+        }
+    }
+}
+
+/*  Name: checkWidth
+ *  Purpose: This function checks every function at one width/lsb pair:
+ *           every field value (and a few too large) for small widths,
+ *           edge values and TRIALS random ones for the rest, each packed
+ *           into a clear, a full and a random word.
+ */
+static void checkWidth(unsigned width, unsigned lsb, uint64_t *seed)
+{
+    uint64_t mask = Bitpack_fast_mask(width);
+    uint64_t bias = (uint64_t)1 << (width - 1);
+    uint64_t words[] = { 0, ~0ull, xorshift(seed) };
+
+    for (size_t w = 0; w < sizeof(words) / sizeof(words[0]); w++) {
+        uint64_t word = words[w];
+        if (width <= SMALL_WIDTH) {
+            for (uint64_t u = 0; u <= mask + 2; u++) {
+                checkUnsigned(width, lsb, word, u);
+            }
+            for (int64_t s = -(int64_t)bias - 2; s <= (int64_t)bias + 1;
+                 s++) {
+                checkSigned(width, lsb, word, s);
+            }
+        }
+        const uint64_t edges[] = {
+            0, 1, mask, mask + 1, mask - 1, bias, bias - 1, -bias,
+            -bias - 1, 0x8000000000000000ull, 0x7fffffffffffffffull, ~0ull
+        };
+        for (size_t e = 0; e < sizeof(edges) / sizeof(edges[0]); e++) {
+            checkUnsigned(width, lsb, word, edges[e]);
+            checkSigned(width, lsb, word, (int64_t)edges[e]);
+        }
+        if (width > SMALL_WIDTH) {
+            for (int t = 0; t < TRIALS; t++) {
+                uint64_t r = xorshift(seed);
+                /* half the values fit, the rest mostly do not */
+                uint64_t value = (t & 1) ? r : (r & mask);
+                checkUnsigned(width, lsb, word, value);
+                checkSigned(width, lsb, word,
+                            (t & 1) ? (int64_t)r
+                                    : Bitpack_fast_gets(r, width, 0));
+            }
+        }
+    }
+}
+
+/*  Name: checkUnsigned
+ *  Purpose: This function compares fitsu, newu, getu and (for widths above
+ *           1) gets of both variants for one unsigned value.
+ */
+static void checkUnsigned(unsigned width, unsigned lsb, uint64_t word,
+                          uint64_t value)
+{
+    int ref_fits = Bitpack_fitsu(value, width);
+    int fast_fits = Bitpack_fast_fitsu(value, width);
+    expect(ref_fits == fast_fits, "fitsu", width, lsb, word, value,
+           ref_fits, fast_fits);
+
+    uint64_t ref, fast;
+    int ref_raised = newu(REFERENCE, word, width, lsb, value, &ref);
+    int fast_raised = newu(FAST, word, width, lsb, value, &fast);
+    expect(ref_raised == fast_raised, "newu raise", width, lsb, word,
+           value, ref_raised, fast_raised);
+    if (ref_raised || fast_raised) {
+        return;
+    }
+    expect(ref == fast, "newu", width, lsb, word, value, ref, fast);
+
+    uint64_t ref_u = Bitpack_getu(ref, width, lsb);
+    uint64_t fast_u = Bitpack_fast_getu(ref, width, lsb);
+    expect(ref_u == fast_u, "getu", width, lsb, ref, value, ref_u, fast_u);
+    if (width > 1) {
+        int64_t ref_s = Bitpack_gets(ref, width, lsb);
+        int64_t fast_s = Bitpack_fast_gets(ref, width, lsb);
+        expect(ref_s == fast_s, "gets", width, lsb, ref, value, ref_s,
+               fast_s);
+    }
+}
+
+/*  Name: checkSigned
+ *  Purpose: This function compares fitss, news and gets of both variants
+ *           for one signed value.
+ */
+static void checkSigned(unsigned width, unsigned lsb, uint64_t word,
+                        int64_t value)
+{
+    int ref_fits = Bitpack_fitss(value, width);
+    int fast_fits = Bitpack_fast_fitss(value, width);
+    expect(ref_fits == fast_fits, "fitss", width, lsb, word, value,
+           ref_fits, fast_fits);
+
+    uint64_t ref, fast;
+    int ref_raised = news(REFERENCE, word, width, lsb, value, &ref);
+    int fast_raised = news(FAST, word, width, lsb, value, &fast);
+    expect(ref_raised == fast_raised, "news raise", width, lsb, word,
+           value, ref_raised, fast_raised);
+    if (ref_raised || fast_raised) {
+        return;
+    }
+    expect(ref == fast, "news", width, lsb, word, value, ref, fast);
+
+    int64_t ref_s = Bitpack_gets(ref, width, lsb);
+    int64_t fast_s = Bitpack_fast_gets(ref, width, lsb);
+    expect(ref_s == fast_s && ref_s == value, "gets", width, lsb, ref,
+           value, ref_s, fast_s);
+}
+
+/*  Name: newu / news
+ *  Purpose: These functions call one variant of Bitpack_newu/news,
+ *           catching Bitpack_Overflow.
+ *  Output: 1 if it was raised, else 0 with the new word in *result
+ */
+static int newu(Variant v, uint64_t word, unsigned width, unsigned lsb,
+                uint64_t value, uint64_t *result)
+{
+    volatile int raised = 0;
+    TRY
+        *result = v == REFERENCE ? Bitpack_newu(word, width, lsb, value)
+                                 : Bitpack_fast_newu(word, width, lsb, value);
+    EXCEPT(Bitpack_Overflow)
+        raised = 1;
+    END_TRY;
+    return raised;
+}
+
+static int news(Variant v, uint64_t word, unsigned width, unsigned lsb,
+                int64_t value, uint64_t *result)
+{
+    volatile int raised = 0;
+    TRY
+        *result = v == REFERENCE ? Bitpack_news(word, width, lsb, value)
+                                 : Bitpack_fast_news(word, width, lsb, value);
+    EXCEPT(Bitpack_Overflow)
+        raised = 1;
+    END_TRY;
+    return raised;
+}
+
+/*  Name: expect
+ *  Purpose: This function counts a mismatch when same is false, and
+ *           describes the first MAX_REPORTS of them on stderr.
+ */
+static void expect(int same, const char *what, unsigned width, unsigned lsb,
+                   uint64_t word, uint64_t value, uint64_t ref,
+                   uint64_t fast)
+{
+    if (same) {
+        return;
+    }
+    if (mismatches++ < MAX_REPORTS) {
+        fprintf(stderr, "%s: width %u lsb %u word 0x%016llx value "
+                "0x%016llx: bitpack.c 0x%016llx, fast 0x%016llx\n", what,
+                width, lsb, (unsigned long long)word,
+                (unsigned long long)value, (unsigned long long)ref,
+                (unsigned long long)fast);
+    }
+}
+
+/* a timing loop over ops calls of one function, cycling through the
+ * inputs; every result goes into acc so no call can be dropped */
+#define TIME_LOOP(call)                                                 \
+    for (long i = 0; i < ops; i++) {                                    \
+        uint64_t word = words[i % NINPUTS];                             \
+        uint64_t value = values[i % NINPUTS];                           \
+        (void)word;                                                     \
+        (void)value;                                                    \
+        acc += (uint64_t)(call);                                        \
+    }
+
+/*  Name: timeCalls
+ *  Purpose: This function times ops calls of one function of one variant
+ *           at one width/lsb pair. Values for newu and news are cut down
+ *           to the width first, outside the timed loop, so none raise.
+ *  Output: nanoseconds per call
+ */
+static double timeCalls(Function f, Variant v, unsigned width, unsigned lsb,
+                        long ops, const uint64_t *words,
+                        const uint64_t *raw)
+{
+    static uint64_t values[NINPUTS];
+    for (int i = 0; i < NINPUTS; i++) {
+        values[i] = f == NEWS ? (uint64_t)Bitpack_fast_gets(raw[i], width, 0)
+                              : raw[i] & Bitpack_fast_mask(width);
+    }
+    uint64_t acc = 0;
+    double start = now();
+    if (v == REFERENCE) {
+        switch (f) {
+        case FITSU: TIME_LOOP(Bitpack_fitsu(word, width)); break;
+        case FITSS: TIME_LOOP(Bitpack_fitss(word, width)); break;
+        case GETU: TIME_LOOP(Bitpack_getu(word, width, lsb)); break;
+        case GETS: TIME_LOOP(Bitpack_gets(word, width, lsb)); break;
+        case NEWU: TIME_LOOP(Bitpack_newu(word, width, lsb, value)); break;
+        case NEWS:
+            TIME_LOOP(Bitpack_news(word, width, lsb, (int64_t)value));
+            break;
+        default: assert(0);
+        }
+    } else {
+        switch (f) {
+        case FITSU: TIME_LOOP(Bitpack_fast_fitsu(word, width)); break;
+        case FITSS: TIME_LOOP(Bitpack_fast_fitss(word, width)); break;
+        case GETU: TIME_LOOP(Bitpack_fast_getu(word, width, lsb)); break;
+        case GETS: TIME_LOOP(Bitpack_fast_gets(word, width, lsb)); break;
+        case NEWU:
+            TIME_LOOP(Bitpack_fast_newu(word, width, lsb, value));
+            break;
+        case NEWS:
+            TIME_LOOP(Bitpack_fast_news(word, width, lsb, (int64_t)value));
+            break;
+        default: assert(0);
+        }
+    }
+    double elapsed = now() - start;
+    sink = acc;
+    return elapsed * 1e9 / ops;
+}
+
+/*  Name: now
+ *  Purpose: This function returns the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*  Name: xorshift
+ *  Purpose: This function returns the next number of a 64-bit xorshift
+ *           generator, so every run checks the same values.
+ */
+static uint64_t xorshift(uint64_t *seed)
+{
+    uint64_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *seed = x;
+}
+
+/*  Name: usage
+ *  Purpose: This function prints the usage and exits.
+ */
+static void usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-n ops] [--check] [--each-lsb]\n",
+            progname);
+    exit(EXIT_FAILURE);
+}
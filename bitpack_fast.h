@@ -0,0 +1,91 @@
+/*********************************************************************
+ *                     bitpack_fast.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the inline fast path for bitpack.h. Each function
+ *              has the same contract as its Bitpack_ counterpart -- the
+ *              same checked runtime errors, Bitpack_Overflow for values
+ *              that do not fit, and fitss() false for width 1 -- but
+ *              builds its mask with a single shift instead of the
+ *              shift helpers in bitpack.c. No shift here is ever by 64:
+ *              the only width-64 case is handled by masking with ~0.
+ *
+ *              bitpack_bench ("make bitpack_bench") checks every
+ *              function here against bitpack.c, exhaustively for small
+ *              widths, before any codec is switched over to it.
+ *********************************************************************/
+
+#ifndef BITPACK_FAST_INCLUDED
+#define BITPACK_FAST_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "assert.h"
+#include "except.h"
+#include "bitpack.h"
+
+/* the low width bits set, for 1 <= width <= 64 */
+static inline uint64_t Bitpack_fast_mask(unsigned width)
+{
+    return ~(uint64_t)0 >> (64 - width);
+}
+
+static inline bool Bitpack_fast_fitsu(uint64_t n, unsigned width)
+{
+    assert(width > 0 && width <= 64);
+    return (n & ~Bitpack_fast_mask(width)) == 0;
+}
+
+/* n fits iff n + 2^(width - 1) lands in [0, 2^width) as an unsigned sum */
+static inline bool Bitpack_fast_fitss(int64_t n, unsigned width)
+{
+    assert(width > 0 && width <= 64);
+    if (width == 1) {
+        return false;
+    }
+    uint64_t bias = (uint64_t)1 << (width - 1);
+    return (((uint64_t)n + bias) & ~Bitpack_fast_mask(width)) == 0;
+}
+
+static inline uint64_t Bitpack_fast_getu(uint64_t word, unsigned width,
+                                         unsigned lsb)
+{
+    assert(width > 0 && width <= 64);
+    assert(lsb + width <= 64);
+    return (word >> lsb) & Bitpack_fast_mask(width);
+}
+
+/* moves the field to the top of the word, then shifts it back down
+ * arithmetically so the sign bit is copied */
+static inline int64_t Bitpack_fast_gets(uint64_t word, unsigned width,
+                                        unsigned lsb)
+{
+    assert(width > 1 && width <= 64);
+    assert(lsb + width <= 64);
+    return (int64_t)(word << (64 - width - lsb)) >> (64 - width);
+}
+
+static inline uint64_t Bitpack_fast_newu(uint64_t word, unsigned width,
+                                         unsigned lsb, uint64_t value)
+{
+    if (!Bitpack_fast_fitsu(value, width)) {
+        RAISE(Bitpack_Overflow);
+    }
+    assert(lsb + width <= 64);
+    uint64_t field = Bitpack_fast_mask(width) << lsb;
+    return (word & ~field) | (value << lsb);
+}
+
+static inline uint64_t Bitpack_fast_news(uint64_t word, unsigned width,
+                                         unsigned lsb, int64_t value)
+{
+    if (!Bitpack_fast_fitss(value, width)) {
+        RAISE(Bitpack_Overflow);
+    }
+    assert(lsb + width <= 64);
+    uint64_t mask = Bitpack_fast_mask(width);
+    return (word & ~(mask << lsb)) | (((uint64_t)value & mask) << lsb);
+}
+
+#endif
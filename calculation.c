@@ -16,26 +16,6 @@
 
 #include "calculation.h"
 
-/* 
- * the component video struct contains 3 variables: y, pb, pr, calculated 
- * from RGB values and can transform into DCT
- */
-struct cv {
-    float y;
-    float pb;
-    float pr;
-};
-
-/* the DCT struct contains 6 variables: y, pb, pr, calculated from cv struct */
-struct DCT {
-    int a;
-    int b;
-    int c;
-    int d;
-    unsigned avepbQUANT;
-    unsigned aveprQUANT;
-};
-
 const int DCT_A = 1;
 const int DCT_BCD = 2;
 
@@ -131,6 +111,23 @@ void calculate_CVtoDCT(cv *elem1, cv *elem2, cv *elem3, cv *elem4, DCT *dest){
     dest->aveprQUANT = Arith40_index_of_chroma(avepr);
 }
 
+/* Function: calculate_flatDCT()
+ * Job: Given the cv struct of a 2x2 block whose 4 pixels are equal, store
+ * its DCT in the given DCT struct. b, c and d of such a block are 0; a
+ * and the chroma averages are the one cv's own values
+ * Designed as a shortcut of calculate_CVtoDCT() for flat blocks
+ * Expected input: 1 cv struct and 1 DCT struct
+ * Expected output: NONE
+ */
+void calculate_flatDCT(cv *elem, DCT *dest){
+    dest->a = scaleDCT(elem->y, DCT_A);
+    dest->b = 0;
+    dest->c = 0;
+    dest->d = 0;
+    dest->avepbQUANT = Arith40_index_of_chroma(elem->pb);
+    dest->aveprQUANT = Arith40_index_of_chroma(elem->pr);
+}
+
 /* Function: scaleDCT() 
  * Job: Given 1 number from a,b,c,d and its type (DCT_A or DCT_BCD), return
  *      its scaled value.
@@ -14,6 +14,9 @@
  *********************************************************************/
 
 
+#ifndef CALCULATION_INCLUDED
+#define CALCULATION_INCLUDED
+
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -29,8 +32,28 @@
 #include <math.h>
 
 
-typedef struct cv cv;
-typedef struct DCT DCT;
+/* 
+ * the component video struct contains 3 variables: y, pb, pr, calculated 
+ * from RGB values and can transform into DCT
+ */
+typedef struct cv {
+    float y;
+    float pb;
+    float pr;
+} cv;
+
+/* 
+ * the DCT struct contains 6 variables: a, b ,c ,d, avepbQUANT, aveprQUANT,
+ * calculated from cv struct 
+ */
+typedef struct DCT {
+    int a;
+    int b;
+    int c;
+    int d;
+    unsigned avepbQUANT;
+    unsigned aveprQUANT;
+} DCT;
 
 
 /* Function: calculateRGB() 
@@ -71,7 +94,20 @@ extern cv calculateCV(int red, int green, int blue, int denom);
  */
 extern void calculate_CVtoDCT(cv *elem1, cv *elem2, cv *elem3, cv *elem4, 
                               DCT *dest);
+
+/* Function: calculate_flatDCT()
+ * Job: Given the cv struct of a 2x2 block whose 4 pixels are equal, store
+ * its DCT in the given DCT struct: a and the chroma indices come from the
+ * one cv with the quantizers of calculate_CVtoDCT(), and b, c, d are 0
+ * Expected input: 1 cv struct and 1 DCT struct
+ * Expected output: NONE
+ */
+extern void calculate_flatDCT(cv *elem, DCT *dest);
                                                         
+/* the DCT_type arguments of scaleDCT() and unscaleDCT() */
+extern const int DCT_A;
+extern const int DCT_BCD;
+
 /* Function: scaleDCT() 
  * Job: Given 1 number from a,b,c,d and its type (DCT_A or DCT_BCD), return
  *      its scaled value.
@@ -114,6 +150,4 @@ extern float unscaleDCT(int num, int DCT_type);
  */
 extern void setCV(cv *elem, float y, float pb, float pr);
 
-
-
-
+#endif
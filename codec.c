@@ -0,0 +1,779 @@
+/*********************************************************************
+ *                     codec.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Date:     March 21, 2020
+ *     Purpose: This is the implementation for the stages of ppm image
+ *              compression & decompression.
+ *              Specifically, it contains functions for RGB <-> CV and 
+ *              CV <-> DCT transformations, as well as for packing and
+ *              unpacking codewords to and from memory.
+ *              The block encoders (RGB_toDCT, encodeBlockRow) go through
+ *              a block memo; its key packs the twelve samples of a block
+ *              into three words, which are hashed by multiplying each by
+ *              an odd constant and keeping the top bits of their sum.
+ *********************************************************************/
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "assert.h"
+#include "codec.h"
+#include "codeword.h"
+#include "pnm.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "uarray2.h"
+#include "arith40.h"
+#include <math.h>
+#include "calculation.h"
+#include "bitpack.h"
+#include "stats.h"
+
+#define A2 A2Methods_UArray2
+
+/* the Info struct contains A2Methods and A2 for passing into *cl */
+typedef struct Info {
+    A2Methods_T methods;
+    A2 array;
+} Info;
+
+/* the Cursor struct locates the codewords of arrayDCT in memory */
+typedef struct Cursor {
+    A2Methods_T methods;
+    uint8_t *codewords;
+} Cursor;
+
+/* the Blocks struct holds the pixels RGB_toDCT reads and its memo */
+typedef struct Blocks {
+    A2Methods_T methods;
+    A2 pixels;
+    unsigned denominator;
+    Block_memo *memo;
+} Blocks;
+
+
+void movePixel(A2Methods_T methods, A2 origArray, A2 finalArray, 
+                        int col, int row, int newCol, int newRow);
+void storeCV(int col, int row, A2 origArray, void *elem, void *cl);
+void storeRGB(int col, int row, A2 CV_pixels, void *elem, void *cl);
+void store_CVtoDCT(int col, int row, A2 arrayDCT, void *elem, void *cl);
+void store_RGBtoDCT(int col, int row, A2 arrayDCT, void *elem, void *cl);
+void printPackedDCT(int col, int row, A2 arrayDCT, void *elem, void *cl);
+void readPackedDCT(int col, int row, A2 arrayDCT, void *elem, void *cl);
+void store_DCTtoCV(int col, int row, A2 arrayDCT, void *elem, void *cl);
+static void blockDCT(Block_memo *memo, const struct Pnm_rgb *p1,
+                     const struct Pnm_rgb *p2, const struct Pnm_rgb *p3,
+                     const struct Pnm_rgb *p4, unsigned denominator,
+                     DCT *dest);
+static void transformBlock(const struct Pnm_rgb *p1, const struct Pnm_rgb *p2,
+                           const struct Pnm_rgb *p3, const struct Pnm_rgb *p4,
+                           unsigned denominator, Block_memo *memo,
+                           DCT *dest);
+static int samePixel(const struct Pnm_rgb *p, const struct Pnm_rgb *q);
+
+
+/*  Name: trimDimension
+ *  Purpose: This function trims the dimension of the imput Pnm_ppm to have an
+ *           even width and height.
+ *  Input: An already initialized Pnm_ppm, a pointer to function struct of
+ *         chosen method
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: CRE if either the width or height is less than 2, and 
+ *                   when passed argument is NULL.
+ */
+void trimDimension(Pnm_ppm origImage, A2Methods_T methods)
+{
+    assert(origImage != NULL && methods != NULL);
+    int width = origImage -> width;
+    int height = origImage -> height;
+    assert(width > 1 && height > 1);
+    if (width % 2 == 0 && height % 2 == 0) {
+        return;
+    }
+    
+    /* update dimension */
+    if (width % 2 != 0) {
+        origImage -> width = width - 1;
+    }
+    if (height % 2 != 0) {
+        origImage -> height = height - 1;
+    }
+    A2 origArray = origImage -> pixels;
+    A2 finalArray = methods -> new(origImage -> width, origImage -> height, 
+                                                  methods -> size(origArray));
+    assert(finalArray != NULL);
+    
+    /* copy pixels to the new trimmed array */
+    for (unsigned row = 0; row < origImage -> height; row++) {
+        for (unsigned col = 0; col < origImage -> width; col++) {
+            movePixel(methods, origArray, finalArray, col, row, col, row);
+        }
+    }
+    origImage -> pixels = finalArray;
+    methods -> free(&origArray);
+    
+}
+
+/*  Name: movePixel
+ *  Purpose: This function moves the pixel at given index from the first array
+ *           to pixel at given index of the second array. 
+ *  Input: two integers for column and row of origArray, two integers for
+ *         column and row of the finalArray. Two pointers to A2array that
+ *         stores the pixels' data. A pointer to function struct of
+ *         chosen method. 
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: EXIT_FAILURE if passed in parameter is NULL. 
+ */
+void movePixel(A2Methods_T methods, A2 origArray, A2 finalArray, 
+                        int col, int row, int newCol, int newRow)
+{
+    if (methods == NULL || origArray == NULL || finalArray == NULL) {
+        exit(EXIT_FAILURE);
+    }
+
+    /* copy RGB values from one pixel to another pixel */
+    Pnm_rgb origPixel = methods -> at(origArray, col, row);
+    Pnm_rgb finalPixel = methods -> at(finalArray, newCol, newRow);
+    finalPixel -> red   = origPixel -> red;
+    finalPixel -> green = origPixel -> green;
+    finalPixel -> blue  = origPixel -> blue;    
+}
+
+/*  Name: RGB_toCV
+ *  Purpose: This function fills the given A2 array with the Component Video
+ *           representation of the passed in Pnm_ppm pixels. 
+ *  Input: An already initialized Pnm_ppm, an A2 array of cv with the same
+ *         dimensions (allocated by the caller, so that it may come from an
+ *         arena), a pointer to function struct of chosen method
+ *  Input expectation: The parameters should not be NULL.
+ *  Output: N/A. arrayYPP holds the CV representation of RGB values in
+ *          Pnm_ppm.
+ *  Output expectation: N/A
+ *  Error condition: CRE if any of the parameter is NULL, or the dimensions
+ *                   do not match.
+ */
+void RGB_toCV(Pnm_ppm origImage, A2 arrayYPP, A2Methods_T methods)
+{
+    assert(origImage != NULL && arrayYPP != NULL && methods != NULL);
+    assert(methods -> width(arrayYPP) == (int)origImage -> width &&
+           methods -> height(arrayYPP) == (int)origImage -> height);
+
+    methods -> map_default(arrayYPP, storeCV, origImage);
+}
+
+
+/*  Name: storeCV
+ *  Purpose: This function is the apply function for method's map function. 
+ *           Specifically, it is applied in RGB_toCV.
+ *           It simply read one element from the pixels in the passed in Pnm,
+ *           and convert its RGB values to CV values and stores it in the
+ *           corresponding index in the destination Array. 
+ *  Input: two integers for column and row, a pointer to A2array that stores
+ *         CV data, an void pointer that represent a CV struct in the 
+ *         destination array, and the closure pointer to original image.
+ *         Pnm_ppm struct.
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: N/A
+ */
+void storeCV(int col, int row, A2 dest_Array, void *elem, void *cl)
+{
+    assert(dest_Array != NULL && cl != NULL);
+
+    Pnm_ppm origImage = cl;
+    assert(origImage -> methods != NULL);
+    
+    Pnm_rgb source_elem = origImage -> methods-> at(origImage->pixels, 
+                                                    col, row);
+    cv *result = origImage -> methods->at(dest_Array, col, row);
+    cv component = calculateCV(source_elem -> red,
+                               source_elem -> green,
+                               source_elem -> blue,
+                               origImage   -> denominator);
+
+    *result = component;
+    (void) elem;
+}
+
+
+/*  Name: CV_toRGB
+ *  Purpose: This function stores into the pixels of the passed in Pnm_ppm
+ *           the RGB calculated from the corresponding index in the
+ *           cv array.
+ *  Input: An already initialized Pnm_ppm whose pixels are allocated (by the
+ *         caller) but uninitialized, a pointer to function struct of chosen
+ *         method, and an A2array with CV pixels. 
+ *  Input expectation: The parameters should not be NULL.
+ *  Output: N/A. The pixels of the Pnm_ppm are filled in.
+ *  Output expectation: N/A
+ *  Error condition: CRE if any of the parameter is NULL.
+ */
+void CV_toRGB(Pnm_ppm finalImage, A2 CV_pixels, A2Methods_T methods)
+{
+    assert(finalImage != NULL && CV_pixels != NULL && methods != NULL);
+    assert(finalImage -> pixels != NULL);
+
+    methods -> map_default(CV_pixels, storeRGB, finalImage);
+}
+
+/*  Name: storeRGB
+ *  Purpose: This function is the apply function for method's map function. 
+ *           Specifically, it is applied in CV_toRGB.
+ *           It simply read one element from the pixels in the passed in Pnm,
+ *           and convert its CV values to RGB values and stores it in the
+ *           corresponding index in the pixels of Pnm_ppm. 
+ *  Input: two integers for column and row, a pointer to A2array that stores
+ *         CV data, an void pointer that represent a CV struct in the 
+ *         destination array, and the closure pointer to final image.
+ *         Pnm_ppm struct.
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: N/A
+ */
+void storeRGB(int col, int row, A2 CV_pixels, void *elem, void *cl)
+{
+    assert(cl != NULL && elem != NULL);
+    Pnm_ppm finalImage = cl;
+    cv *cv_elem = elem;
+    assert(finalImage -> methods != NULL);
+    
+    Pnm_rgb final_pixel = finalImage -> methods -> at(finalImage -> pixels, 
+                                                      col, row);
+    /* convert CV to RGB and save into the final_pixel */
+    calculateRGB(*cv_elem, final_pixel, finalImage -> denominator);
+    (void) CV_pixels;
+}
+
+
+/*  Name: CVtoDCT
+ *  Purpose: This function stores in an A2 array the DCT calculated from the
+ *           corresponding indexes in the cv array.
+ *  Input: An already initialized arrayYPP with cv values; an arrayDCT with
+ *         1/4 the size of arrayYPP (allocated by the caller); a pointer to
+ *         function struct of chosen method. 
+ *  Input expectation: The parameters should not be NULL.
+ *  Output: N/A. Each 2*2 block of arrayYPP is converted to 1 element of
+ *          arrayDCT.
+ *  Output expectation: N/A
+ *  Error condition: CRE if any of the parameter is NULL, or the dimensions
+ *                   do not match.
+ */
+void CVtoDCT(A2 arrayYPP, A2 arrayDCT, A2Methods_T methods)
+{
+    assert(arrayYPP != NULL && arrayDCT != NULL && methods != NULL);
+    assert(methods -> width(arrayDCT) == methods -> width(arrayYPP) / 2 &&
+           methods -> height(arrayDCT) == methods -> height(arrayYPP) / 2);
+
+    Info arr_method = {methods, arrayYPP};
+    methods -> map_default(arrayDCT, store_CVtoDCT, &arr_method);
+}
+
+
+/*  Name: store_CVtoDCT
+ *  Purpose: This function is the apply function for method's map function. 
+ *           Specifically, it is applied in CVtoDCT.
+ *           It reads four element from the A2array of CV, then calculate the
+ *           corresponding DCT values and stores it in the array of DCT. 
+ *           Each 2*2 block is converted to one element of DCT.
+ *  Input: two integers for column and row, a pointer to A2array that stores
+ *         DCT data, an void pointer that represent an element in arrayDCT.
+ *         Closure pointer include struct of Info, which contains the CV array
+ *         and the method suite.
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: N/A
+ */
+void store_CVtoDCT(int col, int row, A2 arrayDCT, void *elem, void *cl)
+{
+    assert(cl != NULL);
+    Info *arr_method = cl;
+    A2 arrayYPP = arr_method -> array;
+    assert(arrayYPP && arr_method -> methods);
+    
+    cv *elem1 = arr_method -> methods -> at(arrayYPP, col*2,   row*2   );
+    cv *elem2 = arr_method -> methods -> at(arrayYPP, col*2+1, row*2   );
+    cv *elem3 = arr_method -> methods -> at(arrayYPP, col*2,   row*2+1 );
+    cv *elem4 = arr_method -> methods -> at(arrayYPP, col*2+1, row*2+1 );
+    
+    DCT *result = elem;
+    calculate_CVtoDCT(elem1, elem2, elem3, elem4, result);
+    (void) arrayDCT;
+    (void) elem;    
+}
+
+
+/*  Name: RGB_toDCT
+ *  Purpose: This function stores in an A2 array the DCT of each 2*2 block
+ *           of the pixels, going straight from RGB to DCT one block at a
+ *           time so that a block found in the memo is not transformed.
+ *  Input: An already initialized and trimmed Pnm_ppm; an arrayDCT with 1/4
+ *         its size (allocated by the caller); a pointer to function struct
+ *         of chosen method; the memo (NULL for none).
+ *  Input expectation: The parameters other than memo should not be NULL.
+ *  Output: N/A. arrayDCT holds what RGB_toCV followed by CVtoDCT would
+ *          store in it.
+ *  Output expectation: N/A
+ *  Error condition: CRE if a required parameter is NULL, or the dimensions
+ *                   do not match.
+ */
+void RGB_toDCT(Pnm_ppm origImage, A2 arrayDCT, A2Methods_T methods,
+               Block_memo *memo)
+{
+    assert(origImage != NULL && arrayDCT != NULL && methods != NULL);
+    assert(methods -> width(arrayDCT) == (int)origImage -> width / 2 &&
+           methods -> height(arrayDCT) == (int)origImage -> height / 2);
+
+    Blocks blocks = { methods, origImage -> pixels,
+                      origImage -> denominator, memo };
+    methods -> map_default(arrayDCT, store_RGBtoDCT, &blocks);
+}
+
+
+/*  Name: store_RGBtoDCT
+ *  Purpose: This function is the apply function for method's map function.
+ *           Specifically, it is applied in RGB_toDCT.
+ *           It reads the four pixels of one block and stores their DCT,
+ *           taken from the memo when the block is there.
+ *  Input: two integers for column and row, a pointer to A2array that stores
+ *         DCT data, an void pointer that represent an element in arrayDCT.
+ *         Closure pointer include struct of Blocks.
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: N/A
+ */
+void store_RGBtoDCT(int col, int row, A2 arrayDCT, void *elem, void *cl)
+{
+    assert(cl != NULL && elem != NULL);
+    Blocks *blocks = cl;
+    A2Methods_T methods = blocks -> methods;
+
+    const struct Pnm_rgb *p1 = methods -> at(blocks -> pixels, col*2,
+                                             row*2);
+    const struct Pnm_rgb *p2 = methods -> at(blocks -> pixels, col*2+1,
+                                             row*2);
+    const struct Pnm_rgb *p3 = methods -> at(blocks -> pixels, col*2,
+                                             row*2+1);
+    const struct Pnm_rgb *p4 = methods -> at(blocks -> pixels, col*2+1,
+                                             row*2+1);
+    blockDCT(blocks -> memo, p1, p2, p3, p4, blocks -> denominator, elem);
+    (void) arrayDCT;
+}
+
+
+/*  Name: readHeader
+ *  Purpose: This function reads and checks the given header of the Compressed
+ *           image and initialize the Pnm_ppm values according to the given 
+ *           dimensions.
+ *  Input: The buffer holding the compressed image and its length, a pointer
+ *         to store the length of the header, one to store its
+ *         Codeword_layout (NULL to accept format 2 only), the pointer to the
+ *         method suite and the Pnm_ppm to initialize (its pixels are left
+ *         NULL).
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: ARITH_OK, or the status from Codeword_header_parse.
+ *  Output expectation: N/A
+ *  Error condition: N/A
+ */
+Arith_status readHeader(const uint8_t *src, size_t n, size_t *len,
+                        int *layout, A2Methods_T methods, Pnm_ppm d_image)
+{
+    assert(src != NULL && len != NULL && methods != NULL && d_image != NULL);
+    /* read in header info of the compressed file */
+    unsigned height, width;
+    Arith_status status = Codeword_header_parse(src, n, &width, &height,
+                                                layout, len);
+    if (status != ARITH_OK) {
+        return status;
+    }
+
+    /* store header info into our ppm output file */
+    d_image -> denominator = 255;
+    d_image -> width = width;
+    d_image -> height = height;
+    d_image -> pixels = NULL;
+    d_image -> methods = methods;
+    return ARITH_OK;
+}
+
+/*  Name: DCTtoCV
+ *  Purpose: This function stores CV values in an initialize A2 array that was
+ *           calculated from the corresponding indexes in the DCT array.
+ *  Input: An already initialized array with values; a pointer to function
+ *         struct of chosen method. An arrayYPP_back with empty values.
+ *  Input expectation: The parameters should not be NULL.
+ *  Output: N/A. Stores value into A2array of YPP values with 4 times the size 
+ *          of original arrayYPP.
+ *  Output expectation: N/A
+ *  Error condition: CRE if any of the parameter is NULL.
+ */
+void DCTtoCV(A2 arrayDCT, A2 arrayYPP_back, A2Methods_T methods)
+{
+    assert(arrayDCT != NULL && arrayYPP_back != NULL && methods != NULL);
+                            
+    Info arr_method = {methods, arrayYPP_back};
+    methods -> map_default(arrayDCT, store_DCTtoCV, &arr_method);
+}
+
+/*  Name: store_DCTtoCV
+ *  Purpose: This function is the apply function for method's map function. 
+ *           Specifically, it is applied in DCTtoCV.
+ *           It reads a element from the A2array of DCT, then calculate the
+ *           corresponding CV values and stores it in the array of CV. 
+ *           Each one element of block is converted to 2*2 blocks of CV.
+ *  Input: two integers for column and row, a pointer to A2array that stores
+ *         DCT data, an void pointer that represent an element in arrayDCT.
+ *         Closure pointer include struct of Info, which contains the CV array
+ *         to be populated and the method suite.
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: N/A
+ */
+void store_DCTtoCV(int col, int row, A2 arrayDCT, void *elem, void *cl)
+{
+    assert(elem != NULL && cl != NULL);
+    Info *arr_method = cl;
+    A2 arrayYPP_back = arr_method -> array;
+    assert(arrayYPP_back);
+    DCT *origin_elem = elem;
+    /* get the elements from the corresponding blocks */
+    cv *elem1 = arr_method -> methods -> at(arrayYPP_back, col*2,   row*2   );
+    cv *elem2 = arr_method -> methods -> at(arrayYPP_back, col*2+1, row*2   );
+    cv *elem3 = arr_method -> methods -> at(arrayYPP_back, col*2,   row*2+1 );
+    cv *elem4 = arr_method -> methods -> at(arrayYPP_back, col*2+1, row*2+1 );
+    assert(elem1 && elem2 && elem3 && elem4);
+    
+    calculate_DCTtoCV(origin_elem, elem1, elem2, elem3, elem4);
+    (void)arrayDCT;
+}
+
+/*  Name: packDCT
+ *  Purpose: This function writes the header and the bitpacked version of the
+ *           input A2Array DCT into memory.
+ *  Input: An already initialized array with DCT values; a pointer to function
+ *         struct of chosen method; the destination buffer.
+ *  Input expectation: The parameters should not be NULL, and dest must hold
+ *         CODEWORD_HEADER_MAX + Codeword_image_size(width, height) bytes.
+ *  Output: the number of bytes written to dest.
+ *  Output expectation: N/A
+ *  Error condition: CRE if any of the parameter is NULL.
+ */
+size_t packDCT(A2 arrayDCT, A2Methods_T methods, uint8_t *dest)
+{
+    assert(arrayDCT != NULL && methods != NULL && dest != NULL);
+    unsigned width = methods -> width(arrayDCT) * 2;
+    unsigned height = methods -> height(arrayDCT) * 2;
+    size_t len = Codeword_header_write(dest, width, height,
+                                     CODEWORD_PLAIN);
+
+    Cursor cursor = {methods, dest + len};
+    methods -> map_default(arrayDCT, printPackedDCT, &cursor);
+    return len + Codeword_image_size(width, height);
+}
+
+/*  Name: printPackedDCT
+ *  Purpose: This function is the apply function for method's map function. 
+ *           Specifically, it is applied in packDCT.
+ *           It reads a element from the A2array of DCT, then pack the elements
+ *           and store the packed bytes at the element's place in memory, so
+ *           the output is row-major whatever order map_default visits in.
+ *  Input: two integers for column and row, a pointer to A2array that stores
+ *         DCT data, an void pointer that represent an element in arrayDCT.
+ *         Closure pointer to the Cursor locating the codewords.
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: N/A
+ */
+void printPackedDCT(int col, int row, A2 arrayDCT, void *elem, void *cl)
+{
+    assert(elem != NULL && cl != NULL);
+    Cursor *cursor = cl;
+    size_t index = (size_t)row * cursor -> methods -> width(arrayDCT) + col;
+
+    Codeword_put(cursor -> codewords + index * CODEWORD_BYTES,
+                 Codeword_pack(elem));
+}
+
+/*  Name: unpackDCT
+ *  Purpose: This function reads the codewords in memory and stores the
+ *           decompressed DCT into the A2 arrayDCT.
+ *  Input: An A2 DCT with empty values; a pointer to the first codeword; a
+ *         pointer to function struct of chosen method.
+ *  Input expectation: The parameters should not be NULL, and src must hold
+ *         one codeword for every element of arrayDCT.
+ *  Output: N/A.
+ *  Output expectation: N/A
+ *  Error condition: CRE if any of the parameter is NULL.
+ */
+void unpackDCT(A2 arrayDCT, const uint8_t *src, A2Methods_T methods)
+{
+
+    assert(arrayDCT != NULL && src != NULL && methods != NULL);
+    Cursor cursor = {methods, (uint8_t *)src};
+    methods -> map_default(arrayDCT, readPackedDCT, &cursor);
+}
+
+
+/*  Name: readPackedDCT
+ *  Purpose: This function is the apply function for method's map function. 
+ *           Specifically, it is applied in unpackDCT.
+ *           It reads the element's codeword from memory, and then get out the
+ *           elements and stores the values insiade the A2 arrayDCT.
+ *  Input: two integers for column and row, a pointer to A2array that stores
+ *         DCT data, an void pointer that represent an element in arrayDCT.
+ *         Closure pointer to the Cursor locating the codewords.
+ *  Input expectation: the parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: CRE when argument is NULL. 
+ */
+void readPackedDCT(int col, int row, A2 arrayDCT, void *elem, void *cl)
+{
+    assert(arrayDCT != NULL && elem != NULL && cl != NULL);
+    Cursor *cursor = cl;
+    size_t index = (size_t)row * cursor -> methods -> width(arrayDCT) + col;
+
+    Codeword_unpack(Codeword_get(cursor -> codewords + index * CODEWORD_BYTES),
+                    elem);
+}
+
+/*  Name: initBlockMemo
+ *  Purpose: This function empties a block memo by filling every slot with
+ *           the black block, whose key is all zeros.
+ *  Input: the memo and the denominator of the blocks it will see
+ *  Output: N/A
+ *  Error condition: CRE if memo is NULL.
+ */
+void initBlockMemo(Block_memo *memo, unsigned denominator)
+{
+    assert(memo != NULL);
+    struct Pnm_rgb black = { 0, 0, 0 };
+    DCT element;
+    transformBlock(&black, &black, &black, &black, denominator, NULL,
+                   &element);
+    memo -> denominator = denominator;
+    memo -> hits = memo -> flat = memo -> computed = 0;
+    for (unsigned k = 0; k < BLOCK_MEMO_SLOTS; k++) {
+        memo -> slot[k].key[0] = 0;
+        memo -> slot[k].key[1] = 0;
+        memo -> slot[k].key[2] = 0;
+        memo -> slot[k].element = element;
+    }
+}
+
+/*  Name: reportBlockMemo
+ *  Purpose: This function hands the counts of a block memo to the
+ *           instrumentation.
+ *  Input: the memo
+ *  Output: N/A
+ *  Error condition: CRE if memo is NULL.
+ */
+void reportBlockMemo(Block_memo *memo)
+{
+    assert(memo != NULL);
+    Stats_blocks(memo -> hits, memo -> flat, memo -> computed);
+    memo -> hits = memo -> flat = memo -> computed = 0;
+}
+
+/*  Name: encodeBlockRow
+ *  Purpose: This function encodes two scanlines of RGB pixels straight into
+ *           one row of codewords, without going through A2 arrays. It is
+ *           the per-row equivalent of RGB_toCV -> CVtoDCT -> packDCT (minus
+ *           the header) for callers that see the pixels a row at a time.
+ *  Input: the two source scanlines of 2 * blocks pixels each, the number of
+ *         blocks, the denominator of the pixels and the destination, which
+ *         must hold blocks codewords.
+ *  Input expectation: The parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: CRE if any of the parameter is NULL.
+ */
+void encodeBlockRow(const struct Pnm_rgb *top, const struct Pnm_rgb *bottom,
+                    unsigned blocks, unsigned denominator, Block_memo *memo,
+                    uint8_t *dest)
+{
+    assert(top != NULL && bottom != NULL && dest != NULL);
+    for (unsigned col = 0; col < blocks; col++) {
+        const struct Pnm_rgb *p1 = &top[col*2],    *p2 = &top[col*2+1];
+        const struct Pnm_rgb *p3 = &bottom[col*2], *p4 = &bottom[col*2+1];
+        DCT element;
+        blockDCT(memo, p1, p2, p3, p4, denominator, &element);
+        Codeword_put(dest + col * CODEWORD_BYTES, Codeword_pack(&element));
+    }
+}
+
+/*  Name: blockDCT
+ *  Purpose: This function finds the DCT of one block in the memo, or
+ *           transforms the block and remembers it. Blocks with a sample
+ *           above 255 have no key and are always transformed.
+ *  Input: the memo (NULL for none), the four pixels in the order of
+ *         calculate_CVtoDCT, their denominator and the destination
+ *  Output: N/A
+ */
+static void blockDCT(Block_memo *memo, const struct Pnm_rgb *p1,
+                     const struct Pnm_rgb *p2, const struct Pnm_rgb *p3,
+                     const struct Pnm_rgb *p4, unsigned denominator,
+                     DCT *dest)
+{
+    if (memo == NULL || denominator > 255) {
+        transformBlock(p1, p2, p3, p4, denominator, memo, dest);
+        return;
+    }
+    if (memo -> denominator != denominator) {
+        reportBlockMemo(memo);
+        initBlockMemo(memo, denominator);
+    }
+    uint32_t key[3] = {
+        p1 -> red | p1 -> green << 8 | p1 -> blue << 16 | p2 -> red << 24,
+        p2 -> green | p2 -> blue << 8 | p3 -> red << 16 | p3 -> green << 24,
+        p3 -> blue | p4 -> red << 8 | p4 -> green << 16 | p4 -> blue << 24
+    };
+    uint32_t hash = key[0] * 0x9e3779b1u + key[1] * 0x85ebca77u +
+                    key[2] * 0xc2b2ae3du;
+    struct Block_memo_slot *slot =
+        &memo -> slot[hash >> (32 - BLOCK_MEMO_BITS)];
+    if (slot -> key[0] == key[0] && slot -> key[1] == key[1] &&
+        slot -> key[2] == key[2]) {
+        memo -> hits++;
+        *dest = slot -> element;
+        return;
+    }
+    slot -> key[0] = key[0];
+    slot -> key[1] = key[1];
+    slot -> key[2] = key[2];
+    transformBlock(p1, p2, p3, p4, denominator, memo, dest);
+    slot -> element = *dest;
+}
+
+/*  Name: transformBlock
+ *  Purpose: This function transforms one block into its DCT. When the
+ *           four pixels are equal only one is converted to CV and
+ *           calculate_flatDCT quantizes it, with b, c and d 0; bench
+ *           checks that this gives the DCT of the general case for every
+ *           flat block of 8-bit colour.
+ *  Input: the four pixels, their denominator, the memo to count the block
+ *         in (NULL for none) and the destination
+ *  Output: N/A
+ */
+static void transformBlock(const struct Pnm_rgb *p1, const struct Pnm_rgb *p2,
+                           const struct Pnm_rgb *p3, const struct Pnm_rgb *p4,
+                           unsigned denominator, Block_memo *memo,
+                           DCT *dest)
+{
+    cv elem1 = calculateCV(p1 -> red, p1 -> green, p1 -> blue,
+                           denominator);
+    if (samePixel(p1, p2) && samePixel(p1, p3) && samePixel(p1, p4)) {
+        calculate_flatDCT(&elem1, dest);
+        if (memo != NULL) {
+            memo -> flat++;
+        }
+        return;
+    }
+    cv elem2 = calculateCV(p2 -> red, p2 -> green, p2 -> blue,
+                           denominator);
+    cv elem3 = calculateCV(p3 -> red, p3 -> green, p3 -> blue,
+                           denominator);
+    cv elem4 = calculateCV(p4 -> red, p4 -> green, p4 -> blue,
+                           denominator);
+    calculate_CVtoDCT(&elem1, &elem2, &elem3, &elem4, dest);
+    if (memo != NULL) {
+        memo -> computed++;
+    }
+}
+
+/*  Name: samePixel
+ *  Purpose: This function compares two pixels.
+ *  Output: 1 if they are equal, 0 if not
+ */
+static int samePixel(const struct Pnm_rgb *p, const struct Pnm_rgb *q)
+{
+    return p -> red == q -> red && p -> green == q -> green &&
+           p -> blue == q -> blue;
+}
+
+/*  Name: decodeBlockRow
+ *  Purpose: This function decodes one row of codewords straight into two
+ *           scanlines of RGB pixels, without going through A2 arrays. It is
+ *           the per-row equivalent of unpackDCT -> DCTtoCV -> CV_toRGB for
+ *           callers that see the codewords a row at a time.
+ *  Input: a pointer to the first codeword of the row, the number of
+ *         codewords in the row, the denominator of the output pixels and
+ *         the two destination scanlines of 2 * blocks pixels each.
+ *  Input expectation: The parameters should not be NULL.
+ *  Output: N/A
+ *  Output expectation: N/A
+ *  Error condition: CRE if any of the parameter is NULL.
+ */
+void decodeBlockRow(const uint8_t *src, unsigned blocks,
+                    unsigned denominator, struct Pnm_rgb *top,
+                    struct Pnm_rgb *bottom)
+{
+    assert(src != NULL && top != NULL && bottom != NULL);
+    for (unsigned col = 0; col < blocks; col++) {
+        DCT element;
+        cv elem1, elem2, elem3, elem4;
+        Codeword_unpack(Codeword_get(src + col * CODEWORD_BYTES), &element);
+        calculate_DCTtoCV(&element, &elem1, &elem2, &elem3, &elem4);
+
+        calculateRGB(elem1, &top[col*2],      denominator);
+        calculateRGB(elem2, &top[col*2+1],    denominator);
+        calculateRGB(elem3, &bottom[col*2],   denominator);
+        calculateRGB(elem4, &bottom[col*2+1], denominator);
+    }
+}
+
+/*  Name: decodeThumbnailRow
+ *  Purpose: This function decodes one scanline of a thumbnail from the
+ *           block averages alone. The average of the four pixels of a
+ *           block is (a, avepb, apr) in component video, so a pixel of a
+ *           half-size image is one codeword and a pixel of a smaller one
+ *           is the mean of a box of codewords; b, c and d, the inverse
+ *           transform and the 2x2 expansion are skipped. A box cut short
+ *           by the right or bottom edge averages the blocks it has.
+ *  Input: the first codeword of the first of rows rows of blocks
+ *         codewords each, the box size in blocks, the denominator of the
+ *         output pixels, scratch for ceil(blocks / factor) cv and the
+ *         destination scanline of as many pixels.
+ *  Input expectation: rows and factor are at least 1.
+ *  Output: N/A
+ *  Error condition: CRE if a pointer is NULL or rows or factor is 0.
+ */
+void decodeThumbnailRow(const uint8_t *src, unsigned blocks, unsigned rows,
+                        unsigned factor, unsigned denominator, cv *sums,
+                        struct Pnm_rgb *dest)
+{
+    assert(src != NULL && sums != NULL && dest != NULL);
+    assert(rows > 0 && factor > 0);
+    unsigned width = (blocks + factor - 1) / factor;
+    memset(sums, 0, width * sizeof(*sums));
+    for (unsigned row = 0; row < rows; row++) {
+        const uint8_t *word = src + (size_t)row * blocks * CODEWORD_BYTES;
+        for (unsigned col = 0; col < blocks; col++, word += CODEWORD_BYTES) {
+            DCT element;
+            Codeword_unpack_dc(Codeword_get(word), &element);
+            cv *sum = &sums[col / factor];
+            sum -> y  += unscaleDCT(element.a, DCT_A);
+            sum -> pb += Arith40_chroma_of_index(element.avepbQUANT);
+            sum -> pr += Arith40_chroma_of_index(element.aveprQUANT);
+        }
+    }
+    for (unsigned x = 0; x < width; x++) {
+        unsigned across = x == width - 1 ? blocks - x * factor : factor;
+        float count = (float)rows * across;
+        cv average = { sums[x].y / count, sums[x].pb / count,
+                       sums[x].pr / count };
+        calculateRGB(average, &dest[x], denominator);
+    }
+}
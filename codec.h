@@ -0,0 +1,124 @@
+/*********************************************************************
+ *                     codec.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for the individual stages of
+ *              compression and decompression. Each stage works on
+ *              A2Methods arrays; the library in arith.c strings them
+ *              together, and they are exported so that tools can run
+ *              (or time) one stage at a time.
+ *
+ *              compression:    trimDimension -> RGB_toCV -> CVtoDCT
+ *                              -> packDCT, or RGB_toDCT -> packDCT
+ *              decompression:  readHeader -> unpackDCT -> DCTtoCV
+ *                              -> CV_toRGB
+ *********************************************************************/
+
+#ifndef CODEC_INCLUDED
+#define CODEC_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "a2methods.h"
+#include "arith.h"
+#include "calculation.h"
+#include "pnm.h"
+
+#define A2 A2Methods_UArray2
+
+/*
+ * A block memo remembers the DCT of recent 2x2 blocks, so that a
+ * block seen before (the same twelve samples, at most 255 each) is not
+ * transformed again. It is direct mapped: BLOCK_MEMO_SLOTS slots chosen
+ * by a hash of the samples, each holding the last block that hashed
+ * there. Every slot starts out as the black block, so none is empty.
+ * Blocks whose four pixels are equal skip three of the four RGB -> CV
+ * conversions whether or not they are remembered. Each thread encoding
+ * needs its own memo.
+ */
+#define BLOCK_MEMO_BITS 10
+#define BLOCK_MEMO_SLOTS (1u << BLOCK_MEMO_BITS)
+
+typedef struct Block_memo {
+    unsigned denominator;           /* of the blocks remembered */
+    uint64_t hits, flat, computed;  /* blocks not yet reported to stats */
+    struct Block_memo_slot {
+        uint32_t key[3];            /* the samples, four bytes to a word */
+        DCT element;                /* their DCT */
+    } slot[BLOCK_MEMO_SLOTS];
+} Block_memo;
+
+/* empties memo for blocks of the given denominator; a memo of all zeros
+ * is set up by its first use */
+extern void initBlockMemo(Block_memo *memo, unsigned denominator);
+
+/* adds the hits, flat blocks and transformed blocks of memo to the
+ * instrumentation and sets them back to 0 */
+extern void reportBlockMemo(Block_memo *memo);
+
+/* trims the image to even width and height (at least 2x2) */
+extern void trimDimension(Pnm_ppm origImage, A2Methods_T methods);
+
+/*
+ * The transforms below fill arrays that the caller has allocated, so that
+ * the caller decides where the memory comes from (methods->new, or an
+ * arena as in arith.c).
+ */
+
+/* RGB pixels -> same sized array of cv */
+extern void RGB_toCV(Pnm_ppm origImage, A2 arrayYPP, A2Methods_T methods);
+
+/* cv array -> the (already allocated) RGB pixels of finalImage */
+extern void CV_toRGB(Pnm_ppm finalImage, A2 CV_pixels, A2Methods_T methods);
+
+/* cv array -> quarter sized array of DCT */
+extern void CVtoDCT(A2 arrayYPP, A2 arrayDCT, A2Methods_T methods);
+
+/* RGB pixels -> quarter sized array of DCT, one block at a time through
+ * memo, without the array of cv; the same DCT as RGB_toCV -> CVtoDCT */
+extern void RGB_toDCT(Pnm_ppm origImage, A2 arrayDCT, A2Methods_T methods,
+                      Block_memo *memo);
+
+/* DCT array -> cv array of twice the width and height */
+extern void DCTtoCV(A2 arrayDCT, A2 arrayYPP_back, A2Methods_T methods);
+
+/* header and codewords of arrayDCT -> dest; returns bytes written. dest
+ * must hold CODEWORD_HEADER_MAX + Codeword_image_size() bytes */
+extern size_t packDCT(A2 arrayDCT, A2Methods_T methods, uint8_t *dest);
+
+/* parses the header in src[0..n) into d_image, leaving its pixels NULL;
+ * with layout not NULL, formats 4 and 5 are accepted and reported there */
+extern Arith_status readHeader(const uint8_t *src, size_t n, size_t *len,
+                               int *layout, A2Methods_T methods,
+                               Pnm_ppm d_image);
+
+/* codewords at src (already checked to be long enough) -> arrayDCT */
+extern void unpackDCT(A2 arrayDCT, const uint8_t *src, A2Methods_T methods);
+
+/* the two scanlines top and bottom of 2 * blocks pixels each -> one row
+ * of blocks codewords at dest, through memo (NULL for none); used by the
+ * pipelined encoder. memo is set up again if its denominator differs */
+extern void encodeBlockRow(const struct Pnm_rgb *top,
+                           const struct Pnm_rgb *bottom, unsigned blocks,
+                           unsigned denominator, Block_memo *memo,
+                           uint8_t *dest);
+
+/* one row of blocks (blocks codewords at src) -> the two scanlines top
+ * and bottom of 2 * blocks pixels each; used by the streaming decoders */
+extern void decodeBlockRow(const uint8_t *src, unsigned blocks,
+                           unsigned denominator, struct Pnm_rgb *top,
+                           struct Pnm_rgb *bottom);
+
+/* rows rows of blocks codewords each, starting at src -> one scanline
+ * of ceil(blocks / factor) pixels at dest, each the average of up to
+ * rows x factor blocks; sums is scratch for as many cv. Only the block
+ * averages are read, so this is a 1 / (2 * factor) scale decode */
+extern void decodeThumbnailRow(const uint8_t *src, unsigned blocks,
+                               unsigned rows, unsigned factor,
+                               unsigned denominator, cv *sums,
+                               struct Pnm_rgb *dest);
+
+#undef A2
+
+#endif
@@ -0,0 +1,356 @@
+/*********************************************************************
+ *                     codeword.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the compressed image
+ *              format: packing DCT fields into codewords with bitpack.c,
+ *              big-endian byte order, and writing/parsing the header
+ *              without a FILE * so the parser can be used on memory
+ *              buffers and on partially received input.
+ *********************************************************************/
+
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include "assert.h"
+#include "bitpack.h"
+#include "codeword.h"
+
+const unsigned Codeword_field_width[CODEWORD_FIELDS] = { 6, 6, 6, 6, 4, 4 };
+const unsigned Codeword_field_lsb[CODEWORD_FIELDS]   = { 26, 20, 14, 8, 4, 0 };
+
+/* the magic of each layout, indexed by Codeword_layout */
+static const char *const magics[] = { CODEWORD_MAGIC,
+                                      CODEWORD_PREDICTED_MAGIC,
+                                      CODEWORD_PROGRESSIVE_MAGIC };
+
+static Arith_status parseHeader(const uint8_t *src, size_t n,
+                               const char *magic, unsigned *values,
+                               int count, size_t *len);
+static Arith_status parseNumber(const uint8_t *src, size_t n, size_t *pos,
+                                unsigned *value);
+static Arith_status skipSpace(const uint8_t *src, size_t n, size_t *pos);
+
+
+/*  Name: Codeword_pack
+ *  Purpose: This function packs the six fields of a DCT struct into the low
+ *           32 bits of a word, at the positions fixed by the format.
+ *  Input: A pointer to a DCT struct with values already scaled/quantized.
+ *  Output: the packed 32 bit codeword
+ *  Error condition: CRE if element is NULL; Bitpack_Overflow is raised when
+ *                   a field does not fit in its width.
+ */
+uint32_t Codeword_pack(const DCT *element)
+{
+    assert(element != NULL);
+    uint64_t packed = 0;
+    packed = Bitpack_newu(packed, 4, 0,  element -> aveprQUANT);
+    packed = Bitpack_newu(packed, 4, 4,  element -> avepbQUANT);
+    packed = Bitpack_news(packed, 6, 8,  element -> d);
+    packed = Bitpack_news(packed, 6, 14, element -> c);
+    packed = Bitpack_news(packed, 6, 20, element -> b);
+    packed = Bitpack_newu(packed, 6, 26, element -> a);
+    return (uint32_t)packed;
+}
+
+/*  Name: Codeword_unpack
+ *  Purpose: This function extracts the six fields of a codeword and stores
+ *           them in the given DCT struct.
+ *  Input: a 32 bit codeword and a pointer to the destination DCT struct
+ *  Output: N/A
+ *  Error condition: CRE if element is NULL.
+ */
+void Codeword_unpack(uint32_t word, DCT *element)
+{
+    assert(element != NULL);
+    element -> aveprQUANT = Bitpack_getu(word, 4, 0);
+    element -> avepbQUANT = Bitpack_getu(word, 4, 4);
+    element -> d = Bitpack_gets(word, 6, 8);
+    element -> c = Bitpack_gets(word, 6, 14);
+    element -> b = Bitpack_gets(word, 6, 20);
+    element -> a = Bitpack_getu(word, 6, 26);
+}
+
+/*  Name: Codeword_unpack_dc
+ *  Purpose: This function extracts the fields that describe the average of
+ *           a block, for decoders that never need the luma gradients.
+ *  Input: a 32 bit codeword and a pointer to the destination DCT struct
+ *  Output: N/A
+ *  Error condition: CRE if element is NULL.
+ */
+void Codeword_unpack_dc(uint32_t word, DCT *element)
+{
+    assert(element != NULL);
+    element -> aveprQUANT = Bitpack_getu(word, 4, 0);
+    element -> avepbQUANT = Bitpack_getu(word, 4, 4);
+    element -> b = element -> c = element -> d = 0;
+    element -> a = Bitpack_getu(word, 6, 26);
+}
+
+/*  Name: Codeword_put
+ *  Purpose: This function stores a codeword as 4 bytes, most significant
+ *           byte first.
+ *  Input: the destination (at least 4 bytes) and the codeword
+ *  Output: N/A
+ */
+void Codeword_put(uint8_t *dest, uint32_t word)
+{
+    for (int lsb = 24; lsb >= 0; lsb -= 8) {
+        *dest++ = Bitpack_getu(word, 8, lsb);
+    }
+}
+
+/*  Name: Codeword_get
+ *  Purpose: This function loads a codeword stored by Codeword_put.
+ *  Input: the source (at least 4 bytes)
+ *  Output: the 32 bit codeword
+ */
+uint32_t Codeword_get(const uint8_t *src)
+{
+    uint64_t word = 0;
+    for (int lsb = 24; lsb >= 0; lsb -= 8) {
+        word = Bitpack_newu(word, 8, lsb, *src++);
+    }
+    return (uint32_t)word;
+}
+
+/*  Name: Codeword_header_write
+ *  Purpose: This function writes the header of a compressed image.
+ *  Input: a buffer of at least CODEWORD_HEADER_MAX bytes, image dimensions
+ *         and the layout of what follows
+ *  Output: the number of bytes written (no terminating NUL is counted)
+ *  Error condition: CRE if dest is NULL or the layout is unknown.
+ */
+size_t Codeword_header_write(uint8_t *dest, unsigned width, unsigned height,
+                             int layout)
+{
+    assert(dest != NULL);
+    assert(layout >= CODEWORD_PLAIN && layout <= CODEWORD_PROGRESSIVE);
+    int len = snprintf((char *)dest, CODEWORD_HEADER_MAX, "%s\n%u %u\n",
+                       magics[layout], width, height);
+    assert(len > 0 && len < CODEWORD_HEADER_MAX);
+    return len;
+}
+
+/*  Name: Codeword_header_parse
+ *  Purpose: This function checks the header of a compressed image held in
+ *           memory. It accepts the same headers as the original
+ *           fscanf("COMP40 Compressed image format 2\n%u %u") + '\n' reader,
+ *           and the same with format 4 or 5 when the caller can take them.
+ *  Input: the buffer and its length, pointers for width, height, the
+ *         layout (may be NULL) and the length of the header.
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ *  Error condition: CRE if any pointer but layout is NULL.
+ */
+Arith_status Codeword_header_parse(const uint8_t *src, size_t n,
+                                   unsigned *width, unsigned *height,
+                                   int *layout, size_t *len)
+{
+    assert(src != NULL && width != NULL && height != NULL && len != NULL);
+    unsigned values[2];
+    int found = CODEWORD_PLAIN;
+    Arith_status status = parseHeader(src, n, magics[found], values, 2,
+                                      len);
+    while (status == ARITH_EBADFORMAT && layout != NULL &&
+           found < CODEWORD_PROGRESSIVE) {
+        found++;
+        status = parseHeader(src, n, magics[found], values, 2, len);
+    }
+    if (layout != NULL) {
+        *layout = found;
+    }
+    if (status != ARITH_OK) {
+        return status;
+    }
+    *width = values[0];
+    *height = values[1];
+    return ARITH_OK;
+}
+
+/*  Name: Codeword_tiled_header_write
+ *  Purpose: This function writes the text part of a tiled header.
+ *  Input: a buffer of at least CODEWORD_HEADER_MAX bytes, image and tile
+ *         dimensions
+ *  Output: the number of bytes written
+ */
+size_t Codeword_tiled_header_write(uint8_t *dest, unsigned width,
+                                   unsigned height, unsigned tile_width,
+                                   unsigned tile_height)
+{
+    assert(dest != NULL);
+    int len = snprintf((char *)dest, CODEWORD_HEADER_MAX,
+                       "%s\n%u %u\n%u %u\n", CODEWORD_TILED_MAGIC, width,
+                       height, tile_width, tile_height);
+    assert(len > 0 && len < CODEWORD_HEADER_MAX);
+    return len;
+}
+
+/*  Name: Codeword_tiled_header_parse
+ *  Purpose: This function checks the text part of a tiled header.
+ *  Input: the buffer and its length, pointers for the four dimensions
+ *         and the length of the text
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ *  Error condition: CRE if any pointer is NULL.
+ */
+Arith_status Codeword_tiled_header_parse(const uint8_t *src, size_t n,
+                                         unsigned *width, unsigned *height,
+                                         unsigned *tile_width,
+                                         unsigned *tile_height, size_t *len)
+{
+    assert(src != NULL && width != NULL && height != NULL);
+    assert(tile_width != NULL && tile_height != NULL && len != NULL);
+    unsigned values[4];
+    Arith_status status = parseHeader(src, n, CODEWORD_TILED_MAGIC, values,
+                                      4, len);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    *width = values[0];
+    *height = values[1];
+    *tile_width = values[2];
+    *tile_height = values[3];
+    return ARITH_OK;
+}
+
+/*  Name: Codeword_sequence_header_write
+ *  Purpose: This function writes the header of a sequence.
+ *  Input: a buffer of at least CODEWORD_HEADER_MAX bytes and the size of
+ *         the frames
+ *  Output: the number of bytes written (no terminating NUL is counted)
+ */
+size_t Codeword_sequence_header_write(uint8_t *dest, unsigned width,
+                                      unsigned height)
+{
+    assert(dest != NULL);
+    int len = snprintf((char *)dest, CODEWORD_HEADER_MAX, "%s\n%u %u\n",
+                       CODEWORD_SEQUENCE_MAGIC, width, height);
+    assert(len > 0 && len < CODEWORD_HEADER_MAX);
+    return len;
+}
+
+/*  Name: Codeword_sequence_header_parse
+ *  Purpose: This function checks the header of a sequence.
+ *  Input: the buffer and its length, pointers for the size of the frames
+ *         and the length of the header
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ *  Error condition: CRE if any pointer is NULL.
+ */
+Arith_status Codeword_sequence_header_parse(const uint8_t *src, size_t n,
+                                            unsigned *width,
+                                            unsigned *height, size_t *len)
+{
+    assert(src != NULL && width != NULL && height != NULL && len != NULL);
+    unsigned values[2];
+    Arith_status status = parseHeader(src, n, CODEWORD_SEQUENCE_MAGIC,
+                                      values, 2, len);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    *width = values[0];
+    *height = values[1];
+    return ARITH_OK;
+}
+
+/*  Name: Codeword_image_size
+ *  Purpose: This function returns the number of bytes of codewords that
+ *           follow the header of a width x height image.
+ *  Input: the image dimensions (even)
+ *  Output: size in bytes
+ */
+size_t Codeword_image_size(unsigned width, unsigned height)
+{
+    return (size_t)(width / 2) * (height / 2) * CODEWORD_BYTES;
+}
+
+/*  Name: parseHeader
+ *  Purpose: This function checks a magic string followed by count
+ *           whitespace-separated numbers and a newline. Every number must
+ *           be even and at least 2, as the headers only hold dimensions.
+ *  Input: the buffer and its length, the magic, space for the numbers,
+ *         how many there are and a pointer for the length of the header
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ */
+static Arith_status parseHeader(const uint8_t *src, size_t n,
+                               const char *magic, unsigned *values,
+                               int count, size_t *len)
+{
+    size_t magic_len = strlen(magic);
+    size_t cmp_len = n < magic_len ? n : magic_len;
+    if (memcmp(src, magic, cmp_len) != 0) {
+        return ARITH_EBADFORMAT;
+    }
+    if (n < magic_len) {
+        return ARITH_ETRUNCATED;
+    }
+
+    size_t pos = magic_len;
+    Arith_status status;
+    for (int i = 0; i < count; i++) {
+        if ((status = skipSpace(src, n, &pos))              != ARITH_OK ||
+            (status = parseNumber(src, n, &pos, &values[i])) != ARITH_OK) {
+            return status;
+        }
+    }
+    if (pos == n) {
+        return ARITH_ETRUNCATED;
+    }
+    if (src[pos] != '\n') {
+        return ARITH_EBADFORMAT;
+    }
+    for (int i = 0; i < count; i++) {
+        if (values[i] < 2 || values[i] % 2 != 0) {
+            return ARITH_EBADFORMAT;
+        }
+    }
+    *len = pos + 1;
+    return ARITH_OK;
+}
+
+/*  Name: skipSpace
+ *  Purpose: This function advances *pos over at least one whitespace
+ *           character.
+ *  Output: ARITH_OK, or ARITH_ETRUNCATED/ARITH_EBADFORMAT if the buffer
+ *          ends / does not have whitespace at *pos.
+ */
+static Arith_status skipSpace(const uint8_t *src, size_t n, size_t *pos)
+{
+    size_t start = *pos;
+    while (*pos < n && (src[*pos] == ' ' || src[*pos] == '\t' ||
+                        src[*pos] == '\n' || src[*pos] == '\r')) {
+        (*pos)++;
+    }
+    if (*pos == n) {
+        return ARITH_ETRUNCATED;
+    }
+    return *pos > start ? ARITH_OK : ARITH_EBADFORMAT;
+}
+
+/*  Name: parseNumber
+ *  Purpose: This function reads a decimal number starting at *pos that must
+ *           be representable as an int.
+ *  Output: ARITH_OK, or ARITH_ETRUNCATED if the buffer ends inside the
+ *          number, ARITH_EBADFORMAT if there is no digit or it overflows.
+ */
+static Arith_status parseNumber(const uint8_t *src, size_t n, size_t *pos,
+                                unsigned *value)
+{
+    size_t start = *pos;
+    unsigned long v = 0;
+    while (*pos < n && src[*pos] >= '0' && src[*pos] <= '9') {
+        v = v * 10 + (src[*pos] - '0');
+        if (v > INT_MAX) {
+            return ARITH_EBADFORMAT;
+        }
+        (*pos)++;
+    }
+    if (*pos == n) {
+        return ARITH_ETRUNCATED;
+    }
+    if (*pos == start) {
+        return ARITH_EBADFORMAT;
+    }
+    *value = v;
+    return ARITH_OK;
+}
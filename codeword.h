@@ -0,0 +1,137 @@
+/*********************************************************************
+ *                     codeword.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for the compressed image format
+ *              "COMP40 Compressed image format 2": the text header
+ *              followed by one 32-bit big-endian codeword per 2x2 block,
+ *              in row-major order. Every module that reads or writes
+ *              the format goes through these functions so the bit
+ *              layout lives in exactly one place.
+ *********************************************************************/
+
+#ifndef CODEWORD_INCLUDED
+#define CODEWORD_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arith.h"
+#include "calculation.h"
+
+#define CODEWORD_MAGIC "COMP40 Compressed image format 2"
+
+/* format 2 with the block averages predicted (predict.h) */
+#define CODEWORD_PREDICTED_MAGIC "COMP40 Compressed image format 4"
+
+/* format 2 with the fields of every block's averages ahead of those of
+ * every block's detail (layers.h) */
+#define CODEWORD_PROGRESSIVE_MAGIC "COMP40 Compressed image format 5"
+
+/* the tiled container (tile.h): the same codewords, grouped into tiles */
+#define CODEWORD_TILED_MAGIC "COMP40 Compressed image format 3"
+
+/* a sequence of frames (sequence.h): their codewords, less repeats */
+#define CODEWORD_SEQUENCE_MAGIC "COMP40 Compressed sequence 1"
+
+/* bytes occupied by one packed 2x2 block */
+#define CODEWORD_BYTES 4
+
+/* the six fields of a codeword as unsigned bit fields, a first, for
+ * coders that treat them alike (b, c and d are two's complement) */
+#define CODEWORD_FIELDS 6
+extern const unsigned Codeword_field_width[CODEWORD_FIELDS];
+extern const unsigned Codeword_field_lsb[CODEWORD_FIELDS];
+
+/* Function: Codeword_pack()
+ * Job: pack the fields of a DCT struct into a 32-bit codeword:
+ *      a[31:26] b[25:20] c[19:14] d[13:8] avepbQUANT[7:4] aveprQUANT[3:0]
+ */
+extern uint32_t Codeword_pack(const DCT *element);
+
+/* Function: Codeword_unpack()
+ * Job: the inverse of Codeword_pack(); b, c and d are sign extended.
+ */
+extern void Codeword_unpack(uint32_t word, DCT *element);
+
+/* Function: Codeword_unpack_dc()
+ * Job: extract only a, avepbQUANT and aveprQUANT, the block's average
+ *      luma and chroma; b, c and d are set to 0 without being decoded.
+ */
+extern void Codeword_unpack_dc(uint32_t word, DCT *element);
+
+/* Function: Codeword_put() / Codeword_get()
+ * Job: store / load a codeword as 4 big-endian bytes.
+ */
+extern void     Codeword_put(uint8_t *dest, uint32_t word);
+extern uint32_t Codeword_get(const uint8_t *src);
+
+/* what follows a header of the one-line kind */
+typedef enum Codeword_layout {
+    CODEWORD_PLAIN,         /* format 2 */
+    CODEWORD_PREDICTED,     /* format 4 */
+    CODEWORD_PROGRESSIVE    /* format 5 */
+} Codeword_layout;
+
+/* Function: Codeword_header_write()
+ * Job: write the header for a width x height image with the given layout
+ *      into dest (which must hold at least CODEWORD_HEADER_MAX bytes) and
+ *      return its length. All the headers of an image have the same
+ *      length.
+ */
+#define CODEWORD_HEADER_MAX 64
+extern size_t Codeword_header_write(uint8_t *dest, unsigned width,
+                                    unsigned height, int layout);
+
+/* Function: Codeword_header_parse()
+ * Job: parse a header from the first n bytes of src. On success store the
+ *      dimensions and the header length in *width, *height and *len.
+ * Expected output: ARITH_OK; ARITH_ETRUNCATED if src is a valid prefix of
+ *      a header but ends too early (so the caller may retry with more
+ *      bytes); ARITH_EBADFORMAT if src can never become a valid header.
+ *      Dimensions must be even, at least 2 and representable as an int.
+ *      If layout is not NULL, the headers of formats 4 and 5 are accepted
+ *      too and *layout says which was found; if it is NULL, only format 2
+ *      is.
+ */
+extern Arith_status Codeword_header_parse(const uint8_t *src, size_t n,
+                                          unsigned *width, unsigned *height,
+                                          int *layout, size_t *len);
+
+/* Function: Codeword_tiled_header_write() / Codeword_tiled_header_parse()
+ * Job: as Codeword_header_write() / Codeword_header_parse(), for the text
+ *      line of a tiled container: the magic, "width height" and
+ *      "tile_width tile_height" on lines of their own. All four must be
+ *      even and at least 2. The tile index follows (see tile.h).
+ */
+extern size_t Codeword_tiled_header_write(uint8_t *dest, unsigned width,
+                                          unsigned height,
+                                          unsigned tile_width,
+                                          unsigned tile_height);
+extern Arith_status Codeword_tiled_header_parse(const uint8_t *src,
+                                                size_t n, unsigned *width,
+                                                unsigned *height,
+                                                unsigned *tile_width,
+                                                unsigned *tile_height,
+                                                size_t *len);
+
+/* Function: Codeword_sequence_header_write() /
+ *           Codeword_sequence_header_parse()
+ * Job: as Codeword_header_write() / Codeword_header_parse(), for the
+ *      header of a sequence: the magic and "width height" of its frames.
+ */
+extern size_t Codeword_sequence_header_write(uint8_t *dest, unsigned width,
+                                             unsigned height);
+extern Arith_status Codeword_sequence_header_parse(const uint8_t *src,
+                                                   size_t n,
+                                                   unsigned *width,
+                                                   unsigned *height,
+                                                   size_t *len);
+
+/* Function: Codeword_image_size()
+ * Job: return the number of codeword bytes following the header of a
+ *      width x height image.
+ */
+extern size_t Codeword_image_size(unsigned width, unsigned height);
+
+#endif
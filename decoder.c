@@ -0,0 +1,276 @@
+/*********************************************************************
+ *                     decoder.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the push-based incremental
+ *              decoder declared in arith.h. The decoder is a small state
+ *              machine: it buffers bytes until the header parses, then
+ *              collects one row of codewords at a time (decoding rows
+ *              in place when a chunk holds them whole) and hands every
+ *              decoded scanline pair to the caller. A format 4 image
+ *              also keeps the last row of restored codewords, which is
+ *              all the prediction of the next row needs.
+ *********************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "arith.h"
+#include "codec.h"
+#include "codeword.h"
+#include "predict.h"
+#include "stats.h"
+
+/* longest header accepted; fscanf allowed any amount of whitespace, but a
+ * sender that needs more than this is not sending a compressed image */
+#define HEADER_LIMIT 256
+
+typedef enum { IN_HEADER, IN_CODEWORDS, DONE } Stage;
+
+struct Arith_decoder {
+    Arith_rowfun *apply;
+    void *cl;
+
+    Stage stage;
+    Arith_status status;        /* sticky error, ARITH_OK otherwise */
+
+    uint8_t header[HEADER_LIMIT];
+    size_t header_len;
+
+    unsigned width, height;
+    unsigned rows_done;         /* scanlines delivered */
+
+    uint8_t *row;               /* one row of codewords */
+    size_t row_bytes, row_len;  /* its size and how much has arrived */
+    int layout;                 /* Codeword_layout of the header */
+    uint8_t *restored;          /* format 4: two rows, each restored in
+                                 * turn from the other */
+    struct Pnm_rgb *top, *bottom;
+};
+
+static size_t feedHeader(Arith_decoder dec, const uint8_t *buf, size_t len);
+static size_t feedCodewords(Arith_decoder dec, const uint8_t *buf,
+                            size_t len);
+static void deliverRow(Arith_decoder dec, const uint8_t *codewords);
+
+
+/*  Name: Arith_decoder_new
+ *  Purpose: This function creates a decoder waiting for the header.
+ *  Input: the function to call for every scanline pair and its closure
+ *  Output: the decoder, or NULL when out of memory
+ *  Error condition: CRE if apply is NULL.
+ */
+Arith_decoder Arith_decoder_new(Arith_rowfun *apply, void *cl)
+{
+    assert(apply != NULL);
+    Stats_init();
+    Arith_decoder dec = calloc(1, sizeof(*dec));
+    if (dec == NULL) {
+        return NULL;
+    }
+    dec -> apply = apply;
+    dec -> cl = cl;
+    dec -> stage = IN_HEADER;
+    dec -> status = ARITH_OK;
+    return dec;
+}
+
+/*  Name: Arith_decoder_feed
+ *  Purpose: This function consumes the next chunk of the compressed image.
+ *  Input: the decoder, the chunk and its length
+ *  Output: ARITH_OK, or the sticky error
+ *  Error condition: CRE if dec is NULL, or buf is NULL with len > 0.
+ */
+Arith_status Arith_decoder_feed(Arith_decoder dec, const uint8_t *buf,
+                                size_t len)
+{
+    assert(dec != NULL && (buf != NULL || len == 0));
+    while (len > 0 && dec -> status == ARITH_OK) {
+        size_t used;
+        if (dec -> stage == IN_HEADER) {
+            used = feedHeader(dec, buf, len);
+        } else if (dec -> stage == IN_CODEWORDS) {
+            used = feedCodewords(dec, buf, len);
+        } else {
+            used = len;     /* trailing bytes after the last codeword */
+        }
+        buf += used;
+        len -= used;
+    }
+    return dec -> status;
+}
+
+/*  Name: Arith_decoder_finish
+ *  Purpose: This function tells the caller, once the input has ended,
+ *           whether the whole image was decoded.
+ *  Input: the decoder
+ *  Output: ARITH_OK, the sticky error, or ARITH_ETRUNCATED
+ *  Error condition: CRE if dec is NULL.
+ */
+Arith_status Arith_decoder_finish(Arith_decoder dec)
+{
+    assert(dec != NULL);
+    if (dec -> status != ARITH_OK) {
+        return dec -> status;
+    }
+    return dec -> stage == DONE ? ARITH_OK : ARITH_ETRUNCATED;
+}
+
+/*  Name: Arith_decoder_progress
+ *  Purpose: This function reports the dimensions and the number of
+ *           scanlines delivered so far.
+ *  Input: the decoder and locations for the results (each may be NULL)
+ *  Output: N/A
+ *  Error condition: CRE if dec is NULL.
+ */
+void Arith_decoder_progress(Arith_decoder dec, unsigned *width,
+                            unsigned *height, unsigned *rows_done)
+{
+    assert(dec != NULL);
+    if (width != NULL) {
+        *width = dec -> width;
+    }
+    if (height != NULL) {
+        *height = dec -> height;
+    }
+    if (rows_done != NULL) {
+        *rows_done = dec -> rows_done;
+    }
+}
+
+/*  Name: Arith_decoder_free
+ *  Purpose: This function releases the decoder and its row buffers.
+ *  Input: a pointer to the decoder
+ *  Output: N/A
+ *  Error condition: CRE if dec or *dec is NULL.
+ */
+void Arith_decoder_free(Arith_decoder *dec)
+{
+    assert(dec != NULL && *dec != NULL);
+    free((*dec) -> row);
+    free((*dec) -> restored);
+    free((*dec) -> top);
+    free((*dec) -> bottom);
+    free(*dec);
+    *dec = NULL;
+}
+
+/*  Name: feedHeader
+ *  Purpose: This function appends bytes to the partial header until it
+ *           parses, then allocates the row buffers.
+ *  Input: the decoder, the chunk and its length
+ *  Output: the number of bytes of the chunk that belonged to the header
+ */
+static size_t feedHeader(Arith_decoder dec, const uint8_t *buf, size_t len)
+{
+    size_t before = dec -> header_len;
+    size_t take = HEADER_LIMIT - before;
+    if (take > len) {
+        take = len;
+    }
+    memcpy(dec -> header + before, buf, take);
+    dec -> header_len += take;
+
+    size_t header_len;
+    Arith_status status = Codeword_header_parse(dec -> header,
+                                                dec -> header_len,
+                                                &dec -> width,
+                                                &dec -> height,
+                                                &dec -> layout,
+                                                &header_len);
+    if (status == ARITH_ETRUNCATED && dec -> header_len < HEADER_LIMIT) {
+        return take;
+    }
+    /* format 5 has no row of codewords until its detail layer */
+    if (status != ARITH_OK || dec -> layout == CODEWORD_PROGRESSIVE) {
+        dec -> status = ARITH_EBADFORMAT;
+        dec -> width = dec -> height = 0;
+        return take;
+    }
+
+    dec -> row_bytes = (size_t)(dec -> width / 2) * CODEWORD_BYTES;
+    dec -> row = malloc(dec -> row_bytes);
+    dec -> top = malloc(dec -> width * sizeof(struct Pnm_rgb));
+    dec -> bottom = malloc(dec -> width * sizeof(struct Pnm_rgb));
+    int predicted = dec -> layout == CODEWORD_PREDICTED;
+    if (predicted) {
+        dec -> restored = malloc(2 * dec -> row_bytes);
+    }
+    if (dec -> row == NULL || dec -> top == NULL || dec -> bottom == NULL ||
+        (predicted && dec -> restored == NULL)) {
+        dec -> status = ARITH_ENOMEM;
+        return take;
+    }
+    dec -> stage = IN_CODEWORDS;
+    /* only the header itself is consumed; the rest is codewords */
+    return header_len - before;
+}
+
+/*  Name: feedCodewords
+ *  Purpose: This function consumes codeword bytes. Whole rows are decoded
+ *           straight from the chunk; a row split between chunks is first
+ *           collected in the decoder's row buffer.
+ *  Input: the decoder, the chunk and its length
+ *  Output: the number of bytes consumed
+ */
+static size_t feedCodewords(Arith_decoder dec, const uint8_t *buf, size_t len)
+{
+    size_t used = 0;
+    if (dec -> row_len > 0) {
+        size_t take = dec -> row_bytes - dec -> row_len;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(dec -> row + dec -> row_len, buf, take);
+        dec -> row_len += take;
+        used = take;
+        if (dec -> row_len < dec -> row_bytes) {
+            return used;
+        }
+        dec -> row_len = 0;
+        deliverRow(dec, dec -> row);
+    }
+
+    while (dec -> stage == IN_CODEWORDS && len - used >= dec -> row_bytes) {
+        deliverRow(dec, buf + used);
+        used += dec -> row_bytes;
+    }
+    if (dec -> stage == IN_CODEWORDS && used < len) {
+        dec -> row_len = len - used;
+        memcpy(dec -> row, buf + used, dec -> row_len);
+        used = len;
+    }
+    return used;
+}
+
+/*  Name: deliverRow
+ *  Purpose: This function decodes one row of codewords (restoring its
+ *           averages first in format 4) and calls the client back with
+ *           the two scanlines.
+ *  Input: the decoder and the codewords of the next row
+ *  Output: N/A
+ */
+static void deliverRow(Arith_decoder dec, const uint8_t *codewords)
+{
+    Stats_clock clock = Stats_start();
+    if (dec -> layout == CODEWORD_PREDICTED) {
+        size_t row_bytes = dec -> row_bytes;
+        unsigned pair = dec -> rows_done / 2;
+        uint8_t *row = dec -> restored + (pair % 2) * row_bytes;
+        const uint8_t *above = dec -> restored + (pair + 1) % 2 * row_bytes;
+        memcpy(row, codewords, row_bytes);
+        Predict_decode_row(row, pair > 0 ? above : NULL, dec -> width / 2);
+        codewords = row;
+    }
+    decodeBlockRow(codewords, dec -> width / 2, 255, dec -> top,
+                   dec -> bottom);
+    Stats_lap(STATS_ROWS, clock);
+    dec -> apply(dec -> rows_done, dec -> top, dec -> bottom, dec -> width,
+                 dec -> cl);
+    dec -> rows_done += 2;
+    if (dec -> rows_done == dec -> height) {
+        dec -> stage = DONE;
+    }
+}
@@ -0,0 +1,117 @@
+/*********************************************************************
+ *                     geometry.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for geometric transforms of
+ *              codeword grids. Mirrors and the half turn read and write
+ *              whole rows in order; the transpose works through squares
+ *              of SQUARE x SQUARE blocks so that the rows it writes stay
+ *              in cache while the columns it reads are gathered.
+ *********************************************************************/
+
+
+#include "assert.h"
+#include "geometry.h"
+#include "bitpack_fast.h"
+#include "codeword.h"
+
+/* side of the squares of blocks the transpose moves at a time: 16
+ * codewords are one 64-byte line */
+#define SQUARE 16
+
+static uint32_t negate(uint32_t word, int field);
+
+
+/*  Name: Geometry_codeword
+ *  Purpose: This function rewrites the gradients of a block for op.
+ *  Input: the codeword and the op
+ *  Output: the new codeword
+ *  Error condition: CRE if op is ARITH_CROP or unknown.
+ */
+uint32_t Geometry_codeword(uint32_t word, Arith_transform_op op)
+{
+    switch (op) {
+    case ARITH_FLIP_X:
+        return negate(negate(word, 2), 3);
+    case ARITH_FLIP_Y:
+        return negate(negate(word, 1), 3);
+    case ARITH_ROTATE_180:
+        return negate(negate(word, 1), 2);
+    case ARITH_TRANSPOSE: {
+        uint64_t b = Bitpack_fast_getu(word, Codeword_field_width[1],
+                                       Codeword_field_lsb[1]);
+        uint64_t c = Bitpack_fast_getu(word, Codeword_field_width[2],
+                                       Codeword_field_lsb[2]);
+        uint64_t swapped = Bitpack_fast_newu(word, Codeword_field_width[1],
+                                             Codeword_field_lsb[1], c);
+        return Bitpack_fast_newu(swapped, Codeword_field_width[2],
+                                 Codeword_field_lsb[2], b);
+    }
+    case ARITH_CROP:
+        break;
+    }
+    assert(0);
+    return word;
+}
+
+/*  Name: Geometry_apply
+ *  Purpose: This function moves every block of a grid to its place after
+ *           op and rewrites its codeword.
+ *  Input: the grid, its codewords per row and its rows, the op and the
+ *         destination
+ *  Output: N/A
+ *  Error condition: CRE if a pointer is NULL or op is ARITH_CROP.
+ */
+void Geometry_apply(const uint8_t *src, unsigned across, unsigned rows,
+                    Arith_transform_op op, uint8_t *dest)
+{
+    assert(src != NULL && dest != NULL && op != ARITH_CROP);
+    if (op == ARITH_TRANSPOSE) {
+        for (unsigned r0 = 0; r0 < rows; r0 += SQUARE) {
+            for (unsigned i0 = 0; i0 < across; i0 += SQUARE) {
+                unsigned r1 = r0 + SQUARE < rows ? r0 + SQUARE : rows;
+                unsigned i1 = i0 + SQUARE < across ? i0 + SQUARE : across;
+                for (unsigned i = i0; i < i1; i++) {
+                    for (unsigned r = r0; r < r1; r++) {
+                        const uint8_t *from = src + ((size_t)r * across +
+                                                     i) * CODEWORD_BYTES;
+                        uint8_t *to = dest + ((size_t)i * rows + r) *
+                                             CODEWORD_BYTES;
+                        Codeword_put(to, Geometry_codeword(
+                                             Codeword_get(from), op));
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    int mirror_x = op == ARITH_FLIP_X || op == ARITH_ROTATE_180;
+    int mirror_y = op == ARITH_FLIP_Y || op == ARITH_ROTATE_180;
+    for (unsigned r = 0; r < rows; r++) {
+        const uint8_t *from = src + (size_t)r * across * CODEWORD_BYTES;
+        uint8_t *to = dest + (size_t)(mirror_y ? rows - 1 - r : r) *
+                             across * CODEWORD_BYTES;
+        for (unsigned i = 0; i < across; i++, from += CODEWORD_BYTES) {
+            unsigned j = mirror_x ? across - 1 - i : i;
+            Codeword_put(to + (size_t)j * CODEWORD_BYTES,
+                         Geometry_codeword(Codeword_get(from), op));
+        }
+    }
+}
+
+/*  Name: negate
+ *  Purpose: This function negates one of the signed fields b, c or d
+ *           (1, 2 or 3). A -32, which the encoder never writes, becomes
+ *           31 rather than overflowing.
+ *  Output: the new codeword
+ */
+static uint32_t negate(uint32_t word, int field)
+{
+    unsigned width = Codeword_field_width[field];
+    unsigned lsb = Codeword_field_lsb[field];
+    int64_t value = -Bitpack_fast_gets(word, width, lsb);
+    int64_t most = ((int64_t)1 << (width - 1)) - 1;
+    return Bitpack_fast_news(word, width, lsb, value > most ? most : value);
+}
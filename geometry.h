@@ -0,0 +1,41 @@
+/*********************************************************************
+ *                     geometry.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for mirroring, rotating and
+ *              transposing a grid of codewords without decoding it. With
+ *              Y1 Y2 over Y3 Y4, b is the bottom minus the top, c the
+ *              right minus the left and d the diagonal difference, so
+ *
+ *                  ARITH_FLIP_X        c = -c, d = -d
+ *                  ARITH_FLIP_Y        b = -b, d = -d
+ *                  ARITH_ROTATE_180    b = -b, c = -c
+ *                  ARITH_TRANSPOSE     b <-> c
+ *
+ *              while a and the chroma indices are left alone. b, c and d
+ *              are quantized to [-31, 31], so negating them is exact.
+ *********************************************************************/
+
+#ifndef GEOMETRY_INCLUDED
+#define GEOMETRY_INCLUDED
+
+#include <stdint.h>
+#include "arith.h"
+
+/* Function: Geometry_codeword()
+ * Job: return the codeword of a block after op (not ARITH_CROP).
+ */
+extern uint32_t Geometry_codeword(uint32_t word, Arith_transform_op op);
+
+/* Function: Geometry_apply()
+ * Job: write the grid of rows rows of across codewords at src, moved and
+ *      rewritten by op (not ARITH_CROP), to dest as a grid of its own:
+ *      rows x across blocks, or across x rows for ARITH_TRANSPOSE.
+ *      src and dest must not overlap.
+ */
+extern void Geometry_apply(const uint8_t *src, unsigned across,
+                           unsigned rows, Arith_transform_op op,
+                           uint8_t *dest);
+
+#endif
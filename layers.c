@@ -0,0 +1,191 @@
+/*********************************************************************
+ *                     layers.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the progressive layout.
+ *              Both layers go through the same bit writer and reader,
+ *              which keep the bits not yet stored (or not yet used) at
+ *              the bottom of a 64-bit word; the fields of each layer are
+ *              taken from codeword.h, so the layout follows the
+ *              codewords if they ever change.
+ *********************************************************************/
+
+
+#include "assert.h"
+#include "layers.h"
+#include "bitpack_fast.h"
+#include "codeword.h"
+
+/* the fields of each layer, in the order they are written */
+#define LAYER_FIELDS 3
+static const int averages[LAYER_FIELDS] = { 0, 4, 5 };
+static const int detail[LAYER_FIELDS] = { 1, 2, 3 };
+
+/* a bit string being written or read, most significant bit first */
+typedef struct Bits {
+    uint8_t *bytes;         /* writing: the next byte to store */
+    const uint8_t *from;    /* reading: the next byte to load */
+    uint64_t pending;       /* the last count bits are not yet stored (or
+                             * not yet used) */
+    unsigned count;
+} Bits;
+
+static unsigned layerBits(const int *fields);
+static void putLayer(const uint8_t *grid, size_t blocks, const int *fields,
+                     uint8_t *dest);
+static void getLayer(const uint8_t *src, size_t blocks, const int *fields,
+                     int fresh, uint8_t *grid);
+static void put(Bits *bits, uint64_t value, unsigned width);
+static uint64_t get(Bits *bits, unsigned width);
+
+
+/*  Name: Layers_dc_size
+ *  Purpose: This function gives the bytes of the averages layer.
+ *  Input: the number of blocks
+ *  Output: the size in bytes
+ */
+size_t Layers_dc_size(size_t blocks)
+{
+    return (blocks * layerBits(averages) + 7) / 8;
+}
+
+/*  Name: Layers_size
+ *  Purpose: This function gives the bytes of both layers.
+ *  Input: the number of blocks
+ *  Output: the size in bytes
+ */
+size_t Layers_size(size_t blocks)
+{
+    return Layers_dc_size(blocks) + (blocks * layerBits(detail) + 7) / 8;
+}
+
+/*  Name: Layers_split
+ *  Purpose: This function writes the averages of every block, then the
+ *           detail of every block.
+ *  Input: the plain codewords, how many there are and the destination
+ *  Output: N/A
+ *  Error condition: CRE if a pointer is NULL.
+ */
+void Layers_split(const uint8_t *grid, size_t blocks, uint8_t *dest)
+{
+    assert(grid != NULL && dest != NULL);
+    putLayer(grid, blocks, averages, dest);
+    putLayer(grid, blocks, detail, dest + Layers_dc_size(blocks));
+}
+
+/*  Name: Layers_join
+ *  Purpose: This function rebuilds the codewords from the averages and
+ *           as much of the detail as there is. A block is refined only
+ *           when all 18 bits of its detail have arrived.
+ *  Input: the layers, how many of their bytes have arrived, the number
+ *         of blocks and the destination
+ *  Output: the number of blocks rebuilt with their detail
+ *  Error condition: CRE if a pointer is NULL or the averages layer is not
+ *                   whole.
+ */
+size_t Layers_join(const uint8_t *src, size_t avail, size_t blocks,
+                   uint8_t *grid)
+{
+    assert(src != NULL && grid != NULL);
+    size_t dc_size = Layers_dc_size(blocks);
+    assert(avail >= dc_size);
+    size_t refined = (avail - dc_size) * 8 / layerBits(detail);
+    if (refined > blocks) {
+        refined = blocks;
+    }
+    getLayer(src, blocks, averages, 1, grid);
+    getLayer(src + dc_size, refined, detail, 0, grid);
+    return refined;
+}
+
+/*  Name: layerBits
+ *  Purpose: This function adds up the widths of the fields of a layer.
+ *  Output: the bits each block takes in the layer
+ */
+static unsigned layerBits(const int *fields)
+{
+    unsigned bits = 0;
+    for (int f = 0; f < LAYER_FIELDS; f++) {
+        bits += Codeword_field_width[fields[f]];
+    }
+    return bits;
+}
+
+/*  Name: putLayer
+ *  Purpose: This function writes the fields of one layer of every block,
+ *           with the last byte padded with zeros.
+ *  Input: the codewords, how many there are, the fields and the
+ *         destination
+ */
+static void putLayer(const uint8_t *grid, size_t blocks, const int *fields,
+                     uint8_t *dest)
+{
+    Bits bits = { dest, NULL, 0, 0 };
+    for (size_t k = 0; k < blocks; k++) {
+        uint32_t word = Codeword_get(grid + k * CODEWORD_BYTES);
+        for (int f = 0; f < LAYER_FIELDS; f++) {
+            unsigned width = Codeword_field_width[fields[f]];
+            put(&bits, Bitpack_fast_getu(word, width,
+                                         Codeword_field_lsb[fields[f]]),
+                width);
+        }
+    }
+    if (bits.count > 0) {
+        put(&bits, 0, 8 - bits.count);
+    }
+}
+
+/*  Name: getLayer
+ *  Purpose: This function reads the fields of one layer of the first
+ *           blocks blocks into their codewords: fresh ones, with the
+ *           other fields 0, or those already there, keeping the others.
+ *  Input: the layer, how many blocks to read, the fields, whether to
+ *         start afresh and the codewords
+ */
+static void getLayer(const uint8_t *src, size_t blocks, const int *fields,
+                     int fresh, uint8_t *grid)
+{
+    Bits bits = { NULL, src, 0, 0 };
+    for (size_t k = 0; k < blocks; k++) {
+        uint8_t *cw = grid + k * CODEWORD_BYTES;
+        uint64_t word = fresh ? 0 : Codeword_get(cw);
+        for (int f = 0; f < LAYER_FIELDS; f++) {
+            unsigned width = Codeword_field_width[fields[f]];
+            word = Bitpack_fast_newu(word, width,
+                                     Codeword_field_lsb[fields[f]],
+                                     get(&bits, width));
+        }
+        Codeword_put(cw, word);
+    }
+}
+
+/*  Name: put
+ *  Purpose: This function appends width bits and stores every byte that
+ *           is complete.
+ */
+static void put(Bits *bits, uint64_t value, unsigned width)
+{
+    bits -> pending = bits -> pending << width | value;
+    bits -> count += width;
+    while (bits -> count >= 8) {
+        bits -> count -= 8;
+        *bits -> bytes++ = bits -> pending >> bits -> count;
+    }
+}
+
+/*  Name: get
+ *  Purpose: This function takes the next width bits, loading bytes only
+ *           as they are needed, so that it never reads past the last
+ *           byte holding a bit it returns.
+ */
+static uint64_t get(Bits *bits, unsigned width)
+{
+    while (bits -> count < width) {
+        bits -> pending = bits -> pending << 8 | *bits -> from++;
+        bits -> count += 8;
+    }
+    bits -> count -= width;
+    return (bits -> pending >> bits -> count) &
+           (((uint64_t)1 << width) - 1);
+}
@@ -0,0 +1,50 @@
+/*********************************************************************
+ *                     layers.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for the progressive layout of
+ *              format 5. The codewords of a grid are cut in two and
+ *              each half is written for every block before the next
+ *              half of any:
+ *
+ *                  averages    a, avepbQUANT, aveprQUANT  (14 bits)
+ *                  detail      b, c, d                    (18 bits)
+ *
+ *              Each layer is a big-endian bit string of its fields,
+ *              block after block in row-major order, padded to a whole
+ *              byte, so the two together take at most one byte more
+ *              than the codewords. Once the averages have arrived the
+ *              whole picture can be drawn, as a thumbnail or with flat
+ *              blocks; the detail then sharpens it a block at a time.
+ *********************************************************************/
+
+#ifndef LAYERS_INCLUDED
+#define LAYERS_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Function: Layers_dc_size() / Layers_size()
+ * Job: return the bytes of the averages layer of a grid of blocks blocks,
+ *      and of both layers together.
+ */
+extern size_t Layers_dc_size(size_t blocks);
+extern size_t Layers_size(size_t blocks);
+
+/* Function: Layers_split()
+ * Job: write the blocks plain (format 2) codewords at grid as the two
+ *      layers, Layers_size(blocks) bytes at dest.
+ */
+extern void Layers_split(const uint8_t *grid, size_t blocks, uint8_t *dest);
+
+/* Function: Layers_join()
+ * Job: rebuild the blocks codewords at grid from the first avail bytes of
+ *      the layers at src, which must hold the averages layer whole.
+ *      Blocks whose detail is not among them get b = c = d = 0.
+ * Expected output: the number of leading blocks rebuilt in full.
+ */
+extern size_t Layers_join(const uint8_t *src, size_t avail, size_t blocks,
+                          uint8_t *grid);
+
+#endif
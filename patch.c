@@ -0,0 +1,338 @@
+/*********************************************************************
+ *                     patch.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for patching compressed
+ *              images. The file is mapped to read the old codewords and
+ *              written with pwrite(); the new image (and the old source)
+ *              is read a row pair at a time. When both sources are P6 of
+ *              the same shape, a row pair whose bytes match is passed
+ *              over without being parsed, so an edit costs little more
+ *              than a comparison of the two files plus the transform of
+ *              the blocks it touched.
+ *********************************************************************/
+
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "assert.h"
+#include "patch.h"
+#include "codec.h"
+#include "codeword.h"
+#include "ppmmem.h"
+
+/* changed codewords at most this many blocks apart are written with one
+ * pwrite(), along with the unchanged ones between them */
+#define GAP 16
+
+/* a PPM image being read one row at a time */
+typedef struct Source {
+    Ppmmem_header header;
+    const uint8_t *src;
+    size_t n, pos;
+    struct Pnm_rgb *top, *bottom;
+} Source;
+
+static Arith_status openSource(Source *source, const uint8_t *src,
+                               size_t n);
+static Arith_status nextRows(Source *source, int skip);
+static int sameRows(const Source *now, const Source *then);
+static void markRects(const Arith_region *rects, unsigned count, unsigned r,
+                      unsigned across, uint8_t *mark);
+static Arith_status writeRuns(int fd, off_t offset, const uint8_t *row,
+                              const uint8_t *mark, unsigned across,
+                              uint64_t *writes);
+static Arith_status writeAll(int fd, const void *buf, size_t len,
+                             off_t offset);
+
+
+/*  Name: Patch_file
+ *  Purpose: This function re-encodes the blocks of an image that may have
+ *           changed and writes the codewords that did over the old ones.
+ *  Input: the path of the compressed image, the new PPM image and its
+ *         length, the dirty rectangles and their count, the old PPM image
+ *         and its length, and a location for the stats
+ *  Output: ARITH_OK, or the reason the file could not be patched
+ *  Error condition: ARITH_EINVAL if a required pointer is NULL or the
+ *                   sizes differ.
+ */
+Arith_status Patch_file(const char *path, const uint8_t *ppm, size_t n,
+                        const Arith_region *rects, unsigned count,
+                        const uint8_t *old, size_t old_n, Patch_stats *stats)
+{
+    if (path == NULL || ppm == NULL || (rects == NULL && count > 0)) {
+        return ARITH_EINVAL;
+    }
+    Source now = { .top = NULL }, then = { .top = NULL };
+    Arith_status status = openSource(&now, ppm, n);
+    if (status == ARITH_OK && old != NULL) {
+        status = openSource(&then, old, old_n);
+    }
+    unsigned width = now.header.width & ~1u;
+    unsigned height = now.header.height & ~1u;
+    if (status == ARITH_OK && old != NULL &&
+        ((then.header.width & ~1u) != width ||
+         (then.header.height & ~1u) != height)) {
+        status = ARITH_EINVAL;
+    }
+
+    int fd = -1;
+    struct stat st;
+    uint8_t *map = MAP_FAILED;
+    if (status == ARITH_OK) {
+        fd = open(path, O_RDWR);
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+            status = ARITH_EIO;
+        } else {
+            map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            status = map == MAP_FAILED ? ARITH_EIO : ARITH_OK;
+        }
+    }
+    unsigned file_width, file_height;
+    size_t hlen = 0;
+    if (status == ARITH_OK) {
+        /* format 2 only: elsewhere a codeword's bytes depend on others */
+        status = Codeword_header_parse(map, st.st_size, &file_width,
+                                       &file_height, NULL, &hlen);
+    }
+    if (status == ARITH_OK &&
+        (size_t)st.st_size - hlen < Codeword_image_size(file_width,
+                                                        file_height)) {
+        status = ARITH_ETRUNCATED;
+    } else if (status == ARITH_OK &&
+               (file_width != width || file_height != height)) {
+        status = ARITH_EINVAL;
+    }
+
+    unsigned across = width / 2;
+    size_t row_bytes = (size_t)across * CODEWORD_BYTES;
+    uint8_t *mark = NULL, *patch = NULL;
+    if (status == ARITH_OK) {
+        mark = malloc(across);
+        patch = malloc(row_bytes);
+        status = mark == NULL || patch == NULL ? ARITH_ENOMEM : ARITH_OK;
+    }
+
+    Patch_stats done = { (uint64_t)across * (height / 2), 0, 0, 0 };
+    Block_memo memo;
+    initBlockMemo(&memo, now.header.denominator);
+    int compare = old != NULL &&
+                  then.header.denominator == now.header.denominator;
+    for (unsigned r = 0; r < height / 2 && status == ARITH_OK; r++) {
+        memset(mark, rects == NULL, across);
+        if (rects != NULL) {
+            markRects(rects, count, r, across, mark);
+        }
+        int skip = memchr(mark, 1, across) == NULL ||
+                   (compare && sameRows(&now, &then));
+        status = nextRows(&now, skip);
+        if (status == ARITH_OK && old != NULL) {
+            status = nextRows(&then, skip);
+        }
+        if (status != ARITH_OK || skip) {
+            continue;
+        }
+
+        const uint8_t *was = map + hlen + r * row_bytes;
+        memcpy(patch, was, row_bytes);
+        int dirty = 0;
+        for (unsigned c = 0; c < across; c++) {
+            size_t pair = 2 * sizeof(struct Pnm_rgb);
+            if (!mark[c] ||
+                (compare &&
+                 memcmp(now.top + 2 * c, then.top + 2 * c, pair) == 0 &&
+                 memcmp(now.bottom + 2 * c, then.bottom + 2 * c,
+                        pair) == 0)) {
+                mark[c] = 0;
+                continue;
+            }
+            uint8_t *cw = patch + (size_t)c * CODEWORD_BYTES;
+            encodeBlockRow(now.top + 2 * c, now.bottom + 2 * c, 1,
+                           now.header.denominator, &memo, cw);
+            done.encoded++;
+            mark[c] = memcmp(cw, was + (size_t)c * CODEWORD_BYTES,
+                             CODEWORD_BYTES) != 0;
+            done.changed += mark[c];
+            dirty |= mark[c];
+        }
+        if (dirty) {
+            status = writeRuns(fd, hlen + r * row_bytes, patch, mark,
+                               across, &done.writes);
+        }
+    }
+
+    reportBlockMemo(&memo);
+    if (map != MAP_FAILED) {
+        munmap(map, st.st_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(mark);
+    free(patch);
+    free(now.top);
+    free(then.top);
+    if (status == ARITH_OK && stats != NULL) {
+        *stats = done;
+    }
+    return status;
+}
+
+/*  Name: openSource
+ *  Purpose: This function parses the header of a PPM image and allocates
+ *           its two rows (one block allocation).
+ *  Output: ARITH_OK, ARITH_ETOOSMALL, ARITH_ENOMEM or a header error
+ */
+static Arith_status openSource(Source *source, const uint8_t *src,
+                               size_t n)
+{
+    Arith_status status = Ppmmem_parse_header(src, n, &source -> header);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    if (source -> header.width < 2 || source -> header.height < 2) {
+        return ARITH_ETOOSMALL;
+    }
+    status = Ppmmem_check_size(&source -> header, n);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    source -> src = src;
+    source -> n = n;
+    source -> pos = source -> header.len;
+    source -> top = malloc(2 * source -> header.width *
+                           sizeof(struct Pnm_rgb));
+    source -> bottom = source -> top + source -> header.width;
+    return source -> top == NULL ? ARITH_ENOMEM : ARITH_OK;
+}
+
+/*  Name: nextRows
+ *  Purpose: This function reads the next two rows of an image, or passes
+ *           over them when they are not needed; the rows of a P3 image
+ *           must be parsed to be passed over.
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ */
+static Arith_status nextRows(Source *source, int skip)
+{
+    const Ppmmem_header *header = &source -> header;
+    if (skip && header -> raw) {
+        size_t bytes = 2 * Ppmmem_row_bytes(header -> width,
+                                            header -> denominator);
+        if (source -> n - source -> pos < bytes) {
+            return ARITH_ETRUNCATED;
+        }
+        source -> pos += bytes;
+        return ARITH_OK;
+    }
+    Arith_status status = Ppmmem_read_row(header, source -> src,
+                                          source -> n, &source -> pos,
+                                          source -> top);
+    if (status == ARITH_OK) {
+        status = Ppmmem_read_row(header, source -> src, source -> n,
+                                 &source -> pos, source -> bottom);
+    }
+    return status;
+}
+
+/*  Name: sameRows
+ *  Purpose: This function compares the bytes of the next two rows of two
+ *           P6 images of the same shape.
+ *  Output: 1 if they are equal, 0 if not or if the images cannot be
+ *          compared this way
+ */
+static int sameRows(const Source *now, const Source *then)
+{
+    const Ppmmem_header *a = &now -> header, *b = &then -> header;
+    if (!a -> raw || !b -> raw || a -> width != b -> width ||
+        a -> denominator != b -> denominator) {
+        return 0;
+    }
+    size_t bytes = 2 * Ppmmem_row_bytes(a -> width, a -> denominator);
+    return now -> n - now -> pos >= bytes &&
+           then -> n - then -> pos >= bytes &&
+           memcmp(now -> src + now -> pos, then -> src + then -> pos,
+                  bytes) == 0;
+}
+
+/*  Name: markRects
+ *  Purpose: This function marks the blocks of row r that the rectangles
+ *           touch, clipped to the row.
+ */
+static void markRects(const Arith_region *rects, unsigned count, unsigned r,
+                      unsigned across, uint8_t *mark)
+{
+    for (unsigned k = 0; k < count; k++) {
+        const Arith_region *rect = &rects[k];
+        if (rect -> width == 0 || rect -> height == 0 ||
+            r < rect -> y / 2 ||
+            r > (rect -> y + (uint64_t)rect -> height - 1) / 2) {
+            continue;
+        }
+        uint64_t last = (rect -> x + (uint64_t)rect -> width - 1) / 2;
+        for (uint64_t c = rect -> x / 2; c <= last && c < across; c++) {
+            mark[c] = 1;
+        }
+    }
+}
+
+/*  Name: writeRuns
+ *  Purpose: This function writes the marked codewords of a row, joining
+ *           those less than GAP blocks apart into one write.
+ *  Input: the file, the offset of the row, its codewords, the marks, the
+ *         number of blocks and the count of writes to add to
+ *  Output: ARITH_OK or ARITH_EIO
+ */
+static Arith_status writeRuns(int fd, off_t offset, const uint8_t *row,
+                              const uint8_t *mark, unsigned across,
+                              uint64_t *writes)
+{
+    unsigned c = 0;
+    while (c < across) {
+        if (!mark[c]) {
+            c++;
+            continue;
+        }
+        unsigned last = c;
+        for (unsigned k = c + 1; k < across && k - last <= GAP; k++) {
+            if (mark[k]) {
+                last = k;
+            }
+        }
+        size_t at = (size_t)c * CODEWORD_BYTES;
+        Arith_status status = writeAll(fd, row + at,
+                                       (size_t)(last + 1 - c) *
+                                       CODEWORD_BYTES, offset + at);
+        if (status != ARITH_OK) {
+            return status;
+        }
+        (*writes)++;
+        c = last + 1;
+    }
+    return ARITH_OK;
+}
+
+/*  Name: writeAll
+ *  Purpose: This function writes len bytes at offset, however many calls
+ *           to pwrite() that takes.
+ *  Output: ARITH_OK or ARITH_EIO
+ */
+static Arith_status writeAll(int fd, const void *buf, size_t len,
+                             off_t offset)
+{
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t written = pwrite(fd, p, len, offset);
+        if (written <= 0) {
+            return ARITH_EIO;
+        }
+        p += written;
+        len -= written;
+        offset += written;
+    }
+    return ARITH_OK;
+}
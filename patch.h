@@ -0,0 +1,48 @@
+/*********************************************************************
+ *                     patch.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for re-encoding the parts of an
+ *              image that were edited. Every codeword of format 2 lies at
+ *              a fixed offset, so when the pixels of a few blocks change
+ *              the compressed file can be brought up to date by writing
+ *              just their codewords over the old ones. The blocks looked
+ *              at are those inside a list of dirty rectangles (all when
+ *              there is no list), less those whose pixels are the same
+ *              in the old source (when it is given); only the codewords
+ *              that come out different are written.
+ *********************************************************************/
+
+#ifndef PATCH_INCLUDED
+#define PATCH_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arith.h"
+
+/* what one patch did */
+typedef struct Patch_stats {
+    uint64_t blocks;        /* blocks in the image */
+    uint64_t encoded;       /* blocks whose codeword was recomputed */
+    uint64_t changed;       /* codewords that came out different */
+    uint64_t writes;        /* pwrite() calls */
+} Patch_stats;
+
+/* Function: Patch_file()
+ * Job: bring the format 2 image in the file at path up to date with the
+ *      PPM image ppm[0..n), which must trim to the same size, by writing
+ *      the codewords of the blocks that changed in place. rects (count of
+ *      them, may be NULL) are the dirty rectangles; old[0..old_n) (may be
+ *      NULL) is the PPM image the file was made from. stats may be NULL.
+ * Expected output: ARITH_OK; ARITH_EINVAL if a pointer is NULL or the
+ *      images differ in size; ARITH_EBADFORMAT if the file is in another
+ *      format; ARITH_EIO, after which the file may hold some of the new
+ *      codewords.
+ */
+extern Arith_status Patch_file(const char *path, const uint8_t *ppm,
+                               size_t n, const Arith_region *rects,
+                               unsigned count, const uint8_t *old,
+                               size_t old_n, Patch_stats *stats);
+
+#endif
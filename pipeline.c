@@ -0,0 +1,502 @@
+/*********************************************************************
+ *                     pipeline.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the pipelined codec. The
+ *              calling thread reads the header, writes the output header
+ *              and then acts as the reader; a transform thread turns each
+ *              batch of row pairs into output bytes with encodeBlockRow()
+ *              or decodeBlockRow(), and a writer thread writes them out.
+ *              The three are joined by two lock-free rings (ring.h):
+ *
+ *                  reader --raw--> transform --coded--> writer
+ *
+ *              A stage that fails records the first error and closes
+ *              its rings, which makes the stages on either side stop.
+ *********************************************************************/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "pipeline.h"
+#include "codec.h"
+#include "codeword.h"
+#include "ppmmem.h"
+#include "predict.h"
+#include "ring.h"
+#include "stats.h"
+
+/* slots per ring, and the size a batch aims for */
+#define RING_SLOTS 8
+#define BATCH_BYTES (256 * 1024)
+
+/* the first read; a header that does not fit is handled without the
+ * pipeline */
+#define PREFIX_SIZE 4096
+
+/* denominator of decompressed images, as in readHeader() */
+#define DENOMINATOR 255
+
+struct Pipeline;
+typedef Arith_status Transform(struct Pipeline *pipe, const uint8_t *src,
+                               unsigned pairs, uint8_t *dest);
+
+typedef struct Pipeline {
+    FILE *in, *out;
+    Ring_T raw, coded;
+    Transform *transform;
+
+    uint8_t prefix[PREFIX_SIZE];        /* first bytes of in */
+    size_t prefix_len, prefix_pos;      /* prefix[pos..len) not yet used */
+
+    Ppmmem_header header;       /* of the input image when compressing */
+    unsigned width;             /* pixels per scanline of top and bottom */
+    unsigned blocks;            /* codewords per row of blocks */
+    size_t in_unit, out_unit;   /* bytes of one row pair, in and out */
+    unsigned pairs;             /* row pairs per batch */
+    struct Pnm_rgb *top, *bottom;       /* the transform thread's rows */
+    uint8_t *restored;          /* format 4: the last two rows of blocks
+                                 * restored by the transform thread */
+    unsigned decoded;           /* rows of blocks decoded so far */
+    Block_memo memo;            /* the transform thread's, encoding */
+
+    int status;                 /* first error, ARITH_OK otherwise */
+} Pipeline;
+
+static Arith_status readPrefix(Pipeline *pipe);
+static Arith_status whole(Pipeline *pipe, Arith_codec *codec);
+static Arith_status run(Pipeline *pipe, const uint8_t *header, size_t hlen,
+                        unsigned npairs);
+static void readBatches(Pipeline *pipe, unsigned npairs);
+static void skipOddRow(Pipeline *pipe);
+static size_t readInput(Pipeline *pipe, uint8_t *dest, size_t n);
+static void *transformer(void *cl);
+static void *writer(void *cl);
+static Transform encodeBatch;
+static Transform decodeBatch;
+static void fail(Pipeline *pipe, Arith_status status);
+static Arith_status getStatus(Pipeline *pipe);
+
+
+/*  Name: Pipeline_compress
+ *  Purpose: This function compresses a binary PPM image from in to out,
+ *           one batch of row pairs at a time.
+ *  Input: the input and output streams
+ *  Output: ARITH_OK, or the reason the image could not be compressed
+ *  Error condition: ARITH_EINVAL if a stream is NULL.
+ */
+Arith_status Pipeline_compress(FILE *in, FILE *out)
+{
+    if (in == NULL || out == NULL) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Pipeline *pipe = calloc(1, sizeof(*pipe));
+    if (pipe == NULL) {
+        return ARITH_ENOMEM;
+    }
+    pipe -> in = in;
+    pipe -> out = out;
+
+    Arith_status status = readPrefix(pipe);
+    if (status == ARITH_OK) {
+        status = Ppmmem_parse_header(pipe -> prefix, pipe -> prefix_len,
+                                     &pipe -> header);
+    }
+    Ppmmem_header *header = &pipe -> header;
+    if ((status == ARITH_ETRUNCATED && pipe -> prefix_len == PREFIX_SIZE) ||
+        (status == ARITH_OK && !header -> raw)) {
+        status = whole(pipe, Arith_compress);
+    } else if (status == ARITH_OK &&
+               (header -> width < 2 || header -> height < 2)) {
+        status = ARITH_ETOOSMALL;
+    } else if (status == ARITH_OK) {
+        unsigned width = header -> width & ~1u;
+        unsigned height = header -> height & ~1u;
+        uint8_t head[CODEWORD_HEADER_MAX];
+        size_t hlen = Codeword_header_write(head, width, height,
+                                            CODEWORD_PLAIN);
+
+        pipe -> transform = encodeBatch;
+        pipe -> prefix_pos = header -> len;
+        pipe -> width = header -> width;
+        pipe -> blocks = width / 2;
+        pipe -> in_unit = 2 * Ppmmem_row_bytes(header -> width,
+                                               header -> denominator);
+        pipe -> out_unit = pipe -> blocks * CODEWORD_BYTES;
+        status = run(pipe, head, hlen, height / 2);
+        if (status == ARITH_OK && header -> height % 2 != 0) {
+            skipOddRow(pipe);
+            status = getStatus(pipe);
+        }
+    }
+    free(pipe);
+    return status;
+}
+
+/*  Name: Pipeline_decompress
+ *  Purpose: This function decompresses a compressed image from in to a P6
+ *           image on out, one batch of rows of blocks at a time.
+ *  Input: the input and output streams
+ *  Output: ARITH_OK, or the reason the image could not be decompressed
+ *  Error condition: ARITH_EINVAL if a stream is NULL.
+ */
+Arith_status Pipeline_decompress(FILE *in, FILE *out)
+{
+    if (in == NULL || out == NULL) {
+        return ARITH_EINVAL;
+    }
+    Stats_init();
+    Pipeline *pipe = calloc(1, sizeof(*pipe));
+    if (pipe == NULL) {
+        return ARITH_ENOMEM;
+    }
+    pipe -> in = in;
+    pipe -> out = out;
+
+    unsigned width, height;
+    int layout = CODEWORD_PLAIN;
+    Arith_status status = readPrefix(pipe);
+    if (status == ARITH_OK) {
+        status = Codeword_header_parse(pipe -> prefix, pipe -> prefix_len,
+                                       &width, &height, &layout,
+                                       &pipe -> prefix_pos);
+    }
+    /* neither the tiles of format 3 nor the layers of format 5 are in
+     * scanline order */
+    size_t magic_len = strlen(CODEWORD_TILED_MAGIC);
+    if ((status == ARITH_EBADFORMAT && pipe -> prefix_len >= magic_len &&
+         memcmp(pipe -> prefix, CODEWORD_TILED_MAGIC, magic_len) == 0) ||
+        (status == ARITH_OK && layout == CODEWORD_PROGRESSIVE)) {
+        status = whole(pipe, Arith_decompress);
+    } else if (status == ARITH_OK) {
+        uint8_t head[PPMMEM_HEADER_MAX];
+        size_t hlen = Ppmmem_header_write(head, width, height, DENOMINATOR);
+
+        pipe -> transform = decodeBatch;
+        pipe -> width = width;
+        pipe -> blocks = width / 2;
+        pipe -> in_unit = pipe -> blocks * CODEWORD_BYTES;
+        pipe -> out_unit = 2 * Ppmmem_row_bytes(width, DENOMINATOR);
+        int predicted = layout == CODEWORD_PREDICTED;
+        if (predicted) {
+            pipe -> restored = malloc(2 * pipe -> in_unit);
+        }
+        status = predicted && pipe -> restored == NULL
+                 ? ARITH_ENOMEM : run(pipe, head, hlen, height / 2);
+        free(pipe -> restored);
+    }
+    free(pipe);
+    return status;
+}
+
+/*  Name: readPrefix
+ *  Purpose: This function reads the first PREFIX_SIZE bytes of the input,
+ *           or all of it if it is shorter; the header must be in there.
+ *  Output: ARITH_OK or ARITH_EIO
+ */
+static Arith_status readPrefix(Pipeline *pipe)
+{
+    pipe -> prefix_len = fread(pipe -> prefix, 1, PREFIX_SIZE, pipe -> in);
+    Stats_io(pipe -> prefix_len, 0);
+    return ferror(pipe -> in) ? ARITH_EIO : ARITH_OK;
+}
+
+/*  Name: whole
+ *  Purpose: This function codes the input without the pipeline: the prefix
+ *           and the rest of the stream are joined in memory and handed to
+ *           the library.
+ *  Input: the pipeline and the library function
+ *  Output: the status of the codec, or ARITH_EIO if writing fails
+ */
+static Arith_status whole(Pipeline *pipe, Arith_codec *codec)
+{
+    uint8_t *rest, *out;
+    size_t n, outlen;
+    Arith_status status = Arith_read_stream(pipe -> in, &rest, &n);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    uint8_t *src = malloc(pipe -> prefix_len + n);
+    if (src == NULL) {
+        free(rest);
+        return ARITH_ENOMEM;
+    }
+    memcpy(src, pipe -> prefix, pipe -> prefix_len);
+    memcpy(src + pipe -> prefix_len, rest, n);
+    free(rest);
+
+    status = codec(src, pipe -> prefix_len + n, &out, &outlen, NULL);
+    free(src);
+    if (status == ARITH_OK) {
+        if (fwrite(out, 1, outlen, pipe -> out) != outlen ||
+            fflush(pipe -> out) != 0) {
+            status = ARITH_EIO;
+        }
+        Stats_io(0, outlen);
+        free(out);
+    }
+    return status;
+}
+
+/*  Name: run
+ *  Purpose: This function writes the output header, starts the transform
+ *           and writer threads, reads npairs row pairs into the raw ring
+ *           and waits for the other two stages to drain.
+ *  Input: the pipeline with its units and transform set, the output header
+ *         and the number of row pairs to read
+ *  Output: ARITH_OK or the first error of any stage
+ */
+static Arith_status run(Pipeline *pipe, const uint8_t *header, size_t hlen,
+                        unsigned npairs)
+{
+    size_t unit = pipe -> in_unit > pipe -> out_unit ? pipe -> in_unit
+                                                     : pipe -> out_unit;
+    pipe -> pairs = BATCH_BYTES / unit > 0 ? BATCH_BYTES / unit : 1;
+    pipe -> raw = Ring_new(RING_SLOTS, pipe -> pairs * pipe -> in_unit);
+    pipe -> coded = Ring_new(RING_SLOTS, pipe -> pairs * pipe -> out_unit);
+    pipe -> top = malloc(pipe -> width * sizeof(struct Pnm_rgb));
+    pipe -> bottom = malloc(pipe -> width * sizeof(struct Pnm_rgb));
+    pipe -> status = ARITH_OK;
+
+    pthread_t transform_tid, writer_tid;
+    if (pipe -> raw == NULL || pipe -> coded == NULL ||
+        pipe -> top == NULL || pipe -> bottom == NULL) {
+        fail(pipe, ARITH_ENOMEM);
+    } else if (fwrite(header, 1, hlen, pipe -> out) != hlen) {
+        fail(pipe, ARITH_EIO);
+    } else {
+        Stats_io(0, hlen);
+        int err = pthread_create(&transform_tid, NULL, transformer, pipe);
+        assert(err == 0);
+        err = pthread_create(&writer_tid, NULL, writer, pipe);
+        assert(err == 0);
+
+        readBatches(pipe, npairs);
+        Ring_close(pipe -> raw);
+        pthread_join(transform_tid, NULL);
+        pthread_join(writer_tid, NULL);
+        if (fflush(pipe -> out) != 0) {
+            fail(pipe, ARITH_EIO);
+        }
+    }
+
+    if (pipe -> raw != NULL) {
+        Ring_free(&pipe -> raw);
+    }
+    if (pipe -> coded != NULL) {
+        Ring_free(&pipe -> coded);
+    }
+    free(pipe -> top);
+    free(pipe -> bottom);
+    return pipe -> status;
+}
+
+/*  Name: readBatches
+ *  Purpose: This function is the reader stage: it fills raw slots with up
+ *           to pipe->pairs row pairs each until npairs have been read, the
+ *           input ends early, or a later stage closes the ring.
+ *  Output: N/A; a short input is recorded as ARITH_ETRUNCATED.
+ */
+static void readBatches(Pipeline *pipe, unsigned npairs)
+{
+    while (npairs > 0) {
+        uint8_t *slot = Ring_reserve(pipe -> raw);
+        if (slot == NULL) {
+            return;
+        }
+        unsigned pairs = npairs < pipe -> pairs ? npairs : pipe -> pairs;
+        size_t want = pairs * pipe -> in_unit;
+        size_t got = readInput(pipe, slot, want);
+        if (got != want) {
+            fail(pipe, ferror(pipe -> in) ? ARITH_EIO : ARITH_ETRUNCATED);
+            return;
+        }
+        Ring_publish(pipe -> raw, want);
+        npairs -= pairs;
+    }
+}
+
+/*  Name: skipOddRow
+ *  Purpose: This function reads the last row of an image of odd height,
+ *           which trimming drops, so that a truncated or bad row is still
+ *           reported as Arith_compress() would.
+ *  Output: N/A; problems are recorded with fail().
+ */
+static void skipOddRow(Pipeline *pipe)
+{
+    size_t bytes = pipe -> in_unit / 2, pos = 0;
+    uint8_t *src = malloc(bytes);
+    struct Pnm_rgb *row = malloc(pipe -> width * sizeof(struct Pnm_rgb));
+    if (src == NULL || row == NULL) {
+        fail(pipe, ARITH_ENOMEM);
+    } else if (readInput(pipe, src, bytes) != bytes) {
+        fail(pipe, ferror(pipe -> in) ? ARITH_EIO : ARITH_ETRUNCATED);
+    } else {
+        fail(pipe, Ppmmem_read_row(&pipe -> header, src, bytes, &pos, row));
+    }
+    free(src);
+    free(row);
+}
+
+/*  Name: readInput
+ *  Purpose: This function reads n bytes of input, taking what is left of
+ *           the prefix first.
+ *  Output: the number of bytes read, less than n at end of file or error
+ */
+static size_t readInput(Pipeline *pipe, uint8_t *dest, size_t n)
+{
+    size_t left = pipe -> prefix_len - pipe -> prefix_pos;
+    size_t take = left < n ? left : n;
+    memcpy(dest, pipe -> prefix + pipe -> prefix_pos, take);
+    pipe -> prefix_pos += take;
+    if (take == n) {
+        return n;
+    }
+    size_t got = fread(dest + take, 1, n - take, pipe -> in);
+    Stats_io(got, 0);
+    return take + got;
+}
+
+/*  Name: transformer
+ *  Purpose: This function is the body of the transform thread: it turns
+ *           every raw slot into a coded slot until the raw ring is drained.
+ *           On the way out it closes both rings, so that the reader stops
+ *           if the transform failed and the writer knows to finish.
+ *  Input: the Pipeline
+ *  Output: NULL
+ */
+static void *transformer(void *cl)
+{
+    Pipeline *pipe = cl;
+    uint8_t *src;
+    size_t len;
+
+    while ((src = Ring_peek(pipe -> raw, &len)) != NULL) {
+        uint8_t *dest = Ring_reserve(pipe -> coded);
+        if (dest == NULL) {
+            break;
+        }
+        unsigned pairs = len / pipe -> in_unit;
+        Stats_clock clock = Stats_start();
+        Arith_status status = pipe -> transform(pipe, src, pairs, dest);
+        Stats_lap(STATS_ROWS, clock);
+        Ring_release(pipe -> raw);
+        if (status != ARITH_OK) {
+            fail(pipe, status);
+            break;
+        }
+        Ring_publish(pipe -> coded, pairs * pipe -> out_unit);
+    }
+    Ring_close(pipe -> raw);
+    Ring_close(pipe -> coded);
+    return NULL;
+}
+
+/*  Name: writer
+ *  Purpose: This function is the body of the writer thread: it writes every
+ *           coded slot to the output until the coded ring is drained.
+ *  Input: the Pipeline
+ *  Output: NULL
+ */
+static void *writer(void *cl)
+{
+    Pipeline *pipe = cl;
+    uint8_t *src;
+    size_t len;
+
+    while ((src = Ring_peek(pipe -> coded, &len)) != NULL) {
+        Stats_clock clock = Stats_start();
+        size_t written = fwrite(src, 1, len, pipe -> out);
+        Stats_lap(STATS_WRITE_OUTPUT, clock);
+        Stats_io(0, written);
+        Ring_release(pipe -> coded);
+        if (written != len) {
+            fail(pipe, ARITH_EIO);
+            break;
+        }
+    }
+    Ring_close(pipe -> coded);
+    return NULL;
+}
+
+/*  Name: encodeBatch
+ *  Purpose: This function parses pairs raw row pairs and encodes each into
+ *           a row of codewords.
+ *  Output: ARITH_OK, or ARITH_EBADFORMAT for a sample over the denominator
+ */
+static Arith_status encodeBatch(Pipeline *pipe, const uint8_t *src,
+                                unsigned pairs, uint8_t *dest)
+{
+    size_t n = pairs * pipe -> in_unit, pos = 0;
+    for (unsigned k = 0; k < pairs; k++) {
+        Arith_status status = Ppmmem_read_row(&pipe -> header, src, n, &pos,
+                                              pipe -> top);
+        if (status == ARITH_OK) {
+            status = Ppmmem_read_row(&pipe -> header, src, n, &pos,
+                                     pipe -> bottom);
+        }
+        if (status != ARITH_OK) {
+            return status;
+        }
+        encodeBlockRow(pipe -> top, pipe -> bottom, pipe -> blocks,
+                       pipe -> header.denominator, &pipe -> memo,
+                       dest + k * pipe -> out_unit);
+    }
+    reportBlockMemo(&pipe -> memo);
+    return ARITH_OK;
+}
+
+/*  Name: decodeBatch
+ *  Purpose: This function decodes pairs rows of codewords into pairs of P6
+ *           scanlines. The rows of a format 4 image are restored first;
+ *           the row above the first of a batch is kept from the last.
+ *  Output: ARITH_OK
+ */
+static Arith_status decodeBatch(Pipeline *pipe, const uint8_t *src,
+                                unsigned pairs, uint8_t *dest)
+{
+    size_t unit = pipe -> in_unit;
+    for (unsigned k = 0; k < pairs; k++, pipe -> decoded++) {
+        uint8_t *d = dest + k * pipe -> out_unit;
+        const uint8_t *codewords = src + k * unit;
+        if (pipe -> restored != NULL) {
+            uint8_t *row = pipe -> restored + pipe -> decoded % 2 * unit;
+            const uint8_t *above = pipe -> restored +
+                                   (pipe -> decoded + 1) % 2 * unit;
+            memcpy(row, codewords, unit);
+            Predict_decode_row(row, pipe -> decoded > 0 ? above : NULL,
+                               pipe -> blocks);
+            codewords = row;
+        }
+        decodeBlockRow(codewords, pipe -> blocks, DENOMINATOR, pipe -> top,
+                       pipe -> bottom);
+        d += Ppmmem_write_row(pipe -> top, pipe -> width, DENOMINATOR, d);
+        Ppmmem_write_row(pipe -> bottom, pipe -> width, DENOMINATOR, d);
+    }
+    return ARITH_OK;
+}
+
+/*  Name: fail
+ *  Purpose: This function records status unless an earlier error was
+ *           recorded; any stage may call it. ARITH_OK is ignored.
+ */
+static void fail(Pipeline *pipe, Arith_status status)
+{
+    int expected = ARITH_OK;
+    if (status != ARITH_OK) {
+        __atomic_compare_exchange_n(&pipe -> status, &expected, status, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+}
+
+/*  Name: getStatus
+ *  Purpose: This function returns the first recorded error, or ARITH_OK.
+ */
+static Arith_status getStatus(Pipeline *pipe)
+{
+    return __atomic_load_n(&pipe -> status, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,38 @@
+/*********************************************************************
+ *                     pipeline.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for pipelined compression and
+ *              decompression between two streams. A reader, a transform
+ *              and a writer thread work on successive batches of row
+ *              pairs at the same time, so reading and writing overlap
+ *              the colour space and DCT arithmetic instead of bracketing
+ *              it. The output is byte-for-byte that of Arith_compress()
+ *              and Arith_decompress().
+ *
+ *              Because output starts before all the input is in, an
+ *              input that turns out to be bad part way through leaves a
+ *              partial image on out; the status still reports it.
+ *********************************************************************/
+
+#ifndef PIPELINE_INCLUDED
+#define PIPELINE_INCLUDED
+
+#include <stdio.h>
+#include "arith.h"
+
+/* Function: Pipeline_compress()
+ * Job: compress the PPM image on in to out. Plain (P3) images, whose rows
+ *      have no fixed size, are read whole and compressed as usual.
+ * Expected output: ARITH_OK, or the same statuses as Arith_compress().
+ */
+extern Arith_status Pipeline_compress(FILE *in, FILE *out);
+
+/* Function: Pipeline_decompress()
+ * Job: decompress the compressed image on in to a P6 image on out.
+ * Expected output: ARITH_OK, or the same statuses as Arith_decompress().
+ */
+extern Arith_status Pipeline_decompress(FILE *in, FILE *out);
+
+#endif
@@ -4,54 +4,146 @@
 #include <assert.h>
 #include <math.h>
 #include <string.h>
-#include "pnm.h"
-#include "a2methods.h"
-#include "a2plain.h"
+#include <pthread.h>
+#include <unistd.h>
+#include "ppmstream.h"
+#include "ring.h"
 
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
 
-FILE** checkArgs(int argc, char *argv[]);
-void checkDimension(Pnm_ppm* image);
-double Calc_difference(A2Methods_T methods, Pnm_ppm* image);
+/* a band holds about this many rows; it is a whole number of tiles and
+ * of SSIM windows, so no tile or window is split between workers */
+#define TARGET_ROWS 64
+#define RING_SLOTS 4
+#define MAX_THREADS 16
+#define WINDOW 8
+#define DEFAULT_TILE 16
+
+/* four 64-bit lanes; samples are widened into these before subtracting,
+ * so the squares are exact for any denominator */
+typedef int64_t  v4di __attribute__ ((vector_size (32)));
+typedef uint16_t v4hu __attribute__ ((vector_size (8)));
+/* one row of an SSIM window */
+typedef float    v8sf __attribute__ ((vector_size (32)));
+
+/* what a band contributes to the totals. The squared errors are integers
+ * and each band's SSIM is summed in a fixed order, so the totals do not
+ * depend on how the bands were split between threads */
+typedef struct Sums {
+    uint64_t channel[3];
+    double ssim;
+    unsigned windows;
+} Sums;
+
+/* command line options that come before the two images */
+typedef struct Options {
+    bool metrics;           /* print every metric, not just the RMSE */
+    const char *heatmap;    /* PGM of the per-tile error, or NULL */
+    unsigned tile;
+} Options;
+
+typedef struct Report {
+    double rmse, psnr, ssim;
+    double channel[3];
+} Report;
+
+/* what the reader shares with the workers; band b goes to worker
+ * b % nworkers through that worker's ring */
+typedef struct Shared {
+    unsigned width[2];
+    unsigned denominator[2];
+    unsigned cols;
+    unsigned band_rows;
+    unsigned tile, tiles_across;
+    unsigned nworkers;
+    Ring_T *rings;
+    Sums *bands;
+    uint64_t *tiles;        /* squared error of each tile, row-major */
+} Shared;
+
+typedef struct Worker {
+    Shared *shared;
+    unsigned id;
+    float *luma[2];         /* current row of each image, zero padded */
+    float *moments;         /* sum x, y, xx, yy, xy for each window */
+} Worker;
+
+FILE** checkArgs(int argc, char *argv[], Options *options);
+Ppmstream_T openImage(FILE *fp, int i);
+void checkDimension(Ppmstream_T* image);
+double Calc_difference(Ppmstream_T* image, Options *options,
+                       Report *report);
+void printReport(Report *report);
+void writeHeatmap(const char *path, Shared *shared, unsigned tiles_down,
+                  int width, int height, int deno);
+unsigned countThreads(unsigned nbands);
+unsigned gcd(unsigned a, unsigned b);
+void readBand(Ppmstream_T image, uint16_t *samples, unsigned rows, int i);
+void *compareBands(void *cl);
+void compareBand(Worker *worker, unsigned band, const uint16_t *a,
+                 const uint16_t *b, unsigned rows);
+void squaredError(const uint16_t *a, const uint16_t *b, size_t n,
+                  uint64_t channel[3]);
+void toLuma(const uint16_t *samples, unsigned cols, unsigned deno,
+            float *luma);
+void addMoments(Worker *worker);
+void finishWindows(Worker *worker, unsigned rows, Sums *sums);
 
 int main(int argc, char *argv[]) {
-    FILE** files = checkArgs(argc, argv);
+    Options options;
+    FILE** files = checkArgs(argc, argv, &options);
     assert(files[0] != NULL && files[1] != NULL);
 
-    /* default to UArray2 methods */
-    A2Methods_T methods = uarray2_methods_plain; 
-    assert(methods);
-    (void) methods;
-    /* default to best map */
-    A2Methods_mapfun *map = methods->map_default; 
-    assert(map);
-    (void) map;
-    Pnm_ppm image[] = { Pnm_ppmread(files[0], methods), 
-                        Pnm_ppmread(files[1], methods) };
+    Ppmstream_T image[] = { openImage(files[0], 0),
+                            openImage(files[1], 1) };
     checkDimension(image);
-    double diff = Calc_difference(methods, image);
-    
-    
-    
-    Pnm_ppmfree(&(image[0]));
-    Pnm_ppmfree(&(image[1]));
-    
+    Report report;
+    double diff = Calc_difference(image, &options, &report);
+
+    Ppmstream_free(&(image[0]));
+    Ppmstream_free(&(image[1]));
+
     fclose(files[0]);
     fclose(files[1]);
     free(files);
-    
+
+    if (options.metrics) {
+        printReport(&report);
+        return 0;
+    }
+
     if (diff > 1){
         fprintf(stderr, "1.0\n");
         exit(EXIT_FAILURE);
     }
-    
+
     printf("%.4f\n", diff);
     return 0;
 }
 
-FILE** checkArgs(int argc, char *argv[])
+FILE** checkArgs(int argc, char *argv[], Options *options)
 {
     FILE **inputfp = malloc(2*sizeof(FILE *));
+    int i = 1;
+    options -> metrics = false;
+    options -> heatmap = NULL;
+    options -> tile = DEFAULT_TILE;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--metrics") == 0) {
+            options -> metrics = true;
+        } else if (strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+            options -> heatmap = argv[++i];
+        } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc &&
+                   atoi(argv[i + 1]) > 0) {
+            options -> tile = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "ERROR: Unknown option %s!\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    argc -= i - 1;
+    argv += i - 1;
     if (argc != 3) {
         fprintf(stderr, "ERROR: Need 2 Arguments!\n");
         exit(EXIT_FAILURE);
@@ -72,14 +164,28 @@ FILE** checkArgs(int argc, char *argv[])
         if (inputfp[i] == NULL || ferror(inputfp[i])) {
             fprintf(stderr, "ERROR: Failure to open file NO.%d!\n", i);
             exit(EXIT_FAILURE);
-        }    
+        }
     }
     return inputfp;
 }
 
-void checkDimension(Pnm_ppm* image){
-    int width[] = { image[0] -> width, image[1] -> width }; 
-    int height[] = { image[0] -> height, image[1] -> height };
+/* reads the header of image NO.i; only the header, the rows are streamed */
+Ppmstream_T openImage(FILE *fp, int i)
+{
+    Arith_status status;
+    Ppmstream_T image = Ppmstream_new(fp, &status);
+    if (image == NULL) {
+        fprintf(stderr, "ERROR: Failure to read file NO.%d!\n", i);
+        exit(EXIT_FAILURE);
+    }
+    return image;
+}
+
+void checkDimension(Ppmstream_T* image){
+    const Ppmmem_header *header[] = { Ppmstream_header(image[0]),
+                                      Ppmstream_header(image[1]) };
+    int width[] = { header[0] -> width, header[1] -> width };
+    int height[] = { header[0] -> height, header[1] -> height };
     if ( abs(width[0] - width[1]) > 1 ) {
         fprintf(stderr, "ERROR: Difference in width is more than 1!\n");
         exit(EXIT_FAILURE);
@@ -90,37 +196,342 @@ void checkDimension(Pnm_ppm* image){
     }
 }
 
-double Calc_difference(A2Methods_T methods, Pnm_ppm* image){
-    double sum = 0;
-    int width = MIN(image[0] -> width, image[1] -> width); 
-    int height = MIN(image[0] -> height, image[1] -> height);
-    int deno = MIN(image[0] -> denominator, image[1] -> denominator);
-    for (int i = 0; i < height; i++){
-        for (int j = 0; j < width; j++){
-            Pnm_rgb pixel0 = methods -> at(image[0]->pixels, j ,i);
-            Pnm_rgb pixel1 = methods -> at(image[1]->pixels, j ,i);
-            
-            
-            int red_diff = (int)pixel0 -> red - (int)pixel1->red;
-            int green_diff = (int)pixel0 -> green - (int)pixel1 -> green;
-            int blue_diff = (int)pixel0 -> blue - (int)pixel1 -> blue;
-            double red_diff_value = (double)red_diff/(double)deno;
-            double green_diff_value = (double)green_diff/(double)deno;
-            double blue_diff_value = (double)blue_diff/(double)deno;
-            
-            double squareOfdiff = red_diff_value*red_diff_value + green_diff_value*green_diff_value + blue_diff_value*blue_diff_value;
-
-            sum += squareOfdiff;
-
-    
+/*
+ * The calling thread reads both images a band of rows at a time and deals
+ * the bands round robin to the workers, which compute every metric for
+ * their bands in one pass; the per-band results are added up in band
+ * order at the end. Only the common rows are read: the last row of a
+ * taller image is never looked at.
+ */
+double Calc_difference(Ppmstream_T* image, Options *options,
+                       Report *report){
+    const Ppmmem_header *header[] = { Ppmstream_header(image[0]),
+                                      Ppmstream_header(image[1]) };
+    int width = MIN(header[0] -> width, header[1] -> width);
+    int height = MIN(header[0] -> height, header[1] -> height);
+    int deno = MIN(header[0] -> denominator, header[1] -> denominator);
+
+    Shared shared = { { header[0] -> width, header[1] -> width },
+                      { header[0] -> denominator,
+                        header[1] -> denominator },
+                      width, 0, options -> tile, 0, 0, NULL, NULL, NULL };
+    unsigned unit = WINDOW / gcd(WINDOW, shared.tile) * shared.tile;
+    shared.band_rows = unit * MAX(1, TARGET_ROWS / unit);
+    shared.tiles_across = (width + shared.tile - 1) / shared.tile;
+    unsigned tiles_down = (height + shared.tile - 1) / shared.tile;
+    unsigned nbands = width == 0 ? 0 : (height + shared.band_rows - 1) /
+                                       shared.band_rows;
+    unsigned nworkers = countThreads(nbands);
+    unsigned padded = (width + WINDOW - 1) / WINDOW * WINDOW;
+    shared.nworkers = nworkers;
+
+    size_t band_bytes = (size_t)shared.band_rows * 3 * sizeof(uint16_t) *
+                        (shared.width[0] + shared.width[1]);
+    shared.rings = malloc(nworkers * sizeof(Ring_T));
+    shared.bands = calloc(nbands + 1, sizeof(Sums));
+    shared.tiles = calloc((size_t)shared.tiles_across * tiles_down + 1,
+                          sizeof(uint64_t));
+    pthread_t *tids = malloc(nworkers * sizeof(pthread_t));
+    Worker *workers = malloc(nworkers * sizeof(Worker));
+    assert(shared.rings && shared.bands && shared.tiles && tids && workers);
+
+    for (unsigned w = 0; w < nworkers; w++) {
+        shared.rings[w] = Ring_new(RING_SLOTS,
+                                   band_bytes > 0 ? band_bytes : 1);
+        workers[w].shared = &shared;
+        workers[w].id = w;
+        workers[w].luma[0] = calloc(padded + 1, sizeof(float));
+        workers[w].luma[1] = calloc(padded + 1, sizeof(float));
+        workers[w].moments = calloc(5 * padded + 1, sizeof(float));
+        assert(shared.rings[w] && workers[w].luma[0] &&
+               workers[w].luma[1] && workers[w].moments);
+        int err = pthread_create(&tids[w], NULL, compareBands, &workers[w]);
+        assert(err == 0);
+    }
+
+    for (unsigned b = 0; b < nbands; b++) {
+        unsigned rows = MIN(shared.band_rows,
+                            height - b * shared.band_rows);
+        Ring_T ring = shared.rings[b % nworkers];
+        uint16_t *samples = (uint16_t *)Ring_reserve(ring);
+        assert(samples != NULL);
+        readBand(image[0], samples, rows, 0);
+        readBand(image[1], samples + (size_t)rows * 3 * shared.width[0],
+                 rows, 1);
+        Ring_publish(ring, (size_t)rows * 3 * sizeof(uint16_t) *
+                           (shared.width[0] + shared.width[1]));
+    }
+    for (unsigned w = 0; w < nworkers; w++) {
+        Ring_close(shared.rings[w]);
+    }
+    for (unsigned w = 0; w < nworkers; w++) {
+        pthread_join(tids[w], NULL);
+        Ring_free(&shared.rings[w]);
+        free(workers[w].luma[0]);
+        free(workers[w].luma[1]);
+        free(workers[w].moments);
+    }
+
+    Sums total = { { 0, 0, 0 }, 0, 0 };
+    for (unsigned b = 0; b < nbands; b++) {
+        for (int c = 0; c < 3; c++) {
+            total.channel[c] += shared.bands[b].channel[c];
         }
+        total.ssim += shared.bands[b].ssim;
+        total.windows += shared.bands[b].windows;
+    }
+    if (options -> heatmap != NULL) {
+        writeHeatmap(options -> heatmap, &shared, tiles_down, width, height,
+                     deno);
+    }
+    free(shared.rings);
+    free(shared.bands);
+    free(shared.tiles);
+    free(tids);
+    free(workers);
+
+    double scale = (double)deno * (double)deno * width * height;
+    for (int c = 0; c < 3; c++) {
+        report -> channel[c] = sqrt(total.channel[c] / scale);
     }
+    double sum = (double)(total.channel[0] + total.channel[1] +
+                          total.channel[2]) / ((double)deno * (double)deno);
 
     int dividor = 3 * width * height;
 
     double afterdivision = (double)sum / (double)dividor;
 
     double diff = sqrt(afterdivision);
+    report -> rmse = diff;
+    report -> psnr = afterdivision > 0 ? -10 * log10(afterdivision)
+                                       : INFINITY;
+    report -> ssim = total.ssim / total.windows;
     return diff;
 }
 
+void printReport(Report *report)
+{
+    printf("RMSE: %.4f\n", report -> rmse);
+    printf("RMSE (red green blue): %.4f %.4f %.4f\n", report -> channel[0],
+           report -> channel[1], report -> channel[2]);
+    printf("PSNR: %.2f dB\n", report -> psnr);
+    printf("SSIM (luma, %dx%d windows): %.4f\n", WINDOW, WINDOW,
+           report -> ssim);
+}
+
+/*
+ * Writes the RMSE of every tile as a P5 image, one pixel per tile, scaled
+ * so that the worst tile is white; the scale is given in a comment.
+ */
+void writeHeatmap(const char *path, Shared *shared, unsigned tiles_down,
+                  int width, int height, int deno)
+{
+    unsigned across = shared -> tiles_across, tile = shared -> tile;
+    double *rmse = malloc(((size_t)across * tiles_down + 1) *
+                          sizeof(double));
+    double worst = 0;
+    assert(rmse != NULL);
+    for (unsigned ty = 0; ty < tiles_down; ty++) {
+        for (unsigned tx = 0; tx < across; tx++) {
+            size_t i = (size_t)ty * across + tx;
+            double pixels = (double)MIN(tile, width - tx * tile) *
+                            MIN(tile, height - ty * tile);
+            rmse[i] = sqrt(shared -> tiles[i] /
+                           (3 * pixels * deno * deno));
+            worst = MAX(worst, rmse[i]);
+        }
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Failure to open %s!\n", path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(fp, "P5\n# %ux%u tiles, white is RMSE %.4f\n%u %u\n255\n",
+            tile, tile, worst, across, tiles_down);
+    for (size_t i = 0; i < (size_t)across * tiles_down; i++) {
+        putc(worst > 0 ? (int)lround(255 * rmse[i] / worst) : 0, fp);
+    }
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "ERROR: Failure to write %s!\n", path);
+        exit(EXIT_FAILURE);
+    }
+    free(rmse);
+}
+
+/* one worker per processor, but never more workers than bands */
+unsigned countThreads(unsigned nbands)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned threads = online > 0 ? MIN(online, MAX_THREADS) : 1;
+    threads = MIN(threads, nbands);
+    return threads > 0 ? threads : 1;
+}
+
+unsigned gcd(unsigned a, unsigned b)
+{
+    while (b != 0) {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+void readBand(Ppmstream_T image, uint16_t *samples, unsigned rows, int i)
+{
+    if (Ppmstream_read_samples(image, samples, rows) != ARITH_OK) {
+        fprintf(stderr, "ERROR: Failure to read file NO.%d!\n", i);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* body of a worker: measures every band that arrives on its ring */
+void *compareBands(void *cl)
+{
+    Worker *worker = cl;
+    Shared *shared = worker -> shared;
+    Ring_T ring = shared -> rings[worker -> id];
+    size_t row_bytes = 3 * sizeof(uint16_t) *
+                       ((size_t)shared -> width[0] + shared -> width[1]);
+    unsigned band = worker -> id;
+    uint8_t *slot;
+    size_t len;
+
+    while ((slot = Ring_peek(ring, &len)) != NULL) {
+        unsigned rows = len / row_bytes;
+        const uint16_t *a = (const uint16_t *)slot;
+        compareBand(worker, band, a, a + (size_t)rows * 3 * shared -> width[0],
+                    rows);
+        Ring_release(ring);
+        band += shared -> nworkers;
+    }
+    return NULL;
+}
+
+/*
+ * Measures one band: the squared error per channel and per tile, and the
+ * SSIM of each WINDOW x WINDOW window of luma (windows at the right and
+ * bottom edges may be smaller).
+ */
+void compareBand(Worker *worker, unsigned band, const uint16_t *a,
+                 const uint16_t *b, unsigned rows)
+{
+    Shared *shared = worker -> shared;
+    Sums *sums = &shared -> bands[band];
+    unsigned cols = shared -> cols, tile = shared -> tile;
+    unsigned first = band * shared -> band_rows;
+
+    for (unsigned r = 0; r < rows; r++) {
+        const uint16_t *x = a + (size_t)r * 3 * shared -> width[0];
+        const uint16_t *y = b + (size_t)r * 3 * shared -> width[1];
+        size_t tile_row = (first + r) / tile;
+        uint64_t *tiles = shared -> tiles + tile_row * shared -> tiles_across;
+        for (unsigned t = 0, c = 0; c < cols; t++, c += tile) {
+            uint64_t error[3] = { 0, 0, 0 };
+            squaredError(x + 3 * c, y + 3 * c, 3 * MIN(tile, cols - c),
+                         error);
+            for (int k = 0; k < 3; k++) {
+                sums -> channel[k] += error[k];
+            }
+            tiles[t] += error[0] + error[1] + error[2];
+        }
+
+        toLuma(x, cols, shared -> denominator[0], worker -> luma[0]);
+        toLuma(y, cols, shared -> denominator[1], worker -> luma[1]);
+        addMoments(worker);
+        if ((r + 1) % WINDOW == 0 || r + 1 == rows) {
+            finishWindows(worker, r % WINDOW + 1, sums);
+        }
+    }
+}
+
+/*
+ * Adds the squared differences of n samples (starting with a red one) to
+ * channel[]. Twelve samples, four pixels, go through three vectors per
+ * step; lane j of vector k always sees channel (4k + j) % 3, so the lanes
+ * are sorted into channels once at the end.
+ */
+void squaredError(const uint16_t *a, const uint16_t *b, size_t n,
+                  uint64_t channel[3])
+{
+    v4di acc[3] = { {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0} };
+    size_t i = 0;
+    for (; i + 12 <= n; i += 12) {
+        for (int k = 0; k < 3; k++) {
+            v4hu x, y;
+            memcpy(&x, a + i + 4 * k, sizeof(x));
+            memcpy(&y, b + i + 4 * k, sizeof(y));
+            v4di d = __builtin_convertvector(x, v4di) -
+                     __builtin_convertvector(y, v4di);
+            acc[k] += d * d;
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        for (int j = 0; j < 4; j++) {
+            channel[(4 * k + j) % 3] += acc[k][j];
+        }
+    }
+    for (; i < n; i++) {
+        int64_t d = (int64_t)a[i] - (int64_t)b[i];
+        channel[i % 3] += d * d;
+    }
+}
+
+/* luma in [0, 1] of cols pixels; the padding after them stays zero */
+void toLuma(const uint16_t *samples, unsigned cols, unsigned deno,
+            float *luma)
+{
+    float scale = 1.0f / deno;
+    for (unsigned c = 0; c < cols; c++, samples += 3) {
+        luma[c] = (0.299f * samples[0] + 0.587f * samples[1] +
+                   0.114f * samples[2]) * scale;
+    }
+}
+
+/* adds the current luma rows to the moments of every window, one vector
+ * (one window row) at a time */
+void addMoments(Worker *worker)
+{
+    unsigned windows = (worker -> shared -> cols + WINDOW - 1) / WINDOW;
+    for (unsigned w = 0; w < windows; w++) {
+        v8sf x, y, m[5];
+        float *moments = worker -> moments + 5 * WINDOW * w;
+        memcpy(&x, worker -> luma[0] + WINDOW * w, sizeof(x));
+        memcpy(&y, worker -> luma[1] + WINDOW * w, sizeof(y));
+        memcpy(m, moments, sizeof(m));
+        m[0] += x;
+        m[1] += y;
+        m[2] += x * x;
+        m[3] += y * y;
+        m[4] += x * y;
+        memcpy(moments, m, sizeof(m));
+    }
+}
+
+/* turns the moments of a row of windows, rows high, into SSIM values and
+ * clears them for the next row of windows */
+void finishWindows(Worker *worker, unsigned rows, Sums *sums)
+{
+    const double c1 = 0.01 * 0.01, c2 = 0.03 * 0.03;
+    unsigned cols = worker -> shared -> cols;
+    unsigned windows = (cols + WINDOW - 1) / WINDOW;
+    for (unsigned w = 0; w < windows; w++) {
+        float *moments = worker -> moments + 5 * WINDOW * w;
+        double s[5] = { 0, 0, 0, 0, 0 };
+        for (int k = 0; k < 5; k++) {
+            for (int j = 0; j < WINDOW; j++) {
+                s[k] += moments[WINDOW * k + j];
+            }
+        }
+        memset(moments, 0, 5 * WINDOW * sizeof(float));
+
+        double n = (double)rows * MIN(WINDOW, cols - WINDOW * w);
+        double mx = s[0] / n, my = s[1] / n;
+        double vx = s[2] / n - mx * mx, vy = s[3] / n - my * my;
+        double cov = s[4] / n - mx * my;
+        sums -> ssim += ((2 * mx * my + c1) * (2 * cov + c2)) /
+                        ((mx * mx + my * my + c1) * (vx + vy + c2));
+        sums -> windows++;
+    }
+}
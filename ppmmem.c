@@ -0,0 +1,352 @@
+/*********************************************************************
+ *                     ppmmem.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for reading and writing PPM
+ *              images held in memory. Both the binary (P6) and the
+ *              ASCII (P3) variants are read; images are always written
+ *              as P6.
+ *********************************************************************/
+
+
+#include <limits.h>
+#include <stdio.h>
+#include "assert.h"
+#include "ppmmem.h"
+
+static Arith_status skipSeparators(const uint8_t *src, size_t n, size_t *pos);
+static Arith_status readNumber(const uint8_t *src, size_t n, size_t *pos,
+                               unsigned *value);
+static Arith_status readPixel(const uint8_t *src, size_t n, size_t *pos,
+                              Pnm_rgb pixel);
+static void writeSample(unsigned value, unsigned denominator,
+                        uint8_t **dest);
+
+
+/*  Name: Ppmmem_parse_header
+ *  Purpose: This function reads the magic number, width, height and
+ *           denominator of a PPM image. Comments starting with '#' may
+ *           appear between the fields.
+ *  Input: the buffer, its length and the header struct to fill in
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ *  Error condition: CRE if src or header is NULL.
+ */
+Arith_status Ppmmem_parse_header(const uint8_t *src, size_t n,
+                                 Ppmmem_header *header)
+{
+    assert(src != NULL && header != NULL);
+    if (n < 2) {
+        return (n == 0 || src[0] == 'P') ? ARITH_ETRUNCATED
+                                         : ARITH_EBADFORMAT;
+    }
+    if (src[0] != 'P' || (src[1] != '3' && src[1] != '6')) {
+        return ARITH_EBADFORMAT;
+    }
+
+    size_t pos = 2;
+    unsigned width, height, denominator;
+    Arith_status status;
+    if ((status = readNumber(src, n, &pos, &width))       != ARITH_OK ||
+        (status = readNumber(src, n, &pos, &height))      != ARITH_OK ||
+        (status = readNumber(src, n, &pos, &denominator)) != ARITH_OK) {
+        return status;
+    }
+    if (denominator == 0 || denominator > 65535) {
+        return ARITH_EBADFORMAT;
+    }
+    /* exactly one whitespace character separates the header from data */
+    if (pos == n) {
+        return ARITH_ETRUNCATED;
+    }
+    if (src[pos] != ' ' && src[pos] != '\t' && src[pos] != '\n' &&
+        src[pos] != '\r') {
+        return ARITH_EBADFORMAT;
+    }
+
+    header -> width = width;
+    header -> height = height;
+    header -> denominator = denominator;
+    header -> raw = (src[1] == '6');
+    header -> len = pos + 1;
+    return ARITH_OK;
+}
+
+/*  Name: Ppmmem_read_row
+ *  Purpose: This function reads one row of pixels of the image described by
+ *           header, starting at src[*pos].
+ *  Input: the parsed header, the buffer and its length, the read position
+ *         and a destination row of header->width pixels.
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ *  Error condition: CRE if any pointer is NULL.
+ */
+Arith_status Ppmmem_read_row(const Ppmmem_header *header,
+                             const uint8_t *src, size_t n,
+                             size_t *pos, struct Pnm_rgb *row)
+{
+    assert(header != NULL && src != NULL && pos != NULL && row != NULL);
+    unsigned width = header -> width;
+    unsigned denom = header -> denominator;
+
+    if (!header -> raw) {
+        for (unsigned col = 0; col < width; col++) {
+            Arith_status status = readPixel(src, n, pos, &row[col]);
+            if (status != ARITH_OK) {
+                return status;
+            }
+            if (row[col].red > denom || row[col].green > denom ||
+                row[col].blue > denom) {
+                return ARITH_EBADFORMAT;
+            }
+        }
+        return ARITH_OK;
+    }
+
+    size_t bytes = Ppmmem_row_bytes(width, denom);
+    if (n - *pos < bytes) {
+        return ARITH_ETRUNCATED;
+    }
+    const uint8_t *p = src + *pos;
+    if (denom < 256) {
+        for (unsigned col = 0; col < width; col++, p += 3) {
+            row[col].red   = p[0];
+            row[col].green = p[1];
+            row[col].blue  = p[2];
+        }
+    } else {
+        for (unsigned col = 0; col < width; col++, p += 6) {
+            row[col].red   = (p[0] << 8) | p[1];
+            row[col].green = (p[2] << 8) | p[3];
+            row[col].blue  = (p[4] << 8) | p[5];
+        }
+    }
+    for (unsigned col = 0; col < width; col++) {
+        if (row[col].red > denom || row[col].green > denom ||
+            row[col].blue > denom) {
+            return ARITH_EBADFORMAT;
+        }
+    }
+    *pos += bytes;
+    return ARITH_OK;
+}
+
+/*  Name: Ppmmem_read_pixels
+ *  Purpose: This function reads the pixels of an image whose header has
+ *           been parsed into an A2 array, dropping the columns and rows
+ *           that do not fit in it.
+ *  Input: the parsed header, the buffer and its length, the destination
+ *         array and its methods, and a row buffer of header->width pixels.
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ *  Error condition: CRE if any pointer is NULL, or pixels is larger than
+ *                   the image.
+ */
+Arith_status Ppmmem_read_pixels(const Ppmmem_header *header,
+                                const uint8_t *src, size_t n,
+                                A2Methods_UArray2 pixels,
+                                A2Methods_T methods, struct Pnm_rgb *row)
+{
+    assert(header != NULL && src != NULL && pixels != NULL);
+    assert(methods != NULL && row != NULL);
+    unsigned width = methods -> width(pixels);
+    unsigned height = methods -> height(pixels);
+    assert(width <= header -> width && height <= header -> height);
+
+    /* a binary image that is too short is caught before any work */
+    if (header -> raw && header -> height > 0 &&
+        (n - header -> len) / header -> height <
+        Ppmmem_row_bytes(header -> width, header -> denominator)) {
+        return ARITH_ETRUNCATED;
+    }
+
+    size_t pos = header -> len;
+    for (unsigned r = 0; r < header -> height; r++) {
+        Arith_status status = Ppmmem_read_row(header, src, n, &pos, row);
+        if (status != ARITH_OK) {
+            return status;
+        }
+        for (unsigned c = 0; r < height && c < width; c++) {
+            *(Pnm_rgb)methods -> at(pixels, c, r) = row[c];
+        }
+    }
+    return ARITH_OK;
+}
+
+/*  Name: Ppmmem_header_write
+ *  Purpose: This function writes the header of a P6 image.
+ *  Input: a buffer of at least PPMMEM_HEADER_MAX bytes and the image size
+ *  Output: the number of bytes written
+ */
+size_t Ppmmem_header_write(uint8_t *dest, unsigned width, unsigned height,
+                           unsigned denominator)
+{
+    assert(dest != NULL);
+    int len = snprintf((char *)dest, PPMMEM_HEADER_MAX, "P6\n%u %u\n%u\n",
+                       width, height, denominator);
+    assert(len > 0 && len < PPMMEM_HEADER_MAX);
+    return len;
+}
+
+/*  Name: Ppmmem_check_size
+ *  Purpose: This function checks that the raster a header declares fits
+ *           in what follows it. The sizes are divided rather than
+ *           multiplied, so a header of any dimensions cannot overflow.
+ *  Input: the parsed header and the length of the whole image
+ *  Output: ARITH_OK, or ARITH_ETRUNCATED if the raster cannot be there
+ */
+Arith_status Ppmmem_check_size(const Ppmmem_header *header, size_t n)
+{
+    assert(header != NULL && header -> len <= n);
+    if (header -> width == 0 || header -> height == 0) {
+        return ARITH_OK;
+    }
+    size_t avail = n - header -> len;
+    size_t row = header -> raw ?
+                 Ppmmem_row_bytes(header -> width, header -> denominator) :
+                 (size_t)header -> width * 3;
+    if (!header -> raw) {
+        avail = avail / 2 + avail % 2;      /* samples that can fit */
+    }
+    return avail / row < header -> height ? ARITH_ETRUNCATED : ARITH_OK;
+}
+
+/*  Name: Ppmmem_row_bytes
+ *  Purpose: This function returns the size of one binary row; samples take
+ *           two bytes when the denominator exceeds 255.
+ */
+size_t Ppmmem_row_bytes(unsigned width, unsigned denominator)
+{
+    return (size_t)width * 3 * (denominator < 256 ? 1 : 2);
+}
+
+/*  Name: Ppmmem_write_row
+ *  Purpose: This function writes one row of pixels as P6 samples.
+ *  Input: the row, its width, the denominator and the destination
+ *  Output: the number of bytes written
+ */
+size_t Ppmmem_write_row(const struct Pnm_rgb *row, unsigned width,
+                        unsigned denominator, uint8_t *dest)
+{
+    assert(row != NULL && dest != NULL);
+    uint8_t *start = dest;
+    for (unsigned col = 0; col < width; col++) {
+        writeSample(row[col].red,   denominator, &dest);
+        writeSample(row[col].green, denominator, &dest);
+        writeSample(row[col].blue,  denominator, &dest);
+    }
+    return dest - start;
+}
+
+/*  Name: Ppmmem_size
+ *  Purpose: This function returns the space Ppmmem_write needs for image.
+ *  Input: the image
+ *  Output: size in bytes (header included)
+ */
+size_t Ppmmem_size(Pnm_ppm image)
+{
+    assert(image != NULL);
+    return PPMMEM_HEADER_MAX +
+           Ppmmem_row_bytes(image -> width, image -> denominator) *
+           image -> height;
+}
+
+/*  Name: Ppmmem_write
+ *  Purpose: This function writes a Pnm_ppm as a P6 image into memory.
+ *  Input: the image and a buffer of Ppmmem_size(image) bytes
+ *  Output: the number of bytes written
+ *  Error condition: CRE if any pointer is NULL.
+ */
+size_t Ppmmem_write(Pnm_ppm image, uint8_t *dest)
+{
+    assert(image != NULL && dest != NULL);
+    unsigned denom = image -> denominator;
+    uint8_t *p = dest + Ppmmem_header_write(dest, image -> width,
+                                            image -> height, denom);
+    for (unsigned row = 0; row < image -> height; row++) {
+        for (unsigned col = 0; col < image -> width; col++) {
+            Pnm_rgb pixel = image -> methods -> at(image -> pixels, col, row);
+            writeSample(pixel -> red,   denom, &p);
+            writeSample(pixel -> green, denom, &p);
+            writeSample(pixel -> blue,  denom, &p);
+        }
+    }
+    return p - dest;
+}
+
+/*  Name: writeSample
+ *  Purpose: This function writes one sample as one or two bytes (big endian)
+ *           and advances *dest.
+ */
+static void writeSample(unsigned value, unsigned denominator, uint8_t **dest)
+{
+    if (denominator > 255) {
+        *(*dest)++ = value >> 8;
+    }
+    *(*dest)++ = value & 0xff;
+}
+
+/*  Name: skipSeparators
+ *  Purpose: This function advances *pos over whitespace and '#' comments.
+ *  Output: ARITH_OK, or ARITH_ETRUNCATED when the buffer ends first.
+ */
+static Arith_status skipSeparators(const uint8_t *src, size_t n, size_t *pos)
+{
+    while (*pos < n) {
+        uint8_t c = src[*pos];
+        if (c == '#') {
+            while (*pos < n && src[*pos] != '\n') {
+                (*pos)++;
+            }
+        } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            (*pos)++;
+        } else {
+            return ARITH_OK;
+        }
+    }
+    return ARITH_ETRUNCATED;
+}
+
+/*  Name: readNumber
+ *  Purpose: This function skips separators and reads a decimal number that
+ *           is representable as an int.
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ */
+static Arith_status readNumber(const uint8_t *src, size_t n, size_t *pos,
+                               unsigned *value)
+{
+    Arith_status status = skipSeparators(src, n, pos);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    size_t start = *pos;
+    unsigned long v = 0;
+    while (*pos < n && src[*pos] >= '0' && src[*pos] <= '9') {
+        v = v * 10 + (src[*pos] - '0');
+        if (v > INT_MAX) {
+            return ARITH_EBADFORMAT;
+        }
+        (*pos)++;
+    }
+    if (*pos == start) {
+        return ARITH_EBADFORMAT;
+    }
+    *value = v;
+    return ARITH_OK;
+}
+
+/*  Name: readPixel
+ *  Purpose: This function reads the red, green and blue samples of one
+ *           pixel of an ASCII (P3) image.
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ */
+static Arith_status readPixel(const uint8_t *src, size_t n, size_t *pos,
+                              Pnm_rgb pixel)
+{
+    Arith_status status = readNumber(src, n, pos, &pixel -> red);
+    if (status == ARITH_OK) {
+        status = readNumber(src, n, pos, &pixel -> green);
+    }
+    if (status == ARITH_OK) {
+        status = readNumber(src, n, pos, &pixel -> blue);
+    }
+    return status;
+}
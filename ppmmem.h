@@ -0,0 +1,101 @@
+/*********************************************************************
+ *                     ppmmem.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for reading and writing PPM images
+ *              held in memory. It plays the role of Pnm_ppmread() and
+ *              Pnm_ppmwrite() for the library, but reports malformed
+ *              input with an Arith_status instead of raising
+ *              Pnm_Badformat, and touches no global state.
+ *********************************************************************/
+
+#ifndef PPMMEM_INCLUDED
+#define PPMMEM_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arith.h"
+#include "pnm.h"
+
+/* what the header of a PPM says about the pixels that follow it */
+typedef struct Ppmmem_header {
+    unsigned width, height, denominator;
+    int raw;        /* nonzero for P6 (binary), zero for P3 (ASCII) */
+    size_t len;     /* bytes of header, i.e. offset of the first sample */
+} Ppmmem_header;
+
+/* Function: Ppmmem_parse_header()
+ * Job: parse the header of a P3 or P6 image from src[0..n).
+ * Expected output: ARITH_OK, ARITH_ETRUNCATED if src ends inside the
+ *      header, ARITH_EBADFORMAT otherwise.
+ */
+extern Arith_status Ppmmem_parse_header(const uint8_t *src, size_t n,
+                                        Ppmmem_header *header);
+
+/* Function: Ppmmem_check_size()
+ * Job: check that src[header->len..n) can hold the raster the header
+ *      declares: exactly, for P6, and at two bytes a sample (a digit and
+ *      a space, less the last space) for P3. Callers check before sizing
+ *      anything from the header, so that a short file cannot ask for an
+ *      image's worth of memory.
+ * Expected output: ARITH_OK or ARITH_ETRUNCATED.
+ */
+extern Arith_status Ppmmem_check_size(const Ppmmem_header *header,
+                                      size_t n);
+
+/* Function: Ppmmem_read_row()
+ * Job: read the next row of header->width pixels starting at src[*pos],
+ *      store it in row[] and advance *pos past it.
+ * Expected output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT (a
+ *      sample larger than the denominator, or garbage in a P3 image).
+ */
+extern Arith_status Ppmmem_read_row(const Ppmmem_header *header,
+                                    const uint8_t *src, size_t n,
+                                    size_t *pos, struct Pnm_rgb *row);
+
+/* Function: Ppmmem_read_pixels()
+ * Job: read every row of the image whose header was parsed, starting at
+ *      src[header->len], into pixels. pixels may be narrower or shorter
+ *      than the image; the columns and rows beyond it are read (so that
+ *      bad input is still noticed) but dropped, which is how odd images
+ *      are trimmed. row must hold header->width pixels.
+ * Expected output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT.
+ */
+extern Arith_status Ppmmem_read_pixels(const Ppmmem_header *header,
+                                       const uint8_t *src, size_t n,
+                                       A2Methods_UArray2 pixels,
+                                       A2Methods_T methods,
+                                       struct Pnm_rgb *row);
+
+/* Function: Ppmmem_header_write()
+ * Job: write a P6 header into dest (at least PPMMEM_HEADER_MAX bytes) and
+ *      return its length.
+ */
+#define PPMMEM_HEADER_MAX 64
+extern size_t Ppmmem_header_write(uint8_t *dest, unsigned width,
+                                  unsigned height, unsigned denominator);
+
+/* Function: Ppmmem_row_bytes()
+ * Job: return the size of one P6 row of the given width and denominator.
+ */
+extern size_t Ppmmem_row_bytes(unsigned width, unsigned denominator);
+
+/* Function: Ppmmem_write_row()
+ * Job: write width pixels as P6 samples into dest; return bytes written.
+ */
+extern size_t Ppmmem_write_row(const struct Pnm_rgb *row, unsigned width,
+                               unsigned denominator, uint8_t *dest);
+
+/* Function: Ppmmem_size()
+ * Job: return an upper bound on the bytes Ppmmem_write() writes.
+ */
+extern size_t Ppmmem_size(Pnm_ppm image);
+
+/* Function: Ppmmem_write()
+ * Job: write image as a P6 file into dest (Ppmmem_size() bytes) and
+ *      return the number of bytes written.
+ */
+extern size_t Ppmmem_write(Pnm_ppm image, uint8_t *dest);
+
+#endif
@@ -0,0 +1,174 @@
+/*********************************************************************
+ *                     ppmstream.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for reading PPM images from a
+ *              stream. The header is collected a byte at a time and
+ *              handed to Ppmmem_parse_header(), so both readers accept
+ *              exactly the same headers; binary rows are then read with
+ *              one fread() per call and widened to 16-bit samples.
+ *********************************************************************/
+
+
+#include <stdlib.h>
+#include "assert.h"
+#include "ppmstream.h"
+
+#define T Ppmstream_T
+
+/* longest header (comments included) that is accepted */
+#define HEADER_LIMIT 4096
+
+struct T {
+    FILE *fp;
+    Ppmmem_header header;
+    uint8_t *bytes;             /* raw rows on their way to samples */
+    size_t capacity;
+};
+
+static Arith_status readRaw(T stream, uint16_t *samples, size_t count);
+static Arith_status readPlain(T stream, uint16_t *samples, size_t count);
+
+
+/*  Name: Ppmstream_new
+ *  Purpose: This function reads the header of a PPM image from fp, leaving
+ *           fp at the first sample.
+ *  Input: the stream and a location for the status
+ *  Output: the Ppmstream, or NULL with *status set
+ *  Error condition: CRE if a pointer is NULL.
+ */
+T Ppmstream_new(FILE *fp, Arith_status *status)
+{
+    assert(fp != NULL && status != NULL);
+    uint8_t text[HEADER_LIMIT];
+    size_t len = 0;
+    Ppmmem_header header;
+
+    *status = ARITH_ETRUNCATED;
+    while (*status == ARITH_ETRUNCATED && len < HEADER_LIMIT) {
+        int c = getc(fp);
+        if (c == EOF) {
+            *status = ferror(fp) ? ARITH_EIO : ARITH_ETRUNCATED;
+            return NULL;
+        }
+        text[len++] = c;
+        *status = Ppmmem_parse_header(text, len, &header);
+    }
+    if (*status != ARITH_OK) {
+        *status = ARITH_EBADFORMAT;
+        return NULL;
+    }
+
+    T stream = calloc(1, sizeof(*stream));
+    if (stream == NULL) {
+        *status = ARITH_ENOMEM;
+        return NULL;
+    }
+    stream -> fp = fp;
+    stream -> header = header;
+    return stream;
+}
+
+/*  Name: Ppmstream_free
+ *  Purpose: This function frees a Ppmstream; the FILE stays open.
+ *  Error condition: CRE if stream or *stream is NULL.
+ */
+void Ppmstream_free(T *stream)
+{
+    assert(stream != NULL && *stream != NULL);
+    free((*stream) -> bytes);
+    free(*stream);
+    *stream = NULL;
+}
+
+/*  Name: Ppmstream_header
+ *  Purpose: This function returns the header read by Ppmstream_new.
+ *  Error condition: CRE if stream is NULL.
+ */
+const Ppmmem_header *Ppmstream_header(T stream)
+{
+    assert(stream != NULL);
+    return &stream -> header;
+}
+
+/*  Name: Ppmstream_read_samples
+ *  Purpose: This function reads nrows rows of samples and checks each
+ *           against the denominator.
+ *  Input: the Ppmstream, room for nrows * width * 3 samples and nrows
+ *  Output: ARITH_OK, ARITH_ETRUNCATED, ARITH_EBADFORMAT or ARITH_EIO
+ *  Error condition: CRE if a pointer is NULL.
+ */
+Arith_status Ppmstream_read_samples(T stream, uint16_t *samples,
+                                    unsigned nrows)
+{
+    assert(stream != NULL && samples != NULL);
+    size_t count = (size_t)nrows * stream -> header.width * 3;
+    Arith_status status = stream -> header.raw
+                          ? readRaw(stream, samples, count)
+                          : readPlain(stream, samples, count);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    unsigned denom = stream -> header.denominator;
+    for (size_t i = 0; i < count; i++) {
+        if (samples[i] > denom) {
+            return ARITH_EBADFORMAT;
+        }
+    }
+    return ARITH_OK;
+}
+
+/*  Name: readRaw
+ *  Purpose: This function reads count binary samples (one byte each, or two
+ *           big-endian bytes when the denominator exceeds 255).
+ *  Output: ARITH_OK, ARITH_ETRUNCATED, ARITH_EIO or ARITH_ENOMEM
+ */
+static Arith_status readRaw(T stream, uint16_t *samples, size_t count)
+{
+    size_t width = stream -> header.denominator < 256 ? 1 : 2;
+    size_t bytes = count * width;
+    if (bytes > stream -> capacity) {
+        uint8_t *bigger = realloc(stream -> bytes, bytes);
+        if (bigger == NULL) {
+            return ARITH_ENOMEM;
+        }
+        stream -> bytes = bigger;
+        stream -> capacity = bytes;
+    }
+    if (fread(stream -> bytes, 1, bytes, stream -> fp) != bytes) {
+        return ferror(stream -> fp) ? ARITH_EIO : ARITH_ETRUNCATED;
+    }
+
+    const uint8_t *p = stream -> bytes;
+    if (width == 1) {
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = p[i];
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = (p[2*i] << 8) | p[2*i + 1];
+        }
+    }
+    return ARITH_OK;
+}
+
+/*  Name: readPlain
+ *  Purpose: This function reads count ASCII samples.
+ *  Output: ARITH_OK, ARITH_ETRUNCATED, ARITH_EBADFORMAT or ARITH_EIO
+ */
+static Arith_status readPlain(T stream, uint16_t *samples, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        unsigned value;
+        int got = fscanf(stream -> fp, "%u", &value);
+        if (got == EOF) {
+            return ferror(stream -> fp) ? ARITH_EIO : ARITH_ETRUNCATED;
+        }
+        if (got != 1 || value > 65535) {
+            return ARITH_EBADFORMAT;
+        }
+        samples[i] = value;
+    }
+    return ARITH_OK;
+}
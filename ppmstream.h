@@ -0,0 +1,51 @@
+/*********************************************************************
+ *                     ppmstream.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for reading a PPM image from a
+ *              stream a few rows at a time, for tools that look at every
+ *              sample once and never need the whole image in memory.
+ *              Rows come out as flat arrays of samples (red, green,
+ *              blue, red, ...), which is the layout vector loops want.
+ *********************************************************************/
+
+#ifndef PPMSTREAM_INCLUDED
+#define PPMSTREAM_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include "arith.h"
+#include "ppmmem.h"
+
+#define T Ppmstream_T
+typedef struct T *T;
+
+/* Function: Ppmstream_new()
+ * Job: read the header of the P3 or P6 image on fp.
+ * Expected output: the stream, or NULL with *status set to
+ *      ARITH_EBADFORMAT, ARITH_ETRUNCATED, ARITH_EIO or ARITH_ENOMEM.
+ */
+extern T Ppmstream_new(FILE *fp, Arith_status *status);
+
+/* Function: Ppmstream_free()
+ * Job: free *stream (not the FILE) and set it to NULL.
+ */
+extern void Ppmstream_free(T *stream);
+
+/* Function: Ppmstream_header()
+ * Job: return the header of the image.
+ */
+extern const Ppmmem_header *Ppmstream_header(T stream);
+
+/* Function: Ppmstream_read_samples()
+ * Job: read the next nrows rows into samples, which must hold
+ *      nrows * width * 3 values.
+ * Expected output: ARITH_OK, ARITH_ETRUNCATED, ARITH_EBADFORMAT (a sample
+ *      over the denominator, or garbage in a P3 image) or ARITH_EIO.
+ */
+extern Arith_status Ppmstream_read_samples(T stream, uint16_t *samples,
+                                           unsigned nrows);
+
+#undef T
+#endif
@@ -0,0 +1,148 @@
+/*********************************************************************
+ *                     predict.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for spatial prediction of the
+ *              block averages. The encoder works in place from the last
+ *              block backwards, so the neighbours of every block are
+ *              still plain when it is reached; the decoder goes forwards
+ *              and finds them already restored.
+ *********************************************************************/
+
+
+#include "assert.h"
+#include "predict.h"
+#include "bitpack_fast.h"
+#include "codeword.h"
+
+/* the fields predicted: a, avepbQUANT and aveprQUANT */
+#define PREDICTED 3
+static const int predicted[PREDICTED] = { 0, 4, 5 };
+
+static uint32_t predictBlock(uint32_t word, const uint8_t *row,
+                             const uint8_t *above, unsigned i, int undo);
+static unsigned median(unsigned left, unsigned up, unsigned corner);
+
+
+/*  Name: Predict_encode
+ *  Purpose: This function predicts every row of a grid, last row and
+ *           last block first.
+ *  Input: the grid, its codewords per row, its rows and its stride
+ *  Output: N/A
+ *  Error condition: CRE if grid is NULL.
+ */
+void Predict_encode(uint8_t *grid, unsigned across, unsigned rows,
+                    size_t stride)
+{
+    assert(grid != NULL);
+    for (unsigned r = rows; r-- > 0; ) {
+        uint8_t *row = grid + r * stride;
+        const uint8_t *above = r > 0 ? row - stride : NULL;
+        for (unsigned i = across; i-- > 0; ) {
+            uint8_t *cw = row + (size_t)i * CODEWORD_BYTES;
+            Codeword_put(cw, predictBlock(Codeword_get(cw), row, above, i,
+                                          0));
+        }
+    }
+}
+
+/*  Name: Predict_decode_row
+ *  Purpose: This function restores one row, first block first.
+ *  Input: the row, the plain row above it (NULL for the first) and the
+ *         codewords per row
+ *  Output: N/A
+ *  Error condition: CRE if row is NULL.
+ */
+void Predict_decode_row(uint8_t *row, const uint8_t *above, unsigned across)
+{
+    assert(row != NULL);
+    for (unsigned i = 0; i < across; i++) {
+        uint8_t *cw = row + (size_t)i * CODEWORD_BYTES;
+        Codeword_put(cw, predictBlock(Codeword_get(cw), row, above, i, 1));
+    }
+}
+
+/*  Name: Predict_decode
+ *  Purpose: This function restores a grid row by row.
+ *  Input: the grid, its codewords per row, its rows and its stride
+ *  Output: N/A
+ *  Error condition: CRE if grid is NULL.
+ */
+void Predict_decode(uint8_t *grid, unsigned across, unsigned rows,
+                    size_t stride)
+{
+    assert(grid != NULL);
+    const uint8_t *above = NULL;
+    for (unsigned r = 0; r < rows; r++, grid += stride) {
+        Predict_decode_row(grid, above, across);
+        above = grid;
+    }
+}
+
+/*  Name: predictBlock
+ *  Purpose: This function maps the averages of block i between values
+ *           and folded residuals, one way or the other. The neighbours are
+ *           read from row (to the left) and above, both plain.
+ *  Input: the block's codeword, its row, the row above (may be NULL),
+ *         its position and whether to restore (1) or predict (0)
+ *  Output: the new codeword
+ */
+static uint32_t predictBlock(uint32_t word, const uint8_t *row,
+                             const uint8_t *above, unsigned i, int undo)
+{
+    uint32_t a = i > 0 ? Codeword_get(row + ((size_t)i - 1) *
+                                      CODEWORD_BYTES) : 0;
+    uint32_t b = above != NULL ? Codeword_get(above + (size_t)i *
+                                              CODEWORD_BYTES) : 0;
+    uint32_t c = above != NULL && i > 0
+                 ? Codeword_get(above + ((size_t)i - 1) * CODEWORD_BYTES)
+                 : 0;
+
+    for (int k = 0; k < PREDICTED; k++) {
+        unsigned width = Codeword_field_width[predicted[k]];
+        unsigned lsb = Codeword_field_lsb[predicted[k]];
+        unsigned pred = 0;
+        if (above == NULL && i > 0) {
+            pred = Bitpack_fast_getu(a, width, lsb);
+        } else if (above != NULL && i == 0) {
+            pred = Bitpack_fast_getu(b, width, lsb);
+        } else if (above != NULL) {
+            pred = median(Bitpack_fast_getu(a, width, lsb),
+                          Bitpack_fast_getu(b, width, lsb),
+                          Bitpack_fast_getu(c, width, lsb));
+        }
+
+        unsigned mask = (1u << width) - 1;
+        unsigned value = Bitpack_fast_getu(word, width, lsb);
+        if (undo) {
+            /* unfold 0, 1, 2, 3, ... into 0, -1, 1, -2, ... */
+            unsigned diff = value & 1 ? ~(value >> 1) : value >> 1;
+            value = (pred + diff) & mask;
+        } else {
+            unsigned diff = (value - pred) & mask;
+            int negative = diff >> (width - 1);
+            value = negative ? ((~diff & mask) << 1) | 1 : diff << 1;
+        }
+        word = Bitpack_fast_newu(word, width, lsb, value);
+    }
+    return word;
+}
+
+/*  Name: median
+ *  Purpose: This function is the median edge detector: the median of
+ *           left, up and the gradient left + up - corner.
+ *  Output: the prediction, between left and up
+ */
+static unsigned median(unsigned left, unsigned up, unsigned corner)
+{
+    unsigned low = left < up ? left : up;
+    unsigned high = left < up ? up : left;
+    if (corner >= high) {
+        return low;
+    }
+    if (corner <= low) {
+        return high;
+    }
+    return left + up - corner;
+}
@@ -0,0 +1,57 @@
+/*********************************************************************
+ *                     predict.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for spatial prediction of the block
+ *              averages. a, avepbQUANT and aveprQUANT change slowly from
+ *              one block to the next, so in a predicted grid each of them
+ *              is replaced by its difference from the median edge
+ *              detector of LOCO-I,
+ *
+ *                  C B         pred = min(A, B)   if C >= max(A, B)
+ *                  A x                max(A, B)   if C <= min(A, B)
+ *                                     A + B - C   otherwise
+ *
+ *              over the left (A), upper (B) and upper-left (C) blocks of
+ *              the same grid; the first row predicts from the left, the
+ *              first column from above and the first block from 0. The
+ *              difference is taken modulo the field's width and folded
+ *              so that small ones of either sign become small values
+ *              (0, -1, 1, -2, ... -> 0, 1, 2, 3, ...); the codewords keep
+ *              their 32 bits and b, c and d are untouched.
+ *
+ *              Only the row above is ever consulted, so a decoder that
+ *              keeps one row of plain codewords can undo the prediction
+ *              as the rows stream in, and a grid starts afresh wherever
+ *              one starts (the tiles of format 3 are predicted apart).
+ *********************************************************************/
+
+#ifndef PREDICT_INCLUDED
+#define PREDICT_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Function: Predict_encode()
+ * Job: replace the averages of the rows x across codewords at grid, rows
+ *      stride bytes apart, by their residuals, in place.
+ */
+extern void Predict_encode(uint8_t *grid, unsigned across, unsigned rows,
+                           size_t stride);
+
+/* Function: Predict_decode_row()
+ * Job: turn the residuals of one row of across codewords back into the
+ *      averages, in place; above is the row before it, already decoded,
+ *      or NULL for the first row of a grid.
+ */
+extern void Predict_decode_row(uint8_t *row, const uint8_t *above,
+                               unsigned across);
+
+/* Function: Predict_decode()
+ * Job: undo Predict_encode() on a whole grid, in place.
+ */
+extern void Predict_decode(uint8_t *grid, unsigned across, unsigned rows,
+                           size_t stride);
+
+#endif
@@ -0,0 +1,351 @@
+/*********************************************************************
+ *                     rans.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the rANS coder of tiles.
+ *              A coded run is
+ *
+ *                  six frequency tables, one per field, a first
+ *                  the final coder state, 4 bytes little-endian
+ *                  the bytes the coder shifted out, in decoding order
+ *
+ *              Each table is a bitmap of the values of its field that
+ *              occur, lowest value in the top bit of the first byte,
+ *              then the weight of every value set in it but the last,
+ *              7 bits to a byte with the top bit set on all bytes but
+ *              the last of a weight. A run of at most PROB_SCALE
+ *              codewords stores its counts, which take fewer bytes than
+ *              frequencies, and a longer one its frequencies; either
+ *              way the last weight is what is left of a total the
+ *              decoder knows, and both sides scale the weights the same
+ *              way, so a small tile pays only for the values it uses.
+ *              The encoder runs over the symbols backwards so that the
+ *              decoder can go forward and write each row of codewords
+ *              as soon as it has it.
+ *********************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "rans.h"
+#include "bitpack_fast.h"
+#include "codeword.h"
+
+/* frequencies of a field sum to PROB_SCALE */
+#define PROB_BITS 12
+#define PROB_SCALE (1u << PROB_BITS)
+
+/* the coder state stays in [RANS_LOW, RANS_LOW << 8) between symbols */
+#define RANS_LOW (1u << 23)
+
+/* values of the widest field */
+#define MAX_SYMBOLS 64
+
+/* the scaled frequencies of one field */
+typedef struct Model {
+    unsigned nsymbols;
+    uint32_t freq[MAX_SYMBOLS];
+    uint32_t start[MAX_SYMBOLS];        /* sum of the frequencies before */
+} Model;
+
+static void fitModel(const uint32_t *counts, unsigned nsymbols,
+                     size_t total, Model *model);
+static size_t writeModel(const uint32_t *weights, unsigned nsymbols,
+                         uint8_t *dest, const uint8_t *end);
+static Arith_status readModel(const uint8_t **src, const uint8_t *end,
+                              size_t total, Model *model, uint8_t *lookup);
+static int put(uint32_t *x, uint8_t **ptr, const uint8_t *limit,
+               const Model *model, unsigned symbol);
+
+
+/*  Name: Rans_encode
+ *  Purpose: This function fits a model to each field of the codewords,
+ *           writes the weights of the models, and then codes the fields
+ *           of every codeword into the back of dest, moving the result
+ *           up behind the models at the end.
+ *  Input: the codewords, how many there are, the output and its size
+ *  Output: the bytes written, or 0 if they would not fit
+ *  Error condition: CRE if a pointer is NULL or count is 0.
+ */
+size_t Rans_encode(const uint8_t *src, size_t count, uint8_t *dest,
+                   size_t capacity)
+{
+    assert(src != NULL && dest != NULL && count > 0);
+    if (capacity < RANS_MIN_BYTES || count > UINT32_MAX) {
+        return 0;
+    }
+
+    uint32_t counts[CODEWORD_FIELDS][MAX_SYMBOLS];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < count; i++) {
+        uint32_t word = Codeword_get(src + i * CODEWORD_BYTES);
+        for (int f = 0; f < CODEWORD_FIELDS; f++) {
+            counts[f][Bitpack_fast_getu(word, Codeword_field_width[f],
+                                        Codeword_field_lsb[f])]++;
+        }
+    }
+    Model models[CODEWORD_FIELDS];
+    size_t len = 0;
+    for (int f = 0; f < CODEWORD_FIELDS; f++) {
+        unsigned nsymbols = 1u << Codeword_field_width[f];
+        fitModel(counts[f], nsymbols, count, &models[f]);
+        size_t written = writeModel(count > PROB_SCALE ? models[f].freq
+                                                       : counts[f],
+                                    nsymbols, dest + len, dest + capacity);
+        if (written == 0) {
+            return 0;
+        }
+        len += written;
+    }
+    if (capacity - len < 4) {
+        return 0;
+    }
+
+    uint32_t x = RANS_LOW;
+    uint8_t *ptr = dest + capacity;
+    for (size_t i = count; i-- > 0; ) {
+        uint32_t word = Codeword_get(src + i * CODEWORD_BYTES);
+        for (int f = CODEWORD_FIELDS - 1; f >= 0; f--) {
+            unsigned symbol = Bitpack_fast_getu(word,
+                                                Codeword_field_width[f],
+                                                Codeword_field_lsb[f]);
+            if (!put(&x, &ptr, dest + len + 4, &models[f], symbol)) {
+                return 0;
+            }
+        }
+    }
+    ptr -= 4;
+    for (int b = 0; b < 4; b++) {
+        ptr[b] = x >> (8 * b);
+    }
+    size_t coded = dest + capacity - ptr;
+    memmove(dest + len, ptr, coded);
+    return len + coded;
+}
+
+/*  Name: Rans_decode
+ *  Purpose: This function reads the models and decodes the codewords
+ *           row by row. Every value read is checked, so corrupt input
+ *           gives ARITH_EBADFORMAT and never a read outside src.
+ *  Input: the coded run and its length, the shape of the codewords and
+ *         where to put them
+ *  Output: ARITH_OK or ARITH_EBADFORMAT
+ *  Error condition: CRE if a pointer is NULL.
+ */
+Arith_status Rans_decode(const uint8_t *src, size_t n, unsigned across,
+                         unsigned rows, uint8_t *dest, size_t stride)
+{
+    assert(src != NULL && dest != NULL);
+    const uint8_t *end = src + n;
+    Model models[CODEWORD_FIELDS];
+    uint8_t lookup[CODEWORD_FIELDS][PROB_SCALE];
+    size_t total = (size_t)across * rows;
+    for (int f = 0; f < CODEWORD_FIELDS; f++) {
+        models[f].nsymbols = 1u << Codeword_field_width[f];
+        Arith_status status = readModel(&src, end, total, &models[f],
+                                        lookup[f]);
+        if (status != ARITH_OK) {
+            return status;
+        }
+    }
+    if (end - src < 4) {
+        return ARITH_EBADFORMAT;
+    }
+    uint32_t x = src[0] | src[1] << 8 | src[2] << 16 |
+                 (uint32_t)src[3] << 24;
+    src += 4;
+
+    for (unsigned r = 0; r < rows; r++, dest += stride) {
+        uint8_t *out = dest;
+        for (unsigned c = 0; c < across; c++, out += CODEWORD_BYTES) {
+            uint64_t word = 0;
+            for (int f = 0; f < CODEWORD_FIELDS; f++) {
+                uint32_t slot = x & (PROB_SCALE - 1);
+                unsigned symbol = lookup[f][slot];
+                const Model *model = &models[f];
+                x = model -> freq[symbol] * (x >> PROB_BITS) + slot -
+                    model -> start[symbol];
+                while (x < RANS_LOW) {
+                    if (src == end) {
+                        return ARITH_EBADFORMAT;
+                    }
+                    x = x << 8 | *src++;
+                }
+                word = Bitpack_fast_newu(word, Codeword_field_width[f],
+                                         Codeword_field_lsb[f], symbol);
+            }
+            Codeword_put(out, word);
+        }
+    }
+    /* the encoder started from RANS_LOW and used every byte */
+    return x == RANS_LOW && src == end ? ARITH_OK : ARITH_EBADFORMAT;
+}
+
+/*  Name: fitModel
+ *  Purpose: This function scales the counts of a field to sum to
+ *           PROB_SCALE. Every value that occurs keeps a frequency of at
+ *           least 1, and the rounding error is given to the most common
+ *           value, which can always absorb it.
+ *  Input: the counts, the number of values, their total and the model
+ */
+static void fitModel(const uint32_t *counts, unsigned nsymbols,
+                     size_t total, Model *model)
+{
+    model -> nsymbols = nsymbols;
+    int32_t sum = 0;
+    unsigned largest = 0;
+    for (unsigned s = 0; s < nsymbols; s++) {
+        uint32_t freq = (uint64_t)counts[s] * PROB_SCALE / total;
+        if (counts[s] > 0 && freq == 0) {
+            freq = 1;
+        }
+        model -> freq[s] = freq;
+        sum += freq;
+        if (counts[s] > counts[largest]) {
+            largest = s;
+        }
+    }
+    model -> freq[largest] += (int32_t)PROB_SCALE - sum;
+    assert((int32_t)model -> freq[largest] > 0);
+
+    uint32_t start = 0;
+    for (unsigned s = 0; s < nsymbols; s++) {
+        model -> start[s] = start;
+        start += model -> freq[s];
+    }
+}
+
+/*  Name: writeModel
+ *  Purpose: This function stores the weights of a field: the bitmap of the
+ *           values that occur, then the weight of each of them but the
+ *           last.
+ *  Input: the weights, the number of values, the output and its end
+ *  Output: the bytes written, or 0 if they would pass end
+ */
+static size_t writeModel(const uint32_t *weights, unsigned nsymbols,
+                         uint8_t *dest, const uint8_t *end)
+{
+    size_t bitmap = (nsymbols + 7) / 8;
+    if ((size_t)(end - dest) < bitmap) {
+        return 0;
+    }
+    memset(dest, 0, bitmap);
+    unsigned last = 0;
+    for (unsigned s = 0; s < nsymbols; s++) {
+        if (weights[s] > 0) {
+            dest[s / 8] |= 0x80 >> s % 8;
+            last = s;
+        }
+    }
+    uint8_t *p = dest + bitmap;
+    for (unsigned s = 0; s < last; s++) {
+        uint32_t weight = weights[s];
+        if (weight == 0) {
+            continue;
+        }
+        for (; weight >= 0x80; weight >>= 7) {
+            if (p == end) {
+                return 0;
+            }
+            *p++ = 0x80 | (weight & 0x7f);
+        }
+        if (p == end) {
+            return 0;
+        }
+        *p++ = weight;
+    }
+    return p - dest;
+}
+
+/*  Name: readModel
+ *  Purpose: This function reads the weights of a field written by
+ *           writeModel(), scales them as the encoder did and fills in
+ *           the table from slot to value.
+ *  Input: the position in the input (advanced), its end, the number of
+ *         codewords, the model with nsymbols set and the lookup table of
+ *         PROB_SCALE entries
+ *  Output: ARITH_OK, or ARITH_EBADFORMAT if the input ends, no value is
+ *          present, or the weights do not leave a positive last one
+ */
+static Arith_status readModel(const uint8_t **src, const uint8_t *end,
+                              size_t total, Model *model, uint8_t *lookup)
+{
+    const uint8_t *p = *src;
+    unsigned nsymbols = model -> nsymbols;
+    size_t bitmap = (nsymbols + 7) / 8;
+    if ((size_t)(end - p) < bitmap || total == 0) {
+        return ARITH_EBADFORMAT;
+    }
+    if (total > PROB_SCALE) {
+        total = PROB_SCALE;
+    }
+    const uint8_t *present = p;
+    p += bitmap;
+
+    uint32_t weights[MAX_SYMBOLS];
+    int last = -1;
+    for (unsigned s = 0; s < nsymbols; s++) {
+        weights[s] = 0;
+        if (present[s / 8] & 0x80 >> s % 8) {
+            last = s;
+        }
+    }
+    if (last < 0) {
+        return ARITH_EBADFORMAT;
+    }
+    size_t sum = 0;
+    for (int s = 0; s < last; s++) {
+        if (!(present[s / 8] & 0x80 >> s % 8)) {
+            continue;
+        }
+        uint32_t weight = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            if (p == end || shift > 7) {
+                return ARITH_EBADFORMAT;
+            }
+            weight |= (uint32_t)(*p & 0x7f) << shift;
+            if (!(*p++ & 0x80)) {
+                break;
+            }
+        }
+        if (weight == 0 || weight >= total - sum) {
+            return ARITH_EBADFORMAT;
+        }
+        weights[s] = weight;
+        sum += weight;
+    }
+    weights[last] = total - sum;
+
+    fitModel(weights, nsymbols, total, model);
+    for (unsigned s = 0; s < nsymbols; s++) {
+        memset(lookup + model -> start[s], s, model -> freq[s]);
+    }
+    *src = p;
+    return ARITH_OK;
+}
+
+/*  Name: put
+ *  Purpose: This function codes one value: it shifts bytes of the state
+ *           out (backwards, towards limit) until the value fits, then
+ *           folds the value into the state.
+ *  Input: the state, the output position, the lowest byte that may be
+ *         written, the model and the value
+ *  Output: 1, or 0 if the output would pass limit
+ */
+static int put(uint32_t *x, uint8_t **ptr, const uint8_t *limit,
+               const Model *model, unsigned symbol)
+{
+    uint32_t freq = model -> freq[symbol];
+    uint32_t x_max = ((RANS_LOW >> PROB_BITS) << 8) * freq;
+    while (*x >= x_max) {
+        if (*ptr == limit) {
+            return 0;
+        }
+        *--*ptr = *x & 0xff;
+        *x >>= 8;
+    }
+    *x = ((*x / freq) << PROB_BITS) + *x % freq + model -> start[symbol];
+    return 1;
+}
@@ -0,0 +1,47 @@
+/*********************************************************************
+ *                     rans.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for the entropy coder of tiles
+ *              (TILE_RANS in tile.h). A run of codewords is split into
+ *              its six fields and each field gets its own frequency
+ *              table, fitted to that run and stored in front of it, so
+ *              the skewed b, c, d and chroma fields cost close to their
+ *              entropy instead of their width. The symbols are coded
+ *              with a byte-wise range asymmetric numeral system (rANS).
+ *              Quantization is untouched: decoding gives back the exact
+ *              codewords.
+ *********************************************************************/
+
+#ifndef RANS_INCLUDED
+#define RANS_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arith.h"
+
+/* the fewest bytes Rans_encode() writes: the bitmaps of the six tables
+ * (8 bytes for each 6-bit field, 2 for each 4-bit one) and the state */
+#define RANS_MIN_BYTES 40
+
+/* Function: Rans_encode()
+ * Job: code the count codewords (4 bytes each, big-endian) at src into
+ *      dest, which has room for capacity bytes.
+ * Expected output: the bytes written, or 0 if the coded form would not
+ *      fit in capacity (the caller then stores the codewords as they are).
+ */
+extern size_t Rans_encode(const uint8_t *src, size_t count, uint8_t *dest,
+                          size_t capacity);
+
+/* Function: Rans_decode()
+ * Job: decode src[0..n) back into rows of across codewords each, rows
+ *      of them in all, the rows stride bytes apart starting at dest.
+ * Expected output: ARITH_OK, or ARITH_EBADFORMAT if src is not the
+ *      output of Rans_encode() for that many codewords.
+ */
+extern Arith_status Rans_decode(const uint8_t *src, size_t n,
+                                unsigned across, unsigned rows,
+                                uint8_t *dest, size_t stride);
+
+#endif
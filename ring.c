@@ -0,0 +1,254 @@
+/*********************************************************************
+ *                     ring.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the single-producer,
+ *              single-consumer ring. head is written only by the
+ *              consumer and tail only by the producer, so no lock is
+ *              needed: each side publishes its counter with a release
+ *              store after touching a slot and reads the other's with
+ *              an acquire load before touching one. The counters live
+ *              on separate cache lines so the two threads do not fight
+ *              over one line. A side that has to wait spins briefly,
+ *              then sleeps on a condition variable after counting
+ *              itself in waiters; the other side takes the lock to wake
+ *              it only when waiters is not 0, so the common case stays
+ *              free of locks and system calls.
+ *********************************************************************/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "assert.h"
+#include "ring.h"
+
+#define T Ring_T
+
+#define CACHE_LINE 64
+
+/* checks of the other side's counter before a side goes to sleep */
+#define RING_SPINS 1024
+
+struct T {
+    unsigned long head;         /* slots consumed; written by consumer */
+    char pad1[CACHE_LINE - sizeof(unsigned long)];
+    unsigned long tail;         /* slots published; written by producer */
+    char pad2[CACHE_LINE - sizeof(unsigned long)];
+    int closed;
+    int waiters;                /* sides asleep or about to be */
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    unsigned nslots;
+    size_t slot_size;
+    size_t *lengths;
+    uint8_t *buffers;
+};
+
+static unsigned long load(const unsigned long *counter);
+static void store(unsigned long *counter, unsigned long value);
+static int isClosed(T ring);
+static int hasRoom(T ring, unsigned long tail);
+static int hasSlot(T ring, unsigned long head);
+static void await(T ring, int ready(T ring, unsigned long mark),
+                  unsigned long mark);
+static void wake(T ring);
+
+
+/*  Name: Ring_new
+ *  Purpose: This function creates an empty, open ring.
+ *  Input: the number of slots and the size of each
+ *  Output: the ring, or NULL when out of memory
+ *  Error condition: CRE if nslots or slot_size is 0.
+ */
+T Ring_new(unsigned nslots, size_t slot_size)
+{
+    assert(nslots > 0 && slot_size > 0);
+    T ring = calloc(1, sizeof(*ring));
+    if (ring == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&ring -> lock, NULL);
+    pthread_cond_init(&ring -> wakeup, NULL);
+    ring -> nslots = nslots;
+    ring -> slot_size = slot_size;
+    ring -> lengths = calloc(nslots, sizeof(size_t));
+    ring -> buffers = malloc(nslots * slot_size);
+    if (ring -> lengths == NULL || ring -> buffers == NULL) {
+        Ring_free(&ring);
+    }
+    return ring;
+}
+
+/*  Name: Ring_free
+ *  Purpose: This function frees a ring that neither side uses any more.
+ *  Error condition: CRE if ring or *ring is NULL.
+ */
+void Ring_free(T *ring)
+{
+    assert(ring != NULL && *ring != NULL);
+    pthread_mutex_destroy(&(*ring) -> lock);
+    pthread_cond_destroy(&(*ring) -> wakeup);
+    free((*ring) -> lengths);
+    free((*ring) -> buffers);
+    free(*ring);
+    *ring = NULL;
+}
+
+/*  Name: Ring_reserve
+ *  Purpose: This function waits until the consumer has released a slot.
+ *  Output: the buffer of the next slot, or NULL if the ring was closed
+ *  Error condition: CRE if ring is NULL.
+ */
+uint8_t *Ring_reserve(T ring)
+{
+    assert(ring != NULL);
+    unsigned long tail = ring -> tail;
+    await(ring, hasRoom, tail);
+    if (isClosed(ring)) {
+        return NULL;
+    }
+    return ring -> buffers + (tail % ring -> nslots) * ring -> slot_size;
+}
+
+/*  Name: Ring_publish
+ *  Purpose: This function hands the reserved slot to the consumer.
+ *  Input: the ring and the number of bytes filled in
+ *  Error condition: CRE if ring is NULL or len is too large.
+ */
+void Ring_publish(T ring, size_t len)
+{
+    assert(ring != NULL && len <= ring -> slot_size);
+    unsigned long tail = ring -> tail;
+    ring -> lengths[tail % ring -> nslots] = len;
+    store(&ring -> tail, tail + 1);
+    wake(ring);
+}
+
+/*  Name: Ring_peek
+ *  Purpose: This function waits until the producer has published a slot.
+ *           Slots published before the ring was closed are still returned.
+ *  Input: the ring and a location for the length of the slot
+ *  Output: the buffer of the oldest slot, or NULL if the ring is closed and
+ *          there is nothing left in it
+ *  Error condition: CRE if a pointer is NULL.
+ */
+uint8_t *Ring_peek(T ring, size_t *len)
+{
+    assert(ring != NULL && len != NULL);
+    unsigned long head = ring -> head;
+    await(ring, hasSlot, head);
+    /* tail is read again after closed, to catch a last publish */
+    if (!hasSlot(ring, head)) {
+        return NULL;
+    }
+    *len = ring -> lengths[head % ring -> nslots];
+    return ring -> buffers + (head % ring -> nslots) * ring -> slot_size;
+}
+
+/*  Name: Ring_release
+ *  Purpose: This function gives the oldest slot back to the producer.
+ *  Error condition: CRE if ring is NULL.
+ */
+void Ring_release(T ring)
+{
+    assert(ring != NULL);
+    store(&ring -> head, ring -> head + 1);
+    wake(ring);
+}
+
+/*  Name: Ring_close
+ *  Purpose: This function closes the ring; either side may call it, any
+ *           number of times.
+ *  Error condition: CRE if ring is NULL.
+ */
+void Ring_close(T ring)
+{
+    assert(ring != NULL);
+    __atomic_store_n(&ring -> closed, 1, __ATOMIC_RELEASE);
+    wake(ring);
+}
+
+/*  Name: load
+ *  Purpose: This function reads the other side's counter; everything that
+ *           side wrote before storing it is visible afterwards.
+ */
+static unsigned long load(const unsigned long *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_ACQUIRE);
+}
+
+/*  Name: store
+ *  Purpose: This function publishes this side's counter after the slot it
+ *           covers has been written or read.
+ */
+static void store(unsigned long *counter, unsigned long value)
+{
+    __atomic_store_n(counter, value, __ATOMIC_RELEASE);
+}
+
+/*  Name: isClosed
+ *  Purpose: This function tells whether either side closed the ring.
+ */
+static int isClosed(T ring)
+{
+    return __atomic_load_n(&ring -> closed, __ATOMIC_ACQUIRE);
+}
+
+/*  Name: hasRoom
+ *  Purpose: This function tells the producer whether slot tail is free.
+ */
+static int hasRoom(T ring, unsigned long tail)
+{
+    return tail - load(&ring -> head) < ring -> nslots;
+}
+
+/*  Name: hasSlot
+ *  Purpose: This function tells the consumer whether slot head has been
+ *           published.
+ */
+static int hasSlot(T ring, unsigned long head)
+{
+    return load(&ring -> tail) != head;
+}
+
+/*  Name: await
+ *  Purpose: This function returns once ready(ring, mark) holds or the ring
+ *           is closed. It checks RING_SPINS times, then counts itself in
+ *           waiters and sleeps. The full fence after the count pairs with
+ *           the one in wake(): either this side sees the other's store or
+ *           the other side sees waiters, and the lock held from the check
+ *           to pthread_cond_wait() keeps the wakeup from falling between.
+ *  Input: the ring, the condition and the counter it is checked against
+ */
+static void await(T ring, int ready(T ring, unsigned long mark),
+                  unsigned long mark)
+{
+    for (int spin = 0; spin < RING_SPINS; spin++) {
+        if (ready(ring, mark) || isClosed(ring)) {
+            return;
+        }
+    }
+    pthread_mutex_lock(&ring -> lock);
+    __atomic_add_fetch(&ring -> waiters, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (!ready(ring, mark) && !isClosed(ring)) {
+        pthread_cond_wait(&ring -> wakeup, &ring -> lock);
+    }
+    __atomic_sub_fetch(&ring -> waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&ring -> lock);
+}
+
+/*  Name: wake
+ *  Purpose: This function wakes the other side if it may be asleep, after
+ *           this side has stored its counter or closed the ring.
+ */
+static void wake(T ring)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring -> waiters, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&ring -> lock);
+        pthread_cond_broadcast(&ring -> wakeup);
+        pthread_mutex_unlock(&ring -> lock);
+    }
+}
@@ -0,0 +1,46 @@
+/*********************************************************************
+ *                     ring.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for a lock-free ring of fixed-size
+ *              byte buffers passed from exactly one producer thread to
+ *              exactly one consumer thread. The producer reserves the
+ *              next free slot, fills it and publishes it; the consumer
+ *              peeks at the oldest published slot, uses it and releases
+ *              it. Either side may close the ring: the producer to say
+ *              that nothing more is coming, the consumer to say that
+ *              nothing more is wanted.
+ *              Slots pass without locks; a side that finds the ring
+ *              full or empty for long sleeps until the other wakes it.
+ *********************************************************************/
+
+#ifndef RING_INCLUDED
+#define RING_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define T Ring_T
+typedef struct T *T;
+
+/* returns a ring of nslots buffers of slot_size bytes each, or NULL when
+ * out of memory */
+extern T        Ring_new    (unsigned nslots, size_t slot_size);
+extern void     Ring_free   (T *ring);
+
+/* producer side: waits for a free slot and returns its buffer, or NULL
+ * once the ring is closed; then publishes len bytes of it */
+extern uint8_t *Ring_reserve(T ring);
+extern void     Ring_publish(T ring, size_t len);
+
+/* consumer side: waits for a published slot and returns its buffer and
+ * length, or NULL once the ring is closed and drained; then releases it */
+extern uint8_t *Ring_peek   (T ring, size_t *len);
+extern void     Ring_release(T ring);
+
+/* no more slots will be published or consumed */
+extern void     Ring_close  (T ring);
+
+#undef T
+#endif
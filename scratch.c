@@ -0,0 +1,177 @@
+/*********************************************************************
+ *                     scratch.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the scratch arena. The
+ *              arena is a list of chunks; allocation bumps a pointer in
+ *              the newest chunk and adds a chunk when it does not fit.
+ *              On reset, a multi-chunk arena is replaced by a single
+ *              chunk as large as all of them, so from then on the same
+ *              sequence of allocations is served by bumping alone.
+ *              An arena grown past SCRATCH_KEEP is emptied on reset.
+ *********************************************************************/
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "assert.h"
+#include "scratch.h"
+#include "stats.h"
+
+#define T Scratch_T
+
+/* every allocation is rounded up to this, the strictest alignment */
+#define ALIGN 16
+#define MIN_CHUNK (64 * 1024)
+
+typedef struct Chunk {
+    struct Chunk *prev;
+    size_t size;                /* usable bytes after the header */
+    size_t used;
+} Chunk;
+
+struct T {
+    Chunk *chunks;              /* newest first */
+    size_t in_use;              /* bytes handed out since the last reset */
+    size_t peak;
+    size_t capacity;
+};
+
+static Chunk *newChunk(size_t size, Chunk *prev);
+static size_t roundUp(size_t n);
+
+
+/*  Name: Scratch_new
+ *  Purpose: This function creates an arena without any chunk; the first
+ *           allocation creates one.
+ *  Output: the arena, or NULL when out of memory
+ */
+T Scratch_new(void)
+{
+    T scratch = calloc(1, sizeof(*scratch));
+    return scratch;
+}
+
+/*  Name: Scratch_free
+ *  Purpose: This function frees every chunk and the arena itself.
+ *  Input: a pointer to the arena
+ *  Error condition: CRE if scratch or *scratch is NULL.
+ */
+void Scratch_free(T *scratch)
+{
+    assert(scratch != NULL && *scratch != NULL);
+    Chunk *chunk = (*scratch) -> chunks;
+    while (chunk != NULL) {
+        Chunk *prev = chunk -> prev;
+        free(chunk);
+        chunk = prev;
+    }
+    free(*scratch);
+    *scratch = NULL;
+}
+
+/*  Name: Scratch_alloc
+ *  Purpose: This function hands out nbytes from the newest chunk, adding a
+ *           chunk at least twice the size of the last one when needed.
+ *  Input: the arena and the number of bytes
+ *  Output: aligned memory, or NULL when out of memory
+ *  Error condition: CRE if scratch is NULL.
+ */
+void *Scratch_alloc(T scratch, size_t nbytes)
+{
+    assert(scratch != NULL);
+    nbytes = roundUp(nbytes);
+    Chunk *chunk = scratch -> chunks;
+    if (chunk == NULL || chunk -> size - chunk -> used < nbytes) {
+        size_t size = chunk == NULL ? MIN_CHUNK : chunk -> size * 2;
+        if (size < nbytes) {
+            size = nbytes;
+        }
+        chunk = newChunk(size, chunk);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        scratch -> chunks = chunk;
+        scratch -> capacity += size;
+    }
+
+    void *p = (char *)chunk + roundUp(sizeof(Chunk)) + chunk -> used;
+    chunk -> used += nbytes;
+    scratch -> in_use += nbytes;
+    if (scratch -> in_use > scratch -> peak) {
+        scratch -> peak = scratch -> in_use;
+    }
+    return p;
+}
+
+/*  Name: Scratch_reset
+ *  Purpose: This function makes all memory of the arena free again. When
+ *           there is more than one chunk they are merged into one, so the
+ *           arena stops growing once it fits the largest job; when they
+ *           hold more than SCRATCH_KEEP bytes they are all freed.
+ *  Input: the arena
+ *  Error condition: CRE if scratch is NULL.
+ */
+void Scratch_reset(T scratch)
+{
+    assert(scratch != NULL);
+    Chunk *chunk = scratch -> chunks;
+    if (chunk != NULL &&
+        (chunk -> prev != NULL || scratch -> capacity > SCRATCH_KEEP)) {
+        size_t total = scratch -> capacity;
+        while (chunk != NULL) {
+            Chunk *prev = chunk -> prev;
+            free(chunk);
+            chunk = prev;
+        }
+        scratch -> chunks = total > SCRATCH_KEEP ? NULL :
+                            newChunk(total, NULL);
+        scratch -> capacity = scratch -> chunks == NULL ? 0 : total;
+    } else if (chunk != NULL) {
+        chunk -> used = 0;
+    }
+    scratch -> in_use = 0;
+}
+
+/*  Name: Scratch_peak
+ *  Purpose: This function returns the high-water mark of bytes in use.
+ */
+size_t Scratch_peak(T scratch)
+{
+    assert(scratch != NULL);
+    return scratch -> peak;
+}
+
+/*  Name: Scratch_capacity
+ *  Purpose: This function returns the bytes held in chunks.
+ */
+size_t Scratch_capacity(T scratch)
+{
+    assert(scratch != NULL);
+    return scratch -> capacity;
+}
+
+/*  Name: newChunk
+ *  Purpose: This function allocates an empty chunk of size usable bytes.
+ *  Output: the chunk, or NULL when out of memory
+ */
+static Chunk *newChunk(size_t size, Chunk *prev)
+{
+    Chunk *chunk = malloc(roundUp(sizeof(Chunk)) + size);
+    Stats_alloc(roundUp(sizeof(Chunk)) + size);
+    if (chunk != NULL) {
+        chunk -> prev = prev;
+        chunk -> size = size;
+        chunk -> used = 0;
+    }
+    return chunk;
+}
+
+/*  Name: roundUp
+ *  Purpose: This function rounds n up to a multiple of ALIGN.
+ */
+static size_t roundUp(size_t n)
+{
+    return (n + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+}
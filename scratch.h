@@ -0,0 +1,44 @@
+/*********************************************************************
+ *                     scratch.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for a growable scratch arena.
+ *              Allocations are carved out of large chunks and are never
+ *              freed one by one; Scratch_reset() makes all the memory
+ *              available again while keeping it, so a caller that does
+ *              the same work over and over stops calling malloc once
+ *              the arena has grown to fit the largest job.
+ *********************************************************************/
+
+#ifndef SCRATCH_INCLUDED
+#define SCRATCH_INCLUDED
+
+#include <stddef.h>
+
+#define T Scratch_T
+typedef struct T *T;
+
+/* returns a new, empty arena, or NULL when out of memory */
+extern T      Scratch_new  (void);
+
+/* releases every chunk of *scratch and sets it to NULL */
+extern void   Scratch_free (T *scratch);
+
+/* returns nbytes of memory aligned for any type, or NULL when out of
+ * memory; the memory stays valid until the next Scratch_reset() */
+extern void  *Scratch_alloc(T scratch, size_t nbytes);
+
+/* forgets every allocation; if the arena had to grow since the last
+ * reset, its chunks are merged into one that holds them all. An arena
+ * holding more than SCRATCH_KEEP bytes gives them all back instead, so
+ * that one huge job does not pin its memory for the jobs after it */
+#define SCRATCH_KEEP ((size_t)256 << 20)
+extern void   Scratch_reset(T scratch);
+
+/* the most bytes handed out between two resets, and the bytes held */
+extern size_t Scratch_peak    (T scratch);
+extern size_t Scratch_capacity(T scratch);
+
+#undef T
+#endif
@@ -0,0 +1,447 @@
+/*********************************************************************
+ *                     sequence.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for frame sequences. The
+ *              encoder keeps two copies of the pixels and codewords of a
+ *              frame, reads the next frame into the spare one while
+ *              comparing it with the last, and swaps them once the frame
+ *              is whole, so a bad frame leaves the sequence as it was.
+ *              The decoder checks that a frame has arrived in full
+ *              before it touches the last one, then redraws each run of
+ *              blocks that changed straight from the run's codewords.
+ *********************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "sequence.h"
+#include "codec.h"
+#include "codeword.h"
+#include "ppmmem.h"
+
+#define T Sequence_T
+
+/* denominator of decoded frames, as in readHeader() */
+#define DENOMINATOR 255
+
+struct T {
+    unsigned width, height;         /* of every frame; 0 before the first */
+    uint64_t frames, blocks, changed;
+
+    /* encoding: the last frame and the one being read */
+    struct Pnm_rgb *pixels[2];
+    uint8_t *grid[2];
+    unsigned denominator;           /* of the last frame */
+    struct Pnm_rgb *row;            /* one row as read, odd pixel included */
+    Block_memo memo;                /* of blocks transformed */
+    uint8_t *out;
+
+    /* decoding: the last frame as a P6 image */
+    uint8_t *frame;
+    size_t frame_len, ppm_len;      /* its size and its header's */
+    struct Pnm_rgb *top, *bottom;   /* a run of blocks being redrawn */
+};
+
+static Arith_status startEncoding(T seq, unsigned width, unsigned height);
+static Arith_status readRow(T seq, const Ppmmem_header *header,
+                            const uint8_t *ppm, size_t n, size_t *pos,
+                            struct Pnm_rgb *dest);
+static int sameBlock(const struct Pnm_rgb *now, const struct Pnm_rgb *then,
+                     unsigned width);
+static Arith_status checkFrame(const T seq, const uint8_t *src, size_t n,
+                               size_t *pos, uint64_t *changed);
+static Arith_status startDecoding(T seq);
+static void redrawRow(T seq, unsigned r, const uint8_t *skip,
+                      const uint8_t *codewords);
+static int skipped(const uint8_t *skip, unsigned k);
+
+
+/*  Name: Sequence_new
+ *  Purpose: This function creates an empty sequence.
+ *  Output: the sequence, or NULL when out of memory
+ */
+T Sequence_new(void)
+{
+    return calloc(1, sizeof(struct T));
+}
+
+/*  Name: Sequence_free
+ *  Purpose: This function frees a sequence and everything it keeps.
+ *  Input: a pointer to the sequence (may point to NULL)
+ *  Output: N/A
+ *  Error condition: CRE if seq is NULL.
+ */
+void Sequence_free(T *seq)
+{
+    assert(seq != NULL);
+    if (*seq == NULL) {
+        return;
+    }
+    for (int k = 0; k < 2; k++) {
+        free((*seq) -> pixels[k]);
+        free((*seq) -> grid[k]);
+    }
+    free((*seq) -> row);
+    free((*seq) -> out);
+    free((*seq) -> frame);
+    free((*seq) -> top);
+    free((*seq) -> bottom);
+    free(*seq);
+    *seq = NULL;
+}
+
+/*  Name: Sequence_encode
+ *  Purpose: This function compresses the next frame. A block whose four
+ *           pixels (and denominator) are those of the last frame keeps
+ *           its codeword without being transformed; any other block is
+ *           transformed, and skipped still if its codeword came out the
+ *           same.
+ *  Input: the sequence, the PPM image and its length, and locations for
+ *         the output
+ *  Output: ARITH_OK, or the reason the frame could not be compressed
+ *  Error condition: ARITH_EINVAL if a pointer is NULL or the frame is not
+ *                   the size of the first.
+ */
+Arith_status Sequence_encode(T seq, const uint8_t *ppm, size_t n,
+                             uint8_t **out, size_t *outlen)
+{
+    if (seq == NULL || ppm == NULL || out == NULL || outlen == NULL ||
+        seq -> frame != NULL) {
+        return ARITH_EINVAL;
+    }
+    Ppmmem_header header;
+    Arith_status status = Ppmmem_parse_header(ppm, n, &header);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    if (header.width < 2 || header.height < 2) {
+        return ARITH_ETOOSMALL;
+    }
+    status = Ppmmem_check_size(&header, n);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    unsigned width = header.width & ~1u, height = header.height & ~1u;
+    if (seq -> frames == 0) {
+        status = startEncoding(seq, width, height);
+    } else if (width != seq -> width || height != seq -> height) {
+        status = ARITH_EINVAL;
+    }
+    if (status != ARITH_OK) {
+        return status;
+    }
+
+    int first = seq -> frames == 0;
+    int same_scale = !first && header.denominator == seq -> denominator;
+    unsigned across = width / 2;
+    size_t map = (across + 7) / 8;
+    uint8_t *p = seq -> out;
+    if (first) {
+        p += Codeword_sequence_header_write(p, width, height);
+    }
+    uint64_t changed = 0;
+    size_t pos = header.len;
+    for (unsigned r = 0; r < height / 2 && status == ARITH_OK; r++) {
+        struct Pnm_rgb *top = seq -> pixels[1] + (size_t)2 * r * width;
+        struct Pnm_rgb *bottom = top + width;
+        const struct Pnm_rgb *was = seq -> pixels[0] +
+                                    (size_t)2 * r * width;
+        status = readRow(seq, &header, ppm, n, &pos, top);
+        if (status == ARITH_OK) {
+            status = readRow(seq, &header, ppm, n, &pos, bottom);
+        }
+        if (status != ARITH_OK) {
+            break;
+        }
+
+        uint8_t *skip = p;
+        memset(skip, 0, map);
+        p += map;
+        for (unsigned c = 0; c < across; c++) {
+            size_t k = (size_t)r * across + c;
+            uint8_t *cw = seq -> grid[1] + k * CODEWORD_BYTES;
+            const uint8_t *old = seq -> grid[0] + k * CODEWORD_BYTES;
+            if (same_scale && sameBlock(top + 2 * c, was + 2 * c, width)) {
+                memcpy(cw, old, CODEWORD_BYTES);
+            } else {
+                encodeBlockRow(top + 2 * c, bottom + 2 * c, 1,
+                               header.denominator, &seq -> memo, cw);
+                if (first || memcmp(cw, old, CODEWORD_BYTES) != 0) {
+                    memcpy(p, cw, CODEWORD_BYTES);
+                    p += CODEWORD_BYTES;
+                    changed++;
+                    continue;
+                }
+            }
+            skip[c / 8] |= 0x80 >> c % 8;
+        }
+    }
+    /* the row an odd height drops is still read, so that it is checked */
+    if (status == ARITH_OK && header.height % 2 != 0) {
+        status = readRow(seq, &header, ppm, n, &pos, NULL);
+    }
+    if (status != ARITH_OK) {
+        if (first) {
+            seq -> width = seq -> height = 0;
+        }
+        return status;
+    }
+
+    struct Pnm_rgb *pixels = seq -> pixels[0];
+    seq -> pixels[0] = seq -> pixels[1];
+    seq -> pixels[1] = pixels;
+    uint8_t *grid = seq -> grid[0];
+    seq -> grid[0] = seq -> grid[1];
+    seq -> grid[1] = grid;
+    seq -> denominator = header.denominator;
+    seq -> frames++;
+    seq -> blocks += (uint64_t)across * (height / 2);
+    seq -> changed += changed;
+    reportBlockMemo(&seq -> memo);
+    *out = seq -> out;
+    *outlen = p - seq -> out;
+    return ARITH_OK;
+}
+
+/*  Name: Sequence_decode
+ *  Purpose: This function decompresses the next frame into the last one,
+ *           redrawing the blocks that changed.
+ *  Input: the sequence, the bytes from where the last frame ended and
+ *         their number, and locations for the bytes taken and the output
+ *  Output: ARITH_OK, or the reason the frame could not be decompressed
+ *  Error condition: ARITH_EINVAL if a pointer is NULL or the sequence has
+ *                   been encoding.
+ */
+Arith_status Sequence_decode(T seq, const uint8_t *src, size_t n,
+                             size_t *used, uint8_t **out, size_t *outlen)
+{
+    if (seq == NULL || src == NULL || used == NULL || out == NULL ||
+        outlen == NULL || seq -> out != NULL) {
+        return ARITH_EINVAL;
+    }
+    size_t pos = 0;
+    Arith_status status = ARITH_OK;
+    if (seq -> frames == 0) {
+        status = Codeword_sequence_header_parse(src, n, &seq -> width,
+                                                &seq -> height, &pos);
+    }
+    size_t start = pos;
+    uint64_t changed;
+    if (status == ARITH_OK) {
+        status = checkFrame(seq, src, n, &pos, &changed);
+    }
+    if (status == ARITH_OK && seq -> frame == NULL) {
+        status = startDecoding(seq);
+    }
+    if (status != ARITH_OK) {
+        if (seq -> frames == 0) {
+            seq -> width = seq -> height = 0;
+        }
+        return status;
+    }
+
+    unsigned across = seq -> width / 2;
+    size_t map = (across + 7) / 8;
+    const uint8_t *p = src + start;
+    for (unsigned r = 0; r < seq -> height / 2; r++) {
+        redrawRow(seq, r, p, p + map);
+        unsigned drawn = 0;
+        for (unsigned c = 0; c < across; c++) {
+            drawn += !skipped(p, c);
+        }
+        p += map + (size_t)drawn * CODEWORD_BYTES;
+    }
+    seq -> frames++;
+    seq -> blocks += (uint64_t)across * (seq -> height / 2);
+    seq -> changed += changed;
+    *used = pos;
+    *out = seq -> frame;
+    *outlen = seq -> frame_len;
+    return ARITH_OK;
+}
+
+/*  Name: Sequence_stats
+ *  Purpose: This function reports the blocks of the frames so far.
+ *  Input: the sequence and locations for the counts (may be NULL)
+ *  Output: N/A
+ *  Error condition: CRE if seq is NULL.
+ */
+void Sequence_stats(T seq, uint64_t *blocks, uint64_t *changed)
+{
+    assert(seq != NULL);
+    if (blocks != NULL) {
+        *blocks = seq -> blocks;
+    }
+    if (changed != NULL) {
+        *changed = seq -> changed;
+    }
+}
+
+/*  Name: startEncoding
+ *  Purpose: This function sizes the buffers of an encoder for its first
+ *           frame; the row is one pixel wider, for images of odd width.
+ *  Output: ARITH_OK or ARITH_ENOMEM
+ */
+static Arith_status startEncoding(T seq, unsigned width, unsigned height)
+{
+    size_t pixels = (size_t)width * height;
+    size_t blocks = pixels / 4;
+    size_t map = (width / 2 + 7) / 8;
+    for (int k = 0; k < 2; k++) {
+        free(seq -> pixels[k]);
+        free(seq -> grid[k]);
+        seq -> pixels[k] = malloc(pixels * sizeof(struct Pnm_rgb));
+        seq -> grid[k] = malloc(blocks * CODEWORD_BYTES);
+    }
+    free(seq -> row);
+    free(seq -> out);
+    seq -> row = malloc((width + 1) * sizeof(struct Pnm_rgb));
+    seq -> out = malloc(CODEWORD_HEADER_MAX + height / 2 * map +
+                        blocks * CODEWORD_BYTES);
+    if (seq -> pixels[0] == NULL || seq -> pixels[1] == NULL ||
+        seq -> grid[0] == NULL || seq -> grid[1] == NULL ||
+        seq -> row == NULL || seq -> out == NULL) {
+        return ARITH_ENOMEM;
+    }
+    seq -> width = width;
+    seq -> height = height;
+    return ARITH_OK;
+}
+
+/*  Name: readRow
+ *  Purpose: This function reads the next row of a frame and keeps its
+ *           first width pixels in dest (none when dest is NULL).
+ *  Output: ARITH_OK, ARITH_ETRUNCATED or ARITH_EBADFORMAT
+ */
+static Arith_status readRow(T seq, const Ppmmem_header *header,
+                            const uint8_t *ppm, size_t n, size_t *pos,
+                            struct Pnm_rgb *dest)
+{
+    Arith_status status = Ppmmem_read_row(header, ppm, n, pos, seq -> row);
+    if (status == ARITH_OK && dest != NULL) {
+        memcpy(dest, seq -> row, seq -> width * sizeof(struct Pnm_rgb));
+    }
+    return status;
+}
+
+/*  Name: sameBlock
+ *  Purpose: This function compares the four pixels of a block in two
+ *           frames, given the top left one of each.
+ *  Output: 1 if they are all equal, 0 otherwise
+ */
+static int sameBlock(const struct Pnm_rgb *now, const struct Pnm_rgb *then,
+                     unsigned width)
+{
+    size_t pair = 2 * sizeof(struct Pnm_rgb);
+    return memcmp(now, then, pair) == 0 &&
+           memcmp(now + width, then + width, pair) == 0;
+}
+
+/*  Name: checkFrame
+ *  Purpose: This function makes sure the whole of a frame has arrived, by
+ *           adding up the blocks its skip maps do not skip.
+ *  Input: the sequence (its size known), the bytes and their number, the
+ *         position of the frame, to be moved past it, and a location for
+ *         the count of blocks not skipped
+ *  Output: ARITH_OK, ARITH_ETRUNCATED, or ARITH_EBADFORMAT if the first
+ *          frame skips a block
+ */
+static Arith_status checkFrame(const T seq, const uint8_t *src, size_t n,
+                               size_t *pos, uint64_t *changed)
+{
+    unsigned across = seq -> width / 2;
+    size_t map = (across + 7) / 8;
+    size_t p = *pos;
+    *changed = 0;
+    for (unsigned r = 0; r < seq -> height / 2; r++) {
+        if (n - p < map) {
+            return ARITH_ETRUNCATED;
+        }
+        unsigned drawn = 0;
+        for (unsigned c = 0; c < across; c++) {
+            drawn += !skipped(src + p, c);
+        }
+        if (seq -> frames == 0 && drawn < across) {
+            return ARITH_EBADFORMAT;
+        }
+        p += map;
+        if (n - p < (size_t)drawn * CODEWORD_BYTES) {
+            return ARITH_ETRUNCATED;
+        }
+        p += (size_t)drawn * CODEWORD_BYTES;
+        *changed += drawn;
+    }
+    *pos = p;
+    return ARITH_OK;
+}
+
+/*  Name: startDecoding
+ *  Purpose: This function allocates the frame of a decoder and writes its
+ *           P6 header; the first frame draws every pixel.
+ *  Output: ARITH_OK or ARITH_ENOMEM
+ */
+static Arith_status startDecoding(T seq)
+{
+    unsigned width = seq -> width, height = seq -> height;
+    uint8_t head[PPMMEM_HEADER_MAX];
+    seq -> ppm_len = Ppmmem_header_write(head, width, height, DENOMINATOR);
+    seq -> frame_len = seq -> ppm_len +
+                       height * Ppmmem_row_bytes(width, DENOMINATOR);
+    seq -> frame = malloc(seq -> frame_len);
+    seq -> top = malloc(width * sizeof(struct Pnm_rgb));
+    seq -> bottom = malloc(width * sizeof(struct Pnm_rgb));
+    if (seq -> frame == NULL || seq -> top == NULL || seq -> bottom == NULL) {
+        free(seq -> frame);
+        seq -> frame = NULL;
+        return ARITH_ENOMEM;
+    }
+    memcpy(seq -> frame, head, seq -> ppm_len);
+    return ARITH_OK;
+}
+
+/*  Name: redrawRow
+ *  Purpose: This function decodes each run of blocks of row r that are
+ *           not skipped, whose codewords lie back to back, over the same
+ *           blocks of the frame; skipped blocks are left as they are.
+ *  Input: the sequence, the row of blocks, its skip map and its codewords
+ */
+static void redrawRow(T seq, unsigned r, const uint8_t *skip,
+                      const uint8_t *codewords)
+{
+    unsigned across = seq -> width / 2;
+    size_t row_bytes = Ppmmem_row_bytes(seq -> width, DENOMINATOR);
+    size_t pixel_bytes = row_bytes / seq -> width;
+    uint8_t *line = seq -> frame + seq -> ppm_len + 2 * (size_t)r *
+                                                    row_bytes;
+    unsigned c = 0;
+    while (c < across) {
+        if (skipped(skip, c)) {
+            c++;
+            continue;
+        }
+        unsigned run = 1;
+        while (c + run < across && !skipped(skip, c + run)) {
+            run++;
+        }
+        decodeBlockRow(codewords, run, DENOMINATOR, seq -> top,
+                       seq -> bottom);
+        size_t at = 2 * (size_t)c * pixel_bytes;
+        Ppmmem_write_row(seq -> top, 2 * run, DENOMINATOR, line + at);
+        Ppmmem_write_row(seq -> bottom, 2 * run, DENOMINATOR,
+                         line + row_bytes + at);
+        codewords += (size_t)run * CODEWORD_BYTES;
+        c += run;
+    }
+}
+
+/*  Name: skipped
+ *  Purpose: This function reads bit k of a skip map.
+ *  Output: 1 if block k is skipped, 0 otherwise
+ */
+static int skipped(const uint8_t *skip, unsigned k)
+{
+    return (skip[k / 8] >> (7 - k % 8)) & 1;
+}
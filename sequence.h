@@ -0,0 +1,83 @@
+/*********************************************************************
+ *                     sequence.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for sequences of frames of one size
+ *              that mostly repeat the frame before, such as those of a
+ *              fixed camera. The layout is
+ *
+ *                  "COMP40 Compressed sequence 1\n"
+ *                  "width height\n"
+ *                  frame, frame, ...
+ *
+ *              and every frame is, for each row of 2x2 blocks, a skip
+ *              map of ceil(width / 16) bytes followed by the codewords
+ *              (format 2) of the blocks it does not skip. Bit k of the
+ *              map (from the most significant bit of its first byte) is
+ *              set when block k is the same as in the frame before; the
+ *              bits past the last block are 0. Nothing is skipped in the
+ *              first frame.
+ *
+ *              The encoder compares the pixels of each block with those
+ *              of the frame before and only computes the codewords of
+ *              blocks that changed; a block that changed too little to
+ *              change its codeword is skipped as well. Every frame
+ *              decodes to what the frame would alone. The decoder keeps
+ *              the last frame and redraws only the blocks that changed.
+ *********************************************************************/
+
+#ifndef SEQUENCE_INCLUDED
+#define SEQUENCE_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arith.h"
+
+#define T Sequence_T
+typedef struct T *T;
+
+/* Function: Sequence_new() / Sequence_free()
+ * Job: create a sequence with no frame yet, to encode or to decode (not
+ *      both), and free it with its last frame.
+ * Expected output: the sequence, or NULL if it cannot be allocated.
+ */
+extern T    Sequence_new(void);
+extern void Sequence_free(T *seq);
+
+/* Function: Sequence_encode()
+ * Job: compress the next frame, the PPM image in ppm[0..n), into *out
+ *      (*outlen bytes): the sequence's header and the frame for the first
+ *      one, the frame alone after that. Odd widths and heights are
+ *      trimmed by one, as by Arith_compress(); every frame must trim to
+ *      the size of the first.
+ * Expected output: ARITH_OK, or an error status with the sequence as it
+ *      was; ARITH_EINVAL for a frame of another size. *out belongs to the
+ *      sequence and is valid until its next use.
+ */
+extern Arith_status Sequence_encode(T seq, const uint8_t *ppm, size_t n,
+                                    uint8_t **out, size_t *outlen);
+
+/* Function: Sequence_decode()
+ * Job: decompress the next frame from src[0..n), which starts where the
+ *      last call left off (at the header, for the first), store how many
+ *      bytes it took in *used, and return the frame as a P6 image with
+ *      denominator 255 in *out (*outlen bytes).
+ * Expected output: ARITH_OK; ARITH_ETRUNCATED if src ends inside the
+ *      frame, with nothing taken and the sequence as it was, so that the
+ *      caller may retry with more bytes; ARITH_EBADFORMAT. *out belongs
+ *      to the sequence and is valid until its next use, which updates it
+ *      in place.
+ */
+extern Arith_status Sequence_decode(T seq, const uint8_t *src, size_t n,
+                                    size_t *used, uint8_t **out,
+                                    size_t *outlen);
+
+/* Function: Sequence_stats()
+ * Job: store how many blocks the frames so far had in all, and how many
+ *      of them were not skipped.
+ */
+extern void Sequence_stats(T seq, uint64_t *blocks, uint64_t *changed);
+
+#undef T
+#endif
@@ -0,0 +1,492 @@
+/*
+ * 40image-serve: decode regions of compressed images for clients on a Unix
+ * domain socket, from a cache of decoded tiles shared by a pool of
+ * workers.
+ *
+ * A client sends one request per line,
+ *
+ *         ppm|rgb scale x,y,w,h|all path
+ *
+ * where scale is 1, 2, 4 or 8 (as in 40image --scale 1/scale) and the
+ * region is in pixels of the scaled image, and gets back either
+ *
+ *         OK width height bytes
+ *
+ * followed by bytes bytes (a P6 image, or width x height RGB triples), or
+ * "ERR reason". The line "stats" is answered with "OK hits misses bytes"
+ * for the tile cache. A connection may carry any number of requests.
+ *
+ * Compressed files are mapped once and kept in a pool, found by path and
+ * checked against the file's identity on every request; the tiles of the
+ * cache are keyed by that identity too, so a rewritten file is never
+ * served stale.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "assert.h"
+#include "arith.h"
+#include "codec.h"
+#include "codeword.h"
+#include "ppmmem.h"
+#include "tilecache.h"
+
+/* pixels of the scaled image along a side of a cached tile; even */
+#define TILE 64
+
+/* a compressed file of the pool; refs counts the requests using it */
+typedef struct File {
+        char *path;
+        Tilecache_key id;       /* device, inode, size and mtime */
+        void *map;
+        size_t maplen;
+        const uint8_t *codewords;
+        uint8_t *copy;
+        unsigned width, height;
+        unsigned refs;
+        unsigned long used;
+} File;
+
+static struct {
+        pthread_mutex_t lock;
+        File **files;
+        unsigned nfiles, capacity;
+        unsigned long clock;
+} pool = { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0 };
+
+static Tilecache_T cache;
+static int listener;
+
+static void usage(const char *progname);
+static void *work(void *cl);
+static void serveClient(int fd);
+static int answer(int fd, char *line);
+static int writeAll(int fd, const void *buf, size_t len);
+static File *acquire(const char *path, const char **reason);
+static void release(File *file);
+static void closeFile(File *file);
+static void scaledSize(const File *file, unsigned scale, unsigned *width,
+                       unsigned *height);
+static void getTile(File *file, unsigned scale, unsigned tx, unsigned ty,
+                    unsigned tw, unsigned th, uint8_t *dest);
+static void decodeTile(const File *file, unsigned scale, unsigned tx,
+                       unsigned ty, unsigned tw, unsigned th,
+                       uint8_t *dest);
+
+int main(int argc, char *argv[])
+{
+        long threads = 0;
+        size_t megabytes = 256;
+        unsigned nfiles = 64;
+        int i;
+        for (i = 1; i < argc - 1; i++) {
+                if (strcmp(argv[i], "-j") == 0 && i + 1 < argc - 1) {
+                        threads = atol(argv[++i]);
+                } else if (strcmp(argv[i], "--cache") == 0 &&
+                           i + 1 < argc - 1) {
+                        megabytes = atol(argv[++i]);
+                } else if (strcmp(argv[i], "--files") == 0 &&
+                           i + 1 < argc - 1) {
+                        nfiles = atoi(argv[++i]);
+                } else {
+                        usage(argv[0]);
+                }
+        }
+        if (i != argc - 1 || threads < 0 || nfiles == 0) {
+                usage(argv[0]);
+        }
+        const char *socket_path = argv[i];
+        if (threads == 0) {
+                long online = sysconf(_SC_NPROCESSORS_ONLN);
+                threads = online > 0 ? online : 1;
+        }
+
+        cache = Tilecache_new(megabytes << 20);
+        pool.files = calloc(nfiles, sizeof(*pool.files));
+        pool.capacity = nfiles;
+        assert(cache != NULL && pool.files != NULL);
+
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+                fprintf(stderr, "%s: socket path too long\n", argv[0]);
+                exit(1);
+        }
+        strcpy(addr.sun_path, socket_path);
+        struct stat st;
+        if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+                unlink(socket_path);    /* left by an earlier run */
+        }
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 ||
+            bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(listener, SOMAXCONN) != 0) {
+                perror(socket_path);
+                exit(1);
+        }
+
+        /* the workers inherit a mask without SIGINT and SIGTERM, which
+         * only this thread waits for */
+        sigset_t stop;
+        sigemptyset(&stop);
+        sigaddset(&stop, SIGINT);
+        sigaddset(&stop, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &stop, NULL);
+        signal(SIGPIPE, SIG_IGN);
+        for (long w = 0; w < threads; w++) {
+                pthread_t tid;
+                int err = pthread_create(&tid, NULL, work, NULL);
+                assert(err == 0);
+                pthread_detach(tid);
+        }
+        int sig;
+        sigwait(&stop, &sig);
+        unlink(socket_path);
+        return EXIT_SUCCESS;
+}
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-j threads] [--cache megabytes] "
+                "[--files count] socket\n", progname);
+        exit(1);
+}
+
+/* a worker: takes connections off the listening socket one at a time */
+static void *work(void *cl)
+{
+        (void)cl;
+        for (;;) {
+                int fd = accept(listener, NULL, NULL);
+                if (fd >= 0) {
+                        serveClient(fd);
+                } else if (errno != EINTR && errno != ECONNABORTED) {
+                        perror("accept");
+                        return NULL;
+                }
+        }
+}
+
+/* answers the requests of one connection until it closes or fails */
+static void serveClient(int fd)
+{
+        FILE *in = fdopen(fd, "r");
+        if (in == NULL) {
+                close(fd);
+                return;
+        }
+        char line[PATH_MAX + 64];
+        while (fgets(line, sizeof(line), in) != NULL) {
+                line[strcspn(line, "\n")] = '\0';
+                if (!answer(fd, line)) {
+                        break;
+                }
+        }
+        fclose(in);
+}
+
+/* answers one request; 0 if the client can no longer be written to */
+static int answer(int fd, char *line)
+{
+        char head[128];
+        if (strcmp(line, "stats") == 0) {
+                uint64_t hits, misses;
+                size_t bytes;
+                Tilecache_stats(cache, &hits, &misses, &bytes);
+                snprintf(head, sizeof(head), "OK %llu %llu %zu\n",
+                         (unsigned long long)hits,
+                         (unsigned long long)misses, bytes);
+                return writeAll(fd, head, strlen(head));
+        }
+
+        char kind[8], where[64];
+        unsigned scale;
+        int offset = -1;
+        sscanf(line, "%7s %u %63s %n", kind, &scale, where, &offset);
+        Arith_region box = { 0, 0, UINT_MAX, UINT_MAX };
+        char extra;
+        const char *reason = NULL;
+        if (offset < 0 || line[offset] == '\0' ||
+            (strcmp(kind, "ppm") != 0 && strcmp(kind, "rgb") != 0) ||
+            (scale != 1 && scale != 2 && scale != 4 && scale != 8) ||
+            (strcmp(where, "all") != 0 &&
+             (sscanf(where, "%u,%u,%u,%u%c", &box.x, &box.y, &box.width,
+                     &box.height, &extra) != 4 ||
+              box.width == 0 || box.height == 0))) {
+                reason = "bad request";
+        }
+        File *file = reason == NULL ? acquire(line + offset, &reason)
+                                    : NULL;
+        unsigned width = 0, height = 0;
+        if (file != NULL) {
+                scaledSize(file, scale, &width, &height);
+                if (box.x >= width || box.y >= height) {
+                        reason = "region outside the image";
+                }
+        }
+        if (reason != NULL) {
+                if (file != NULL) {
+                        release(file);
+                }
+                snprintf(head, sizeof(head), "ERR %s\n", reason);
+                return writeAll(fd, head, strlen(head));
+        }
+        if (box.width > width - box.x) {
+                box.width = width - box.x;
+        }
+        if (box.height > height - box.y) {
+                box.height = height - box.y;
+        }
+
+        /* every tile the region touches, from the cache if possible */
+        size_t hlen = strcmp(kind, "ppm") == 0
+                      ? (size_t)snprintf(head, sizeof(head),
+                                         "P6\n%u %u\n255\n", box.width,
+                                         box.height)
+                      : 0;
+        size_t len = hlen + (size_t)box.width * box.height * 3;
+        uint8_t *out = malloc(len);
+        uint8_t tile[TILE * TILE * 3];
+        assert(out != NULL);
+        memcpy(out, head, hlen);
+        for (unsigned ty = box.y / TILE;
+             ty <= (box.y + box.height - 1) / TILE; ty++) {
+                for (unsigned tx = box.x / TILE;
+                     tx <= (box.x + box.width - 1) / TILE; tx++) {
+                        unsigned x0 = tx * TILE, y0 = ty * TILE;
+                        unsigned tw = width - x0 < TILE ? width - x0 : TILE;
+                        unsigned th = height - y0 < TILE ? height - y0
+                                                         : TILE;
+                        getTile(file, scale, tx, ty, tw, th, tile);
+                        unsigned left = x0 > box.x ? x0 : box.x;
+                        unsigned right = x0 + tw < box.x + box.width
+                                         ? x0 + tw : box.x + box.width;
+                        unsigned top = y0 > box.y ? y0 : box.y;
+                        unsigned bottom = y0 + th < box.y + box.height
+                                          ? y0 + th : box.y + box.height;
+                        for (unsigned y = top; y < bottom; y++) {
+                                memcpy(out + hlen + ((size_t)(y - box.y) *
+                                                     box.width +
+                                                     left - box.x) * 3,
+                                       tile + ((size_t)(y - y0) * tw +
+                                               left - x0) * 3,
+                                       (size_t)(right - left) * 3);
+                        }
+                }
+        }
+        release(file);
+
+        snprintf(head, sizeof(head), "OK %u %u %zu\n", box.width,
+                 box.height, len);
+        int ok = writeAll(fd, head, strlen(head)) &&
+                 writeAll(fd, out, len);
+        free(out);
+        return ok;
+}
+
+static int writeAll(int fd, const void *buf, size_t len)
+{
+        const uint8_t *p = buf;
+        while (len > 0) {
+                ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n <= 0) {
+                        return 0;
+                }
+                p += n;
+                len -= n;
+        }
+        return 1;
+}
+
+/* the pooled file at path, mapped on first use and again whenever the
+ * file has changed; NULL, with the reason, if it cannot be read */
+static File *acquire(const char *path, const char **reason)
+{
+        struct stat st;
+        if (stat(path, &st) != 0) {
+                *reason = strerror(errno);
+                return NULL;
+        }
+        Tilecache_key id = { st.st_dev, st.st_ino, st.st_size,
+                             st.st_mtim.tv_sec * 1000000000ull +
+                             st.st_mtim.tv_nsec, 0, 0, 0 };
+
+        pthread_mutex_lock(&pool.lock);
+        for (unsigned k = 0; k < pool.nfiles; k++) {
+                File *file = pool.files[k];
+                if (strcmp(file->path, path) == 0 &&
+                    memcmp(&file->id, &id, sizeof(id)) == 0) {
+                        file->refs++;
+                        file->used = ++pool.clock;
+                        pthread_mutex_unlock(&pool.lock);
+                        return file;
+                }
+        }
+        pthread_mutex_unlock(&pool.lock);
+
+        /* mapped without the lock; a file opened twice at once is simply
+         * pooled twice until one copy is evicted */
+        File *file = calloc(1, sizeof(*file));
+        FILE *fp = fopen(path, "r");
+        assert(file != NULL);
+        if (fp == NULL || !S_ISREG(st.st_mode) || st.st_size == 0) {
+                *reason = fp == NULL ? strerror(errno) : "not a file";
+                if (fp != NULL) {
+                        fclose(fp);
+                }
+                free(file);
+                return NULL;
+        }
+        file->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                         fileno(fp), 0);
+        fclose(fp);
+        if (file->map == MAP_FAILED) {
+                *reason = strerror(errno);
+                free(file);
+                return NULL;
+        }
+        file->maplen = st.st_size;
+        Arith_status status = Arith_codewords(file->map, file->maplen,
+                                              &file->width, &file->height,
+                                              &file->codewords,
+                                              &file->copy);
+        if (status != ARITH_OK) {
+                *reason = Arith_strerror(status);
+                munmap(file->map, file->maplen);
+                free(file);
+                return NULL;
+        }
+        file->path = strdup(path);
+        file->id = id;
+        file->refs = 1;
+        assert(file->path != NULL);
+
+        /* a full pool gives up its least recently used idle file, or
+         * grows if every file is in use */
+        pthread_mutex_lock(&pool.lock);
+        file->used = ++pool.clock;
+        if (pool.nfiles == pool.capacity) {
+                unsigned victim = pool.nfiles;
+                for (unsigned k = 0; k < pool.nfiles; k++) {
+                        if (pool.files[k]->refs == 0 &&
+                            (victim == pool.nfiles ||
+                             pool.files[k]->used <
+                             pool.files[victim]->used)) {
+                                victim = k;
+                        }
+                }
+                if (victim < pool.nfiles) {
+                        closeFile(pool.files[victim]);
+                        pool.files[victim] = pool.files[--pool.nfiles];
+                } else {
+                        pool.capacity *= 2;
+                        pool.files = realloc(pool.files, pool.capacity *
+                                             sizeof(*pool.files));
+                        assert(pool.files != NULL);
+                }
+        }
+        pool.files[pool.nfiles++] = file;
+        pthread_mutex_unlock(&pool.lock);
+        return file;
+}
+
+static void release(File *file)
+{
+        pthread_mutex_lock(&pool.lock);
+        file->refs--;
+        pthread_mutex_unlock(&pool.lock);
+}
+
+static void closeFile(File *file)
+{
+        free(file->copy);
+        munmap(file->map, file->maplen);
+        free(file->path);
+        free(file);
+}
+
+/* the size of the image at 1/scale, as Arith_decompress() makes it */
+static void scaledSize(const File *file, unsigned scale, unsigned *width,
+                       unsigned *height)
+{
+        unsigned factor = scale / 2;
+        *width = scale == 1 ? file->width
+                            : (file->width / 2 + factor - 1) / factor;
+        *height = scale == 1 ? file->height
+                             : (file->height / 2 + factor - 1) / factor;
+}
+
+/* the tw x th RGB tile (tx, ty) of the image at 1/scale, from the cache
+ * or decoded into it */
+static void getTile(File *file, unsigned scale, unsigned tx, unsigned ty,
+                    unsigned tw, unsigned th, uint8_t *dest)
+{
+        Tilecache_key key = file->id;
+        key.scale = scale;
+        key.x = tx;
+        key.y = ty;
+        size_t len = (size_t)tw * th * 3;
+        if (!Tilecache_get(cache, &key, dest, len)) {
+                decodeTile(file, scale, tx, ty, tw, th, dest);
+                Tilecache_put(cache, &key, dest, len);
+        }
+}
+
+/* decodes a tile: at full size two scanlines per row of blocks, and
+ * smaller from the block averages alone, one scanline per scale / 2 rows
+ * of blocks (gathered first, since decodeThumbnailRow() reads whole
+ * rows) */
+static void decodeTile(const File *file, unsigned scale, unsigned tx,
+                       unsigned ty, unsigned tw, unsigned th,
+                       uint8_t *dest)
+{
+        unsigned blocks = file->width / 2, block_rows = file->height / 2;
+        size_t stride = (size_t)blocks * CODEWORD_BYTES;
+        struct Pnm_rgb rows[2][TILE];
+        if (scale == 1) {
+                for (unsigned r = 0; r < th; r += 2) {
+                        decodeBlockRow(file->codewords +
+                                       (ty * TILE + r) / 2 * stride +
+                                       (size_t)tx * TILE / 2 *
+                                       CODEWORD_BYTES,
+                                       tw / 2, 255, rows[0], rows[1]);
+                        dest += Ppmmem_write_row(rows[0], tw, 255, dest);
+                        dest += Ppmmem_write_row(rows[1], tw, 255, dest);
+                }
+                return;
+        }
+
+        unsigned factor = scale / 2;
+        unsigned first_col = tx * TILE * factor;
+        unsigned across = blocks - first_col < TILE * factor
+                          ? blocks - first_col : TILE * factor;
+        uint8_t gathered[(8 / 2) * TILE * (8 / 2) * CODEWORD_BYTES];
+        cv sums[TILE];
+        for (unsigned r = 0; r < th; r++) {
+                unsigned first = (ty * TILE + r) * factor;
+                unsigned nrows = block_rows - first < factor
+                                 ? block_rows - first : factor;
+                for (unsigned k = 0; k < nrows; k++) {
+                        memcpy(gathered + (size_t)k * across *
+                               CODEWORD_BYTES,
+                               file->codewords + (first + k) * stride +
+                               (size_t)first_col * CODEWORD_BYTES,
+                               (size_t)across * CODEWORD_BYTES);
+                }
+                decodeThumbnailRow(gathered, across, nrows, factor, 255,
+                                   sums, rows[0]);
+                dest += Ppmmem_write_row(rows[0], tw, 255, dest);
+        }
+}
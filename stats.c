@@ -0,0 +1,222 @@
+/*********************************************************************
+ *                     stats.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the instrumentation. Times
+ *              are kept in nanoseconds in 64-bit counters. The number of
+ *              read and write system calls is not counted here but taken
+ *              from /proc/self/io when the report is printed, so it
+ *              covers every call the process made, the library's or not.
+ *********************************************************************/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+static const char *stageNames[STATS_NSTAGES] = {
+    "read_input", "parse_header", "read_pixels",
+    "rgb_to_cv", "cv_to_dct", "rgb_to_dct", "pack",
+    "unpack", "dct_to_cv", "cv_to_rgb", "write_ppm",
+    "rows", "write_output"
+};
+
+static int enabled = 0;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static uint64_t startWall;
+
+static uint64_t stageWall[STATS_NSTAGES];
+static uint64_t stageCpu[STATS_NSTAGES];
+static uint64_t stageCalls[STATS_NSTAGES];
+static uint64_t allocs, allocBytes;
+static uint64_t bytesRead, bytesWritten;
+static uint64_t blockHits, blockFlat, blockComputed;
+
+static void readEnvironment(void);
+static void report(void);
+static uint64_t nanoseconds(clockid_t clock);
+static void add(uint64_t *counter, uint64_t amount);
+static long long procField(const char *name);
+
+
+/*  Name: Stats_init
+ *  Purpose: This function checks ARITH_STATS the first time it is called.
+ */
+void Stats_init(void)
+{
+    pthread_once(&once, readEnvironment);
+}
+
+/*  Name: Stats_enable
+ *  Purpose: This function turns the instrumentation on (once) and
+ *           registers the report with atexit().
+ */
+void Stats_enable(void)
+{
+    if (enabled) {
+        return;
+    }
+    startWall = nanoseconds(CLOCK_MONOTONIC);
+    enabled = 1;
+    atexit(report);
+}
+
+/*  Name: Stats_start
+ *  Purpose: This function reads both clocks when the instrumentation is on.
+ */
+Stats_clock Stats_start(void)
+{
+    Stats_clock now = { 0, 0 };
+    if (enabled) {
+        now.wall = nanoseconds(CLOCK_MONOTONIC);
+        now.cpu = nanoseconds(CLOCK_THREAD_CPUTIME_ID);
+    }
+    return now;
+}
+
+/*  Name: Stats_lap
+ *  Purpose: This function charges the time since start to a stage.
+ *  Input: the stage and the clock returned by Stats_start or Stats_lap
+ *  Output: the current clock
+ */
+Stats_clock Stats_lap(Stats_stage stage, Stats_clock start)
+{
+    if (!enabled) {
+        return start;
+    }
+    Stats_clock now = Stats_start();
+    add(&stageWall[stage], now.wall - start.wall);
+    add(&stageCpu[stage], now.cpu - start.cpu);
+    add(&stageCalls[stage], 1);
+    return now;
+}
+
+/*  Name: Stats_alloc
+ *  Purpose: This function counts an allocation.
+ */
+void Stats_alloc(size_t bytes)
+{
+    if (enabled) {
+        add(&allocs, 1);
+        add(&allocBytes, bytes);
+    }
+}
+
+/*  Name: Stats_io
+ *  Purpose: This function counts bytes moved in and out of the process.
+ */
+void Stats_io(size_t read, size_t written)
+{
+    if (enabled) {
+        add(&bytesRead, read);
+        add(&bytesWritten, written);
+    }
+}
+
+/*  Name: Stats_blocks
+ *  Purpose: This function counts blocks encoded, by how they were encoded.
+ */
+void Stats_blocks(uint64_t hits, uint64_t flat, uint64_t computed)
+{
+    if (enabled) {
+        add(&blockHits, hits);
+        add(&blockFlat, flat);
+        add(&blockComputed, computed);
+    }
+}
+
+/*  Name: readEnvironment
+ *  Purpose: This function enables the instrumentation if ARITH_STATS is
+ *           set to anything but "" or "0".
+ */
+static void readEnvironment(void)
+{
+    const char *value = getenv("ARITH_STATS");
+    if (value != NULL && *value != '\0' && strcmp(value, "0") != 0) {
+        Stats_enable();
+    }
+}
+
+/*  Name: report
+ *  Purpose: This function prints the totals as one JSON object on stderr;
+ *           stages that never ran are left out.
+ */
+static void report(void)
+{
+    double wall = (nanoseconds(CLOCK_MONOTONIC) - startWall) / 1e9;
+    double cpu = nanoseconds(CLOCK_PROCESS_CPUTIME_ID) / 1e9;
+    char line[4096];
+    int len = snprintf(line, sizeof(line),
+                       "{\"wall_s\":%.6f,\"cpu_s\":%.6f,\"stages\":{",
+                       wall, cpu);
+    const char *sep = "";
+    for (int s = 0; s < STATS_NSTAGES; s++) {
+        if (stageCalls[s] == 0) {
+            continue;
+        }
+        len += snprintf(line + len, sizeof(line) - len,
+                        "%s\"%s\":{\"calls\":%llu,\"wall_s\":%.6f,"
+                        "\"cpu_s\":%.6f}", sep, stageNames[s],
+                        (unsigned long long)stageCalls[s],
+                        stageWall[s] / 1e9, stageCpu[s] / 1e9);
+        sep = ",";
+    }
+    snprintf(line + len, sizeof(line) - len,
+             "},\"allocs\":%llu,\"alloc_bytes\":%llu,"
+             "\"bytes_read\":%llu,\"bytes_written\":%llu,"
+             "\"read_syscalls\":%lld,\"write_syscalls\":%lld,"
+             "\"block_memo_hits\":%llu,\"flat_blocks\":%llu,"
+             "\"blocks_transformed\":%llu}",
+             (unsigned long long)allocs, (unsigned long long)allocBytes,
+             (unsigned long long)bytesRead,
+             (unsigned long long)bytesWritten,
+             procField("syscr"), procField("syscw"),
+             (unsigned long long)blockHits, (unsigned long long)blockFlat,
+             (unsigned long long)blockComputed);
+    fprintf(stderr, "%s\n", line);
+}
+
+/*  Name: nanoseconds
+ *  Purpose: This function reads a clock in nanoseconds.
+ */
+static uint64_t nanoseconds(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/*  Name: add
+ *  Purpose: This function adds to a counter that other threads may be
+ *           adding to at the same time.
+ */
+static void add(uint64_t *counter, uint64_t amount)
+{
+    __atomic_fetch_add(counter, amount, __ATOMIC_RELAXED);
+}
+
+/*  Name: procField
+ *  Purpose: This function returns a field of /proc/self/io.
+ *  Output: its value, or -1 where there is no such file
+ */
+static long long procField(const char *name)
+{
+    FILE *fp = fopen("/proc/self/io", "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    char key[32];
+    long long value, found = -1;
+    while (fscanf(fp, "%31[^:]: %lld ", key, &value) == 2) {
+        if (strcmp(key, name) == 0) {
+            found = value;
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+}
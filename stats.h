@@ -0,0 +1,60 @@
+/*********************************************************************
+ *                     stats.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for the built-in instrumentation.
+ *              When it is on ("40image --stats", or ARITH_STATS=1 in
+ *              the environment of any program using the library) it
+ *              adds up the wall and CPU time of every stage, the
+ *              allocations the library makes and the bytes it reads and
+ *              writes, and prints them as one line of JSON on stderr at
+ *              exit. When it is off every call returns after testing
+ *              one flag. The counters are updated atomically, so batch
+ *              and pipelined modes can be measured too.
+ *********************************************************************/
+
+#ifndef STATS_INCLUDED
+#define STATS_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    STATS_READ_INPUT, STATS_PARSE_HEADER, STATS_READ_PIXELS,
+    STATS_RGB_TO_CV, STATS_CV_TO_DCT, STATS_RGB_TO_DCT, STATS_PACK,
+    STATS_UNPACK, STATS_DCT_TO_CV, STATS_CV_TO_RGB, STATS_WRITE_PPM,
+    STATS_ROWS, STATS_WRITE_OUTPUT,
+    STATS_NSTAGES
+} Stats_stage;
+
+/* a point in time on the wall clock and the calling thread's CPU clock */
+typedef struct Stats_clock {
+    uint64_t wall, cpu;
+} Stats_clock;
+
+/* turns the instrumentation on if ARITH_STATS is set and not "0"; only
+ * the first call does anything, so every library entry point makes it */
+extern void Stats_init(void);
+
+/* turns the instrumentation on and arranges for the report at exit */
+extern void Stats_enable(void);
+
+/* starts timing; returns zeros when the instrumentation is off */
+extern Stats_clock Stats_start(void);
+
+/* charges the time since start to stage and returns the current time,
+ * which starts the next stage */
+extern Stats_clock Stats_lap(Stats_stage stage, Stats_clock start);
+
+/* counts one allocation of bytes */
+extern void Stats_alloc(size_t bytes);
+
+/* counts bytes read from and written to files or streams */
+extern void Stats_io(size_t read, size_t written);
+
+/* counts 2x2 blocks encoded: found in a block memo, transformed as flat
+ * (four equal pixels) and transformed in full */
+extern void Stats_blocks(uint64_t hits, uint64_t flat, uint64_t computed);
+
+#endif
@@ -0,0 +1,193 @@
+/*********************************************************************
+ *                     survey.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for measuring an image from
+ *              its codewords. The pass reads the bytes of each codeword
+ *              straight from the grid: a is the top six bits of the
+ *              first and the two chroma indices are the last, so the
+ *              common case is two table increments per block. Counts go
+ *              to LANES tables in turn, so that runs of equal blocks do
+ *              not wait on one counter.
+ *********************************************************************/
+
+
+#include <string.h>
+#include "assert.h"
+#include "survey.h"
+#include "arith40.h"
+#include "bitpack_fast.h"
+#include "codeword.h"
+
+/* tables counted into in turn */
+#define LANES 4
+
+/* cells of the hash along each side */
+#define SIDE 8
+
+/* a and b, c, d are quantized by these (calculation.c); a luma of
+ * (a * 103 + s * 63) / (63 * 103) is 0 to 1 */
+#define A_SCALE 63
+#define BCD_SCALE 103
+
+static unsigned lumaBin(int scaled);
+static unsigned cellStart(unsigned cell, unsigned blocks);
+static double variance(double mean_square, double mean);
+
+
+/*  Name: Survey_scan
+ *  Purpose: This function counts the fields of every block, sums a over
+ *           the cells of the hash, and turns the counts into the
+ *           statistics.
+ *  Input: the grid, its codewords per row and its rows, whether to count
+ *         the four pixels of a block apart, and the summary to fill in
+ *  Output: N/A
+ *  Error condition: CRE if grid or summary is NULL.
+ */
+void Survey_scan(const uint8_t *grid, unsigned across, unsigned rows,
+                 int detail, Arith_summary *summary)
+{
+    assert(grid != NULL && summary != NULL);
+    uint64_t averages[LANES][1 << 6];
+    uint64_t chroma[LANES][1 << 8];
+    uint64_t luma[LANES][ARITH_LUMA_BINS];
+    uint64_t cells[SIDE][SIDE];
+    memset(averages, 0, sizeof(averages));
+    memset(chroma, 0, sizeof(chroma));
+    memset(luma, 0, sizeof(luma));
+    memset(cells, 0, sizeof(cells));
+
+    for (unsigned r = 0; r < rows; r++) {
+        const uint8_t *row = grid + (size_t)r * across * CODEWORD_BYTES;
+        unsigned u = (uint64_t)r * SIDE / rows;
+        for (unsigned v = 0; v < SIDE; v++) {
+            uint64_t sum = 0;
+            unsigned end = cellStart(v + 1, across);
+            for (unsigned i = cellStart(v, across); i < end; i++) {
+                const uint8_t *cw = row + (size_t)i * CODEWORD_BYTES;
+                unsigned a = cw[0] >> 2;
+                averages[i % LANES][a]++;
+                chroma[i % LANES][cw[3]]++;
+                sum += a;
+                if (detail) {
+                    uint32_t word = Codeword_get(cw);
+                    int g[3];
+                    for (int f = 0; f < 3; f++) {
+                        g[f] = Bitpack_fast_gets(word,
+                                                 Codeword_field_width[f + 1],
+                                                 Codeword_field_lsb[f + 1]);
+                    }
+                    int base = a * BCD_SCALE;
+                    uint64_t *lane = luma[i % LANES];
+                    lane[lumaBin(base + A_SCALE * (-g[0] - g[1] + g[2]))]++;
+                    lane[lumaBin(base + A_SCALE * (-g[0] + g[1] - g[2]))]++;
+                    lane[lumaBin(base + A_SCALE * (g[0] - g[1] - g[2]))]++;
+                    lane[lumaBin(base + A_SCALE * (g[0] + g[1] + g[2]))]++;
+                }
+            }
+            cells[u][v] += sum;
+        }
+    }
+
+    for (unsigned k = 1; k < LANES; k++) {
+        for (unsigned j = 0; j < 1 << 6; j++) {
+            averages[0][j] += averages[k][j];
+        }
+        for (unsigned j = 0; j < 1 << 8; j++) {
+            chroma[0][j] += chroma[k][j];
+        }
+        for (unsigned j = 0; j < ARITH_LUMA_BINS; j++) {
+            luma[0][j] += luma[k][j];
+        }
+    }
+    double blocks = (double)across * rows;
+    double total = 0;
+    for (unsigned a = 0; a < 1 << 6; a++) {
+        total += (double)a * averages[0][a];
+        if (!detail) {
+            luma[0][lumaBin(a * BCD_SCALE)] += 4 * averages[0][a];
+        }
+    }
+    memcpy(summary -> luma, luma[0], sizeof(summary -> luma));
+    summary -> mean_y = total / blocks / A_SCALE;
+
+    /* the last byte is avepbQUANT << 4 | aveprQUANT */
+    double pb = 0, pb2 = 0, pr = 0, pr2 = 0;
+    for (unsigned j = 0; j < 1 << 8; j++) {
+        float x = Arith40_chroma_of_index(j >> 4);
+        float y = Arith40_chroma_of_index(j & 0xf);
+        pb += (double)x * chroma[0][j];
+        pb2 += (double)x * x * chroma[0][j];
+        pr += (double)y * chroma[0][j];
+        pr2 += (double)y * y * chroma[0][j];
+    }
+    summary -> mean_pb = pb / blocks;
+    summary -> mean_pr = pr / blocks;
+    summary -> var_pb = variance(pb2 / blocks, summary -> mean_pb);
+    summary -> var_pr = variance(pr2 / blocks, summary -> mean_pr);
+
+    /* a grid narrower or shorter than SIDE leaves cells empty; they take
+     * the mean of the cell of the block where they start */
+    double means[SIDE][SIDE], sum = 0;
+    for (unsigned u = 0; u < SIDE; u++) {
+        for (unsigned v = 0; v < SIDE; v++) {
+            unsigned down = cellStart(u + 1, rows) - cellStart(u, rows);
+            unsigned wide = cellStart(v + 1, across) - cellStart(v, across);
+            means[u][v] = down * wide > 0
+                          ? (double)cells[u][v] / ((double)down * wide)
+                          : -1;
+        }
+    }
+    for (unsigned u = 0; u < SIDE; u++) {
+        for (unsigned v = 0; v < SIDE; v++) {
+            if (means[u][v] < 0) {
+                unsigned su = (uint64_t)u * rows / SIDE * SIDE / rows;
+                unsigned sv = (uint64_t)v * across / SIDE * SIDE / across;
+                means[u][v] = means[su][sv];
+            }
+            sum += means[u][v];
+        }
+    }
+    summary -> hash = 0;
+    for (unsigned k = 0; k < SIDE * SIDE; k++) {
+        if (means[k / SIDE][k % SIDE] * SIDE * SIDE > sum) {
+            summary -> hash |= (uint64_t)1 << (SIDE * SIDE - 1 - k);
+        }
+    }
+}
+
+/*  Name: lumaBin
+ *  Purpose: This function finds the bin of a luma scaled by 63 * 103,
+ *           clamped to 0 to 1 as the decoder clamps it.
+ *  Output: the bin, below ARITH_LUMA_BINS
+ */
+static unsigned lumaBin(int scaled)
+{
+    if (scaled <= 0) {
+        return 0;
+    }
+    unsigned bin = (unsigned)scaled * ARITH_LUMA_BINS /
+                   (A_SCALE * BCD_SCALE);
+    return bin < ARITH_LUMA_BINS ? bin : ARITH_LUMA_BINS - 1;
+}
+
+/*  Name: cellStart
+ *  Purpose: This function finds the first of blocks blocks that falls in
+ *           cell (block i is in cell i * SIDE / blocks).
+ *  Output: the index of the block, blocks for cell SIDE
+ */
+static unsigned cellStart(unsigned cell, unsigned blocks)
+{
+    return ((uint64_t)cell * blocks + SIDE - 1) / SIDE;
+}
+
+/*  Name: variance
+ *  Purpose: This function is E[x^2] - E[x]^2, kept from going below 0 by
+ *           rounding.
+ */
+static double variance(double mean_square, double mean)
+{
+    double var = mean_square - mean * mean;
+    return var > 0 ? var : 0;
+}
@@ -0,0 +1,35 @@
+/*********************************************************************
+ *                     survey.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for measuring an image from its
+ *              codewords alone. Every statistic is a function of the
+ *              quantized fields, so it is gathered by counting field
+ *              values in one pass over the grid and converted to real
+ *              numbers once at the end:
+ *
+ *                  luma        a / 63, or with detail the four pixels
+ *                              a +- b +- c +- d of the block (b, c and
+ *                              d over 103), in ARITH_LUMA_BINS bins
+ *                  Pb, Pr      Arith40_chroma_of_index() of the
+ *                              indices, weighted by their counts
+ *                  hash        the grid of a cut into 8 x 8 cells;
+ *                              bit k (from the top) is set when cell k
+ *                              is brighter than the mean of the cells
+ *********************************************************************/
+
+#ifndef SURVEY_INCLUDED
+#define SURVEY_INCLUDED
+
+#include <stdint.h>
+#include "arith.h"
+
+/* Function: Survey_scan()
+ * Job: fill in every field of *summary but the dimensions from the grid
+ *      of rows rows of across plain (format 2) codewords at grid.
+ */
+extern void Survey_scan(const uint8_t *grid, unsigned across, unsigned rows,
+                        int detail, Arith_summary *summary);
+
+#endif
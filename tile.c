@@ -0,0 +1,473 @@
+/*********************************************************************
+ *                     tile.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the tiled container. The
+ *              whole index is checked when a container is opened, so a
+ *              tile can be found by one lookup afterwards. Decoding a
+ *              tile goes straight from its codewords to P6 samples with
+ *              decodeBlockRow(), one row of blocks at a time, into the
+ *              rectangle of the output the tile covers; tiles never
+ *              share output bytes, so workers need no locks.
+ *********************************************************************/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "assert.h"
+#include "tile.h"
+#include "codec.h"
+#include "codeword.h"
+#include "ppmmem.h"
+#include "predict.h"
+#include "rans.h"
+#include "stats.h"
+
+/* state shared by the workers of one Tile_decode() */
+typedef struct Job {
+    const Tile_layout *layout;
+    uint8_t *pixels;
+    unsigned ntiles;
+    unsigned next;          /* next tile to take, atomically */
+    int status;             /* first error, ARITH_OK otherwise */
+} Job;
+
+/* memory one worker decodes its tiles with */
+typedef struct Scratch {
+    uint8_t *codewords;     /* one tile's worth */
+    struct Pnm_rgb *top, *bottom;
+} Scratch;
+
+static uint64_t offsetAt(const Tile_layout *layout, unsigned i);
+static void putOffset(uint8_t *dest, uint64_t offset);
+static Arith_status unpackTile(const Tile_layout *layout, unsigned index,
+                               uint8_t *dest, size_t stride);
+static Arith_status decodeTile(const Tile_layout *layout, unsigned index,
+                               Scratch *scratch, uint8_t *pixels,
+                               size_t row_bytes);
+static int newScratch(const Tile_layout *layout, Scratch *scratch);
+static void freeScratch(Scratch *scratch);
+static void *work(void *cl);
+
+
+/*  Name: Tile_bound
+ *  Purpose: This function bounds the size of a container: the header, the
+ *           index, one coding byte per tile and every codeword.
+ *  Input: the image and tile dimensions
+ *  Output: a size in bytes
+ */
+size_t Tile_bound(unsigned width, unsigned height, unsigned tile_width,
+                  unsigned tile_height)
+{
+    assert(tile_width >= 2 && tile_height >= 2);
+    size_t ntiles = (size_t)((width + tile_width - 1) / tile_width) *
+                    ((height + tile_height - 1) / tile_height);
+    return CODEWORD_HEADER_MAX + (ntiles + 1) * TILE_OFFSET_BYTES + ntiles +
+           Codeword_image_size(width, height);
+}
+
+/*  Name: Tile_pack
+ *  Purpose: This function regroups the codewords of a format 2 image into
+ *           tiles and writes the index in front of them. To predict or
+ *           entropy code a tile its codewords are first gathered into one
+ *           run; if that memory cannot be had, every tile is simply left
+ *           raw.
+ *  Input: the codewords, the image and tile dimensions, the coding and
+ *         the output
+ *  Output: the number of bytes written
+ *  Error condition: CRE if a pointer is NULL, a dimension is odd or less
+ *                   than 2, or the coding is unknown.
+ */
+size_t Tile_pack(const uint8_t *grid, unsigned width, unsigned height,
+                 unsigned tile_width, unsigned tile_height, int coding,
+                 uint8_t *dest)
+{
+    assert(grid != NULL && dest != NULL);
+    int predict = coding & TILE_PREDICTED;
+    coding &= ~TILE_PREDICTED;
+    assert(coding == TILE_RAW || coding == TILE_RANS);
+    assert(width >= 2 && height >= 2 && width % 2 == 0 && height % 2 == 0);
+    assert(tile_width >= 2 && tile_height >= 2);
+    assert(tile_width % 2 == 0 && tile_height % 2 == 0);
+    Tile_layout layout = { width, height, tile_width, tile_height,
+                           (width + tile_width - 1) / tile_width,
+                           (height + tile_height - 1) / tile_height,
+                           NULL, 0, 0, 0 };
+    unsigned ntiles = layout.across * layout.down;
+    size_t stride = (size_t)(width / 2) * CODEWORD_BYTES;
+
+    size_t len = Codeword_tiled_header_write(dest, width, height,
+                                             tile_width, tile_height);
+    uint8_t *index = dest + len;
+    uint8_t *data = index + (size_t)(ntiles + 1) * TILE_OFFSET_BYTES;
+    uint8_t *p = data;
+    uint8_t *run = NULL;
+    if (coding == TILE_RANS || predict) {
+        run = malloc(Codeword_image_size(tile_width < width ? tile_width
+                                                            : width,
+                                         tile_height < height ? tile_height
+                                                              : height));
+    }
+    for (unsigned t = 0; t < ntiles; t++) {
+        unsigned x, y, w, h;
+        Tile_bounds(&layout, t, &x, &y, &w, &h);
+        putOffset(index + (size_t)t * TILE_OFFSET_BYTES, p - data);
+        const uint8_t *src = grid + (y / 2) * stride +
+                             (size_t)(x / 2) * CODEWORD_BYTES;
+        size_t row = (size_t)(w / 2) * CODEWORD_BYTES;
+        size_t size = row * (h / 2);
+        if (run == NULL) {
+            *p++ = TILE_RAW;
+            for (unsigned r = 0; r < h / 2; r++, src += stride, p += row) {
+                memcpy(p, src, row);
+            }
+            continue;
+        }
+        for (unsigned r = 0; r < h / 2; r++) {
+            memcpy(run + r * row, src + r * stride, row);
+        }
+        if (predict) {
+            Predict_encode(run, w / 2, h / 2, row);
+        }
+        size_t coded = 0;
+        if (coding == TILE_RANS) {
+            coded = Rans_encode(run, (size_t)(w / 2) * (h / 2), p + 1,
+                                size - 1);
+        }
+        if (coded > 0) {
+            *p++ = TILE_RANS | predict;
+            p += coded;
+        } else {
+            *p++ = TILE_RAW | predict;
+            memcpy(p, run, size);
+            p += size;
+        }
+    }
+    free(run);
+    putOffset(index + (size_t)ntiles * TILE_OFFSET_BYTES, p - data);
+    return p - dest;
+}
+
+/*  Name: Tile_open
+ *  Purpose: This function checks a container: its header, that the index
+ *           fits, and that every tile lies inside the data and holds at
+ *           least its coding byte.
+ *  Input: the container, its length and the layout to fill in
+ *  Output: ARITH_OK, ARITH_EBADFORMAT or ARITH_ETRUNCATED
+ *  Error condition: CRE if a pointer is NULL.
+ */
+Arith_status Tile_open(const uint8_t *src, size_t n, Tile_layout *layout)
+{
+    assert(src != NULL && layout != NULL);
+    size_t len;
+    Arith_status status = Codeword_tiled_header_parse(
+        src, n, &layout -> width, &layout -> height, &layout -> tile_width,
+        &layout -> tile_height, &len);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    layout -> across = (layout -> width + layout -> tile_width - 1) /
+                       layout -> tile_width;
+    layout -> down = (layout -> height + layout -> tile_height - 1) /
+                     layout -> tile_height;
+    if (layout -> across > (unsigned)-2 / layout -> down) {
+        return ARITH_EBADFORMAT;
+    }
+    unsigned ntiles = layout -> across * layout -> down;
+    if ((n - len) / TILE_OFFSET_BYTES < (size_t)ntiles + 1) {
+        return ARITH_ETRUNCATED;
+    }
+    layout -> src = src;
+    layout -> n = n;
+    layout -> index = len;
+    layout -> data = len + ((size_t)ntiles + 1) * TILE_OFFSET_BYTES;
+
+    uint64_t previous = offsetAt(layout, 0);
+    if (previous != 0) {
+        return ARITH_EBADFORMAT;
+    }
+    for (unsigned t = 1; t <= ntiles; t++) {
+        uint64_t offset = offsetAt(layout, t);
+        if (offset <= previous) {
+            return ARITH_EBADFORMAT;
+        }
+        previous = offset;
+    }
+    return previous > n - layout -> data ? ARITH_ETRUNCATED : ARITH_OK;
+}
+
+/*  Name: Tile_bounds
+ *  Purpose: This function locates a tile in the image.
+ *  Input: the layout, the tile and locations for its position and size
+ *  Output: N/A
+ *  Error condition: CRE if a pointer is NULL or there is no such tile.
+ */
+void Tile_bounds(const Tile_layout *layout, unsigned index, unsigned *x,
+                 unsigned *y, unsigned *width, unsigned *height)
+{
+    assert(layout != NULL && x != NULL && y != NULL);
+    assert(width != NULL && height != NULL);
+    assert(index < layout -> across * layout -> down);
+    *x = index % layout -> across * layout -> tile_width;
+    *y = index / layout -> across * layout -> tile_height;
+    *width = layout -> width - *x < layout -> tile_width
+             ? layout -> width - *x : layout -> tile_width;
+    *height = layout -> height - *y < layout -> tile_height
+              ? layout -> height - *y : layout -> tile_height;
+}
+
+/*  Name: Tile_unpack
+ *  Purpose: This function puts the codewords of one tile where they belong
+ *           in a format 2 grid.
+ *  Input: the layout, the tile, the grid and the bytes per row of blocks
+ *  Output: ARITH_OK or ARITH_EBADFORMAT
+ *  Error condition: CRE if a pointer is NULL.
+ */
+Arith_status Tile_unpack(const Tile_layout *layout, unsigned index,
+                         uint8_t *grid, size_t stride)
+{
+    assert(layout != NULL && grid != NULL);
+    unsigned x, y, w, h;
+    Tile_bounds(layout, index, &x, &y, &w, &h);
+    return unpackTile(layout, index, grid + (y / 2) * stride +
+                      (size_t)(x / 2) * CODEWORD_BYTES, stride);
+}
+
+/*  Name: Tile_decode
+ *  Purpose: This function decodes every tile of an image, spreading the
+ *           tiles over a pool of threads that each take the next one in
+ *           turn.
+ *  Input: the layout, the number of threads and the output samples
+ *  Output: ARITH_OK, or the first error any tile had
+ *  Error condition: CRE if a pointer is NULL or threads cannot be made.
+ */
+Arith_status Tile_decode(const Tile_layout *layout, unsigned threads,
+                         uint8_t *pixels)
+{
+    assert(layout != NULL && pixels != NULL);
+    Job job = { layout, pixels, layout -> across * layout -> down, 0,
+                ARITH_OK };
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? online : 1;
+    }
+    if (threads > job.ntiles) {
+        threads = job.ntiles;
+    }
+    if (threads <= 1) {
+        work(&job);
+        return job.status;
+    }
+
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    if (tids == NULL) {
+        return ARITH_ENOMEM;
+    }
+    for (unsigned w = 0; w < threads; w++) {
+        int err = pthread_create(&tids[w], NULL, work, &job);
+        assert(err == 0);
+    }
+    for (unsigned w = 0; w < threads; w++) {
+        pthread_join(tids[w], NULL);
+    }
+    free(tids);
+    return job.status;
+}
+
+/*  Name: Tile_decode_one
+ *  Purpose: This function decodes a single tile, reading nothing but its
+ *           own index entries and data.
+ *  Input: the layout, the tile and the output samples
+ *  Output: ARITH_OK, ARITH_EBADFORMAT or ARITH_ENOMEM
+ *  Error condition: CRE if a pointer is NULL or there is no such tile.
+ */
+Arith_status Tile_decode_one(const Tile_layout *layout, unsigned index,
+                             uint8_t *pixels)
+{
+    assert(layout != NULL && pixels != NULL);
+    unsigned x, y, w, h;
+    Tile_bounds(layout, index, &x, &y, &w, &h);
+    Scratch scratch;
+    if (!newScratch(layout, &scratch)) {
+        return ARITH_ENOMEM;
+    }
+    Arith_status status = decodeTile(layout, index, &scratch, pixels,
+                                     Ppmmem_row_bytes(w, 255));
+    freeScratch(&scratch);
+    return status;
+}
+
+/*  Name: offsetAt
+ *  Purpose: This function reads entry i of the index.
+ */
+static uint64_t offsetAt(const Tile_layout *layout, unsigned i)
+{
+    const uint8_t *p = layout -> src + layout -> index +
+                       (size_t)i * TILE_OFFSET_BYTES;
+    uint64_t offset = 0;
+    for (int b = 0; b < TILE_OFFSET_BYTES; b++) {
+        offset = offset << 8 | p[b];
+    }
+    return offset;
+}
+
+/*  Name: putOffset
+ *  Purpose: This function writes an index entry, most significant byte
+ *           first.
+ */
+static void putOffset(uint8_t *dest, uint64_t offset)
+{
+    for (int b = TILE_OFFSET_BYTES - 1; b >= 0; b--) {
+        dest[b] = offset & 0xff;
+        offset >>= 8;
+    }
+}
+
+/*  Name: unpackTile
+ *  Purpose: This function decodes the codewords of one tile into rows of
+ *           blocks stride bytes apart starting at dest, restoring the
+ *           averages if the tile was predicted.
+ *  Input: the layout, the tile, the destination and its stride
+ *  Output: ARITH_OK, or ARITH_EBADFORMAT for an unknown coding or a tile
+ *          of the wrong length
+ */
+static Arith_status unpackTile(const Tile_layout *layout, unsigned index,
+                               uint8_t *dest, size_t stride)
+{
+    unsigned x, y, w, h;
+    Tile_bounds(layout, index, &x, &y, &w, &h);
+    uint64_t start = offsetAt(layout, index);
+    uint64_t end = offsetAt(layout, index + 1);
+    const uint8_t *body = layout -> src + layout -> data + start + 1;
+    size_t len = end - start - 1;
+    size_t row = (size_t)(w / 2) * CODEWORD_BYTES;
+
+    Arith_status status = ARITH_EBADFORMAT;
+    switch (body[-1] & ~TILE_PREDICTED) {
+    case TILE_RAW:
+        if (len != row * (h / 2)) {
+            return ARITH_EBADFORMAT;
+        }
+        for (unsigned r = 0; r < h / 2; r++) {
+            memcpy(dest + r * stride, body + r * row, row);
+        }
+        status = ARITH_OK;
+        break;
+    case TILE_RANS:
+        status = Rans_decode(body, len, w / 2, h / 2, dest, stride);
+        break;
+    }
+    if (status == ARITH_OK && (body[-1] & TILE_PREDICTED)) {
+        Predict_decode(dest, w / 2, h / 2, stride);
+    }
+    return status;
+}
+
+/*  Name: decodeTile
+ *  Purpose: This function decodes one tile into the P6 samples of the
+ *           rectangle it covers.
+ *  Input: the layout, the tile, scratch memory, the samples of the
+ *         tile's top left pixel and the bytes from one row of samples to
+ *         the next
+ *  Output: ARITH_OK or ARITH_EBADFORMAT
+ */
+static Arith_status decodeTile(const Tile_layout *layout, unsigned index,
+                               Scratch *scratch, uint8_t *pixels,
+                               size_t row_bytes)
+{
+    unsigned x, y, w, h;
+    Tile_bounds(layout, index, &x, &y, &w, &h);
+    size_t stride = (size_t)(w / 2) * CODEWORD_BYTES;
+    Arith_status status = unpackTile(layout, index, scratch -> codewords,
+                                     stride);
+    if (status != ARITH_OK) {
+        return status;
+    }
+    const uint8_t *src = scratch -> codewords;
+    for (unsigned r = 0; r < h / 2; r++, src += stride) {
+        decodeBlockRow(src, w / 2, 255, scratch -> top, scratch -> bottom);
+        Ppmmem_write_row(scratch -> top, w, 255, pixels);
+        pixels += row_bytes;
+        Ppmmem_write_row(scratch -> bottom, w, 255, pixels);
+        pixels += row_bytes;
+    }
+    return ARITH_OK;
+}
+
+/*  Name: newScratch
+ *  Purpose: This function allocates a worker's memory for the largest
+ *           tile.
+ *  Output: 1, or 0 when out of memory
+ */
+static int newScratch(const Tile_layout *layout, Scratch *scratch)
+{
+    unsigned w = layout -> tile_width < layout -> width
+                 ? layout -> tile_width : layout -> width;
+    unsigned h = layout -> tile_height < layout -> height
+                 ? layout -> tile_height : layout -> height;
+    scratch -> codewords = malloc(Codeword_image_size(w, h));
+    scratch -> top = malloc(2 * (size_t)w * sizeof(struct Pnm_rgb));
+    scratch -> bottom = scratch -> top + w;
+    if (scratch -> codewords == NULL || scratch -> top == NULL) {
+        freeScratch(scratch);
+        return 0;
+    }
+    Stats_alloc(Codeword_image_size(w, h) +
+                2 * (size_t)w * sizeof(struct Pnm_rgb));
+    return 1;
+}
+
+/*  Name: freeScratch
+ *  Purpose: This function releases a worker's memory.
+ */
+static void freeScratch(Scratch *scratch)
+{
+    free(scratch -> codewords);
+    free(scratch -> top);
+}
+
+/*  Name: work
+ *  Purpose: This function is a worker of Tile_decode(): it takes tiles
+ *           until there are none left or some tile has failed.
+ *  Input: the Job
+ *  Output: NULL
+ */
+static void *work(void *cl)
+{
+    Job *job = cl;
+    const Tile_layout *layout = job -> layout;
+    size_t row_bytes = Ppmmem_row_bytes(layout -> width, 255);
+    Scratch scratch;
+    if (!newScratch(layout, &scratch)) {
+        int expected = ARITH_OK;
+        __atomic_compare_exchange_n(&job -> status, &expected, ARITH_ENOMEM,
+                                    0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    for (;;) {
+        unsigned t = __atomic_fetch_add(&job -> next, 1, __ATOMIC_RELAXED);
+        if (t >= job -> ntiles ||
+            __atomic_load_n(&job -> status, __ATOMIC_RELAXED) != ARITH_OK) {
+            break;
+        }
+        unsigned x, y, w, h;
+        Tile_bounds(layout, t, &x, &y, &w, &h);
+        Stats_clock clock = Stats_start();
+        Arith_status status = decodeTile(layout, t, &scratch,
+                                         job -> pixels + y * row_bytes +
+                                         Ppmmem_row_bytes(x, 255),
+                                         row_bytes);
+        Stats_lap(STATS_ROWS, clock);
+        if (status != ARITH_OK) {
+            int expected = ARITH_OK;
+            __atomic_compare_exchange_n(&job -> status, &expected, status,
+                                        0, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED);
+        }
+    }
+    freeScratch(&scratch);
+    return NULL;
+}
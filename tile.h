@@ -0,0 +1,117 @@
+/*********************************************************************
+ *                     tile.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for the tiled container, "COMP40
+ *              Compressed image format 3". The image is cut into tiles
+ *              of tile_width x tile_height pixels (the last column and
+ *              row may be narrower); each tile holds the codewords of
+ *              its own blocks and can be decoded on its own. The layout
+ *              is
+ *
+ *                  text header (Codeword_tiled_header_write)
+ *                  index: ntiles + 1 offsets, 8 bytes big-endian each
+ *                  tile 0, tile 1, ... in row-major order
+ *
+ *              Offsets count from the first byte after the index, so
+ *              tile i is bytes [offset[i], offset[i + 1]) of the data.
+ *              The first byte of a tile says how it is coded; the rest
+ *              is the tile's codewords in that coding.
+ *********************************************************************/
+
+#ifndef TILE_INCLUDED
+#define TILE_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arith.h"
+
+/* codings of a tile */
+#define TILE_RAW  0     /* 4-byte codewords, row-major within the tile */
+#define TILE_RANS 1     /* the same codewords through Rans_encode() */
+
+/* or'd into a coding: the tile's codewords are a grid of their own
+ * through Predict_encode() (predict.h) */
+#define TILE_PREDICTED 0x80
+
+/* bytes of one index entry */
+#define TILE_OFFSET_BYTES 8
+
+/* default tile side, in pixels */
+#define TILE_DEFAULT 256
+
+/* a container checked by Tile_open(); src must outlive it */
+typedef struct Tile_layout {
+    unsigned width, height;             /* of the image, in pixels */
+    unsigned tile_width, tile_height;   /* in pixels, even */
+    unsigned across, down;              /* tiles per row and column */
+    const uint8_t *src;                 /* the whole container */
+    size_t n;                           /* its length */
+    size_t index;                       /* where the index starts */
+    size_t data;                        /* where the tile data starts */
+} Tile_layout;
+
+/* Function: Tile_bound()
+ * Job: return the most bytes Tile_pack() writes for these dimensions.
+ */
+extern size_t Tile_bound(unsigned width, unsigned height,
+                         unsigned tile_width, unsigned tile_height);
+
+/* Function: Tile_pack()
+ * Job: write a container for the width x height image whose codewords,
+ *      in format 2 order, are at grid; return the bytes written. dest
+ *      must hold Tile_bound() bytes. Tiles are written in coding, except
+ *      that a tile that TILE_RANS would not make smaller is left raw.
+ * Error condition: CRE if a dimension is odd or less than 2, or coding is
+ *      not TILE_RAW or TILE_RANS, either of them possibly with
+ *      TILE_PREDICTED.
+ */
+extern size_t Tile_pack(const uint8_t *grid, unsigned width,
+                        unsigned height, unsigned tile_width,
+                        unsigned tile_height, int coding, uint8_t *dest);
+
+/* Function: Tile_open()
+ * Job: check the header and index of the container in src[0..n).
+ * Expected output: ARITH_OK with *layout filled in; ARITH_EBADFORMAT if
+ *      src is not a container or its index is inconsistent, and
+ *      ARITH_ETRUNCATED if it ends early.
+ */
+extern Arith_status Tile_open(const uint8_t *src, size_t n,
+                              Tile_layout *layout);
+
+/* Function: Tile_bounds()
+ * Job: store the position and size in pixels of tile index.
+ */
+extern void Tile_bounds(const Tile_layout *layout, unsigned index,
+                        unsigned *x, unsigned *y, unsigned *width,
+                        unsigned *height);
+
+/* Function: Tile_unpack()
+ * Job: decode the codewords of tile index into a format 2 grid whose
+ *      rows of blocks are stride bytes apart, starting at the tile's own
+ *      first block, grid + (y / 2) * stride + (x / 2) * CODEWORD_BYTES.
+ * Expected output: ARITH_OK, or ARITH_EBADFORMAT if the tile is corrupt.
+ */
+extern Arith_status Tile_unpack(const Tile_layout *layout, unsigned index,
+                                uint8_t *grid, size_t stride);
+
+/* Function: Tile_decode()
+ * Job: decode every tile into the P6 samples of the whole image (rows of
+ *      3 * width bytes, no header) at pixels, on threads threads (0: one
+ *      per online processor). Tiles are independent, so the threads
+ *      share nothing but a counter of the next tile.
+ * Expected output: ARITH_OK, ARITH_EBADFORMAT or ARITH_ENOMEM.
+ */
+extern Arith_status Tile_decode(const Tile_layout *layout, unsigned threads,
+                                uint8_t *pixels);
+
+/* Function: Tile_decode_one()
+ * Job: decode tile index alone into P6 samples (rows of 3 * its width
+ *      bytes) at pixels.
+ * Expected output: as for Tile_decode().
+ */
+extern Arith_status Tile_decode_one(const Tile_layout *layout,
+                                    unsigned index, uint8_t *pixels);
+
+#endif
@@ -0,0 +1,280 @@
+/*********************************************************************
+ *                     tilecache.c (Implementation)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the implementation for the shared tile cache. Each
+ *              entry sits on a chain of a hash table, found by its key,
+ *              and on a list from most to least recently used; a hit
+ *              moves it to the front and room is made from the back.
+ *              The table doubles whenever the entries outnumber its
+ *              chains.
+ *********************************************************************/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "tilecache.h"
+
+#define T Tilecache_T
+
+#define FIRST_CHAINS 256
+
+typedef struct Entry {
+    Tilecache_key key;
+    struct Entry *chain;            /* next on the same chain */
+    struct Entry *newer, *older;    /* neighbours in the list */
+    size_t len;
+    uint8_t tile[];
+} Entry;
+
+struct T {
+    pthread_mutex_t lock;
+    size_t budget, bytes;
+    unsigned entries;
+    unsigned nchains;           /* a power of 2 */
+    Entry **chains;
+    Entry *newest, *oldest;
+    uint64_t hits, misses;
+};
+
+static Entry **find(T cache, const Tilecache_key *key);
+static unsigned hash(const Tilecache_key *key);
+static int sameKey(const Tilecache_key *x, const Tilecache_key *y);
+static void detach(T cache, Entry *entry);
+static void pushNewest(T cache, Entry *entry);
+static void drop(T cache, Entry *entry);
+static void grow(T cache);
+
+
+/*  Name: Tilecache_new
+ *  Purpose: This function creates an empty cache.
+ *  Input: the most bytes of tiles to hold
+ *  Output: the cache, or NULL when out of memory
+ */
+T Tilecache_new(size_t budget)
+{
+    T cache = calloc(1, sizeof(*cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache -> chains = calloc(FIRST_CHAINS, sizeof(*cache -> chains));
+    if (cache -> chains == NULL) {
+        free(cache);
+        return NULL;
+    }
+    cache -> nchains = FIRST_CHAINS;
+    cache -> budget = budget;
+    pthread_mutex_init(&cache -> lock, NULL);
+    return cache;
+}
+
+/*  Name: Tilecache_free
+ *  Purpose: This function frees a cache and every tile in it.
+ *  Error condition: CRE if cache or *cache is NULL.
+ */
+void Tilecache_free(T *cache)
+{
+    assert(cache != NULL && *cache != NULL);
+    while ((*cache) -> oldest != NULL) {
+        drop(*cache, (*cache) -> oldest);
+    }
+    pthread_mutex_destroy(&(*cache) -> lock);
+    free((*cache) -> chains);
+    free(*cache);
+    *cache = NULL;
+}
+
+/*  Name: Tilecache_get
+ *  Purpose: This function copies out a cached tile and makes it the most
+ *           recently used.
+ *  Input: the cache, the key, and the destination and its length
+ *  Output: 1 on a hit, 0 on a miss
+ *  Error condition: CRE if a pointer is NULL.
+ */
+int Tilecache_get(T cache, const Tilecache_key *key, uint8_t *dest,
+                  size_t len)
+{
+    assert(cache != NULL && key != NULL && dest != NULL);
+    pthread_mutex_lock(&cache -> lock);
+    Entry *entry = *find(cache, key);
+    int hit = entry != NULL && entry -> len == len;
+    if (hit) {
+        memcpy(dest, entry -> tile, len);
+        detach(cache, entry);
+        pushNewest(cache, entry);
+        cache -> hits++;
+    } else {
+        cache -> misses++;
+    }
+    pthread_mutex_unlock(&cache -> lock);
+    return hit;
+}
+
+/*  Name: Tilecache_put
+ *  Purpose: This function caches a copy of a tile, dropping the least
+ *           recently used tiles until it fits. Out of memory, the tile
+ *           is simply not kept.
+ *  Input: the cache, the key, and the tile and its length
+ *  Output: N/A
+ *  Error condition: CRE if a pointer is NULL.
+ */
+void Tilecache_put(T cache, const Tilecache_key *key, const uint8_t *tile,
+                   size_t len)
+{
+    assert(cache != NULL && key != NULL && tile != NULL);
+    if (len > cache -> budget) {
+        return;
+    }
+    Entry *entry = malloc(sizeof(*entry) + len);
+    if (entry == NULL) {
+        return;
+    }
+    entry -> key = *key;
+    entry -> len = len;
+    memcpy(entry -> tile, tile, len);
+
+    pthread_mutex_lock(&cache -> lock);
+    Entry *old = *find(cache, key);
+    if (old != NULL) {
+        drop(cache, old);
+    }
+    while (cache -> bytes + len > cache -> budget) {
+        drop(cache, cache -> oldest);
+    }
+    Entry **chain = &cache -> chains[hash(key) & (cache -> nchains - 1)];
+    entry -> chain = *chain;
+    *chain = entry;
+    pushNewest(cache, entry);
+    cache -> bytes += len;
+    if (++cache -> entries > cache -> nchains) {
+        grow(cache);
+    }
+    pthread_mutex_unlock(&cache -> lock);
+}
+
+/*  Name: Tilecache_stats
+ *  Purpose: This function reports how the cache has done; any pointer
+ *           may be NULL.
+ */
+void Tilecache_stats(T cache, uint64_t *hits, uint64_t *misses,
+                     size_t *bytes)
+{
+    assert(cache != NULL);
+    pthread_mutex_lock(&cache -> lock);
+    if (hits != NULL) {
+        *hits = cache -> hits;
+    }
+    if (misses != NULL) {
+        *misses = cache -> misses;
+    }
+    if (bytes != NULL) {
+        *bytes = cache -> bytes;
+    }
+    pthread_mutex_unlock(&cache -> lock);
+}
+
+/*  Name: find
+ *  Purpose: This function finds the link that points to the entry of key
+ *           on its chain.
+ *  Output: the link; it holds NULL if key is not cached
+ */
+static Entry **find(T cache, const Tilecache_key *key)
+{
+    Entry **link = &cache -> chains[hash(key) & (cache -> nchains - 1)];
+    while (*link != NULL && !sameKey(&(*link) -> key, key)) {
+        link = &(*link) -> chain;
+    }
+    return link;
+}
+
+/*  Name: hash
+ *  Purpose: This function mixes every field of a key (FNV-1a over 64-bit
+ *           words).
+ */
+static unsigned hash(const Tilecache_key *key)
+{
+    uint64_t words[] = { key -> device, key -> inode, key -> size,
+                         key -> mtime, key -> scale,
+                         (uint64_t)key -> x << 32 | key -> y };
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned k = 0; k < sizeof(words) / sizeof(words[0]); k++) {
+        h = (h ^ words[k]) * 1099511628211ull;
+    }
+    return h ^ h >> 32;
+}
+
+static int sameKey(const Tilecache_key *x, const Tilecache_key *y)
+{
+    return x -> device == y -> device && x -> inode == y -> inode &&
+           x -> size == y -> size && x -> mtime == y -> mtime &&
+           x -> scale == y -> scale && x -> x == y -> x && x -> y == y -> y;
+}
+
+/*  Name: detach / pushNewest
+ *  Purpose: These functions take an entry off the list / put it on the
+ *           front.
+ */
+static void detach(T cache, Entry *entry)
+{
+    if (entry -> newer != NULL) {
+        entry -> newer -> older = entry -> older;
+    } else {
+        cache -> newest = entry -> older;
+    }
+    if (entry -> older != NULL) {
+        entry -> older -> newer = entry -> newer;
+    } else {
+        cache -> oldest = entry -> newer;
+    }
+}
+
+static void pushNewest(T cache, Entry *entry)
+{
+    entry -> newer = NULL;
+    entry -> older = cache -> newest;
+    if (cache -> newest != NULL) {
+        cache -> newest -> newer = entry;
+    } else {
+        cache -> oldest = entry;
+    }
+    cache -> newest = entry;
+}
+
+/*  Name: drop
+ *  Purpose: This function takes an entry off its chain and the list and
+ *           frees it.
+ */
+static void drop(T cache, Entry *entry)
+{
+    Entry **link = find(cache, &entry -> key);
+    *link = entry -> chain;
+    detach(cache, entry);
+    cache -> bytes -= entry -> len;
+    cache -> entries--;
+    free(entry);
+}
+
+/*  Name: grow
+ *  Purpose: This function doubles the chains and moves every entry to
+ *           its new one; if that memory cannot be had, the chains just
+ *           get longer.
+ */
+static void grow(T cache)
+{
+    unsigned nchains = cache -> nchains * 2;
+    Entry **chains = calloc(nchains, sizeof(*chains));
+    if (chains == NULL) {
+        return;
+    }
+    for (Entry *e = cache -> newest; e != NULL; e = e -> older) {
+        Entry **chain = &chains[hash(&e -> key) & (nchains - 1)];
+        e -> chain = *chain;
+        *chain = e;
+    }
+    free(cache -> chains);
+    cache -> chains = chains;
+    cache -> nchains = nchains;
+}
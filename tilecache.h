@@ -0,0 +1,51 @@
+/*********************************************************************
+ *                     tilecache.h (Interface)
+ *
+ *     Assignment: HW4: arith
+ *     Authors:  Hanfeng Xu (hxu06), William Huang (whuang08)
+ *     Purpose: This is the interface for a cache of decoded tiles shared
+ *              by many threads. A tile is any run of bytes, found by a
+ *              key that names the file it came from (its device, inode,
+ *              size and modification time, so a rewritten file misses),
+ *              the scale and the tile's place. The cache holds at most a
+ *              budget of bytes; when a tile does not fit, the least
+ *              recently used ones are dropped. Tiles are copied in and
+ *              out under one lock, so no caller ever holds one that
+ *              another thread may drop.
+ *********************************************************************/
+
+#ifndef TILECACHE_INCLUDED
+#define TILECACHE_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define T Tilecache_T
+typedef struct T *T;
+
+typedef struct Tilecache_key {
+    uint64_t device, inode, size, mtime;    /* mtime in nanoseconds */
+    unsigned scale, x, y;
+} Tilecache_key;
+
+/* returns an empty cache of at most budget bytes, or NULL when out of
+ * memory */
+extern T      Tilecache_new (size_t budget);
+extern void   Tilecache_free(T *cache);
+
+/* copies the tile of key to dest, which holds len bytes, and returns 1;
+ * returns 0 if it is not cached or is not len bytes long */
+extern int    Tilecache_get (T cache, const Tilecache_key *key,
+                             uint8_t *dest, size_t len);
+
+/* caches a copy of the len bytes at tile under key, replacing any tile
+ * already there; a tile larger than the budget is not kept */
+extern void   Tilecache_put (T cache, const Tilecache_key *key,
+                             const uint8_t *tile, size_t len);
+
+/* the hits and misses of Tilecache_get() so far and the bytes cached */
+extern void   Tilecache_stats(T cache, uint64_t *hits, uint64_t *misses,
+                              size_t *bytes);
+
+#undef T
+#endif